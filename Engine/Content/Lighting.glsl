@@ -0,0 +1,31 @@
+﻿// Clustered point lights, built every frame by Source/Private/Renderer/LightClusters.hpp and read through texture buffers.
+// Needs UniformBlocks.glsl for the frame's cluster layout.
+
+uniform samplerBuffer lightData;      // Two texels per light, xyz: view-space position, w: radius, then rgb: color times intensity
+uniform usamplerBuffer lightClusters; // Per cluster, x: first entry in lightIndices, y: light count
+uniform usamplerBuffer lightIndices;  // Light indices, cluster after cluster
+
+int LightCluster(vec2 fragCoord, float viewDepth)
+{
+    ivec3 cell = ivec3(fragCoord * frame.clusterScale.zw, log(viewDepth) * frame.clusterScale.x + frame.clusterScale.y);
+    cell = clamp(cell, ivec3(0), frame.clusterCount.xyz - 1);
+    return (cell.z * frame.clusterCount.y + cell.y) * frame.clusterCount.x + cell.x;
+}
+
+// Light arriving at a view-space position from the lights of its cluster plus the ambient light.
+// Meshes carry no normals yet, so lights only fall off with distance.
+vec3 ClusteredLight(vec2 fragCoord, vec3 viewPosition)
+{
+    uvec2 range = texelFetch(lightClusters, LightCluster(fragCoord, -viewPosition.z)).xy;
+
+    vec3 light = frame.ambientLight.rgb;
+    for (uint entry = range.x; entry < range.x + range.y; entry++)
+    {
+        int index = int(texelFetch(lightIndices, int(entry)).x);
+        vec4 sphere = texelFetch(lightData, index * 2);
+        vec3 offset = sphere.xyz - viewPosition;
+        float falloff = clamp(1.0 - dot(offset, offset) / (sphere.w * sphere.w), 0.0, 1.0);
+        light += texelFetch(lightData, index * 2 + 1).rgb * falloff * falloff;
+    }
+    return light;
+}
@@ -0,0 +1,12 @@
+﻿// Sampling textures placed by Source/Private/Renderer/TextureAtlas.hpp, every texture is a region of a sampler2DArray layer.
+
+// Images sharing a layer with others can't repeat, their coordinates are clamped to the region.
+// A region covering the whole layer has a scale of exactly 1 and repeats like a plain texture.
+vec4 SampleAtlas(sampler2DArray atlas, vec4 rect, int layer, vec2 uv)
+{
+    if (rect.zw != vec2(1.0))
+    {
+        uv = clamp(uv, 0.0, 1.0);
+    }
+    return texture(atlas, vec3(rect.xy + uv * rect.zw, float(layer)));
+}
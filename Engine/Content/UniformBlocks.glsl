@@ -0,0 +1,36 @@
+﻿// Uniform blocks shared by all shaders, mirrors Source/Private/Renderer/UniformBlocks.hpp.
+// The renderer assigns the binding points by block name after linking.
+
+layout (std140) uniform FrameData
+{
+    mat4 view;
+    mat4 projection;
+    mat4 viewProjection;
+    vec4 cameraPosition;
+    vec4 time; // x: seconds since start, y: delta time
+    vec4 clusterScale; // x: depth slices per log view depth, y: slice at view depth 1, zw: clusters per pixel
+    ivec4 clusterCount; // xyz: light clusters along x, y and depth, w: lights
+    vec4 ambientLight;  // rgb: added to the clustered lights
+} frame;
+
+layout (std140) uniform PassData
+{
+    vec4 viewport; // xy: size in pixels, zw: 1 / size
+    ivec4 pass;    // x: render pass, 0 opaque, 1 transparent, 2 overlay
+} pass;
+
+// Instances pass their index into `materials` as a flat uint, see MaterialsPerBlock
+#define MATERIALS_PER_BLOCK 128
+
+struct Material
+{
+    vec4 color;
+    vec4 params;           // x: how much of texture2 is blended over texture1 with TEXTURE_BLEND, y: alpha cutoff with ALPHA_TEST
+    vec4 textureRects[4];  // Per texture slot, xy: offset, zw: scale of the texture coordinates within the atlas layer
+    ivec4 textureLayers;   // Per texture slot, atlas layer
+};
+
+layout (std140) uniform MaterialData
+{
+    Material materials[MATERIALS_PER_BLOCK];
+};
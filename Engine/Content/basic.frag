@@ -1,14 +1,40 @@
 ﻿#version 330 core
 
+// Variants:
+//   TEXTURE_BLEND       blend texture2 over texture1 by material.params.x
+//   ALPHA_TEST          discard fragments with alpha below material.params.y
+//   CLUSTERED_LIGHTING  multiply by the ambient light plus the point lights of the pixel's cluster
+
+#include "UniformBlocks.glsl"
+#include "TextureAtlas.glsl"
+#include "Lighting.glsl"
+
 out vec4 outColor;
 
-in vec3 vertexColor;
 in vec2 texCoord;
+in vec3 viewPosition;
+flat in uint materialIndex;
 
-uniform sampler2D texture1;
-uniform sampler2D texture2;
+uniform sampler2DArray texture1;
+uniform sampler2DArray texture2;
 
 void main()
 {
-    outColor = mix(texture(texture1, texCoord), texture(texture2, texCoord), 0.2);
+    Material material = materials[materialIndex];
+
+    vec4 color = SampleAtlas(texture1, material.textureRects[0], material.textureLayers.x, texCoord);
+#ifdef TEXTURE_BLEND
+    color = mix(color, SampleAtlas(texture2, material.textureRects[1], material.textureLayers.y, texCoord), material.params.x);
+#endif
+    outColor = color * material.color;
+#ifdef CLUSTERED_LIGHTING
+    outColor.rgb *= ClusteredLight(gl_FragCoord.xy, viewPosition);
+#endif
+
+#ifdef ALPHA_TEST
+    if (outColor.a < material.params.y)
+    {
+        discard;
+    }
+#endif
 }
@@ -1,16 +1,21 @@
 ﻿#version 330 core
 
+#include "UniformBlocks.glsl"
+
 layout (location = 0) in vec3 inPosition;
 layout (location = 1) in vec2 inTexCoord;
+layout (location = 2) in mat4 inModel; // Per instance, takes locations 2 to 5
+layout (location = 6) in uint inMaterial; // Per instance, index into MaterialData
 
 out vec2 texCoord;
-
-uniform mat4 model;
-uniform mat4 view;
-uniform mat4 projection;
+out vec3 viewPosition;
+flat out uint materialIndex;
 
 void main()
 {
-    gl_Position = projection * view * model * vec4(inPosition, 1.0);
+    vec4 worldPosition = inModel * vec4(inPosition, 1.0);
+    gl_Position = frame.viewProjection * worldPosition;
+    viewPosition = (frame.view * worldPosition).xyz;
     texCoord = inTexCoord;
+    materialIndex = inMaterial;
 }
@@ -0,0 +1,14 @@
+﻿#version 330 core
+
+out vec4 outColor;
+
+in vec2 texCoord;
+in vec4 color;
+
+uniform sampler2DArray texture1;
+uniform int atlasLayer;
+
+void main()
+{
+    outColor = texture(texture1, vec3(texCoord, float(atlasLayer))) * color;
+}
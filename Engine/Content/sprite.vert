@@ -0,0 +1,19 @@
+﻿#version 330 core
+
+// Sprites from Source/Private/Renderer/SpriteBatch.hpp, one quad per sprite expanded on the CPU
+
+layout (location = 0) in vec2 inPosition; // Pixels from the top left
+layout (location = 1) in vec2 inTexCoord; // Already placed in the sprite's atlas region
+layout (location = 2) in vec4 inColor;
+
+out vec2 texCoord;
+out vec4 color;
+
+uniform mat4 screenToClip;
+
+void main()
+{
+    gl_Position = screenToClip * vec4(inPosition, 0.0, 1.0);
+    texCoord = inTexCoord;
+    color = inColor;
+}
@@ -0,0 +1,448 @@
+﻿#include "Benchmark.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <random>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Blackbox.hpp"
+#include "Jobs/JobSystem.hpp"
+#include "Logging/BinaryLog.hpp"
+#include "Renderer/FrustumCulling.hpp"
+#include "Renderer/NullBackend.hpp"
+#include "Renderer/RenderGraph.hpp"
+#include "Renderer/SpriteBatch.hpp"
+#include "Renderer/TextureAtlas.hpp"
+#include "Renderer/TransientTargetPool.hpp"
+
+namespace blackbox
+{
+    namespace
+    {
+        constexpr uint32_t Iterations = 10; // The fastest run counts, the others warm caches and absorb noise
+
+        template <typename Function>
+        float BestOf(Function&& function)
+        {
+            float best = std::numeric_limits<float>::max();
+            for (uint32_t iteration = 0; iteration < Iterations; iteration++)
+            {
+                const auto start = std::chrono::steady_clock::now();
+                function();
+                best = std::min(best, std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count());
+            }
+            return best;
+        }
+    }
+
+    bool Benchmark::Run(const std::string_view name, JobSystem& jobs)
+    {
+        if (name == "binarylog")
+        {
+            return BinaryLogging();
+        }
+        if (name == "culling")
+        {
+            return Culling(jobs);
+        }
+        if (name == "rendergraph")
+        {
+            return RenderGraphAliasing();
+        }
+        if (name == "sprites")
+        {
+            return Sprites();
+        }
+
+        LogEngine->Error("Unknown benchmark \"{}\", available: binarylog, culling, rendergraph, sprites", name);
+        return false;
+    }
+
+    bool Benchmark::BinaryLogging()
+    {
+        // Few enough calls per run that the staging buffers never fill, a dropped call would look cheaper than it is
+        constexpr uint32_t Calls = 10'000;
+        constexpr auto DrainTime = std::chrono::milliseconds(10);
+        constexpr double GoalNs = 50.0;
+
+        const bool opened = !BinaryLog::IsOpen();
+        if (opened && !BinaryLog::Open("Saved/Logs/Benchmark.bblog"))
+        {
+            return false;
+        }
+
+        const auto category = std::make_unique<Logger>("LogBenchmark");
+        category->SetLevel(LogLevel::Trace);
+        const auto logCalls = [&category]
+        {
+            for (uint32_t i = 0; i < Calls; i++)
+            {
+                BB_LOG_BINARY(category, Trace, "Entity {} moved to {:.2f}, {:.2f}", i, static_cast<float>(i) * 0.5f, -static_cast<float>(i));
+            }
+        };
+
+        // Each run starts after the writer had time to empty the buffers of the previous one. `run` returns the
+        // milliseconds it spent logging.
+        const auto bestOf = [&](const auto& run)
+        {
+            float best = std::numeric_limits<float>::max();
+            for (uint32_t iteration = 0; iteration < Iterations; iteration++)
+            {
+                std::this_thread::sleep_for(DrainTime);
+                best = std::min(best, run());
+            }
+            return best;
+        };
+
+        const float singleMs = bestOf([&]
+        {
+            const auto start = std::chrono::steady_clock::now();
+            logCalls();
+            return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        });
+
+        // Every thread logs into its own staging buffer, they only contend for the cache lines shared with the writer.
+        // Threads attach their buffer and wait before the clock starts, so neither counts.
+        const uint32_t threadCount = std::clamp(std::thread::hardware_concurrency(), 2u, 8u);
+        const float contendedMs = bestOf([&]
+        {
+            std::atomic<uint32_t> ready {0};
+            std::atomic<bool> go {false};
+            std::chrono::steady_clock::time_point start {};
+            {
+                std::vector<std::jthread> threads {};
+                threads.reserve(threadCount);
+                for (uint32_t thread = 0; thread < threadCount; thread++)
+                {
+                    threads.emplace_back([&, thread]
+                    {
+                        BB_LOG_BINARY(category, Trace, "Benchmark thread {} started", thread);
+                        ready.fetch_add(1);
+                        while (!go.load())
+                        {
+                            std::this_thread::yield();
+                        }
+                        logCalls();
+                    });
+                }
+                while (ready.load() < threadCount)
+                {
+                    std::this_thread::yield();
+                }
+                start = std::chrono::steady_clock::now();
+                go.store(true);
+            }
+            return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        });
+
+        if (opened)
+        {
+            BinaryLog::Close();
+        }
+
+        const double singleNs = singleMs * 1e6 / Calls;
+        const double contendedNs = contendedMs * 1e6 / Calls;
+        LogEngine->Info("Binary log: {:.1f}ns per call on one thread ({:.1f}M calls/s), {:.1f}ns per call with {} threads at once ({:.1f}M calls/s in all), goal {:.0f}ns",
+            singleNs, 1e3 / singleNs, contendedNs, threadCount, 1e3 * threadCount / contendedNs, GoalNs);
+        return true;
+    }
+
+    bool Benchmark::Culling(JobSystem& jobs)
+    {
+        constexpr size_t ObjectCounts[] {10'000, 100'000, 1'000'000};
+        constexpr float WorldSize = 2000.0f;
+
+        // What the culler replaces: bounds stored per object, tested one at a time
+        struct ObjectBounds
+        {
+            float3 center {};
+            float3 extents {};
+            float radius {0.0f};
+        };
+
+        // Objects spread through a cube around a camera that sees about a tenth of it
+        const glm::mat4 view = glm::lookAt(glm::vec3(0.0f), glm::vec3(0.0f, 0.0f, -1.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        const glm::mat4 projection = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, WorldSize * 0.5f);
+        const Frustum frustum = Frustum::FromMatrix(projection * view);
+
+        std::mt19937 random(42);
+        std::uniform_real_distribution<float> position(-WorldSize * 0.5f, WorldSize * 0.5f);
+        std::uniform_real_distribution<float> size(0.5f, 5.0f);
+
+        bool passed {true};
+        for (const size_t count : ObjectCounts)
+        {
+            std::vector<ObjectBounds> objects {};
+            objects.reserve(count);
+            FrustumCuller culler {};
+            culler.Reserve(count);
+
+            // Half spheres, half boxes
+            for (size_t i = 0; i < count; i++)
+            {
+                const float3 center(position(random), position(random), position(random));
+                if (i % 2 == 0)
+                {
+                    const float radius = size(random);
+                    objects.push_back({.center = center, .extents = float3(radius), .radius = radius});
+                    culler.AddSphere(center, radius);
+                }
+                else
+                {
+                    const float3 extents(size(random), size(random), size(random));
+                    objects.push_back({.center = center, .extents = extents, .radius = glm::length(extents)});
+                    culler.Add(center, extents);
+                }
+            }
+
+            std::vector<uint32_t> reference {};
+            reference.reserve(count);
+            const float scalarMs = BestOf([&]
+            {
+                reference.clear();
+                for (size_t i = 0; i < objects.size(); i++)
+                {
+                    if (frustum.Intersects(objects[i].center, objects[i].extents, objects[i].radius))
+                    {
+                        reference.push_back(static_cast<uint32_t>(i));
+                    }
+                }
+            });
+
+            bool matches {true};
+            const float simdMs = BestOf([&] { matches &= std::ranges::equal(culler.Cull(frustum), reference); });
+            const float jobsMs = BestOf([&] { matches &= std::ranges::equal(culler.Cull(frustum, jobs), reference); });
+
+            LogEngine->Info("Culling {} objects, {} visible: scalar {:.3f}ms, SSE2 {:.3f}ms ({:.1f}x), SSE2 on {} workers {:.3f}ms ({:.1f}x)",
+                count, reference.size(), scalarMs, simdMs, scalarMs / simdMs, jobs.WorkerCount(), jobsMs, scalarMs / jobsMs);
+
+            if (!matches)
+            {
+                LogEngine->Error("Culling {} objects: FrustumCuller disagrees with the scalar reference", count);
+                passed = false;
+            }
+        }
+        return passed;
+    }
+
+    bool Benchmark::RenderGraphAliasing()
+    {
+        constexpr uint2 Size {1920, 1080};
+        constexpr uint32_t BloomLevels = 5;
+        RenderGraph graph {};
+        std::vector<TargetHandle> transients {};
+
+        // Depth prepass, G-buffer, SSAO, deferred lighting, transparency, a bloom chain, tonemapping and FXAA.
+        // The debug view of the normals is never shown, so its pass is culled.
+        auto build = [&]
+        {
+            graph.Reset();
+            transients.clear();
+            auto create = [&](RenderGraph::PassBuilder& pass, const std::string_view name, const TargetDesc& desc)
+            {
+                return transients.emplace_back(pass.Create(name, desc));
+            };
+            const uint2 half = Size / 2u;
+
+            const TargetHandle backbuffer = graph.Import("Backbuffer", {Size, TargetFormat::RGBA8});
+
+            RenderGraph::PassBuilder prepass = graph.AddPass("DepthPrepass", {});
+            const TargetHandle depth = create(prepass, "Depth", {Size, TargetFormat::Depth24Stencil8});
+
+            RenderGraph::PassBuilder gbuffer = graph.AddPass("GBuffer", {});
+            gbuffer.Read(depth).Write(depth);
+            const TargetHandle albedo = create(gbuffer, "Albedo", {Size, TargetFormat::RGBA8});
+            const TargetHandle normals = create(gbuffer, "Normals", {Size, TargetFormat::RG16F});
+            const TargetHandle material = create(gbuffer, "Material", {Size, TargetFormat::RGBA8});
+
+            RenderGraph::PassBuilder debug = graph.AddPass("DebugNormals", {});
+            debug.Read(normals);
+            create(debug, "DebugView", {Size, TargetFormat::RGBA8});
+
+            RenderGraph::PassBuilder ssao = graph.AddPass("SSAO", {});
+            ssao.Read(depth).Read(normals);
+            const TargetHandle occlusion = create(ssao, "Occlusion", {half, TargetFormat::R8});
+            RenderGraph::PassBuilder blurX = graph.AddPass("SSAOBlurX", {});
+            blurX.Read(occlusion);
+            const TargetHandle blurredX = create(blurX, "OcclusionBlurX", {half, TargetFormat::R8});
+            RenderGraph::PassBuilder blurY = graph.AddPass("SSAOBlurY", {});
+            blurY.Read(blurredX);
+            const TargetHandle blurred = create(blurY, "OcclusionBlurred", {half, TargetFormat::R8});
+
+            RenderGraph::PassBuilder lighting = graph.AddPass("Lighting", {});
+            lighting.Read(depth).Read(albedo).Read(normals).Read(material).Read(blurred);
+            const TargetHandle hdr = create(lighting, "SceneColor", {Size, TargetFormat::RGBA16F});
+
+            graph.AddPass("Transparent", {}).Read(depth).Read(hdr).Write(hdr);
+
+            // Downsampled into a mip chain, then added back up level by level
+            std::array<TargetHandle, BloomLevels> down {};
+            TargetHandle source = hdr;
+            for (uint32_t level = 0; level < BloomLevels; level++)
+            {
+                RenderGraph::PassBuilder pass = graph.AddPass("BloomDownsample", {});
+                pass.Read(source);
+                source = down[level] = create(pass, "BloomDown", {glm::max(half >> level, 1u), TargetFormat::RGBA16F});
+            }
+            for (uint32_t level = BloomLevels - 1; level > 0; level--)
+            {
+                RenderGraph::PassBuilder pass = graph.AddPass("BloomUpsample", {});
+                pass.Read(source).Read(down[level - 1]);
+                source = create(pass, "BloomUp", {glm::max(half >> (level - 1), 1u), TargetFormat::RGBA16F});
+            }
+
+            RenderGraph::PassBuilder tonemap = graph.AddPass("Tonemap", {});
+            tonemap.Read(hdr).Read(source);
+            const TargetHandle ldr = create(tonemap, "Tonemapped", {Size, TargetFormat::RGBA8});
+
+            graph.AddPass("FXAA", {}).Read(ldr).Write(backbuffer);
+            return graph.Compile();
+        };
+
+        bool compiled {true};
+        const float compileMs = BestOf([&] { compiled &= build(); });
+        if (!compiled)
+        {
+            LogEngine->Error("Render graph: the benchmark's graph didn't compile");
+            return false;
+        }
+
+        // Textures come from a pool like in a real frame, executing a second time must not create more
+        NullBackend backend {};
+        TransientTargetPool pool(backend);
+        graph.Execute(pool);
+        graph.Execute(pool);
+        bool passed {true};
+        if (pool.Size() != graph.PhysicalTargets().size())
+        {
+            LogEngine->Error("Render graph: the pool holds {} textures for {} physical targets", pool.Size(), graph.PhysicalTargets().size());
+            passed = false;
+        }
+
+        // Targets sharing a texture must never be alive at the same time
+        for (size_t i = 0; i < transients.size(); i++)
+        {
+            for (size_t j = i + 1; j < transients.size(); j++)
+            {
+                const uint32_t texture = graph.Texture(transients[i]).texture;
+                if (texture == 0 || texture != graph.Texture(transients[j]).texture)
+                {
+                    continue;
+                }
+                const uint2 first = graph.Lifetime(transients[i]);
+                const uint2 second = graph.Lifetime(transients[j]);
+                if (first.x <= second.y && second.x <= first.y)
+                {
+                    LogEngine->Error("Render graph: targets {} and {} share a texture while both are alive", i, j);
+                    passed = false;
+                }
+            }
+        }
+
+        const RenderGraphStats& stats = graph.Stats();
+        constexpr double Megabyte = 1024.0 * 1024.0;
+        LogEngine->Info("Render graph of {} passes at {}x{}, {} culled, compiled in {:.3f}ms", stats.passes, Size.x, Size.y, stats.culledPasses, compileMs);
+        LogEngine->Info("  {} transient targets in {} textures: peak target memory {:.1f}MB without aliasing, {:.1f}MB with ({:.0f}% less), {:.1f}MB alive at most",
+            stats.transientTargets, stats.physicalTargets, static_cast<double>(stats.transientBytes) / Megabyte, static_cast<double>(stats.aliasedBytes) / Megabyte,
+            100.0 - 100.0 * static_cast<double>(stats.aliasedBytes) / static_cast<double>(stats.transientBytes), static_cast<double>(stats.liveBytes) / Megabyte);
+        return passed;
+    }
+
+    bool Benchmark::Sprites()
+    {
+        constexpr size_t SpriteCounts[] {10'000, 100'000, 1'000'000};
+        constexpr uint32_t TextureCount = 64;
+        constexpr int16_t LayerCount = 4;
+        constexpr float FrameMs = 1000.0f / 60.0f;
+
+        std::mt19937 random(42);
+        std::uniform_real_distribution<float> position(0.0f, 1920.0f);
+        std::uniform_real_distribution<float> size(8.0f, 64.0f);
+        std::uniform_real_distribution<float> angle(0.0f, glm::two_pi<float>());
+        std::uniform_int_distribution<uint32_t> texture(1, TextureCount);
+        std::uniform_int_distribution<int> layer(-LayerCount / 2, LayerCount / 2 - 1);
+
+        // Textures of assorted small sizes, which the atlas packs onto several layers of its shared pages
+        NullBackend backend {};
+        const ShaderHandle shader = backend.CreateShader({}, {});
+        std::uniform_int_distribution<uint32_t> textureSize(32, TextureAtlas::SmallTextureSize);
+        for (uint32_t i = 0; i < TextureCount; i++)
+        {
+            const uint2 textureExtent(textureSize(random), textureSize(random));
+            const std::vector<uint8_t> rgba(size_t {textureExtent.x} * textureExtent.y * 4, 0xFF);
+            backend.CreateTexture(rgba, textureExtent, {});
+        }
+
+        bool passed {true};
+        for (const size_t count : SpriteCounts)
+        {
+            // Textures and layers in random order, the worst case for batching before the sort
+            std::vector<Sprite> input(count);
+            for (Sprite& sprite : input)
+            {
+                sprite = {
+                    .position = {position(random), position(random) * 0.5625f},
+                    .size = float2(size(random)),
+                    .rotation = angle(random),
+                    .texture = {texture(random)},
+                    .layer = static_cast<int16_t>(layer(random)),
+                };
+            }
+
+            SpriteBatch batch {};
+            const float submitMs = BestOf([&]
+            {
+                batch.Clear();
+                for (const Sprite& sprite : input)
+                {
+                    batch.Submit(sprite);
+                }
+            });
+            const float sortMs = BestOf([&] { batch.Sort(); });
+
+            // What GLBackend writes per sprite, its four vertices
+            std::vector<SpriteVertex> vertices(count * 4);
+            const float expandMs = BestOf([&]
+            {
+                const std::span<const uint32_t> order = batch.Order();
+                for (size_t i = 0; i < order.size(); i++)
+                {
+                    SpriteBatch::WriteQuad(input[order[i]], {0.25f, 0.5f, 0.125f, 0.125f}, std::span<SpriteVertex, 4>(vertices.data() + i * 4, 4));
+                }
+            });
+
+            // The sort must match a stable sort by layer, then texture
+            std::vector<uint32_t> reference(count);
+            for (uint32_t i = 0; i < count; i++)
+            {
+                reference[i] = i;
+            }
+            std::ranges::stable_sort(reference, {}, [&](const uint32_t i) { return std::pair(input[i].layer, input[i].texture.id); });
+            if (!std::ranges::equal(batch.Order(), reference))
+            {
+                LogEngine->Error("Sprites: SpriteBatch's order of {} sprites disagrees with std::stable_sort", count);
+                passed = false;
+            }
+
+            // Draws as the backend splits them, per atlas bin and layer and at most MaxSpritesPerDraw each
+            backend.BeginFrame(0, uint2(1920, 1080), float4(0.0f));
+            backend.DrawSprites(batch, shader);
+            const uint32_t draws = backend.Stats().spriteDrawCalls;
+            backend.EndFrame();
+
+            const float totalMs = submitMs + sortMs + expandMs;
+            LogEngine->Info("Sprites {}: submit {:.3f}ms, sort {:.3f}ms, expand {:.3f}ms, {:.3f}ms in all ({:.0f}% of a 60Hz frame), {} draws of {} textures on {} layers",
+                count, submitMs, sortMs, expandMs, totalMs, 100.0f * totalMs / FrameMs, draws, TextureCount, LayerCount);
+        }
+        return passed;
+    }
+}
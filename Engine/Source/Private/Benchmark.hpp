@@ -0,0 +1,34 @@
+﻿#pragma once
+
+#include <string_view>
+
+namespace blackbox
+{
+    class JobSystem;
+
+    /**
+     * Micro benchmarks of engine systems, run with -Benchmark=<name> instead of the main loop. Results go to the
+     * log, the exit code is 1 when a benchmark found its optimized path disagreeing with the reference.
+     *
+     *   binarylog    BB_LOG_BINARY calls per second from one thread and from several threads at once
+     *   culling      FrustumCuller against a scalar loop over 10k, 100k and 1M objects
+     *   rendergraph  RenderGraph of a deferred frame with post-processing, target memory with and without aliasing
+     *   sprites      SpriteBatch submitting, sorting and writing vertices of 10k, 100k and 1M sprites against a 60Hz
+     *                frame, with the draw calls NullBackend splits them into
+     *
+     * These stop short of the GPU. A -Frames=N run logs its average and slowest frame and the sprite draw calls when it
+     * ends, so the whole path is timed with e.g. -DemoSprites=100000 -Headless -Frames=600.
+     */
+    class Benchmark
+    {
+    public:
+        // False when there is no benchmark called `name` or it failed
+        static bool Run(std::string_view name, JobSystem& jobs);
+
+    private:
+        static bool BinaryLogging();
+        static bool Culling(JobSystem& jobs);
+        static bool RenderGraphAliasing();
+        static bool Sprites();
+    };
+}
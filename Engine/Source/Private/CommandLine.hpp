@@ -0,0 +1,62 @@
+﻿#pragma once
+
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace blackbox
+{
+    /**
+     * Read-only view of the arguments the engine was started with.
+     * Options are written as `-Name` for flags and `-Name=Value` for values, names are case-sensitive.
+     *
+     *   Engine.exe -LogLevel=All=Warn,LogRenderer=Trace
+     */
+    class CommandLine
+    {
+        std::vector<std::string_view> arguments {};
+
+    public:
+        CommandLine() = default;
+        CommandLine(int argc, char* argv[]);
+
+        [[nodiscard]] bool HasFlag(std::string_view name) const;
+        [[nodiscard]] std::optional<std::string_view> GetValue(std::string_view name) const;
+    };
+
+    inline CommandLine::CommandLine(const int argc, char* argv[])
+    {
+        // Skip the executable path
+        for (int i = 1; i < argc; i++)
+        {
+            arguments.emplace_back(argv[i]);
+        }
+    }
+
+    inline bool CommandLine::HasFlag(const std::string_view name) const
+    {
+        for (const std::string_view argument : arguments)
+        {
+            if (argument.size() == name.size() + 1 && argument.front() == '-' && argument.substr(1) == name)
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+
+    inline std::optional<std::string_view> CommandLine::GetValue(const std::string_view name) const
+    {
+        for (const std::string_view argument : arguments)
+        {
+            if (argument.size() > name.size() + 1 && argument.front() == '-'
+                && argument.substr(1, name.size()) == name && argument[name.size() + 1] == '=')
+            {
+                return argument.substr(name.size() + 2);
+            }
+        }
+
+        return std::nullopt;
+    }
+}
@@ -0,0 +1,76 @@
+﻿#include "CrashHandler.hpp"
+
+#include <csignal>
+#include <cstdlib>
+#include <exception>
+
+namespace blackbox
+{
+    namespace
+    {
+        constexpr std::array FatalSignals {SIGSEGV, SIGABRT, SIGFPE, SIGILL};
+    }
+
+    void CrashHandler::Install()
+    {
+        for (const int signal : FatalSignals)
+        {
+            std::signal(signal, &CrashHandler::OnSignal);
+        }
+
+        std::set_terminate(&CrashHandler::OnTerminate);
+    }
+
+    void CrashHandler::AddCallback(const Callback callback)
+    {
+        for (size_t i = 0; i < callbackCount.load(); i++)
+        {
+            if (callbacks[i].load() == callback)
+            {
+                return;
+            }
+        }
+
+        const size_t index = callbackCount.fetch_add(1);
+        if (index >= MaxCallbacks)
+        {
+            callbackCount.store(MaxCallbacks);
+            return;
+        }
+
+        callbacks[index].store(callback);
+    }
+
+    void CrashHandler::RunCallbacks()
+    {
+        // A crash inside a callback must not recurse back into the callbacks
+        if (handling.test_and_set())
+        {
+            return;
+        }
+
+        const size_t count = callbackCount.load();
+        for (size_t i = 0; i < count && i < MaxCallbacks; i++)
+        {
+            if (const Callback callback = callbacks[i].load())
+            {
+                callback();
+            }
+        }
+    }
+
+    void CrashHandler::OnSignal(const int signal)
+    {
+        RunCallbacks();
+
+        // Hand the signal to the default handler so the process still terminates (and dumps) as usual
+        std::signal(signal, SIG_DFL);
+        std::raise(signal);
+    }
+
+    void CrashHandler::OnTerminate()
+    {
+        RunCallbacks();
+        std::abort();
+    }
+}
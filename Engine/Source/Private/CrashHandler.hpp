@@ -0,0 +1,33 @@
+﻿#pragma once
+
+#include <array>
+#include <atomic>
+
+namespace blackbox
+{
+    /**
+     * Runs registered callbacks when the process is about to die from a fatal signal (SIGSEGV, SIGABRT, ...)
+     * or an unhandled exception, then lets the default handler terminate the process.
+     *
+     * Callbacks run inside a signal handler, keep them short and avoid allocating or taking locks.
+     */
+    class CrashHandler
+    {
+    public:
+        using Callback = void(*)();
+
+        static void Install();
+        static void AddCallback(Callback callback);
+
+    private:
+        static constexpr size_t MaxCallbacks = 8;
+
+        inline static std::array<std::atomic<Callback>, MaxCallbacks> callbacks {};
+        inline static std::atomic<size_t> callbackCount {0};
+        inline static std::atomic_flag handling {};
+
+        static void RunCallbacks();
+        static void OnSignal(int signal);
+        static void OnTerminate();
+    };
+}
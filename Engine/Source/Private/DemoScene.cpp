@@ -0,0 +1,196 @@
+﻿#include "DemoScene.hpp"
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <glm/gtc/constants.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "EventBus.hpp"
+#include "Jobs/JobSystem.hpp"
+#include "Renderer/Renderer.hpp"
+
+namespace blackbox
+{
+    namespace
+    {
+        // Four vertices per face so every face gets the full texture
+        constexpr std::array<Vertex, 24> CubeVertices {{
+            {{-0.5f, -0.5f,  0.5f}, {0.0f, 0.0f}}, {{ 0.5f, -0.5f,  0.5f}, {1.0f, 0.0f}}, {{ 0.5f,  0.5f,  0.5f}, {1.0f, 1.0f}}, {{-0.5f,  0.5f,  0.5f}, {0.0f, 1.0f}},
+            {{ 0.5f, -0.5f, -0.5f}, {0.0f, 0.0f}}, {{-0.5f, -0.5f, -0.5f}, {1.0f, 0.0f}}, {{-0.5f,  0.5f, -0.5f}, {1.0f, 1.0f}}, {{ 0.5f,  0.5f, -0.5f}, {0.0f, 1.0f}},
+            {{-0.5f, -0.5f, -0.5f}, {0.0f, 0.0f}}, {{-0.5f, -0.5f,  0.5f}, {1.0f, 0.0f}}, {{-0.5f,  0.5f,  0.5f}, {1.0f, 1.0f}}, {{-0.5f,  0.5f, -0.5f}, {0.0f, 1.0f}},
+            {{ 0.5f, -0.5f,  0.5f}, {0.0f, 0.0f}}, {{ 0.5f, -0.5f, -0.5f}, {1.0f, 0.0f}}, {{ 0.5f,  0.5f, -0.5f}, {1.0f, 1.0f}}, {{ 0.5f,  0.5f,  0.5f}, {0.0f, 1.0f}},
+            {{-0.5f,  0.5f,  0.5f}, {0.0f, 0.0f}}, {{ 0.5f,  0.5f,  0.5f}, {1.0f, 0.0f}}, {{ 0.5f,  0.5f, -0.5f}, {1.0f, 1.0f}}, {{-0.5f,  0.5f, -0.5f}, {0.0f, 1.0f}},
+            {{-0.5f, -0.5f, -0.5f}, {0.0f, 0.0f}}, {{ 0.5f, -0.5f, -0.5f}, {1.0f, 0.0f}}, {{ 0.5f, -0.5f,  0.5f}, {1.0f, 1.0f}}, {{-0.5f, -0.5f,  0.5f}, {0.0f, 1.0f}},
+        }};
+
+        constexpr std::array<uint32_t, 36> CubeIndices {
+             0,  1,  2,  2,  3,  0,
+             4,  5,  6,  6,  7,  4,
+             8,  9, 10, 10, 11,  8,
+            12, 13, 14, 14, 15, 12,
+            16, 17, 18, 18, 19, 16,
+            20, 21, 22, 22, 23, 20,
+        };
+
+        // The cubes are solid, so each one is its own occluder
+        constexpr std::array<float3, CubeVertices.size()> CubePositions = []
+        {
+            std::array<float3, CubeVertices.size()> positions {};
+            for (size_t i = 0; i < CubeVertices.size(); i++)
+            {
+                positions[i] = CubeVertices[i].position;
+            }
+            return positions;
+        }();
+
+        // The cubes spin in place, the sphere through their corners bounds every rotation
+        constexpr float CubeRadius = 0.8660254f;
+
+        constexpr float Spacing = 1.5f;
+        constexpr float Offset = (DemoScene::GridSize - 1) * Spacing * 0.5f;
+
+        glm::vec3 GridPosition(const int32_t x, const int32_t z)
+        {
+            return {x * Spacing - Offset, 0.0f, z * Spacing - Offset};
+        }
+
+        constexpr float LightRadius = 3.0f;
+        constexpr float3 AmbientLight {0.15f};
+        constexpr std::array<float3, 4> LightColors {{{1.0f, 0.5f, 0.2f}, {0.3f, 0.6f, 1.0f}, {0.4f, 1.0f, 0.4f}, {1.0f, 0.3f, 0.8f}}};
+
+        constexpr float SpriteSize = 32.0f;
+
+        // Folds a position moving forever into one bouncing between 0 and `extent`
+        float Bounce(const float position, const float extent)
+        {
+            const float folded = std::fmod(std::abs(position), 2.0f * extent);
+            return folded > extent ? 2.0f * extent - folded : folded;
+        }
+    }
+
+    DemoScene::DemoScene(EventBus& eventbus, JobSystem& jobs, Renderer& renderer, const uint32_t lightCount, const uint32_t spriteCount)
+        : renderer(renderer)
+        , jobs(jobs)
+        , occlusion(jobs)
+        , lightCount(lightCount)
+        , spriteCount(spriteCount)
+    {
+        eventbus.Subscribe<TickEvent>(this, &DemoScene::OnTick);
+
+        const ShaderHandle basic = renderer.LoadShader("Content/basic.vert", "Content/basic.frag");
+        const ShaderHandle shader = lightCount > 0
+            ? renderer.LoadShaderVariant(basic, {"TEXTURE_BLEND", "CLUSTERED_LIGHTING"})
+            : renderer.LoadShaderVariant(basic, {"TEXTURE_BLEND"});
+        if (lightCount > 0)
+        {
+            renderer.SetAmbientLight(AmbientLight);
+        }
+        const TextureHandle face = renderer.LoadTexture("Content/awesomeface.png");
+        wood = renderer.CreateMaterial(shader, {renderer.LoadTexture("Content/ContainerWood.png"), face});
+        const TextureHandle bricks = renderer.LoadTexture("Content/BrickSquare.png");
+        brick = renderer.CreateMaterial(shader, {bricks, face});
+        spriteTextures = {face, bricks};
+        cube = renderer.CreateMesh(CubeVertices, CubeIndices);
+
+        transforms.resize(GridSize * GridSize);
+        culler.Reserve(GridSize * GridSize);
+        for (int32_t i = 0; i < GridSize * GridSize; i++)
+        {
+            culler.AddSphere(GridPosition(i % GridSize, i / GridSize), CubeRadius);
+        }
+    }
+
+    void DemoScene::OnTick(const TickEvent& event)
+    {
+        time += event.deltaTime;
+
+        constexpr float farPlane = 100.0f;
+        const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 6.0f, 14.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+        const glm::mat4 projection = glm::perspective(glm::radians(60.0f), renderer.AspectRatio(), 0.1f, farPlane);
+        renderer.SetCamera(view, projection, farPlane);
+
+        // Rings of lights over the grid, each light on its own radius and speed
+        for (uint32_t i = 0; i < lightCount; i++)
+        {
+            const float fraction = static_cast<float>(i) / static_cast<float>(lightCount);
+            const float distance = Offset * (0.2f + 0.8f * std::fmod(fraction * 7.0f, 1.0f));
+            const float angle = fraction * glm::two_pi<float>() + time * (0.3f + 0.4f * std::fmod(fraction * 3.0f, 1.0f));
+            renderer.SubmitLight({
+                .position = {std::cos(angle) * distance, 1.0f, std::sin(angle) * distance},
+                .radius = LightRadius,
+                .color = LightColors[i % LightColors.size()],
+                .intensity = 0.6f,
+            });
+        }
+
+        // Every sprite on its own path, submitted in an order that mixes layers and textures for the batch to sort
+        const float2 screen = float2(renderer.ViewportSize()) - SpriteSize;
+        for (uint32_t i = 0; i < spriteCount; i++)
+        {
+            const float seed = static_cast<float>(i) * 0.618034f;
+            const float2 velocity = float2(std::cos(seed * 11.0f), std::sin(seed * 13.0f)) * (60.0f + 40.0f * std::fmod(seed, 1.0f));
+            // Spread evenly over the screen by the R2 sequence
+            const float2 start = glm::fract(static_cast<float>(i) * float2(0.7548777f, 0.5698403f)) * screen;
+            renderer.SubmitSprite({
+                .position = float2(Bounce(start.x + velocity.x * time, screen.x), Bounce(start.y + velocity.y * time, screen.y)) + SpriteSize * 0.5f,
+                .size = float2(SpriteSize),
+                .rotation = time * (std::fmod(seed * 7.0f, 2.0f) - 1.0f),
+                .color = float4(LightColors[i % LightColors.size()], 0.9f),
+                .texture = spriteTextures[i / 3 % spriteTextures.size()],
+                .layer = static_cast<int16_t>(i % 3),
+            });
+        }
+
+        const glm::mat4 viewProjection = projection * view;
+        const std::span<const uint32_t> visible = culler.Cull(Frustum::FromMatrix(viewProjection), jobs);
+        jobs.ParallelFor(visible.size(), 64, [this, visible](const size_t begin, const size_t end, uint32_t)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                const auto x = static_cast<int32_t>(visible[i] % GridSize);
+                const auto z = static_cast<int32_t>(visible[i] / GridSize);
+                const float angle = time + static_cast<float>(x + z) * 0.3f;
+                transforms[visible[i]] = glm::rotate(glm::translate(glm::mat4(1.0f), GridPosition(x, z)), angle, glm::vec3(0.3f, 1.0f, 0.0f));
+            }
+        });
+
+        const auto occlusionStart = std::chrono::steady_clock::now();
+        occlusion.Begin(viewProjection);
+        for (const uint32_t index : visible)
+        {
+            occlusion.AddOccluder(CubePositions, CubeIndices, transforms[index]);
+        }
+        occlusion.Rasterize();
+        const float occlusionMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - occlusionStart).count();
+
+        std::atomic<uint32_t> occluded {0};
+        jobs.ParallelFor(visible.size(), 64, [this, visible, &occluded](const size_t begin, const size_t end, const uint32_t worker)
+        {
+            RenderRecorder recorder = renderer.Recorder(worker);
+            uint32_t hidden {0};
+            for (size_t i = begin; i < end; i++)
+            {
+                const auto x = static_cast<int32_t>(visible[i] % GridSize);
+                const auto z = static_cast<int32_t>(visible[i] / GridSize);
+                const glm::vec3 position = GridPosition(x, z);
+                if (!occlusion.IsVisible(position - CubeRadius, position + CubeRadius))
+                {
+                    hidden++;
+                    continue;
+                }
+                recorder.Submit(cube, (x + z) % 2 == 0 ? wood : brick, transforms[visible[i]]);
+            }
+            occluded += hidden;
+        });
+
+        cullingStats = {
+            .objects = static_cast<uint32_t>(culler.Size()),
+            .outsideFrustum = static_cast<uint32_t>(culler.Size() - visible.size()),
+            .occluded = occluded,
+            .occluderTriangles = occlusion.TriangleCount(),
+            .occlusionMs = occlusionMs,
+        };
+    }
+}
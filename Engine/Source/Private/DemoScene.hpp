@@ -0,0 +1,54 @@
+﻿#pragma once
+
+#include <array>
+#include <vector>
+#include <glm/mat4x4.hpp>
+
+#include "Events.hpp"
+#include "Renderer/FrustumCulling.hpp"
+#include "Renderer/OcclusionCulling.hpp"
+#include "Renderer/RenderStats.hpp"
+#include "Renderer/RenderTypes.hpp"
+
+namespace blackbox
+{
+    class EventBus;
+    class JobSystem;
+    class Renderer;
+
+    // Grid of spinning textured cubes drawn with basic.vert/basic.frag, the reference scene for headless
+    // golden images and renderer benchmarks. With lights the cubes use the CLUSTERED_LIGHTING variant and
+    // colored point lights circle above the grid. With sprites textured quads bounce over the screen.
+    class DemoScene
+    {
+        Renderer& renderer;
+        JobSystem& jobs;
+
+        MeshHandle cube {};
+        MaterialHandle wood {};
+        MaterialHandle brick {};
+        std::array<TextureHandle, 2> spriteTextures {};
+        FrustumCuller culler {}; // A sphere around every cube, in grid order
+        OcclusionCuller occlusion; // The cubes inside the frustum hide the ones behind them
+        std::vector<glm::mat4> transforms {};
+        CullingStats cullingStats {};
+        uint32_t lightCount {0};
+        uint32_t spriteCount {0};
+        float time {0.0f};
+
+    public:
+        static constexpr int32_t GridSize = 10;
+
+        DemoScene(EventBus& eventbus, JobSystem& jobs, Renderer& renderer, uint32_t lightCount = 0, uint32_t spriteCount = 0);
+
+        DemoScene(const DemoScene& other) = delete;
+        DemoScene& operator=(const DemoScene&) = delete;
+        DemoScene(DemoScene&& other) = delete;
+        DemoScene& operator=(DemoScene&& other) = delete;
+
+        [[nodiscard]] const CullingStats& Culling() const { return cullingStats; }
+
+    private:
+        void OnTick(const TickEvent& event);
+    };
+}
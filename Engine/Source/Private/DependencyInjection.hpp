@@ -5,6 +5,7 @@
 #include <memory>
 #include <typeindex>
 #include <unordered_map>
+#include <vector>
 
 #include "Blackbox.hpp"
 
@@ -13,10 +14,11 @@ namespace blackbox
     class Container
     {
         std::unordered_map<std::type_index, std::any> instances {};
+        std::vector<std::type_index> registrationOrder {};
 
     public:
         Container() = default;
-        ~Container() = default;
+        ~Container();
 
         Container(const Container& other) = delete;
         Container& operator=(const Container&) = delete;
@@ -44,9 +46,20 @@ namespace blackbox
 
         T* raw = instance.get();
         instances[std::type_index(typeid(T))] = std::move(instance);
+        registrationOrder.emplace_back(typeid(T));
         return raw;
     }
 
+    inline Container::~Container()
+    {
+        // Dependencies are registered before their dependents, so tear down in reverse (e.g. the renderer has to
+        // release its GL objects before the window destroys the context)
+        for (auto it = registrationOrder.rbegin(); it != registrationOrder.rend(); ++it)
+        {
+            instances.erase(*it);
+        }
+    }
+
     template <typename... T>
     std::tuple<T&...> Container::Get()
     {
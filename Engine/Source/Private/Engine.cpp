@@ -1,30 +1,146 @@
 ﻿#include "Engine.hpp"
 
+#include <algorithm>
+#include <charconv>
 #include <chrono>
+#include <filesystem>
 #include <thread>
 
 #include <SDL3/SDL_events.h>
+#include "Benchmark.hpp"
 #include "Blackbox.hpp"
+#include "CrashHandler.hpp"
+#include "DemoScene.hpp"
 #include "DependencyInjection.hpp"
 #include "FileIO.hpp"
+#include "FlightRecorder.hpp"
 #include "Window.hpp"
+#include "Renderer/GoldenImage.hpp"
+#include "Renderer/HeadlessContext.hpp"
+#include "Renderer/NullBackend.hpp"
+#include "Renderer/Renderer.hpp"
+#include "Renderer/SoftwareFramebuffer.hpp"
 #include "Helpers/SDL3EventHelper.hpp"
 #include "Input/Input.hpp"
+#include "Jobs/JobSystem.hpp"
+#include "Logging/BinaryLog.hpp"
 
 blackbox::BlackboxEngine Engine;
 
-void blackbox::BlackboxEngine::Initialize()
+void blackbox::BlackboxEngine::Initialize(const int argc, char* argv[])
 {
+    commandLine = CommandLine(argc, argv);
+
+    // The flight recorder registers first so its signal-safe dump runs before the best effort log flush
+    CrashHandler::Install();
+    FlightRecorder::Install("Saved/Logs/Crash.txt");
+    Logger::EnableAsync();
+    ConfigureLogLevels();
+
+    if (const auto path = commandLine.GetValue("BinaryLog"); path.has_value())
+    {
+        BinaryLog::Open(std::string(*path));
+    }
+    else if (commandLine.HasFlag("BinaryLog"))
+    {
+        BinaryLog::Open("Saved/Logs/Blackbox.bblog");
+    }
+
     LogEngine->Trace("Initializing Engine...");
 
-    SDL_Init(SDL_INIT_VIDEO);
+    if (const auto frames = commandLine.GetValue("Frames"); frames.has_value())
+    {
+        std::from_chars(frames->data(), frames->data() + frames->size(), frameLimit);
+    }
+
+    logStats = commandLine.HasFlag("Stats");
+
+    // Captured frames have to be reproducible, so they only depend on -Frames and not on how fast the machine is
+    if (commandLine.GetValue("Capture").has_value() || commandLine.GetValue("Golden").has_value())
+    {
+        fixedDeltaTime = 1.0f / 60.0f;
+    }
+
+    // Headless runs render offscreen through surfaceless EGL, so they don't need a display or video subsystem.
+    // Software runs render on the CPU and null renderer runs don't draw at all, both are always headless and
+    // don't need a GPU either. Benchmarks stop before anything renders.
+    const auto benchmark = commandLine.GetValue("Benchmark");
+    const bool runSoftware = commandLine.HasFlag("Software");
+    const bool runNull = commandLine.HasFlag("NullRenderer");
+    const bool runHeadless = runSoftware || runNull || benchmark.has_value() || commandLine.HasFlag("Headless");
+    SDL_Init(runHeadless ? SDL_INIT_EVENTS : SDL_INIT_VIDEO);
     
     // Populate the DI container
     container = std::make_unique<Container>();
     eventbus = container->Register<EventBus>();
     fileIO = container->Register<FileIO>();
-    window = container->Register<Window, EventBus&>(1024, 576, "Blackbox", "Content/Icon64x64.bmp");
+    jobs = container->Register<JobSystem>();
+    if (benchmark.has_value())
+    {
+        // -Benchmark=<name> runs a micro benchmark instead of the main loop
+        exitCode = Benchmark::Run(*benchmark, *jobs) ? 0 : 1;
+        isRunning = false;
+        return;
+    }
+    if (runSoftware)
+    {
+        software = container->Register<SoftwareFramebuffer>(1024u, 576u);
+    }
+    else if (runHeadless && !runNull)
+    {
+        headless = container->Register<HeadlessContext>(1024u, 576u);
+        context = headless;
+        if (!headless->IsValid())
+        {
+            LogEngine->Error("Headless rendering is unavailable, stopping");
+            exitCode = 1;
+            isRunning = false;
+            return;
+        }
+    }
+    else if (!runHeadless)
+    {
+        window = container->Register<Window, EventBus&>(1024, 576, "Blackbox", "Content/Icon64x64.bmp");
+        context = window;
+    }
     input = container->Register<Input, EventBus&>();
+    if (runNull)
+    {
+        // -RecordCommands=<path> writes the command stream of every frame to a text file, to diff two runs
+        const std::string recordingPath(commandLine.GetValue("RecordCommands").value_or(""));
+        renderer = container->Register<Renderer, EventBus&, FileIO&, JobSystem&>(std::make_unique<NullBackend>(recordingPath), uint2(1024u, 576u));
+    }
+    else
+    {
+        renderer = software != nullptr
+            ? container->Register<Renderer, EventBus&, FileIO&, JobSystem&>(*software)
+            : container->Register<Renderer, EventBus&, FileIO&, JobSystem&>(*context);
+    }
+    if (const auto budget = commandLine.GetValue("TextureBudget"); budget.has_value())
+    {
+        size_t megabytes {0};
+        std::from_chars(budget->data(), budget->data() + budget->size(), megabytes);
+        renderer->SetTextureBudget(megabytes * 1024 * 1024);
+    }
+    uint32_t demoLights {0};
+    if (const auto lights = commandLine.GetValue("DemoLights"); lights.has_value())
+    {
+        std::from_chars(lights->data(), lights->data() + lights->size(), demoLights);
+    }
+    uint32_t demoSprites {0};
+    if (const auto sprites = commandLine.GetValue("DemoSprites"); sprites.has_value())
+    {
+        std::from_chars(sprites->data(), sprites->data() + sprites->size(), demoSprites);
+    }
+    demoScene = container->Register<DemoScene, EventBus&, JobSystem&, Renderer&>(demoLights, demoSprites);
+
+    // Everything created up to here is startup work
+    const ProgramCacheStats programs = renderer->ProgramStats();
+    LogEngine->Info("Shader programs: {} loaded from cache in {:.1f}ms, {} compiled in {:.1f}ms, {:.1f}ms of compiling saved",
+        programs.hits, programs.loadMs, programs.misses, programs.compileMs, programs.savedMs);
+
+    const AtlasStats atlas = renderer->TextureStats();
+    LogEngine->Info("Textures: {} atlas bins, {} layers, {:.1f}MB", atlas.bins, atlas.layers, static_cast<double>(atlas.bytes) / (1024.0 * 1024.0));
 
     // Subscribe to events and assign callbacks
     eventbus->Subscribe<ShutdownEvent>(this, &BlackboxEngine::RequestShutdown);
@@ -38,6 +154,11 @@ void blackbox::BlackboxEngine::Initialize()
 
 void blackbox::BlackboxEngine::Run()
 {
+    if (!isRunning)
+    {
+        return;
+    }
+
     auto previousTime = std::chrono::high_resolution_clock::now();
     SDL_Event event;
 
@@ -49,15 +170,30 @@ void blackbox::BlackboxEngine::Run()
     {
         const auto currentTime = std::chrono::high_resolution_clock::now();
         const float elapsed = static_cast<float>(std::chrono::duration_cast<std::chrono::microseconds>(currentTime - previousTime).count());
-        deltaTime = elapsed / 1000000.0f; // time in seconds
+        deltaTime = fixedDeltaTime > 0.0f ? fixedDeltaTime : elapsed / 1000000.0f; // time in seconds
         uptime += deltaTime;
         const float frameTime = elapsed / 1000.0f; // time in milliseconds
         previousTime = currentTime;
 
+        BB_LOG_BINARY(LogEngine, Trace, "Frame {} took {:.3f}ms", frameNumber, frameTime);
+        FlightRecorder::RecordFrame(frameNumber, frameTime);
+
+        // Minimized frames sleep on purpose, only a rendering frame counts as a hitch
+        if (frameTime > HitchThresholdMs && !stopRendering && uptime - lastHitchDump > HitchDumpCooldown)
+        {
+            LogEngine->Warn("Frame {} took {:.1f}ms, writing flight recorder to Saved/Logs/Hitch.txt", frameNumber, frameTime);
+            FlightRecorder::Dump("Saved/Logs/Hitch.txt", "hitch");
+            lastHitchDump = uptime;
+        }
+
         while (SDL_PollEvent(&event))
         {
             SDL3ToBlackBoxEvent::Broadcast(event, *eventbus);
         }
+        if (window != nullptr)
+        {
+            window->ApplyPendingResize();
+        }
 
         // Do not draw if we are minimized
         if (stopRendering)
@@ -68,9 +204,142 @@ void blackbox::BlackboxEngine::Run()
         }
 
         eventbus->Broadcast(TickEvent{.deltaTime = deltaTime});
-        window->SwapBuffers();
+        renderer->Render();
+        if (context != nullptr)
+        {
+            context->Present();
+        }
+
+        stats = {.frameNumber = frameNumber, .frameTimeMs = frameTime, .render = renderer->Stats(), .culling = demoScene->Culling(), .graph = renderer->GraphStats()};
+        if (logStats && uptime - lastStatsLog >= 1.0f)
+        {
+            LogStats();
+            lastStatsLog = uptime;
+        }
+        if (frameLimit > 0 && frameNumber >= WarmupFrames)
+        {
+            timedFrames++;
+            timedFrameMs += frameTime;
+            slowestFrameMs = std::max(slowestFrameMs, frameTime);
+        }
         
         frameNumber++;
+        if (frameLimit > 0 && frameNumber >= frameLimit)
+        {
+            isRunning = false;
+        }
+    }
+
+    if (frameLimit > 0)
+    {
+        LogRunSummary();
+    }
+    if (software != nullptr || (headless != nullptr && headless->IsValid()))
+    {
+        FinishHeadlessRun();
+    }
+}
+
+void blackbox::BlackboxEngine::FinishHeadlessRun()
+{
+    const auto capturePath = commandLine.GetValue("Capture");
+    const auto goldenPath = commandLine.GetValue("Golden");
+    if (!capturePath.has_value() && !goldenPath.has_value())
+    {
+        return;
+    }
+
+    const auto pixels = software != nullptr ? software->ReadPixels() : headless->ReadPixels();
+    const uint2 size = software != nullptr ? software->Size() : headless->FramebufferSize();
+
+    if (capturePath.has_value() && GoldenImage::Save(std::string(*capturePath), pixels, size))
+    {
+        LogEngine->Info("Captured frame {} to {}", frameNumber, *capturePath);
+    }
+
+    if (goldenPath.has_value())
+    {
+        const auto result = GoldenImage::Compare(std::string(*goldenPath), pixels, size);
+        if (result.matches)
+        {
+            LogEngine->Info("Frame {} matches {} (max difference {})", frameNumber, *goldenPath, result.maxDifference);
+        }
+        else
+        {
+            LogEngine->Error("Frame {} differs from {}: {} pixel(s), max difference {}", frameNumber, *goldenPath, result.differingPixels, result.maxDifference);
+            exitCode = 1;
+        }
+    }
+}
+
+void blackbox::BlackboxEngine::LogStats() const
+{
+    const GLStateCounters& gl = stats.render.glState;
+    LogRenderer->Info("Frame {}: {:.2f}ms, {} packets, {} draw calls", stats.frameNumber, stats.frameTimeMs, stats.render.packets, stats.render.drawCalls);
+    LogRenderer->Info("  GL state calls issued {} / skipped {} (program {}/{}, vertex array {}/{}, texture {}/{}, uniform {}/{})",
+        gl.TotalIssued(), gl.TotalSkipped(),
+        gl.Issued(GLStateCall::Program), gl.Skipped(GLStateCall::Program),
+        gl.Issued(GLStateCall::VertexArray), gl.Skipped(GLStateCall::VertexArray),
+        gl.Issued(GLStateCall::Texture), gl.Skipped(GLStateCall::Texture),
+        gl.Issued(GLStateCall::Uniform), gl.Skipped(GLStateCall::Uniform));
+    LogRenderer->Info("  Streamed {} bytes, {} stall(s) ({:.2f}ms)", stats.render.streamingBytes, stats.render.streamingStalls, stats.render.streamingStallMs);
+    if (stats.render.shadersBuilding > 0)
+    {
+        LogRenderer->Info("  {} shader variant(s) building, drawn with their base shader meanwhile", stats.render.shadersBuilding);
+    }
+    LogRenderer->Info("  Textures {:.1f}MB resident, {} mip request(s), {} loading",
+        static_cast<double>(stats.render.textureBytes) / (1024.0 * 1024.0), stats.render.textureRequests, stats.render.texturesLoading);
+    LogRenderer->Info("  Culled {} of {} objects, {} outside the frustum and {} occluded by {} triangles ({:.2f}ms)",
+        stats.culling.outsideFrustum + stats.culling.occluded, stats.culling.objects, stats.culling.outsideFrustum, stats.culling.occluded,
+        stats.culling.occluderTriangles, stats.culling.occlusionMs);
+    LogRenderer->Info("  Render graph: {} of {} passes, {} transient target(s) in {} texture(s), {:.1f}MB instead of {:.1f}MB, {} pooled texture(s) ({:.1f}MB)",
+        stats.graph.passes - stats.graph.culledPasses, stats.graph.passes, stats.graph.transientTargets, stats.graph.physicalTargets,
+        static_cast<double>(stats.graph.aliasedBytes) / (1024.0 * 1024.0), static_cast<double>(stats.graph.transientBytes) / (1024.0 * 1024.0),
+        stats.graph.pooledTextures, static_cast<double>(stats.graph.pooledBytes) / (1024.0 * 1024.0));
+    if (stats.render.lights > 0)
+    {
+        LogRenderer->Info("  {} light(s) in {} cluster assignment(s)", stats.render.lights, stats.render.lightAssignments);
+    }
+    if (stats.render.sprites > 0)
+    {
+        LogRenderer->Info("  {} sprite(s) in {} draw call(s)", stats.render.sprites, stats.render.spriteDrawCalls);
+    }
+    if (stats.render.invalidPackets > 0)
+    {
+        LogRenderer->Warn("  {} invalid packet(s) skipped", stats.render.invalidPackets);
+    }
+}
+
+void blackbox::BlackboxEngine::LogRunSummary() const
+{
+    if (timedFrames == 0)
+    {
+        LogEngine->Info("Ran {} frame(s), none timed after {} warm-up frame(s)", frameNumber, WarmupFrames);
+        return;
+    }
+
+    constexpr double FrameBudgetMs = 1000.0 / 60.0;
+    const double averageMs = timedFrameMs / timedFrames;
+    LogEngine->Info("Ran {} frame(s), the last {} took {:.3f}ms on average ({:.0f}% of a 60Hz frame), {:.3f}ms at most",
+        frameNumber, timedFrames, averageMs, 100.0 * averageMs / FrameBudgetMs, slowestFrameMs);
+    if (stats.render.sprites > 0)
+    {
+        LogEngine->Info("  {} sprite(s) in {} draw call(s) per frame", stats.render.sprites, stats.render.spriteDrawCalls);
+    }
+}
+
+void blackbox::BlackboxEngine::ConfigureLogLevels() const
+{
+    constexpr auto configPath = "Content/Config/Logging.ini";
+    if (std::filesystem::exists(configPath) && !Logger::ApplyLevelSpec(FileIO().ReadFile(configPath)))
+    {
+        LogEngine->Warn("Ignored invalid entries in {}", configPath);
+    }
+
+    // The command line wins over the config file
+    if (const auto spec = commandLine.GetValue("LogLevel"); spec.has_value() && !Logger::ApplyLevelSpec(*spec))
+    {
+        LogEngine->Warn("Ignored invalid entries in -LogLevel={}", *spec);
     }
 }
 
@@ -79,5 +348,10 @@ void blackbox::BlackboxEngine::Shutdown()
     LogEngine->Trace("Shutting Down Engine...");
     LogEngine->Info("Engine uptime: {}s", Uptime());
 
+    // Everything in the container may still use SDL or the GL context
+    container.reset();
     SDL_Quit();
+
+    BinaryLog::Close();
+    Logger::Shutdown();
 }
@@ -3,6 +3,8 @@
 #include <memory>
 
 #include "Blackbox.hpp"
+#include "CommandLine.hpp"
+#include "EngineStats.hpp"
 #include "EventBus.hpp"
 #include "Input/InputMapping.hpp"
 #include "Input/InputMappingContext.hpp"
@@ -13,7 +15,13 @@ namespace blackbox
     class Input;
     class Container;
     class Window;
+    class GLContext;
+    class HeadlessContext;
+    class SoftwareFramebuffer;
     class FileIO;
+    class JobSystem;
+    class Renderer;
+    class DemoScene;
 
     struct ExitEngineAction {};
     struct EngineContext final : InputMappingContext<EngineContext>
@@ -28,29 +36,62 @@ namespace blackbox
     
     class BlackboxEngine
     {
+        CommandLine commandLine {};
         std::unique_ptr<Container> container {nullptr};
         EventBus* eventbus {nullptr};
         FileIO* fileIO {nullptr};
-        Window* window {nullptr};
+        Window* window {nullptr};                // nullptr when running headless
+        HeadlessContext* headless {nullptr};     // Only set with -Headless
+        GLContext* context {nullptr};            // Whichever of the two above owns the GL context, nullptr with -Software or -NullRenderer
+        SoftwareFramebuffer* software {nullptr}; // Only set with -Software, the renderer draws into it on the CPU
         Input* input {nullptr};
+        JobSystem* jobs {nullptr};
+        Renderer* renderer {nullptr};
+        DemoScene* demoScene {nullptr};
 
         bool stopRendering {false};
         bool isRunning {true};
         uint32_t frameNumber {0};
+        uint32_t frameLimit {0}; // -Frames=N, 0 runs until shutdown is requested
+        int exitCode {0};
 
         float deltaTime {0.0f};
         float uptime {0.0f};
+        float fixedDeltaTime {0.0f}; // -Capture and -Golden runs tick by this instead of the real frame time
+
+        static constexpr float HitchThresholdMs {250.0f};
+        static constexpr float HitchDumpCooldown {30.0f}; // seconds between two hitch dumps
+        float lastHitchDump {-HitchDumpCooldown};
+
+        EngineStats stats {};
+        bool logStats {false}; // -Stats
+        float lastStatsLog {0.0f};
+
+        // Frame times of a -Frames=N run, summarized when it ends. The first frames still compile shaders and upload.
+        static constexpr uint32_t WarmupFrames {10};
+        uint32_t timedFrames {0};
+        double timedFrameMs {0.0};
+        float slowestFrameMs {0.0f};
         
     public:
-        void Initialize();
+        void Initialize(int argc, char* argv[]);
         void Run();
         void Shutdown();
 
         [[nodiscard]] float DeltaTime() const { return deltaTime; }
         [[nodiscard]] float Uptime() const { return uptime; } // How long the engine has een running in seconds
         [[nodiscard]] uint32_t FrameNumber() const { return frameNumber; }
+        [[nodiscard]] const CommandLine& Arguments() const { return commandLine; }
+        [[nodiscard]] Renderer& GetRenderer() const { return *renderer; }
+        [[nodiscard]] const EngineStats& Stats() const { return stats; }
+        [[nodiscard]] int ExitCode() const { return exitCode; }
 
     private:
+        void ConfigureLogLevels() const;
+        void FinishHeadlessRun();
+        void LogStats() const;
+        void LogRunSummary() const;
+
         void RequestShutdown(const ShutdownEvent&) { isRunning = false; }
         void StopRendering(const Event&) { stopRendering = true; }
         void StartRendering(const Event&) { stopRendering = false; }
@@ -0,0 +1,18 @@
+﻿#pragma once
+
+#include <cstdint>
+
+#include "Renderer/RenderStats.hpp"
+
+namespace blackbox
+{
+    // Snapshot of the last completed frame, see BlackboxEngine::Stats
+    struct EngineStats
+    {
+        uint32_t frameNumber {0};
+        float frameTimeMs {0.0f};
+        RenderStats render {};
+        CullingStats culling {};
+        RenderGraphStats graph {};
+    };
+}
@@ -7,6 +7,7 @@
 #include <SDL3/SDL_events.h>
 
 #include "Events.hpp"
+#include "FlightRecorder.hpp"
 
 namespace blackbox
 {
@@ -37,6 +38,8 @@ namespace blackbox
     template <typename EventType>
     void EventBus::Broadcast(EventType event)
     {
+        FlightRecorder::RecordEvent(typeid(EventType).name());
+
         const auto typeIndex = std::type_index(typeid(EventType));
         if (const auto it = subscribers.find(typeIndex); it != subscribers.end())
         {
@@ -40,6 +40,7 @@ namespace blackbox
     struct WindowMinimizedEvent : Event {};
     struct WindowRestoredEvent : Event {};
     struct WindowResizedEvent : Event { float2 windowSize {}; };
+    struct ViewportResizedEvent : Event { uint2 size {}; }; // Once per frame at most, after a burst of WindowResizedEvents
     struct WindowFocusLostEvent : Event {};
     struct WindowFocusGainedEvent : Event {};
 }
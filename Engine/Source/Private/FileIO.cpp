@@ -26,4 +26,9 @@ namespace blackbox
 
         return content;
     }
+
+    std::unique_ptr<FileStream> FileIO::OpenStream(const std::string& filepath, const size_t chunkSize) const
+    {
+        return std::make_unique<FileStream>(filepath, chunkSize);
+    }
 }
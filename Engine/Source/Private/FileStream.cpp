@@ -0,0 +1,166 @@
+﻿#include "FileStream.hpp"
+
+#include <algorithm>
+
+#include "Blackbox.hpp"
+
+namespace blackbox
+{
+    FileStream::FileStream(const std::string& filepath, const size_t chunkSize)
+        : file(filepath, std::ios::ate | std::ios::binary)
+        , chunkSize(std::max<size_t>(chunkSize, 1))
+    {
+        if (!file.is_open())
+        {
+            LogEngine->Error("Could not open file for streaming: {}", filepath);
+            finished = true;
+            return;
+        }
+
+        fileSize = static_cast<uint64_t>(file.tellg());
+        file.seekg(0, std::ios::beg);
+
+        if (fileSize == 0)
+        {
+            finished = true;
+            return;
+        }
+
+        // Both buffers are allocated once up front, memory stays at 2 * chunkSize for the lifetime of the stream
+        const size_t bufferSize = static_cast<size_t>(std::min<uint64_t>(this->chunkSize, fileSize));
+        for (auto& slot : slots)
+        {
+            slot.buffer.resize(bufferSize);
+        }
+
+        prefetchThread = std::thread(&FileStream::PrefetchLoop, this);
+    }
+
+    FileStream::~FileStream()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stopRequested = true;
+        }
+        slotFreed.notify_all();
+
+        if (prefetchThread.joinable())
+        {
+            prefetchThread.join();
+        }
+    }
+
+    bool FileStream::IsChunkReady() const
+    {
+        std::lock_guard lock(mutex);
+        return slots[readSlot].state == SlotState::Ready;
+    }
+
+    bool FileStream::Acquire(FileChunk& chunk)
+    {
+        std::unique_lock lock(mutex);
+        ReleaseLocked();
+
+        chunkReady.wait(lock, [this] { return slots[readSlot].state == SlotState::Ready || finished; });
+        if (slots[readSlot].state != SlotState::Ready)
+        {
+            return false; // End of file, nothing left to hand out
+        }
+
+        TakeReadySlot(chunk);
+        return true;
+    }
+
+    bool FileStream::TryAcquire(FileChunk& chunk)
+    {
+        std::lock_guard lock(mutex);
+        if (slots[readSlot].state != SlotState::Ready)
+        {
+            return false;
+        }
+
+        ReleaseLocked();
+        TakeReadySlot(chunk);
+        return true;
+    }
+
+    void FileStream::Release()
+    {
+        std::lock_guard lock(mutex);
+        ReleaseLocked();
+    }
+
+    void FileStream::ReleaseLocked()
+    {
+        if (!holdingChunk)
+        {
+            return;
+        }
+
+        // The acquired slot is always the one just before the read cursor
+        slots[readSlot ^ 1u].state = SlotState::Free;
+        holdingChunk = false;
+        slotFreed.notify_one();
+    }
+
+    void FileStream::TakeReadySlot(FileChunk& chunk)
+    {
+        Slot& slot = slots[readSlot];
+        slot.state = SlotState::Acquired;
+        holdingChunk = true;
+        readSlot ^= 1u;
+
+        chunk.data = std::span<const std::byte>(slot.buffer.data(), slot.size);
+        chunk.offset = slot.offset;
+        chunk.last = slot.last;
+    }
+
+    void FileStream::PrefetchLoop()
+    {
+        uint64_t offset {0};
+
+        while (true)
+        {
+            Slot* slot {nullptr};
+            {
+                std::unique_lock lock(mutex);
+                slotFreed.wait(lock, [this] { return stopRequested || slots[writeSlot].state == SlotState::Free; });
+                if (stopRequested)
+                {
+                    return;
+                }
+
+                slot = &slots[writeSlot];
+            }
+
+            // The slot is free so neither side touches it until it's marked ready, read without holding the lock
+            const size_t toRead = static_cast<size_t>(std::min<uint64_t>(chunkSize, fileSize - offset));
+            file.read(reinterpret_cast<char*>(slot->buffer.data()), static_cast<std::streamsize>(toRead));
+            const size_t bytesRead = static_cast<size_t>(file.gcount());
+
+            if (bytesRead != toRead)
+            {
+                LogEngine->Error("Streaming read failed at offset {} ({} of {} bytes)", offset, bytesRead, toRead);
+            }
+
+            const bool last = bytesRead != toRead || offset + bytesRead >= fileSize;
+            {
+                std::lock_guard lock(mutex);
+                slot->size = bytesRead;
+                slot->offset = offset;
+                slot->last = last;
+                slot->state = SlotState::Ready;
+                writeSlot ^= 1u;
+                finished = last;
+            }
+            chunkReady.notify_one();
+
+            if (last)
+            {
+                return;
+            }
+
+            offset += bytesRead;
+        }
+    }
+}
@@ -0,0 +1,265 @@
+﻿#include "FlightRecorder.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+
+#if defined(_WIN32)
+#include <fcntl.h>
+#include <io.h>
+#include <sys/stat.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "CrashHandler.hpp"
+
+namespace blackbox
+{
+    namespace
+    {
+        // Initialized during static initialization so reading it from a signal handler never hits a guard
+        const auto ProcessStart = std::chrono::steady_clock::now();
+
+        // Indexed by spdlog::level::level_enum
+        constexpr std::array<const char*, 7> LevelNames {"trace", "debug", "info", "warn", "error", "critical", "off"};
+
+        int OpenForWrite(const char* path)
+        {
+#if defined(_WIN32)
+            return _open(path, _O_WRONLY | _O_CREAT | _O_TRUNC | _O_BINARY, _S_IREAD | _S_IWRITE);
+#else
+            return open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+#endif
+        }
+
+        void WriteToFile(const int file, const char* data, const size_t size)
+        {
+#if defined(_WIN32)
+            _write(file, data, static_cast<unsigned int>(size));
+#else
+            size_t written {0};
+            while (written < size)
+            {
+                const ssize_t result = write(file, data + written, size - written);
+                if (result <= 0)
+                {
+                    return;
+                }
+                written += static_cast<size_t>(result);
+            }
+#endif
+        }
+
+        void CloseFile(const int file)
+        {
+#if defined(_WIN32)
+            _close(file);
+#else
+            close(file);
+#endif
+        }
+
+        // Buffered writer that only uses async-signal-safe calls, no stdio, no allocation, no locale
+        class DumpWriter
+        {
+            int file {-1};
+            std::array<char, 4096> buffer {};
+            size_t used {0};
+
+        public:
+            explicit DumpWriter(const int file) : file(file) {}
+            ~DumpWriter() { Flush(); }
+
+            DumpWriter(const DumpWriter& other) = delete;
+            DumpWriter& operator=(const DumpWriter&) = delete;
+            DumpWriter(DumpWriter&& other) = delete;
+            DumpWriter& operator=(DumpWriter&& other) = delete;
+
+            DumpWriter& operator<<(const std::string_view text)
+            {
+                for (const char c : text)
+                {
+                    if (used == buffer.size())
+                    {
+                        Flush();
+                    }
+                    buffer[used++] = c;
+                }
+                return *this;
+            }
+
+            DumpWriter& operator<<(const char* text)
+            {
+                return *this << std::string_view(text != nullptr ? text : "(null)");
+            }
+
+            DumpWriter& operator<<(uint64_t value)
+            {
+                std::array<char, 20> digits {};
+                size_t count {0};
+                do
+                {
+                    digits[count++] = static_cast<char>('0' + value % 10);
+                    value /= 10;
+                } while (value != 0);
+
+                std::reverse(digits.begin(), digits.begin() + static_cast<ptrdiff_t>(count));
+                return *this << std::string_view(digits.data(), count);
+            }
+
+            // Microseconds as milliseconds with three decimals, e.g. 16.667
+            DumpWriter& Milliseconds(const uint64_t microseconds)
+            {
+                *this << microseconds / 1000 << ".";
+                const uint64_t fraction = microseconds % 1000;
+                if (fraction < 100) *this << "0";
+                if (fraction < 10) *this << "0";
+                return *this << fraction;
+            }
+
+            void Flush()
+            {
+                WriteToFile(file, buffer.data(), used);
+                used = 0;
+            }
+        };
+
+        // Visit the published entries of a ring from oldest to newest, skipping slots torn by a concurrent write
+        template <typename Ring, typename Visit>
+        void ForEachEntry(Ring& ring, Visit&& visit)
+        {
+            constexpr size_t capacity = std::tuple_size_v<decltype(ring.slots)>;
+            const uint64_t end = ring.next.load(std::memory_order_acquire);
+            const uint64_t begin = end > capacity ? end - capacity : 0;
+
+            for (uint64_t index = begin; index < end; index++)
+            {
+                auto& slot = ring.slots[index % capacity];
+                if (slot.sequence.load(std::memory_order_acquire) != index + 1)
+                {
+                    continue;
+                }
+
+                const auto entry = slot.entry;
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.sequence.load(std::memory_order_relaxed) != index + 1)
+                {
+                    continue;
+                }
+
+                visit(entry);
+            }
+        }
+
+        template <size_t N>
+        void CopyTruncated(std::array<char, N>& target, const std::string_view source)
+        {
+            const size_t length = std::min(source.size(), N - 1);
+            std::memcpy(target.data(), source.data(), length);
+            target[length] = '\0';
+        }
+    }
+
+    FlightRecorder::Ring<FlightRecorder::LogEntry, FlightRecorder::LogCapacity> FlightRecorder::logs {};
+    FlightRecorder::Ring<FlightRecorder::FrameEntry, FlightRecorder::FrameCapacity> FlightRecorder::frames {};
+    FlightRecorder::Ring<FlightRecorder::EventEntry, FlightRecorder::EventCapacity> FlightRecorder::events {};
+    std::array<char, 260> FlightRecorder::crashDumpPath {};
+
+    void FlightRecorder::Install(const std::string_view path)
+    {
+        // Directories can't be created from inside a signal handler, make sure it exists up front
+        if (const auto directory = std::filesystem::path(path).parent_path(); !directory.empty())
+        {
+            std::error_code error {};
+            std::filesystem::create_directories(directory, error);
+        }
+
+        CopyTruncated(crashDumpPath, path);
+        CrashHandler::AddCallback(&FlightRecorder::OnCrash);
+    }
+
+    void FlightRecorder::RecordLog(const uint8_t level, const std::string_view category, const std::string_view message)
+    {
+        Record(logs, [&](LogEntry& entry)
+        {
+            entry.timeMicroseconds = NowMicroseconds();
+            entry.level = level;
+            CopyTruncated(entry.category, category);
+            entry.messageLength = static_cast<uint16_t>(std::min(message.size(), MessageLength));
+            std::memcpy(entry.message.data(), message.data(), entry.messageLength);
+        });
+    }
+
+    void FlightRecorder::RecordFrame(const uint32_t frameNumber, const float frameTimeMs)
+    {
+        Record(frames, [&](FrameEntry& entry)
+        {
+            entry.timeMicroseconds = NowMicroseconds();
+            entry.frameNumber = frameNumber;
+            entry.frameTimeMicroseconds = static_cast<uint32_t>(std::max(frameTimeMs, 0.0f) * 1000.0f);
+        });
+    }
+
+    void FlightRecorder::RecordEvent(const char* eventName)
+    {
+        Record(events, [&](EventEntry& entry)
+        {
+            entry.timeMicroseconds = NowMicroseconds();
+            entry.name = eventName;
+        });
+    }
+
+    bool FlightRecorder::Dump(const char* path, const char* reason)
+    {
+        const int file = OpenForWrite(path);
+        if (file < 0)
+        {
+            return false;
+        }
+
+        {
+            DumpWriter out(file);
+            out << "Blackbox flight recorder\nReason: " << reason << "\nTime: " << NowMicroseconds() / 1000 << " ms since start\n";
+
+            out << "\n== Frames (oldest first) ==\n";
+            ForEachEntry(frames, [&out](const FrameEntry& entry)
+            {
+                out << "[" << entry.timeMicroseconds / 1000 << " ms] frame " << entry.frameNumber << " ";
+                out.Milliseconds(entry.frameTimeMicroseconds) << " ms\n";
+            });
+
+            out << "\n== Events (oldest first) ==\n";
+            ForEachEntry(events, [&out](const EventEntry& entry)
+            {
+                out << "[" << entry.timeMicroseconds / 1000 << " ms] " << entry.name << "\n";
+            });
+
+            out << "\n== Log (oldest first) ==\n";
+            ForEachEntry(logs, [&out](const LogEntry& entry)
+            {
+                out << "[" << entry.timeMicroseconds / 1000 << " ms] " << entry.category.data() << " "
+                    << LevelNames[std::min<size_t>(entry.level, LevelNames.size() - 1)] << ": "
+                    << std::string_view(entry.message.data(), entry.messageLength) << "\n";
+            });
+        }
+
+        CloseFile(file);
+        return true;
+    }
+
+    uint64_t FlightRecorder::NowMicroseconds()
+    {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - ProcessStart).count());
+    }
+
+    void FlightRecorder::OnCrash()
+    {
+        if (crashDumpPath[0] != '\0')
+        {
+            Dump(crashDumpPath.data(), "fatal signal or unhandled exception");
+        }
+    }
+}
@@ -0,0 +1,96 @@
+﻿#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <string_view>
+
+namespace blackbox
+{
+    /**
+     * Always-on, fixed-size history of the most recent log messages, frame timings and broadcast events.
+     *
+     * Recording is lock-free and never allocates: a writer claims a slot with one atomic increment and publishes
+     * it with a sequence number, so it is safe from any thread. Dumping only uses async-signal-safe calls
+     * (open/write/close and hand-rolled number formatting), which lets the CrashHandler write the history to
+     * disk from inside a SIGSEGV/SIGABRT handler. Slots that were being written when the dump happened are skipped.
+     */
+    class FlightRecorder
+    {
+    public:
+        static constexpr size_t LogCapacity = 256;
+        static constexpr size_t FrameCapacity = 512;
+        static constexpr size_t EventCapacity = 256;
+        static constexpr size_t MessageLength = 160; // Longer log messages are truncated
+
+        // Set the crash dump location and register with the CrashHandler. Install before anything that may hang on crash.
+        static void Install(std::string_view crashDumpPath);
+
+        static void RecordLog(uint8_t level, std::string_view category, std::string_view message);
+        static void RecordFrame(uint32_t frameNumber, float frameTimeMs);
+        static void RecordEvent(const char* eventName);
+
+        // Write the current history to `path`, safe to call from a signal handler
+        static bool Dump(const char* path, const char* reason);
+
+    private:
+        struct LogEntry
+        {
+            uint64_t timeMicroseconds {0};
+            uint8_t level {0};
+            std::array<char, 32> category {};
+            std::array<char, MessageLength> message {};
+            uint16_t messageLength {0};
+        };
+
+        struct FrameEntry
+        {
+            uint64_t timeMicroseconds {0};
+            uint32_t frameNumber {0};
+            uint32_t frameTimeMicroseconds {0};
+        };
+
+        struct EventEntry
+        {
+            uint64_t timeMicroseconds {0};
+            const char* name {nullptr}; // Points to type_info names, which live for the whole program
+        };
+
+        // Sequence 0 means the slot is being written (or was never written), otherwise it's the claimed index + 1
+        template <typename T, size_t Capacity>
+        struct Ring
+        {
+            struct Slot
+            {
+                std::atomic<uint64_t> sequence {0};
+                T entry {};
+            };
+
+            std::atomic<uint64_t> next {0};
+            std::array<Slot, Capacity> slots {};
+        };
+
+        static Ring<LogEntry, LogCapacity> logs;
+        static Ring<FrameEntry, FrameCapacity> frames;
+        static Ring<EventEntry, EventCapacity> events;
+        static std::array<char, 260> crashDumpPath;
+
+        template <typename T, size_t Capacity, typename Fill>
+        static void Record(Ring<T, Capacity>& ring, Fill&& fill);
+
+        static uint64_t NowMicroseconds();
+        static void OnCrash();
+    };
+
+    template <typename T, size_t Capacity, typename Fill>
+    void FlightRecorder::Record(Ring<T, Capacity>& ring, Fill&& fill)
+    {
+        const uint64_t index = ring.next.fetch_add(1, std::memory_order_relaxed);
+        auto& slot = ring.slots[index % Capacity];
+
+        slot.sequence.store(0, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        fill(slot.entry);
+        slot.sequence.store(index + 1, std::memory_order_release);
+    }
+}
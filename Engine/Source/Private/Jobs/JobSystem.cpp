@@ -0,0 +1,127 @@
+﻿#include "JobSystem.hpp"
+
+#include <algorithm>
+#include <string>
+
+#include "Blackbox.hpp"
+
+namespace blackbox
+{
+    namespace
+    {
+        // 0 on threads that don't belong to a pool
+        thread_local uint32_t currentWorker {0};
+    }
+
+    JobSystem::JobSystem(const uint32_t workerCount)
+    {
+        const uint32_t count = workerCount > 0 ? workerCount : std::max(std::thread::hardware_concurrency(), 1u);
+        for (uint32_t index = 1; index < count; index++)
+        {
+            threads.emplace_back(&JobSystem::WorkerLoop, this, index);
+        }
+
+        LogEngine->Trace("Started job system with {} worker(s)", count);
+    }
+
+    JobSystem::~JobSystem()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wakeWorkers.notify_all();
+
+        for (std::thread& thread : threads)
+        {
+            thread.join();
+        }
+    }
+
+    void JobSystem::Run(const BatchFunction function, void* context, const size_t count, const size_t batchSize)
+    {
+        if (count == 0)
+        {
+            return;
+        }
+
+        const size_t size = std::max<size_t>(batchSize, 1);
+        const size_t batches = (count + size - 1) / size;
+
+        // One batch isn't worth waking anyone, and a job started from inside a job would deadlock waiting on itself
+        if (batches == 1 || threads.empty() || currentWorker != 0 || running.exchange(true))
+        {
+            function(context, 0, count, currentWorker);
+            return;
+        }
+
+        {
+            std::lock_guard lock(mutex);
+            job.function = function;
+            job.context = context;
+            job.count = count;
+            job.batchSize = size;
+            job.nextBatch.store(0, std::memory_order_relaxed);
+            job.batchesLeft.store(batches, std::memory_order_relaxed);
+            activeJob = &job;
+            generation++;
+        }
+        wakeWorkers.notify_all();
+
+        RunBatches(0);
+
+        // Workers may still be inside the function even after the last batch was claimed
+        std::unique_lock lock(mutex);
+        jobFinished.wait(lock, [this] { return job.batchesLeft.load(std::memory_order_acquire) == 0 && busyWorkers == 0; });
+        activeJob = nullptr;
+        lock.unlock();
+
+        running.store(false);
+    }
+
+    void JobSystem::WorkerLoop(const uint32_t workerIndex)
+    {
+        currentWorker = workerIndex;
+        uint64_t seenGeneration {0};
+
+        while (true)
+        {
+            {
+                std::unique_lock lock(mutex);
+                wakeWorkers.wait(lock, [&] { return stopping || (activeJob != nullptr && generation != seenGeneration); });
+                if (stopping)
+                {
+                    return;
+                }
+
+                seenGeneration = generation;
+                busyWorkers++;
+            }
+
+            RunBatches(workerIndex);
+
+            {
+                std::lock_guard lock(mutex);
+                busyWorkers--;
+            }
+            jobFinished.notify_one();
+        }
+    }
+
+    void JobSystem::RunBatches(const uint32_t workerIndex)
+    {
+        const size_t batches = (job.count + job.batchSize - 1) / job.batchSize;
+        while (true)
+        {
+            const size_t batch = job.nextBatch.fetch_add(1, std::memory_order_relaxed);
+            if (batch >= batches)
+            {
+                return;
+            }
+
+            const size_t begin = batch * job.batchSize;
+            job.function(job.context, begin, std::min(begin + job.batchSize, job.count), workerIndex);
+            job.batchesLeft.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+}
@@ -0,0 +1,81 @@
+﻿#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace blackbox
+{
+    /**
+     * Fixed pool of worker threads for data-parallel loops.
+     *
+     * The calling thread takes part in every ParallelFor as worker 0, so a pool of N workers runs N - 1 threads.
+     * Worker indices are stable and below WorkerCount(), which lets callers keep per-worker scratch data
+     * without locking. ParallelFor is meant to be started from one thread at a time, usually the main thread.
+     *
+     *   jobs.ParallelFor(objects.size(), 256, [&](size_t begin, size_t end, uint32_t worker) { ... });
+     */
+    class JobSystem
+    {
+        using BatchFunction = void (*)(void* context, size_t begin, size_t end, uint32_t worker);
+
+        struct Job
+        {
+            BatchFunction function {nullptr};
+            void* context {nullptr};
+            size_t count {0};
+            size_t batchSize {1};
+            std::atomic<size_t> nextBatch {0};
+            std::atomic<size_t> batchesLeft {0};
+        };
+
+        std::vector<std::thread> threads {};
+        std::mutex mutex {};
+        std::condition_variable wakeWorkers {};
+        std::condition_variable jobFinished {};
+
+        Job job {};
+        Job* activeJob {nullptr}; // Only set while a ParallelFor is running, guarded by `mutex`
+        uint64_t generation {0};
+        uint32_t busyWorkers {0};
+        bool stopping {false};
+        std::atomic<bool> running {false};
+
+    public:
+        // 0 uses one worker per hardware thread
+        explicit JobSystem(uint32_t workerCount = 0);
+        ~JobSystem();
+
+        JobSystem(const JobSystem& other) = delete;
+        JobSystem& operator=(const JobSystem&) = delete;
+        JobSystem(JobSystem&& other) = delete;
+        JobSystem& operator=(JobSystem&& other) = delete;
+
+        // Worker threads plus the calling thread
+        [[nodiscard]] uint32_t WorkerCount() const { return static_cast<uint32_t>(threads.size()) + 1; }
+
+        // Calls `function(begin, end, workerIndex)` for every batch of up to `batchSize` items and returns once all
+        // batches are done. Small loops and nested calls from inside a job run inline on the calling thread.
+        template <typename Function>
+        void ParallelFor(size_t count, size_t batchSize, Function&& function);
+
+    private:
+        void Run(BatchFunction function, void* context, size_t count, size_t batchSize);
+        void WorkerLoop(uint32_t workerIndex);
+        void RunBatches(uint32_t workerIndex);
+    };
+
+    template <typename Function>
+    void JobSystem::ParallelFor(const size_t count, const size_t batchSize, Function&& function)
+    {
+        auto invoke = [](void* context, const size_t begin, const size_t end, const uint32_t worker)
+        {
+            (*static_cast<std::remove_reference_t<Function>*>(context))(begin, end, worker);
+        };
+
+        Run(invoke, const_cast<void*>(static_cast<const void*>(&function)), count, batchSize);
+    }
+}
@@ -1,9 +1,165 @@
 ﻿#include "Logger.hpp"
-#include <spdlog/sinks/stdout_color_sinks.h>
+
+#include <algorithm>
+#include <cctype>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "Logging/LogBackend.hpp"
+
+namespace
+{
+#ifdef DEBUG
+    constexpr auto DefaultLevel = blackbox::LogLevel::Trace;
+#elif defined SHIPPING
+    constexpr auto DefaultLevel = blackbox::LogLevel::Warn;
+#else
+    constexpr auto DefaultLevel = blackbox::LogLevel::Info;
+#endif
+
+    constexpr std::string_view AllCategories = "All";
+
+    // Every live logger plus the levels requested by name, so categories created later pick them up as well
+    struct LevelRegistry
+    {
+        std::mutex mutex {};
+        std::vector<blackbox::Logger*> loggers {};
+        std::unordered_map<std::string, blackbox::LogLevel> overrides {};
+        std::optional<blackbox::LogLevel> allOverride {};
+    };
+
+    LevelRegistry& Registry()
+    {
+        static LevelRegistry registry {};
+        return registry;
+    }
+
+    std::string_view Trim(std::string_view text)
+    {
+        while (!text.empty() && std::isspace(static_cast<unsigned char>(text.front()))) text.remove_prefix(1);
+        while (!text.empty() && std::isspace(static_cast<unsigned char>(text.back()))) text.remove_suffix(1);
+        return text;
+    }
+
+    bool EqualsIgnoreCase(const std::string_view a, const std::string_view b)
+    {
+        return std::ranges::equal(a, b, [](const char x, const char y)
+        {
+            return std::tolower(static_cast<unsigned char>(x)) == std::tolower(static_cast<unsigned char>(y));
+        });
+    }
+
+    std::optional<blackbox::LogLevel> ParseLevel(const std::string_view text)
+    {
+        using enum blackbox::LogLevel;
+        if (EqualsIgnoreCase(text, "Trace")) return Trace;
+        if (EqualsIgnoreCase(text, "Info")) return Info;
+        if (EqualsIgnoreCase(text, "Warn") || EqualsIgnoreCase(text, "Warning")) return Warn;
+        if (EqualsIgnoreCase(text, "Error")) return Error;
+        if (EqualsIgnoreCase(text, "Off")) return Off;
+        return std::nullopt;
+    }
+}
 
 blackbox::Logger::Logger(const std::string& name)
+    : level(DefaultLevel)
 {
-    spdlog::set_pattern("%^ %n [%T] %v%$");
-    log = spdlog::stdout_color_mt(name);
+    // Filtering happens in IsEnabled, spdlog lets everything through
+    log = std::make_shared<spdlog::logger>(name, LogBackend::Get());
     log->set_level(spdlog::level::trace);
+
+    auto& registry = Registry();
+    std::lock_guard lock(registry.mutex);
+    registry.loggers.push_back(this);
+
+    if (registry.allOverride.has_value())
+    {
+        SetLevel(*registry.allOverride);
+    }
+    if (const auto it = registry.overrides.find(name); it != registry.overrides.end())
+    {
+        SetLevel(it->second);
+    }
+}
+
+blackbox::Logger::~Logger()
+{
+    auto& registry = Registry();
+    std::lock_guard lock(registry.mutex);
+    std::erase(registry.loggers, this);
+}
+
+void blackbox::Logger::EnableAsync(const AsyncLogSettings& settings)
+{
+    LogBackend::Get()->EnableAsync(settings);
+}
+
+void blackbox::Logger::Shutdown()
+{
+    LogBackend::Get()->Shutdown();
+}
+
+void blackbox::Logger::SetLevel(const std::string_view category, const LogLevel newLevel)
+{
+    auto& registry = Registry();
+    std::lock_guard lock(registry.mutex);
+
+    if (category == AllCategories)
+    {
+        // A blanket level replaces earlier per-category ones, later entries in a spec can refine it again
+        registry.allOverride = newLevel;
+        registry.overrides.clear();
+        for (Logger* logger : registry.loggers)
+        {
+            logger->SetLevel(newLevel);
+        }
+        return;
+    }
+
+    registry.overrides[std::string(category)] = newLevel;
+    for (Logger* logger : registry.loggers)
+    {
+        if (logger->Name() == category)
+        {
+            logger->SetLevel(newLevel);
+        }
+    }
+}
+
+bool blackbox::Logger::ApplyLevelSpec(std::string_view spec)
+{
+    bool valid {true};
+
+    // Config files saved by Visual Studio start with a UTF-8 byte order mark
+    if (spec.starts_with("\xEF\xBB\xBF"))
+    {
+        spec.remove_prefix(3);
+    }
+
+    size_t start {0};
+    while (start <= spec.size())
+    {
+        const size_t end = std::min(spec.find_first_of(",\n", start), spec.size());
+        const std::string_view entry = Trim(spec.substr(start, end - start));
+        start = end + 1;
+
+        if (entry.empty() || entry.front() == ';' || entry.front() == '#')
+        {
+            continue;
+        }
+
+        const size_t separator = entry.find('=');
+        const auto parsedLevel = separator != std::string_view::npos ? ParseLevel(Trim(entry.substr(separator + 1))) : std::nullopt;
+        if (!parsedLevel.has_value())
+        {
+            valid = false;
+            continue;
+        }
+
+        SetLevel(Trim(entry.substr(0, separator)), *parsedLevel);
+    }
+
+    return valid;
 }
@@ -0,0 +1,279 @@
+﻿#include "BinaryLog.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "Blackbox.hpp"
+
+namespace blackbox
+{
+    namespace
+    {
+        constexpr size_t StagingBufferSize = 1024 * 1024;
+        constexpr auto WriterInterval = std::chrono::milliseconds(2);
+        constexpr auto CalibrationInterval = std::chrono::seconds(1);
+
+        // Everything the writer thread and registration share, only touched under `mutex`
+        struct BinaryLogState
+        {
+            std::mutex mutex {};
+            std::ofstream file {};
+            std::thread writer {};
+            bool stopRequested {false};
+
+            std::vector<std::unique_ptr<BinaryLogStagingBuffer>> buffers {};
+            uint32_t nextThreadIndex {0};
+
+            std::vector<std::vector<std::byte>> descriptors {}; // Encoded, indexed by id - 1
+            size_t descriptorsWritten {0};
+
+            uint64_t tscAtOpen {0};
+            std::chrono::steady_clock::time_point timeAtOpen {};
+        };
+
+        BinaryLogState& State()
+        {
+            static BinaryLogState state {};
+            return state;
+        }
+
+        template <typename T>
+        void Append(std::vector<std::byte>& out, const T value)
+        {
+            const auto* bytes = reinterpret_cast<const std::byte*>(&value);
+            out.insert(out.end(), bytes, bytes + sizeof(T));
+        }
+
+        void AppendString(std::vector<std::byte>& out, const std::string_view text)
+        {
+            const auto length = static_cast<uint16_t>(std::min<size_t>(text.size(), UINT16_MAX));
+            Append(out, length);
+            const auto* bytes = reinterpret_cast<const std::byte*>(text.data());
+            out.insert(out.end(), bytes, bytes + length);
+        }
+
+        void WriteChunk(std::ofstream& file, const binarylog::ChunkType type, const std::span<const std::byte> first, const std::span<const std::byte> second = {})
+        {
+            const binarylog::ChunkHeader header {.type = type, .size = static_cast<uint32_t>(first.size() + second.size())};
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(reinterpret_cast<const char*>(first.data()), static_cast<std::streamsize>(first.size()));
+            file.write(reinterpret_cast<const char*>(second.data()), static_cast<std::streamsize>(second.size()));
+        }
+
+        void WriteCalibration(BinaryLogState& state)
+        {
+            std::vector<std::byte> payload {};
+            Append(payload, state.tscAtOpen);
+            Append(payload, binarylog::ReadTimestamp());
+            Append(payload, static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - state.timeAtOpen).count()));
+            WriteChunk(state.file, binarylog::ChunkType::Calibration, payload);
+        }
+
+        // Moves everything the logging threads committed since the last call into the file
+        void Flush(BinaryLogState& state)
+        {
+            std::vector<std::byte> records {};
+            std::vector<std::byte> dropped {};
+            std::vector<const void*> finished {};
+
+            for (const auto& buffer : state.buffers)
+            {
+                // Read before draining, a thread retiring during the drain may have committed records after it
+                if (buffer->retired.load(std::memory_order_acquire))
+                {
+                    finished.push_back(buffer.get());
+                }
+
+                records.clear();
+                Append(records, buffer->threadIndex);
+                buffer->Drain([&records](const std::span<const std::byte> bytes)
+                {
+                    records.insert(records.end(), bytes.begin(), bytes.end());
+                });
+
+                if (records.size() > sizeof(uint32_t))
+                {
+                    // Descriptors first, every drained record was committed after its descriptor was registered
+                    for (; state.descriptorsWritten < state.descriptors.size(); state.descriptorsWritten++)
+                    {
+                        WriteChunk(state.file, binarylog::ChunkType::Descriptor, state.descriptors[state.descriptorsWritten]);
+                    }
+                    WriteChunk(state.file, binarylog::ChunkType::Records, records);
+                }
+
+                if (const uint64_t count = buffer->dropped.exchange(0, std::memory_order_relaxed); count > 0)
+                {
+                    dropped.clear();
+                    Append(dropped, buffer->threadIndex);
+                    Append(dropped, count);
+                    WriteChunk(state.file, binarylog::ChunkType::Dropped, dropped);
+                }
+            }
+
+            // Threads that had exited before their drain have nothing left to commit, the others go next time
+            std::erase_if(state.buffers, [&finished](const auto& buffer) { return std::ranges::find(finished, buffer.get()) != finished.end(); });
+        }
+
+        void WriterLoop()
+        {
+            auto& state = State();
+            auto lastCalibration = std::chrono::steady_clock::now();
+
+            while (true)
+            {
+                std::this_thread::sleep_for(WriterInterval);
+
+                std::lock_guard lock(state.mutex);
+                if (state.stopRequested)
+                {
+                    return;
+                }
+
+                Flush(state);
+
+                if (std::chrono::steady_clock::now() - lastCalibration > CalibrationInterval)
+                {
+                    WriteCalibration(state);
+                    lastCalibration = std::chrono::steady_clock::now();
+                }
+            }
+        }
+
+        // Marks the calling thread's staging buffer as retired when the thread exits
+        struct ThreadBufferRelease
+        {
+            BinaryLogStagingBuffer* buffer {nullptr};
+
+            ~ThreadBufferRelease()
+            {
+                if (buffer != nullptr)
+                {
+                    buffer->retired.store(true, std::memory_order_release);
+                }
+            }
+        };
+
+        thread_local ThreadBufferRelease threadBufferRelease {};
+    }
+
+    BinaryLogStagingBuffer::BinaryLogStagingBuffer(const size_t capacity, const uint32_t threadIndex)
+        : storage(std::make_unique<std::byte[]>(capacity))
+        , capacity(capacity)
+        , threadIndex(threadIndex)
+    {}
+
+    bool BinaryLog::Open(const std::string& filepath)
+    {
+        auto& state = State();
+        std::lock_guard lock(state.mutex);
+
+        if (open.load())
+        {
+            LogEngine->Warn("Binary log is already open");
+            return false;
+        }
+
+        if (const auto directory = std::filesystem::path(filepath).parent_path(); !directory.empty())
+        {
+            std::error_code error {};
+            std::filesystem::create_directories(directory, error);
+        }
+
+        state.file.open(filepath, std::ios::binary | std::ios::trunc);
+        if (!state.file.is_open())
+        {
+            LogEngine->Error("Could not open binary log: {}", filepath);
+            return false;
+        }
+
+        const binarylog::FileHeader header {
+            .unixTimeNanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count(),
+        };
+        state.file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        // Leftovers from a previous session belong to the previous file
+        for (const auto& buffer : state.buffers)
+        {
+            buffer->Drain([](std::span<const std::byte>) {});
+            buffer->dropped.store(0);
+        }
+
+        // Sites keep their ids across sessions, so every known descriptor goes into the new file again
+        state.descriptorsWritten = 0;
+        state.tscAtOpen = binarylog::ReadTimestamp();
+        state.timeAtOpen = std::chrono::steady_clock::now();
+        state.stopRequested = false;
+        state.writer = std::thread(&WriterLoop);
+
+        open.store(true);
+        LogEngine->Info("Writing binary log to {}", filepath);
+        return true;
+    }
+
+    void BinaryLog::Close()
+    {
+        auto& state = State();
+        if (!open.exchange(false))
+        {
+            return;
+        }
+
+        {
+            std::lock_guard lock(state.mutex);
+            state.stopRequested = true;
+        }
+        state.writer.join();
+
+        std::lock_guard lock(state.mutex);
+        Flush(state);
+        WriteCalibration(state);
+        state.file.close();
+    }
+
+    uint32_t BinaryLog::Register(BinaryLogSite& site, const std::string_view format, const std::span<const binarylog::ArgType> argTypes)
+    {
+        auto& state = State();
+        std::lock_guard lock(state.mutex);
+
+        // Another thread may have registered the same site while we waited for the lock
+        if (const uint32_t id = site.id.load(std::memory_order_acquire); id != 0)
+        {
+            return id;
+        }
+
+        const auto id = static_cast<uint32_t>(state.descriptors.size() + 1);
+
+        std::vector<std::byte> descriptor {};
+        Append(descriptor, id);
+        Append(descriptor, static_cast<uint8_t>(site.level));
+        Append(descriptor, site.line);
+        Append(descriptor, static_cast<uint8_t>(argTypes.size()));
+        for (const binarylog::ArgType type : argTypes)
+        {
+            Append(descriptor, type);
+        }
+        AppendString(descriptor, site.category.Name());
+        AppendString(descriptor, site.file);
+        AppendString(descriptor, format);
+        state.descriptors.push_back(std::move(descriptor));
+
+        site.id.store(id, std::memory_order_release);
+        return id;
+    }
+
+    BinaryLogStagingBuffer& BinaryLog::AttachThread()
+    {
+        auto& state = State();
+        std::lock_guard lock(state.mutex);
+
+        auto& buffer = state.buffers.emplace_back(std::make_unique<BinaryLogStagingBuffer>(StagingBufferSize, state.nextThreadIndex++));
+        threadBuffer = buffer.get();
+        threadBufferRelease.buffer = buffer.get();
+        return *buffer;
+    }
+}
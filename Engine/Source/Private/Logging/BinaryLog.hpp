@@ -0,0 +1,283 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+
+#include "BinaryLogFormat.hpp"
+#include "Logger.hpp"
+
+namespace blackbox
+{
+    // Static state of a single BB_LOG_BINARY call site, registered with the binary log the first time it fires
+    struct BinaryLogSite
+    {
+        const Logger& category;
+        LogLevel level {LogLevel::Trace};
+        const char* file {nullptr};
+        uint32_t line {0};
+        std::atomic<uint32_t> id {0}; // 0 until registered
+
+        BinaryLogSite(const Logger& category, const LogLevel level, const char* file, const uint32_t line)
+            : category(category), level(level), file(file), line(line) {}
+    };
+
+    /**
+     * Single producer, single consumer byte ring owned by one logging thread and drained by the binary log writer.
+     * The producer only ever writes whole records, so every range the consumer reads starts and ends on a record.
+     */
+    class BinaryLogStagingBuffer
+    {
+        static constexpr size_t CacheLine = 64;
+
+        std::unique_ptr<std::byte[]> storage {};
+        size_t capacity {0};
+
+        // Producer side
+        alignas(CacheLine) size_t writeCursor {0};
+        size_t cachedReadCursor {0};
+        std::atomic<size_t> committed {0};
+        std::atomic<size_t> wrapPosition {0}; // End of valid data before the producer wrapped around to 0
+
+        // Consumer side
+        alignas(CacheLine) std::atomic<size_t> readCursor {0};
+
+    public:
+        const uint32_t threadIndex {0};
+        std::atomic<uint64_t> dropped {0};
+        std::atomic<bool> retired {false};
+
+        BinaryLogStagingBuffer(size_t capacity, uint32_t threadIndex);
+
+        // Returns space for `size` contiguous bytes, or nullptr if the consumer hasn't freed enough yet
+        [[nodiscard]] std::byte* Reserve(size_t size);
+        void Commit(size_t size);
+
+        // Consumer only, calls `sink(std::span<const std::byte>)` for every committed range and frees it
+        template <typename Sink>
+        void Drain(Sink&& sink);
+    };
+
+    /**
+     * Deferred-format logging for hot paths.
+     *
+     * A call site registers its format string and argument types once. After that every call only copies the
+     * descriptor id, a TSC timestamp and the raw argument bytes into a per-thread staging buffer, no formatting,
+     * locking or allocation happens on the calling thread. A writer thread streams the buffers to a .bblog file
+     * which Tools/LogDecoder turns back into text. If a thread outpaces the writer its messages are dropped and
+     * counted rather than blocking the caller.
+     *
+     * Supported arguments: bool, char, integers, floats, enums, pointers, C strings, std::string(_view).
+     *
+     *   BinaryLog::Open("Saved/Logs/Blackbox.bblog");
+     *   BB_LOG_BINARY(LogEngine, Trace, "Entity {} moved to {}", id, position.x);
+     */
+    class BinaryLog
+    {
+        inline static std::atomic<bool> open {false};
+        inline static thread_local BinaryLogStagingBuffer* threadBuffer {nullptr};
+
+    public:
+        static bool Open(const std::string& filepath);
+        static void Close();
+
+        [[nodiscard]] static bool IsOpen() { return open.load(std::memory_order_relaxed); }
+
+        template <typename... TArgs>
+        static void Write(BinaryLogSite& site, fmt::format_string<TArgs...> format, const TArgs&... args);
+
+    private:
+        static uint32_t Register(BinaryLogSite& site, std::string_view format, std::span<const binarylog::ArgType> argTypes);
+        static BinaryLogStagingBuffer& AttachThread();
+    };
+
+    namespace binarylog
+    {
+        template <typename T>
+        using Stored = typename std::conditional_t<std::is_enum_v<T>, std::underlying_type<T>, std::type_identity<T>>::type;
+
+        template <typename T>
+        constexpr bool IsString = std::is_array_v<T> || std::is_same_v<T, const char*> || std::is_same_v<T, char*>
+            || std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view>;
+
+        template <typename TArg>
+        constexpr ArgType TypeOf()
+        {
+            using T = Stored<std::remove_cvref_t<TArg>>;
+            if constexpr (IsString<T>) return ArgType::String;
+            else if constexpr (std::is_same_v<T, bool>) return ArgType::Bool;
+            else if constexpr (std::is_same_v<T, char>) return ArgType::Char;
+            else if constexpr (std::is_pointer_v<T>) return ArgType::Pointer;
+            else if constexpr (std::is_same_v<T, float>) return ArgType::Float;
+            else if constexpr (std::is_same_v<T, double>) return ArgType::Double;
+            else if constexpr (std::is_integral_v<T> && sizeof(T) <= 4) return std::is_signed_v<T> ? ArgType::Int32 : ArgType::UInt32;
+            else if constexpr (std::is_integral_v<T> && sizeof(T) == 8) return std::is_signed_v<T> ? ArgType::Int64 : ArgType::UInt64;
+            else static_assert(sizeof(T) == 0, "Unsupported binary log argument type");
+        }
+
+        template <typename TArg>
+        std::string_view AsString(const TArg& value)
+        {
+            using T = std::remove_cvref_t<TArg>;
+            if constexpr (std::is_array_v<T>) return std::string_view(value);
+            else if constexpr (std::is_pointer_v<T>) return value != nullptr ? std::string_view(value) : std::string_view();
+            else return std::string_view(value);
+        }
+
+        template <typename TArg>
+        size_t EncodedSize(const TArg& value)
+        {
+            constexpr ArgType type = TypeOf<TArg>();
+            if constexpr (type == ArgType::String) return sizeof(uint16_t) + std::min<size_t>(AsString(value).size(), UINT16_MAX);
+            else if constexpr (type == ArgType::Bool || type == ArgType::Char) return 1;
+            else if constexpr (type == ArgType::Int32 || type == ArgType::UInt32 || type == ArgType::Float) return 4;
+            else return 8;
+        }
+
+        template <typename T>
+        std::byte* Store(std::byte* out, const T value)
+        {
+            std::memcpy(out, &value, sizeof(T));
+            return out + sizeof(T);
+        }
+
+        template <typename TArg>
+        std::byte* Encode(std::byte* out, const TArg& value)
+        {
+            constexpr ArgType type = TypeOf<TArg>();
+            if constexpr (type == ArgType::String)
+            {
+                const std::string_view text = AsString(value);
+                const auto length = static_cast<uint16_t>(std::min<size_t>(text.size(), UINT16_MAX));
+                out = Store(out, length);
+                std::memcpy(out, text.data(), length);
+                return out + length;
+            }
+            else if constexpr (type == ArgType::Pointer) return Store(out, reinterpret_cast<uint64_t>(value));
+            else if constexpr (type == ArgType::Int32) return Store(out, static_cast<int32_t>(value));
+            else if constexpr (type == ArgType::UInt32) return Store(out, static_cast<uint32_t>(value));
+            else if constexpr (type == ArgType::Int64) return Store(out, static_cast<int64_t>(value));
+            else if constexpr (type == ArgType::UInt64) return Store(out, static_cast<uint64_t>(value));
+            else return Store(out, static_cast<Stored<std::remove_cvref_t<TArg>>>(value));
+        }
+
+        inline uint64_t ReadTimestamp()
+        {
+            return __rdtsc();
+        }
+    }
+
+    inline std::byte* BinaryLogStagingBuffer::Reserve(const size_t size)
+    {
+        // Two attempts, the second one with a fresh read cursor in case the consumer made room in the meantime
+        for (int attempt = 0; attempt < 2; attempt++)
+        {
+            if (writeCursor >= cachedReadCursor)
+            {
+                // Free space is the tail [writeCursor, capacity) plus the head [0, readCursor)
+                if (capacity - writeCursor > size)
+                {
+                    return storage.get() + writeCursor;
+                }
+                if (cachedReadCursor > size)
+                {
+                    wrapPosition.store(writeCursor, std::memory_order_relaxed);
+                    writeCursor = 0;
+                    committed.store(0, std::memory_order_release);
+                    return storage.get();
+                }
+            }
+            else if (cachedReadCursor - writeCursor > size)
+            {
+                return storage.get() + writeCursor;
+            }
+
+            cachedReadCursor = readCursor.load(std::memory_order_acquire);
+        }
+
+        return nullptr;
+    }
+
+    inline void BinaryLogStagingBuffer::Commit(const size_t size)
+    {
+        writeCursor += size;
+        committed.store(writeCursor, std::memory_order_release);
+    }
+
+    template <typename Sink>
+    void BinaryLogStagingBuffer::Drain(Sink&& sink)
+    {
+        size_t begin = readCursor.load(std::memory_order_relaxed);
+        const size_t end = committed.load(std::memory_order_acquire);
+
+        if (end < begin)
+        {
+            // The producer wrapped, finish the tail first
+            const size_t tailEnd = wrapPosition.load(std::memory_order_relaxed);
+            if (tailEnd > begin)
+            {
+                sink(std::span<const std::byte>(storage.get() + begin, tailEnd - begin));
+            }
+            begin = 0;
+        }
+
+        if (end > begin)
+        {
+            sink(std::span<const std::byte>(storage.get() + begin, end - begin));
+        }
+        readCursor.store(end, std::memory_order_release);
+    }
+
+    template <typename... TArgs>
+    void BinaryLog::Write(BinaryLogSite& site, fmt::format_string<TArgs...> format, const TArgs&... args)
+    {
+        uint32_t id = site.id.load(std::memory_order_acquire);
+        if (id == 0) [[unlikely]]
+        {
+            static constexpr std::array<binarylog::ArgType, sizeof...(TArgs)> argTypes {binarylog::TypeOf<TArgs>()...};
+            id = Register(site, std::string_view(format.get().data(), format.get().size()), argTypes);
+        }
+
+        BinaryLogStagingBuffer& buffer = threadBuffer != nullptr ? *threadBuffer : AttachThread();
+        const size_t size = sizeof(uint32_t) + sizeof(uint64_t) + (binarylog::EncodedSize(args) + ... + 0);
+
+        std::byte* out = buffer.Reserve(size);
+        if (out == nullptr) [[unlikely]]
+        {
+            buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        out = binarylog::Store(out, id);
+        out = binarylog::Store(out, binarylog::ReadTimestamp());
+        ((out = binarylog::Encode(out, args)), ...);
+        buffer.Commit(size);
+    }
+}
+
+/**
+ * Binary counterpart of BB_LOG, only the argument bytes are recorded and formatting happens offline.
+ * Does nothing unless the category has `Level` enabled and BinaryLog::Open has been called.
+ */
+#define BB_LOG_BINARY(Category, Level, ...) \
+    do \
+    { \
+        if ((Category)->IsEnabled(::blackbox::LogLevel::Level) && ::blackbox::BinaryLog::IsOpen()) \
+        { \
+            static ::blackbox::BinaryLogSite binaryLogSite(*(Category), ::blackbox::LogLevel::Level, __FILE__, __LINE__); \
+            ::blackbox::BinaryLog::Write(binaryLogSite, __VA_ARGS__); \
+        } \
+    } while (false)
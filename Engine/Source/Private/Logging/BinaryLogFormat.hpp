@@ -0,0 +1,59 @@
+﻿#pragma once
+
+#include <array>
+#include <cstdint>
+
+// On-disk layout of binary log files, shared between the engine and Tools/LogDecoder.
+// All values are little-endian and written without padding.
+//
+//   FileHeader
+//   ChunkHeader + payload, repeated until the end of the file
+//
+// Descriptor payload:  uint32 id, uint8 level, uint32 line, uint8 argCount, BinaryArgType[argCount],
+//                      uint16 + chars category, uint16 + chars file, uint16 + chars format
+// Records payload:     uint32 threadIndex, followed by complete records:
+//                      uint32 descriptorId, uint64 tsc, encoded arguments
+// Dropped payload:     uint32 threadIndex, uint64 count
+// Calibration payload: uint64 tscAtOpen, uint64 tscNow, uint64 nanosecondsSinceOpen
+//
+// Arguments are stored raw in their native size, strings as uint16 length followed by the characters.
+namespace blackbox::binarylog
+{
+    constexpr std::array<char, 8> Magic {'B', 'B', 'L', 'O', 'G', '0', '0', '1'};
+
+    enum class ChunkType : uint8_t
+    {
+        Descriptor,
+        Records,
+        Dropped,
+        Calibration,
+    };
+
+    enum class ArgType : uint8_t
+    {
+        Bool,
+        Char,
+        Int32,
+        UInt32,
+        Int64,
+        UInt64,
+        Float,
+        Double,
+        Pointer,
+        String,
+    };
+
+    #pragma pack(push, 1)
+    struct FileHeader
+    {
+        std::array<char, 8> magic {Magic};
+        int64_t unixTimeNanoseconds {0}; // Wall clock time the log was opened
+    };
+
+    struct ChunkHeader
+    {
+        ChunkType type {};
+        uint32_t size {0}; // Payload size in bytes, excluding this header
+    };
+    #pragma pack(pop)
+}
@@ -0,0 +1,282 @@
+﻿#include "LogBackend.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <spdlog/sinks/stdout_color_sinks.h>
+
+#if defined(_WIN32)
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+#include "CrashHandler.hpp"
+#include "FlightRecorder.hpp"
+
+namespace blackbox
+{
+    namespace
+    {
+        // Async-signal-safe, no stdio and no locks
+        void WriteToStdout(const char* data, const size_t size)
+        {
+#if defined(_WIN32)
+            _write(1, data, static_cast<unsigned int>(size));
+#else
+            size_t written {0};
+            while (written < size)
+            {
+                const ssize_t result = write(STDOUT_FILENO, data + written, size - written);
+                if (result <= 0)
+                {
+                    return;
+                }
+                written += static_cast<size_t>(result);
+            }
+#endif
+        }
+    }
+
+    LogBackend::LogBackend()
+        : console(std::make_shared<spdlog::sinks::stdout_color_sink_mt>())
+    {
+        console->set_pattern("%^ %n [%T] %v%$");
+    }
+
+    LogBackend::~LogBackend()
+    {
+        Shutdown();
+    }
+
+    const std::shared_ptr<LogBackend>& LogBackend::Get()
+    {
+        static const auto backend = std::make_shared<LogBackend>();
+        return backend;
+    }
+
+    void LogBackend::EnableAsync(const AsyncLogSettings& settings)
+    {
+        if (asyncEnabled.load())
+        {
+            return;
+        }
+
+        queue = std::make_unique<LogRingBuffer<LogRecord>>(settings.queueSize);
+        overflowPolicy = settings.overflowPolicy;
+        stopRequested.store(false);
+        worker = std::thread(&LogBackend::WorkerLoop, this);
+        asyncEnabled.store(true);
+
+        CrashHandler::AddCallback([] { Get()->FlushOnCrash(); });
+    }
+
+    void LogBackend::Shutdown()
+    {
+        if (!asyncEnabled.exchange(false))
+        {
+            console->flush();
+            return;
+        }
+
+        // Producers that already saw async mode enabled finish their push before the worker is stopped
+        while (producersInFlight.load() != 0)
+        {
+            std::this_thread::yield();
+        }
+
+        stopRequested.store(true);
+        workerSleeping.store(false);
+        workerSleeping.notify_one();
+        worker.join();
+
+        console->flush();
+    }
+
+    void LogBackend::FlushOnCrash()
+    {
+        asyncEnabled.store(false);
+
+        // The worker may be halfway through a batch, give it a moment to let go of the queue
+        for (int attempt = 0; attempt < 100000 && consumerBusy.test(std::memory_order_acquire); attempt++) {}
+
+        if (queue != nullptr)
+        {
+            DrainToStdout();
+        }
+    }
+
+    void LogBackend::log(const spdlog::details::log_msg& msg)
+    {
+        FlightRecorder::RecordLog(static_cast<uint8_t>(msg.level), {msg.logger_name.data(), msg.logger_name.size()}, {msg.payload.data(), msg.payload.size()});
+
+        if (!asyncEnabled.load(std::memory_order_relaxed))
+        {
+            console->log(msg);
+            return;
+        }
+
+        producersInFlight.fetch_add(1);
+        if (asyncEnabled.load())
+        {
+            Enqueue(msg);
+        }
+        else
+        {
+            console->log(msg); // Shutdown started between the two checks
+        }
+        producersInFlight.fetch_sub(1);
+    }
+
+    void LogBackend::flush()
+    {
+        if (!asyncEnabled.load(std::memory_order_relaxed))
+        {
+            console->flush();
+        }
+        // In async mode the worker flushes after every batch
+    }
+
+    void LogBackend::set_pattern(const std::string& pattern)
+    {
+        console->set_pattern(pattern);
+    }
+
+    void LogBackend::set_formatter(std::unique_ptr<spdlog::formatter> formatter)
+    {
+        console->set_formatter(std::move(formatter));
+    }
+
+    void LogBackend::Enqueue(const spdlog::details::log_msg& msg)
+    {
+        const auto fill = [&msg](LogRecord& record)
+        {
+            record.time = msg.time;
+            record.loggerName = msg.logger_name;
+            record.threadId = msg.thread_id;
+            record.level = msg.level;
+            record.size = static_cast<uint32_t>(msg.payload.size());
+            record.overflow = record.size > LogRecord::PayloadCapacity ? new char[record.size] : nullptr;
+            std::memcpy(record.overflow != nullptr ? record.overflow : record.payload.data(), msg.payload.data(), record.size);
+        };
+
+        if (queue->TryPush(fill))
+        {
+            WakeWorker();
+            return;
+        }
+
+        switch (overflowPolicy)
+        {
+        case LogOverflowPolicy::Block:
+            WakeWorker();
+            while (!queue->TryPush(fill))
+            {
+                std::this_thread::yield();
+            }
+            WakeWorker();
+            break;
+        case LogOverflowPolicy::Drop:
+            break;
+        case LogOverflowPolicy::DropAndCount:
+            droppedMessages.fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+    }
+
+    void LogBackend::WakeWorker()
+    {
+        // Orders the push before the load, pairs with the fence in WorkerLoop so that either the worker sees the
+        // record or we see it sleeping
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (workerSleeping.load() && workerSleeping.exchange(false))
+        {
+            workerSleeping.notify_one();
+        }
+    }
+
+    void LogBackend::WorkerLoop()
+    {
+        while (true)
+        {
+            Drain();
+
+            if (stopRequested.load())
+            {
+                Drain(); // Anything pushed while the last batch was written
+                return;
+            }
+
+            // Announce we're about to sleep, then check once more so a push racing with us isn't missed
+            workerSleeping.store(true);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (!queue->IsEmpty() || stopRequested.load())
+            {
+                workerSleeping.store(false);
+                continue;
+            }
+            workerSleeping.wait(true);
+        }
+    }
+
+    void LogBackend::Drain()
+    {
+        if (consumerBusy.test_and_set(std::memory_order_acquire))
+        {
+            return;
+        }
+
+        LogRecord record {};
+        bool wroteAny {false};
+        while (queue->TryPop(record))
+        {
+            Write(record);
+            delete[] record.overflow;
+            wroteAny = true;
+        }
+
+        if (const uint64_t dropped = droppedMessages.exchange(0, std::memory_order_relaxed); dropped > 0)
+        {
+            const std::string text = fmt::format("Log queue overflowed, dropped {} message(s)", dropped);
+            console->log(spdlog::details::log_msg("Logger", spdlog::level::warn, text));
+            wroteAny = true;
+        }
+
+        if (wroteAny)
+        {
+            console->flush();
+        }
+
+        consumerBusy.clear(std::memory_order_release);
+    }
+
+    void LogBackend::DrainToStdout()
+    {
+        if (consumerBusy.test_and_set(std::memory_order_acquire))
+        {
+            return;
+        }
+
+        // " Name [level] message", the pattern's time would need localtime, which isn't signal safe
+        LogRecord record {};
+        while (queue->TryPop(record))
+        {
+            const spdlog::string_view_t level = spdlog::level::to_string_view(record.level);
+            WriteToStdout(" ", 1);
+            WriteToStdout(record.loggerName.data(), record.loggerName.size());
+            WriteToStdout(" [", 2);
+            WriteToStdout(level.data(), level.size());
+            WriteToStdout("] ", 2);
+            WriteToStdout(record.Text(), record.size);
+            WriteToStdout("\n", 1);
+        }
+
+        consumerBusy.clear(std::memory_order_release);
+    }
+
+    void LogBackend::Write(const LogRecord& record) const
+    {
+        spdlog::details::log_msg msg(record.time, {}, record.loggerName, record.level, {record.Text(), record.size});
+        msg.thread_id = record.threadId;
+        console->log(msg);
+    }
+}
@@ -0,0 +1,84 @@
+﻿#pragma once
+
+#include <array>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <spdlog/sinks/sink.h>
+
+#include "Logger.hpp"
+#include "LogRingBuffer.hpp"
+
+namespace blackbox
+{
+    struct LogRecord
+    {
+        static constexpr size_t PayloadCapacity = 208; // Longer messages spill into `overflow`
+
+        spdlog::log_clock::time_point time {};
+        spdlog::string_view_t loggerName {}; // Points into the owning spdlog::logger, loggers outlive the queue
+        size_t threadId {0};
+        spdlog::level::level_enum level {spdlog::level::off};
+        uint32_t size {0};
+        std::array<char, PayloadCapacity> payload {};
+        char* overflow {nullptr}; // Heap copy of a message that doesn't fit `payload`, freed by the consumer
+
+        [[nodiscard]] const char* Text() const { return overflow != nullptr ? overflow : payload.data(); }
+    };
+
+    /**
+     * The single sink every Logger writes to.
+     *
+     * In synchronous mode it forwards straight to the console sink. In async mode it copies the already
+     * formatted message into a LogRingBuffer and a background thread applies the pattern and writes it out.
+     */
+    class LogBackend final : public spdlog::sinks::sink
+    {
+        std::shared_ptr<spdlog::sinks::sink> console {};
+
+        std::unique_ptr<LogRingBuffer<LogRecord>> queue {};
+        LogOverflowPolicy overflowPolicy {LogOverflowPolicy::DropAndCount};
+
+        std::atomic<bool> asyncEnabled {false};
+        std::atomic<uint32_t> producersInFlight {0};
+        std::atomic<uint64_t> droppedMessages {0};
+
+        std::atomic<bool> stopRequested {false};
+        std::atomic<bool> workerSleeping {false};
+        std::atomic_flag consumerBusy {};
+        std::thread worker {};
+
+    public:
+        LogBackend();
+        ~LogBackend() override;
+
+        LogBackend(const LogBackend& other) = delete;
+        LogBackend& operator=(const LogBackend&) = delete;
+        LogBackend(LogBackend&& other) = delete;
+        LogBackend& operator=(LogBackend&& other) = delete;
+
+        [[nodiscard]] static const std::shared_ptr<LogBackend>& Get();
+
+        void EnableAsync(const AsyncLogSettings& settings);
+        void Shutdown();
+
+        // Best effort drain from a crash handler. Records are written to stdout with write(2) and without the
+        // console's pattern, the sink's mutex may be held by the crashing thread. Gives up if the worker doesn't
+        // let go of the queue in time.
+        void FlushOnCrash();
+
+        // spdlog::sinks::sink
+        void log(const spdlog::details::log_msg& msg) override;
+        void flush() override;
+        void set_pattern(const std::string& pattern) override;
+        void set_formatter(std::unique_ptr<spdlog::formatter> formatter) override;
+
+    private:
+        void Enqueue(const spdlog::details::log_msg& msg);
+        void WakeWorker();
+        void WorkerLoop();
+        void Drain();
+        void DrainToStdout();
+        void Write(const LogRecord& record) const;
+    };
+}
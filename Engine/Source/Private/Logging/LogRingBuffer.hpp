@@ -0,0 +1,117 @@
+﻿#pragma once
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+#include <new>
+
+namespace blackbox
+{
+    /**
+     * Bounded lock-free multi-producer queue with a fixed number of preallocated slots.
+     *
+     * Every slot carries a sequence number that tells producers and the consumer whose turn it is, so pushing
+     * is a single CAS on the write cursor followed by a plain copy into the slot. Nothing is allocated after
+     * construction. Only one thread may pop at a time, the owner serializes consumers itself.
+     */
+    template <typename T>
+    class LogRingBuffer
+    {
+        struct Slot
+        {
+            std::atomic<size_t> sequence {0};
+            T value {};
+        };
+
+        static constexpr size_t CacheLine = 64;
+
+        std::unique_ptr<Slot[]> slots {};
+        size_t mask {0};
+
+        alignas(CacheLine) std::atomic<size_t> writePosition {0};
+        alignas(CacheLine) size_t readPosition {0};
+
+    public:
+        explicit LogRingBuffer(size_t capacity);
+
+        LogRingBuffer(const LogRingBuffer& other) = delete;
+        LogRingBuffer& operator=(const LogRingBuffer&) = delete;
+        LogRingBuffer(LogRingBuffer&& other) = delete;
+        LogRingBuffer& operator=(LogRingBuffer&& other) = delete;
+
+        [[nodiscard]] size_t Capacity() const { return mask + 1; }
+
+        // Claims a slot and lets `fill` write into it. Returns false without calling `fill` if the queue is full.
+        template <typename Fill>
+        bool TryPush(Fill&& fill);
+
+        // Pops the oldest value into `out`. Returns false if the queue is empty.
+        bool TryPop(T& out);
+
+        [[nodiscard]] bool IsEmpty() const;
+    };
+
+    template <typename T>
+    LogRingBuffer<T>::LogRingBuffer(const size_t capacity)
+        : slots(std::make_unique<Slot[]>(std::bit_ceil(capacity < 2 ? size_t {2} : capacity)))
+        , mask(std::bit_ceil(capacity < 2 ? size_t {2} : capacity) - 1)
+    {
+        for (size_t i = 0; i <= mask; i++)
+        {
+            slots[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    template <typename T>
+    template <typename Fill>
+    bool LogRingBuffer<T>::TryPush(Fill&& fill)
+    {
+        size_t position = writePosition.load(std::memory_order_relaxed);
+        while (true)
+        {
+            Slot& slot = slots[position & mask];
+            const size_t sequence = slot.sequence.load(std::memory_order_acquire);
+            const auto difference = static_cast<ptrdiff_t>(sequence) - static_cast<ptrdiff_t>(position);
+
+            if (difference == 0)
+            {
+                if (writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    fill(slot.value);
+                    slot.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false; // The consumer hasn't freed this slot yet, queue is full
+            }
+            else
+            {
+                position = writePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    template <typename T>
+    bool LogRingBuffer<T>::TryPop(T& out)
+    {
+        Slot& slot = slots[readPosition & mask];
+        if (slot.sequence.load(std::memory_order_acquire) != readPosition + 1)
+        {
+            return false;
+        }
+
+        out = slot.value;
+        slot.sequence.store(readPosition + mask + 1, std::memory_order_release);
+        readPosition++;
+        return true;
+    }
+
+    template <typename T>
+    bool LogRingBuffer<T>::IsEmpty() const
+    {
+        return slots[readPosition & mask].sequence.load(std::memory_order_acquire) != readPosition + 1;
+    }
+}
@@ -0,0 +1,211 @@
+﻿#include "FrustumCulling.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <emmintrin.h>
+
+#include "Jobs/JobSystem.hpp"
+
+namespace blackbox
+{
+    Frustum Frustum::FromMatrix(const glm::mat4& viewProjection)
+    {
+        // Gribb and Hartmann: each clip plane is the w row plus or minus one of the x, y and z rows
+        auto row = [&](const glm::length_t index)
+        {
+            return float4(viewProjection[0][index], viewProjection[1][index], viewProjection[2][index], viewProjection[3][index]);
+        };
+
+        Frustum frustum {};
+        frustum.planes = {row(3) + row(0), row(3) - row(0), row(3) + row(1), row(3) - row(1), row(3) + row(2), row(3) - row(2)};
+        for (float4& plane : frustum.planes)
+        {
+            plane /= glm::length(float3(plane));
+        }
+        return frustum;
+    }
+
+    bool Frustum::Intersects(const float3& center, const float3& extents, const float radius) const
+    {
+        // Summed in the order FrustumCuller sums its lanes, so both agree on objects touching a plane
+        for (const float4& plane : planes)
+        {
+            const float distance = (plane.x * center.x + plane.y * center.y) + (plane.z * center.z + plane.w);
+            const float reach = std::min((std::abs(plane.x) * extents.x + std::abs(plane.y) * extents.y) + std::abs(plane.z) * extents.z, radius);
+            if (!(distance >= -reach))
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    uint32_t FrustumCuller::Add(const float3& center, const float3& extents)
+    {
+        const auto index = static_cast<uint32_t>(Size());
+        for (std::vector<float>* array : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ, &radius})
+        {
+            array->push_back(0.0f);
+        }
+        Set(index, center, extents);
+        return index;
+    }
+
+    uint32_t FrustumCuller::AddSphere(const float3& center, const float sphereRadius)
+    {
+        const uint32_t index = Add(center, float3(sphereRadius));
+        SetSphere(index, center, sphereRadius);
+        return index;
+    }
+
+    void FrustumCuller::Set(const uint32_t index, const float3& center, const float3& extents)
+    {
+        centerX[index] = center.x;
+        centerY[index] = center.y;
+        centerZ[index] = center.z;
+        extentX[index] = extents.x;
+        extentY[index] = extents.y;
+        extentZ[index] = extents.z;
+        radius[index] = glm::length(extents);
+    }
+
+    void FrustumCuller::SetSphere(const uint32_t index, const float3& center, const float sphereRadius)
+    {
+        Set(index, center, float3(sphereRadius));
+        radius[index] = sphereRadius;
+    }
+
+    void FrustumCuller::Reserve(const size_t count)
+    {
+        for (std::vector<float>* array : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ, &radius})
+        {
+            array->reserve(count);
+        }
+    }
+
+    void FrustumCuller::Clear()
+    {
+        for (std::vector<float>* array : {&centerX, &centerY, &centerZ, &extentX, &extentY, &extentZ, &radius})
+        {
+            array->clear();
+        }
+    }
+
+    std::span<const uint32_t> FrustumCuller::Cull(const Frustum& frustum, JobSystem& jobs)
+    {
+        const size_t chunks = (Size() + ChunkSize - 1) / ChunkSize;
+        visible.resize(Size());
+        chunkCounts.resize(chunks);
+
+        // Every chunk writes from its own start, Compact closes the gaps afterwards
+        jobs.ParallelFor(chunks, 1, [&](const size_t begin, const size_t end, uint32_t)
+        {
+            for (size_t chunk = begin; chunk < end; chunk++)
+            {
+                const size_t first = chunk * ChunkSize;
+                chunkCounts[chunk] = static_cast<uint32_t>(CullRange(frustum, first, std::min(first + ChunkSize, Size()), visible.data() + first));
+            }
+        });
+
+        return Compact(chunks);
+    }
+
+    std::span<const uint32_t> FrustumCuller::Cull(const Frustum& frustum)
+    {
+        visible.resize(Size());
+        return {visible.data(), CullRange(frustum, 0, Size(), visible.data())};
+    }
+
+    size_t FrustumCuller::CullRange(const Frustum& frustum, const size_t begin, const size_t end, uint32_t* output) const
+    {
+        struct PlaneLanes
+        {
+            __m128 x, y, z, w;
+            __m128 absX, absY, absZ;
+        };
+
+        PlaneLanes planes[Frustum::PlaneCount];
+        for (size_t i = 0; i < Frustum::PlaneCount; i++)
+        {
+            const float4& plane = frustum.planes[i];
+            planes[i] = {
+                _mm_set1_ps(plane.x), _mm_set1_ps(plane.y), _mm_set1_ps(plane.z), _mm_set1_ps(plane.w),
+                _mm_set1_ps(std::abs(plane.x)), _mm_set1_ps(std::abs(plane.y)), _mm_set1_ps(std::abs(plane.z)),
+            };
+        }
+
+        size_t count {0};
+        for (size_t first = begin; first < end; first += 4)
+        {
+            // Fewer than four objects left at the end, they're gathered into zeroed lanes the mask ignores
+            const size_t lanes = std::min<size_t>(end - first, 4);
+            __m128 cx, cy, cz, ex, ey, ez, r;
+            if (lanes == 4)
+            {
+                cx = _mm_loadu_ps(&centerX[first]);
+                cy = _mm_loadu_ps(&centerY[first]);
+                cz = _mm_loadu_ps(&centerZ[first]);
+                ex = _mm_loadu_ps(&extentX[first]);
+                ey = _mm_loadu_ps(&extentY[first]);
+                ez = _mm_loadu_ps(&extentZ[first]);
+                r = _mm_loadu_ps(&radius[first]);
+            }
+            else
+            {
+                alignas(16) float tail[7][4] {};
+                for (size_t lane = 0; lane < lanes; lane++)
+                {
+                    tail[0][lane] = centerX[first + lane];
+                    tail[1][lane] = centerY[first + lane];
+                    tail[2][lane] = centerZ[first + lane];
+                    tail[3][lane] = extentX[first + lane];
+                    tail[4][lane] = extentY[first + lane];
+                    tail[5][lane] = extentZ[first + lane];
+                    tail[6][lane] = radius[first + lane];
+                }
+                cx = _mm_load_ps(tail[0]);
+                cy = _mm_load_ps(tail[1]);
+                cz = _mm_load_ps(tail[2]);
+                ex = _mm_load_ps(tail[3]);
+                ey = _mm_load_ps(tail[4]);
+                ez = _mm_load_ps(tail[5]);
+                r = _mm_load_ps(tail[6]);
+            }
+
+            uint32_t mask = (1u << lanes) - 1;
+            for (const PlaneLanes& plane : planes)
+            {
+                const __m128 distance = _mm_add_ps(_mm_add_ps(_mm_mul_ps(plane.x, cx), _mm_mul_ps(plane.y, cy)), _mm_add_ps(_mm_mul_ps(plane.z, cz), plane.w));
+                const __m128 boxReach = _mm_add_ps(_mm_add_ps(_mm_mul_ps(plane.absX, ex), _mm_mul_ps(plane.absY, ey)), _mm_mul_ps(plane.absZ, ez));
+                const __m128 reach = _mm_min_ps(boxReach, r);
+
+                // distance + reach >= 0, written as a comparison so NaN bounds count as outside
+                mask &= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmpge_ps(distance, _mm_sub_ps(_mm_setzero_ps(), reach))));
+                if (mask == 0)
+                {
+                    break;
+                }
+            }
+
+            for (; mask != 0; mask &= mask - 1)
+            {
+                output[count++] = static_cast<uint32_t>(first + std::countr_zero(mask));
+            }
+        }
+        return count;
+    }
+
+    std::span<const uint32_t> FrustumCuller::Compact(const size_t chunks)
+    {
+        // Chunks only ever move toward the front, so copying forward never overwrites what is still to be moved
+        size_t count {0};
+        for (size_t chunk = 0; chunk < chunks; chunk++)
+        {
+            const auto source = visible.begin() + static_cast<std::ptrdiff_t>(chunk * ChunkSize);
+            std::copy(source, source + chunkCounts[chunk], visible.begin() + static_cast<std::ptrdiff_t>(count));
+            count += chunkCounts[chunk];
+        }
+        return {visible.data(), count};
+    }
+}
@@ -0,0 +1,84 @@
+﻿#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/mat4x4.hpp>
+
+#include "Types.hpp"
+
+namespace blackbox
+{
+    class JobSystem;
+
+    // Six planes facing inward, a point p is inside a plane when dot(plane.xyz, p) + plane.w >= 0
+    struct Frustum
+    {
+        static constexpr size_t PlaneCount = 6;
+
+        std::array<float4, PlaneCount> planes {}; // Left, right, bottom, top, near, far
+
+        // Planes of what GL keeps after clipping, -w <= x, y, z <= w, so it also fits zero to one depth projections
+        [[nodiscard]] static Frustum FromMatrix(const glm::mat4& viewProjection);
+
+        // The same test FrustumCuller runs, one object at a time
+        [[nodiscard]] bool Intersects(const float3& center, const float3& extents, float radius) const;
+    };
+
+    /**
+     * World-space bounds of many objects in structure of arrays layout, culled against a Frustum four at a time
+     * with SSE2.
+     *
+     * Every object has an axis-aligned box and a sphere around the same center, each plane tests against the
+     * one that reaches less far toward it. Objects added as boxes get the sphere enclosing the box and the other
+     * way around, so the test is never looser than the shape an object was added with. Like every plane test it
+     * is conservative, objects near a frustum corner can pass without being visible.
+     *
+     * Cull hands ChunkSize objects at a time to the JobSystem and returns the indices of the visible objects in
+     * ascending order.
+     *
+     *   const uint32_t index = culler.Add(center, extents);
+     *   for (const uint32_t visible : culler.Cull(Frustum::FromMatrix(projection * view), jobs)) { ... }
+     */
+    class FrustumCuller
+    {
+    public:
+        static constexpr size_t ChunkSize = 4096;
+
+    private:
+        std::vector<float> centerX {};
+        std::vector<float> centerY {};
+        std::vector<float> centerZ {};
+        std::vector<float> extentX {};
+        std::vector<float> extentY {};
+        std::vector<float> extentZ {};
+        std::vector<float> radius {};
+
+        std::vector<uint32_t> visible {};
+        std::vector<uint32_t> chunkCounts {}; // Visible objects per chunk before compaction
+
+    public:
+        // Returns the object's index, which it keeps until Clear
+        uint32_t Add(const float3& center, const float3& extents);
+        uint32_t AddSphere(const float3& center, float sphereRadius);
+
+        // Move an object, or change its size
+        void Set(uint32_t index, const float3& center, const float3& extents);
+        void SetSphere(uint32_t index, const float3& center, float sphereRadius);
+
+        void Reserve(size_t count);
+        void Clear();
+        [[nodiscard]] size_t Size() const { return radius.size(); }
+
+        // Indices of the objects intersecting `frustum`, valid until the next call
+        [[nodiscard]] std::span<const uint32_t> Cull(const Frustum& frustum, JobSystem& jobs);
+        // On the calling thread only
+        [[nodiscard]] std::span<const uint32_t> Cull(const Frustum& frustum);
+
+    private:
+        // Writes the visible objects of [begin, end) to `output` and returns how many there are
+        size_t CullRange(const Frustum& frustum, size_t begin, size_t end, uint32_t* output) const;
+        [[nodiscard]] std::span<const uint32_t> Compact(size_t chunks);
+    };
+}
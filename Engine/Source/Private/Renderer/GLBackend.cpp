@@ -0,0 +1,719 @@
+﻿#include "GLBackend.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <optional>
+#include <string>
+#include <utility>
+#include <glad/glad.h>
+#include <glm/gtc/matrix_transform.hpp>
+
+#include "Blackbox.hpp"
+#include "LightClusters.hpp"
+#include "SortKey.hpp"
+#include "SpriteBatch.hpp"
+
+namespace blackbox
+{
+    namespace
+    {
+        // Room for 13k instances per frame before the ring has to grow
+        constexpr size_t InstanceBufferSize = 1024 * 1024;
+        // Room for the 100k sprites per frame SpriteBatch is built for before the ring has to grow
+        constexpr size_t SpriteBufferSize = 100'000 * 4 * sizeof(SpriteVertex);
+        constexpr size_t PassCount = 3;
+        constexpr auto ProgramCacheDirectory = "Saved/ShaderCache";
+
+        // Samplers and texel formats of the LightClusters arrays, in LightUnit order
+        constexpr const char* LightSamplerNames[] {"lightData", "lightClusters", "lightIndices"};
+        constexpr GLenum LightFormats[] {GL_RGBA32F, GL_RG32UI, GL_R16UI};
+
+        // Texture formats of the render graph's targets, in TargetFormat order
+        struct TargetFormatInfo
+        {
+            GLenum internalFormat {GL_RGBA8};
+            GLenum format {GL_RGBA};
+            GLenum type {GL_UNSIGNED_BYTE};
+            GLenum attachment {GL_COLOR_ATTACHMENT0};
+        };
+
+        constexpr TargetFormatInfo TargetFormats[] {
+            {GL_RGBA8, GL_RGBA, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT0},
+            {GL_RGBA16F, GL_RGBA, GL_HALF_FLOAT, GL_COLOR_ATTACHMENT0},
+            {GL_R11F_G11F_B10F, GL_RGB, GL_FLOAT, GL_COLOR_ATTACHMENT0},
+            {GL_RG16F, GL_RG, GL_HALF_FLOAT, GL_COLOR_ATTACHMENT0},
+            {GL_R8, GL_RED, GL_UNSIGNED_BYTE, GL_COLOR_ATTACHMENT0},
+            {GL_R16F, GL_RED, GL_HALF_FLOAT, GL_COLOR_ATTACHMENT0},
+            {GL_R32F, GL_RED, GL_FLOAT, GL_COLOR_ATTACHMENT0},
+            {GL_DEPTH24_STENCIL8, GL_DEPTH_STENCIL, GL_UNSIGNED_INT_24_8, GL_DEPTH_STENCIL_ATTACHMENT},
+            {GL_DEPTH_COMPONENT32F, GL_DEPTH_COMPONENT, GL_FLOAT, GL_DEPTH_ATTACHMENT},
+        };
+
+        // Per-instance vertex data, read through InstanceAttribute and MaterialAttribute
+        struct InstanceData
+        {
+            glm::mat4 model {1.0f};
+            uint32_t material {0}; // Index within the bound MaterialData window
+            uint32_t padding[3] {};
+        };
+
+        size_t AlignUp(const size_t value, const size_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+    }
+
+    GLBackend::GLBackend(GLContext& context, const FileIO& fileIO)
+        : instances(context, state, InstanceBufferSize)
+        , spriteVertices(context, state, SpriteBufferSize)
+        , atlas(state)
+        , streamer(fileIO, atlas)
+        , programCache(context, ProgramCacheDirectory)
+        , compiler(context, programCache)
+    {
+        glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+        GLint alignment {0};
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        uniformAlignment = std::max<size_t>(alignment, 16);
+        materialBlocks.windowStride = AlignUp(sizeof(MaterialBlock) * MaterialsPerBlock, uniformAlignment);
+        glGenBuffers(1, &materialBlocks.buffer);
+
+        // The textures keep pointing at their buffers when a frame's upload reallocates them
+        glGenBuffers(LightBufferCount, lightBuffers.buffers.data());
+        glGenTextures(LightBufferCount, lightBuffers.textures.data());
+        for (uint32_t i = 0; i < LightBufferCount; i++)
+        {
+            state.BindBuffer(GL_TEXTURE_BUFFER, lightBuffers.buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, 16, nullptr, GL_STREAM_DRAW);
+            state.BindTextureForEdit(LightUnit + i, GL_TEXTURE_BUFFER, lightBuffers.textures[i]);
+            glTexBuffer(GL_TEXTURE_BUFFER, LightFormats[i], lightBuffers.buffers[i]);
+        }
+
+        // Every quad is two triangles over its four corners, the same for all sprites
+        std::vector<uint16_t> spriteIndices(MaxSpritesPerDraw * 6);
+        for (uint32_t sprite = 0; sprite < MaxSpritesPerDraw; sprite++)
+        {
+            const auto corner = static_cast<uint16_t>(sprite * 4);
+            std::ranges::copy(std::array<uint16_t, 6> {corner, static_cast<uint16_t>(corner + 1), static_cast<uint16_t>(corner + 2),
+                static_cast<uint16_t>(corner + 2), static_cast<uint16_t>(corner + 3), corner}, spriteIndices.begin() + sprite * 6);
+        }
+        glGenVertexArrays(1, &spriteBuffers.vertexArray);
+        glGenBuffers(1, &spriteBuffers.indexBuffer);
+        state.BindVertexArray(spriteBuffers.vertexArray);
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, spriteBuffers.indexBuffer);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(spriteIndices.size() * sizeof(uint16_t)), spriteIndices.data(), GL_STATIC_DRAW);
+        for (uint32_t attribute = 0; attribute < 3; attribute++)
+        {
+            glEnableVertexAttribArray(attribute);
+        }
+    }
+
+    GLBackend::~GLBackend()
+    {
+        for (const Shader& shader : shaders)
+        {
+            glDeleteProgram(shader.program);
+        }
+
+        for (const Mesh& mesh : meshes)
+        {
+            glDeleteVertexArrays(1, &mesh.vertexArray);
+            glDeleteBuffers(1, &mesh.vertexBuffer);
+            glDeleteBuffers(1, &mesh.indexBuffer);
+        }
+
+        glDeleteBuffers(1, &materialBlocks.buffer);
+        glDeleteTextures(LightBufferCount, lightBuffers.textures.data());
+        glDeleteBuffers(LightBufferCount, lightBuffers.buffers.data());
+        glDeleteVertexArrays(1, &spriteBuffers.vertexArray);
+        glDeleteBuffers(1, &spriteBuffers.indexBuffer);
+    }
+
+    ShaderHandle GLBackend::CreateShader(const std::string_view vertexSource, const std::string_view fragmentSource)
+    {
+        if (shaders.size() >= SortKey::MaxShaders - 1)
+        {
+            LogRenderer->Error("Shader limit of {} reached", SortKey::MaxShaders - 1);
+            return {};
+        }
+
+        // Sources are hashed as the driver sees them, so editing a shader or anything it includes misses the cache
+        const uint64_t cacheKey = programCache.Key(vertexSource, fragmentSource);
+        uint32_t program = programCache.Load(cacheKey);
+        if (program == 0)
+        {
+            float buildMs {0.0f};
+            program = ShaderCompiler::Build(vertexSource, fragmentSource, programCache, buildMs);
+            if (program == 0)
+            {
+                return {};
+            }
+            programCache.Store(cacheKey, program, buildMs);
+        }
+
+        return AddShader(program, cacheKey);
+    }
+
+    ShaderHandle GLBackend::CreateShaderVariant(std::string vertexSource, std::string fragmentSource, const ShaderHandle fallback)
+    {
+        if (!compiler.IsAsync() || !fallback.IsValid())
+        {
+            return CreateShader(vertexSource, fragmentSource);
+        }
+
+        if (shaders.size() >= SortKey::MaxShaders - 1)
+        {
+            LogRenderer->Error("Shader limit of {} reached", SortKey::MaxShaders - 1);
+            return {};
+        }
+
+        // A cached binary loads in a fraction of a millisecond, only real compiles go to the background
+        const uint64_t cacheKey = programCache.Key(vertexSource, fragmentSource);
+        if (const uint32_t program = programCache.Load(cacheKey); program != 0)
+        {
+            return AddShader(program, cacheKey);
+        }
+
+        const ShaderHandle handle = AddShader(0, cacheKey);
+        shaders.back().fallback = fallback;
+        compiler.Submit({.shader = handle, .vertexSource = std::move(vertexSource), .fragmentSource = std::move(fragmentSource)});
+        return handle;
+    }
+
+    TextureHandle GLBackend::CreateTexture(const std::span<const uint8_t> rgba, const uint2 size, const std::string& sourcePath)
+    {
+        const bool streamed = !sourcePath.empty() && TextureStreamer::ShouldStream(size);
+        const std::optional<AtlasRegion> region = streamed ? streamer.Add(sourcePath, rgba, size) : atlas.Insert(rgba, size);
+        if (!region)
+        {
+            LogRenderer->Error("Could not place a {}x{} texture in the atlas", size.x, size.y);
+            return {};
+        }
+
+        Texture& texture = textures.emplace_back();
+        texture.region = *region;
+        texture.size = size;
+        texture.streamed = streamed;
+
+        return {static_cast<uint32_t>(textures.size())};
+    }
+
+    MeshHandle GLBackend::CreateMesh(const std::span<const Vertex> vertices, const std::span<const uint32_t> indices)
+    {
+        if (meshes.size() >= SortKey::MaxMeshes - 1)
+        {
+            LogRenderer->Error("Mesh limit of {} reached", SortKey::MaxMeshes - 1);
+            return {};
+        }
+
+        Mesh& mesh = meshes.emplace_back();
+        mesh.count = static_cast<uint32_t>(indices.empty() ? vertices.size() : indices.size());
+
+        glGenVertexArrays(1, &mesh.vertexArray);
+        state.BindVertexArray(mesh.vertexArray);
+
+        glGenBuffers(1, &mesh.vertexBuffer);
+        state.BindBuffer(GL_ARRAY_BUFFER, mesh.vertexBuffer);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(vertices.size_bytes()), vertices.data(), GL_STATIC_DRAW);
+
+        if (!indices.empty())
+        {
+            glGenBuffers(1, &mesh.indexBuffer);
+            glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, mesh.indexBuffer);
+            glBufferData(GL_ELEMENT_ARRAY_BUFFER, static_cast<GLsizeiptr>(indices.size_bytes()), indices.data(), GL_STATIC_DRAW);
+        }
+
+        glEnableVertexAttribArray(0);
+        glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, position)));
+        glEnableVertexAttribArray(1);
+        glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, texCoord)));
+
+        // One column of the model matrix per location, advancing once per instance
+        for (uint32_t column = 0; column < 4; column++)
+        {
+            glEnableVertexAttribArray(InstanceAttribute + column);
+            glVertexAttribDivisor(InstanceAttribute + column, 1);
+        }
+        glEnableVertexAttribArray(MaterialAttribute);
+        glVertexAttribDivisor(MaterialAttribute, 1);
+        return {static_cast<uint32_t>(meshes.size())};
+    }
+
+    MaterialHandle GLBackend::CreateMaterial(const ShaderHandle shader, const std::span<const TextureHandle> materialTextures, const MaterialBlock& parameters)
+    {
+        if (materials.size() >= SortKey::MaxMaterials - 1 || materialTextures.size() > MaxMaterialTextures)
+        {
+            LogRenderer->Error("Material limit reached or more than {} textures", MaxMaterialTextures);
+            return {};
+        }
+
+        Material& material = materials.emplace_back();
+        material.shader = shader;
+        std::ranges::copy(materialTextures, material.textures.begin());
+
+        MaterialBlock block = parameters;
+        for (size_t slot = 0; slot < materialTextures.size(); slot++)
+        {
+            if (materialTextures[slot].IsValid())
+            {
+                const AtlasRegion& region = textures[materialTextures[slot].Index()].region;
+                block.textureRects[slot] = region.rect;
+                block.textureLayers[static_cast<glm::length_t>(slot)] = static_cast<int32_t>(region.layer);
+                material.streamsTextures |= textures[materialTextures[slot].Index()].streamed;
+            }
+        }
+
+        // Blocks are packed tightly within a window, windows start at the uniform buffer offset alignment
+        const size_t index = materials.size() - 1;
+        const size_t offset = index / MaterialsPerBlock * materialBlocks.windowStride + index % MaterialsPerBlock * sizeof(MaterialBlock);
+        materialBlocks.data.resize((index / MaterialsPerBlock + 1) * materialBlocks.windowStride);
+        std::memcpy(materialBlocks.data.data() + offset, &block, sizeof(MaterialBlock));
+        materialBlocks.dirty = true;
+
+        return {static_cast<uint32_t>(materials.size())};
+    }
+
+    TargetTexture GLBackend::CreateTarget(const TargetDesc& desc)
+    {
+        const TargetFormatInfo& format = TargetFormats[static_cast<size_t>(desc.format)];
+        const bool color = format.attachment == GL_COLOR_ATTACHMENT0;
+
+        TargetTexture target {};
+        glGenTextures(1, &target.texture);
+        state.BindTextureForEdit(0, GL_TEXTURE_2D, target.texture);
+        glTexImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(format.internalFormat), static_cast<GLsizei>(desc.size.x), static_cast<GLsizei>(desc.size.y), 0,
+            format.format, format.type, nullptr);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, color ? GL_LINEAR : GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, color ? GL_LINEAR : GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+        glGenFramebuffers(1, &target.framebuffer);
+        state.BindFramebuffer(target.framebuffer);
+        glFramebufferTexture2D(GL_FRAMEBUFFER, format.attachment, GL_TEXTURE_2D, target.texture, 0);
+        if (!color)
+        {
+            glDrawBuffer(GL_NONE);
+            glReadBuffer(GL_NONE);
+        }
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            LogRenderer->Error("Could not create a {}x{} render target of format {}", desc.size.x, desc.size.y, static_cast<uint32_t>(desc.format));
+            DestroyTarget(target);
+            return {};
+        }
+        return target;
+    }
+
+    void GLBackend::DestroyTarget(const TargetTexture& target)
+    {
+        glDeleteFramebuffers(1, &target.framebuffer);
+        glDeleteTextures(1, &target.texture);
+
+        // Deleting unbinds them and the names get reused, the cache may still think they're bound
+        state.Invalidate();
+    }
+
+    void GLBackend::BeginFrame(const uint32_t framebuffer, const uint2 size, const float4& clearColor)
+    {
+        stats = {};
+        state.ResetCounters();
+        CollectCompiledShaders();
+        atlas.Flush();
+        instances.BeginFrame();
+        spriteVertices.BeginFrame();
+
+        viewport = float2(size);
+        state.BindFramebuffer(framebuffer);
+        state.Viewport({0, 0, static_cast<int32_t>(size.x), static_cast<int32_t>(size.y)});
+        ApplyPassState(RenderPass::Opaque);
+
+        glClearColor(clearColor.r, clearColor.g, clearColor.b, clearColor.a);
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    }
+
+    void GLBackend::Execute(const RenderCommandBuffer& commands, const FrameData& frame)
+    {
+        const std::span<const SortEntry> entries = commands.Entries();
+        stats.packets += static_cast<uint32_t>(entries.size());
+        if (entries.empty())
+        {
+            return;
+        }
+
+        UploadMaterialBlocks();
+        if (frame.lights != nullptr)
+        {
+            UploadLights(*frame.lights);
+        }
+
+        // Frame and pass blocks plus all transforms go up as one allocation:
+        // FrameBlock | PassBlock per pass | InstanceData in the order the batches below consume them
+        const size_t frameOffset = 0;
+        const size_t passOffset = AlignUp(sizeof(FrameBlock), uniformAlignment);
+        const size_t passStride = AlignUp(sizeof(PassBlock), uniformAlignment);
+        const size_t instanceOffset = passOffset + passStride * PassCount;
+
+        const auto allocation = instances.Allocate(instanceOffset + entries.size() * sizeof(InstanceData), uniformAlignment);
+        if (allocation.data == nullptr)
+        {
+            return;
+        }
+
+        auto* bytes = static_cast<std::byte*>(allocation.data);
+        new (bytes + frameOffset) FrameBlock {
+            .view = frame.view,
+            .projection = frame.projection,
+            .viewProjection = frame.projection * frame.view,
+            .cameraPosition = glm::inverse(frame.view)[3],
+            .time = {frame.time, frame.deltaTime, 0.0f, 0.0f},
+            .clusterScale = frame.lights != nullptr ? frame.lights->ClusterScale() : float4(0.0f),
+            .clusterCount = int4(LightClusters::ClustersX, LightClusters::ClustersY, LightClusters::DepthSlices, frame.lights != nullptr ? frame.lights->LightCount() : 0),
+            .ambientLight = float4(frame.ambientLight, 1.0f),
+        };
+
+        for (size_t pass = 0; pass < PassCount; pass++)
+        {
+            new (bytes + passOffset + pass * passStride) PassBlock {
+                .viewport = {viewport.x, viewport.y, 1.0f / std::max(viewport.x, 1.0f), 1.0f / std::max(viewport.y, 1.0f)},
+                .pass = {static_cast<int32_t>(pass), 0, 0, 0},
+            };
+        }
+
+        auto* instanceData = reinterpret_cast<InstanceData*>(bytes + instanceOffset);
+        for (const SortEntry& entry : entries)
+        {
+            const DrawPacket& packet = commands.Packet(entry);
+            *instanceData++ = {
+                .model = packet.model,
+                .material = static_cast<uint32_t>(packet.material.Index() % MaterialsPerBlock),
+            };
+
+            if (materials[packet.material.Index()].streamsTextures)
+            {
+                MarkTexturesVisible(packet, frame);
+            }
+        }
+        instances.Flush();
+
+        const uint32_t buffer = instances.Buffer();
+        state.BindUniformBuffer(static_cast<uint32_t>(UniformBinding::Frame), buffer, allocation.offset + frameOffset, sizeof(FrameBlock));
+        state.BindUniformBuffer(static_cast<uint32_t>(UniformBinding::Pass), buffer, allocation.offset + passOffset, sizeof(PassBlock));
+
+        RenderPass currentPass {RenderPass::Opaque};
+        size_t first {0};
+        while (first < entries.size())
+        {
+            const DrawPacket& packet = commands.Packet(entries[first]);
+
+            // Sorting put packets with the same mesh and material next to each other, they become one instanced draw.
+            // Neighbouring materials join in when only their blocks differ, instances index MaterialData themselves.
+            size_t end = first + 1;
+            while (end < entries.size())
+            {
+                const DrawPacket& next = commands.Packet(entries[end]);
+                if (next.mesh != packet.mesh || !CanBatch(packet.material, next.material) || SortKey::Pass(entries[end].key) != SortKey::Pass(entries[first].key))
+                {
+                    break;
+                }
+                end++;
+            }
+
+            const Material& material = materials[packet.material.Index()];
+            const Mesh& mesh = meshes[packet.mesh.Index()];
+
+            if (const RenderPass pass = SortKey::Pass(entries[first].key); pass != currentPass)
+            {
+                ApplyPassState(pass);
+                currentPass = pass;
+
+                const size_t offset = allocation.offset + passOffset + static_cast<size_t>(pass) * passStride;
+                state.BindUniformBuffer(static_cast<uint32_t>(UniformBinding::Pass), buffer, offset, sizeof(PassBlock));
+            }
+
+            // Programs read the blocks from fixed binding points, so switching programs needs no uploads
+            state.UseProgram(ProgramFor(material.shader));
+            const size_t window = packet.material.Index() / MaterialsPerBlock;
+            state.BindUniformBuffer(static_cast<uint32_t>(UniformBinding::Material), materialBlocks.buffer, window * materialBlocks.windowStride, MaterialsPerBlock * sizeof(MaterialBlock));
+
+            for (uint32_t unit = 0; unit < MaxMaterialTextures && material.textures[unit].IsValid(); unit++)
+            {
+                state.BindTexture(unit, GL_TEXTURE_2D_ARRAY, atlas.Texture(textures[material.textures[unit].Index()].region.bin));
+            }
+
+            state.BindVertexArray(mesh.vertexArray);
+            BindInstances(allocation.offset + instanceOffset + first * sizeof(InstanceData));
+
+            const auto instanceCount = static_cast<GLsizei>(end - first);
+            if (mesh.indexBuffer != 0)
+            {
+                glDrawElementsInstanced(GL_TRIANGLES, static_cast<GLsizei>(mesh.count), GL_UNSIGNED_INT, nullptr, instanceCount);
+            }
+            else
+            {
+                glDrawArraysInstanced(GL_TRIANGLES, 0, static_cast<GLsizei>(mesh.count), instanceCount);
+            }
+
+            stats.drawCalls++;
+            first = end;
+        }
+
+        // Depth writes have to be back on for the next frame's clear
+        ApplyPassState(RenderPass::Opaque);
+    }
+
+    void GLBackend::DrawSprites(const SpriteBatch& batch, const ShaderHandle shader)
+    {
+        const std::span<const uint32_t> order = batch.Order();
+        if (order.empty() || !shader.IsValid() || ProgramFor(shader) == 0)
+        {
+            return;
+        }
+        const uint32_t program = ProgramFor(shader);
+
+        const auto allocation = spriteVertices.Allocate(order.size() * 4 * sizeof(SpriteVertex));
+        if (allocation.data == nullptr)
+        {
+            return;
+        }
+
+        // The sort put sprites of one texture next to each other, textures sharing an atlas layer join their run.
+        // Sprites without a texture collapse to a point.
+        const std::span<const Sprite> sprites = batch.Sprites();
+        auto* vertices = static_cast<SpriteVertex*>(allocation.data);
+        std::vector<SpriteRun>& runs = spriteBuffers.runs;
+        runs.clear();
+        for (uint32_t index = 0; index < order.size(); index++)
+        {
+            const Sprite& sprite = sprites[order[index]];
+            SpriteVertex* quad = vertices + size_t {index} * 4;
+            if (!sprite.texture.IsValid() || sprite.texture.Index() >= textures.size())
+            {
+                std::fill_n(quad, 4, SpriteVertex {});
+                if (runs.empty() || runs.back().count == MaxSpritesPerDraw)
+                {
+                    runs.push_back({.bin = runs.empty() ? 0 : runs.back().bin, .layer = runs.empty() ? 0 : runs.back().layer, .first = index});
+                }
+                runs.back().count++;
+                continue;
+            }
+
+            const AtlasRegion& region = textures[sprite.texture.Index()].region;
+            if (runs.empty() || runs.back().bin != region.bin || runs.back().layer != region.layer || runs.back().count == MaxSpritesPerDraw)
+            {
+                runs.push_back({.bin = region.bin, .layer = region.layer, .first = index});
+            }
+            runs.back().count++;
+            SpriteBatch::WriteQuad(sprite, region.rect, std::span<SpriteVertex, 4>(quad, 4));
+        }
+        spriteVertices.Flush();
+
+        ApplyPassState(RenderPass::Overlay);
+        state.UseProgram(program);
+        state.Uniform(glGetUniformLocation(program, "screenToClip"), glm::ortho(0.0f, viewport.x, viewport.y, 0.0f));
+        const GLint layerLocation = glGetUniformLocation(program, "atlasLayer");
+
+        // Attributes point at this frame's allocation, runs start at their first corner through the base vertex
+        state.BindVertexArray(spriteBuffers.vertexArray);
+        state.BindBuffer(GL_ARRAY_BUFFER, spriteVertices.Buffer());
+        glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(SpriteVertex), reinterpret_cast<void*>(allocation.offset + offsetof(SpriteVertex, position)));
+        glVertexAttribPointer(1, 2, GL_UNSIGNED_SHORT, GL_TRUE, sizeof(SpriteVertex), reinterpret_cast<void*>(allocation.offset + offsetof(SpriteVertex, texCoord)));
+        glVertexAttribPointer(2, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(SpriteVertex), reinterpret_cast<void*>(allocation.offset + offsetof(SpriteVertex, color)));
+
+        for (const SpriteRun& run : runs)
+        {
+            state.BindTexture(0, GL_TEXTURE_2D_ARRAY, atlas.Texture(run.bin));
+            state.Uniform(layerLocation, static_cast<int32_t>(run.layer));
+            glDrawElementsBaseVertex(GL_TRIANGLES, static_cast<GLsizei>(run.count * 6), GL_UNSIGNED_SHORT, nullptr, static_cast<GLint>(run.first * 4));
+        }
+
+        stats.drawCalls += static_cast<uint32_t>(runs.size());
+        stats.sprites += static_cast<uint32_t>(order.size());
+        stats.spriteDrawCalls += static_cast<uint32_t>(runs.size());
+        ApplyPassState(RenderPass::Opaque);
+    }
+
+    void GLBackend::EndFrame()
+    {
+        instances.EndFrame();
+        spriteVertices.EndFrame();
+
+        const GPURingStats& ring = instances.Stats();
+        const GPURingStats& spriteRing = spriteVertices.Stats();
+        stats.streamingStalls = ring.stalls + spriteRing.stalls;
+        stats.streamingStallMs = ring.stallTimeMs + spriteRing.stallTimeMs;
+        stats.streamingBytes = ring.bytesAllocated + spriteRing.bytesAllocated;
+        stats.glState = state.Counters();
+        stats.shadersBuilding = static_cast<uint32_t>(compiler.Pending());
+
+        streamer.Update();
+        stats.textureBytes = atlas.Stats().bytes;
+        stats.textureRequests = streamer.RequestsThisFrame();
+        stats.texturesLoading = static_cast<uint32_t>(streamer.Pending());
+    }
+
+    void GLBackend::UploadMaterialBlocks()
+    {
+        if (!materialBlocks.dirty)
+        {
+            return;
+        }
+
+        state.BindBuffer(GL_UNIFORM_BUFFER, materialBlocks.buffer);
+        glBufferData(GL_UNIFORM_BUFFER, static_cast<GLsizeiptr>(materialBlocks.data.size()), materialBlocks.data.data(), GL_STATIC_DRAW);
+        materialBlocks.dirty = false;
+    }
+
+    void GLBackend::UploadLights(const LightClusters& lights)
+    {
+        // Orphaned and refilled every frame, a texture buffer can't be empty so there's always room for a texel
+        const std::array<std::span<const std::byte>, LightBufferCount> arrays {
+            std::as_bytes(lights.LightData()), std::as_bytes(lights.Clusters()), std::as_bytes(lights.Indices()),
+        };
+        for (uint32_t i = 0; i < LightBufferCount; i++)
+        {
+            state.BindBuffer(GL_TEXTURE_BUFFER, lightBuffers.buffers[i]);
+            glBufferData(GL_TEXTURE_BUFFER, static_cast<GLsizeiptr>(std::max<size_t>(arrays[i].size(), 16)), nullptr, GL_STREAM_DRAW);
+            if (!arrays[i].empty())
+            {
+                glBufferSubData(GL_TEXTURE_BUFFER, 0, static_cast<GLsizeiptr>(arrays[i].size()), arrays[i].data());
+            }
+            state.BindTexture(LightUnit + i, GL_TEXTURE_BUFFER, lightBuffers.textures[i]);
+        }
+
+        stats.lights = lights.LightCount();
+        stats.lightAssignments = static_cast<uint32_t>(lights.Indices().size());
+    }
+
+    void GLBackend::BindInstances(const size_t offset)
+    {
+        // GL 3.3 has no base instance, so the attributes of the bound vertex array are pointed at the batch instead
+        state.BindBuffer(GL_ARRAY_BUFFER, instances.Buffer());
+        for (uint32_t column = 0; column < 4; column++)
+        {
+            glVertexAttribPointer(InstanceAttribute + column, 4, GL_FLOAT, GL_FALSE, sizeof(InstanceData), reinterpret_cast<void*>(offset + column * sizeof(glm::vec4)));
+        }
+        glVertexAttribIPointer(MaterialAttribute, 1, GL_UNSIGNED_INT, sizeof(InstanceData), reinterpret_cast<void*>(offset + offsetof(InstanceData, material)));
+    }
+
+    void GLBackend::MarkTexturesVisible(const DrawPacket& packet, const FrameData& frame)
+    {
+        const float distance = -(frame.view * packet.model[3]).z;
+        if (distance <= 0.0f)
+        {
+            return;
+        }
+
+        // Meshes have no bounds, the largest scale of the model matrix stands in for the extent of a unit mesh
+        const float extent = std::max({glm::length(glm::vec3(packet.model[0])), glm::length(glm::vec3(packet.model[1])), glm::length(glm::vec3(packet.model[2]))});
+        const float pixels = extent * frame.projection[1][1] * 0.5f * viewport.y / distance;
+
+        const Material& material = materials[packet.material.Index()];
+        for (uint32_t unit = 0; unit < MaxMaterialTextures && material.textures[unit].IsValid(); unit++)
+        {
+            if (const Texture& texture = textures[material.textures[unit].Index()]; texture.streamed)
+            {
+                streamer.MarkVisible(texture.region.bin, pixels);
+            }
+        }
+    }
+
+    bool GLBackend::CanBatch(const MaterialHandle first, const MaterialHandle second) const
+    {
+        if (first == second)
+        {
+            return true;
+        }
+
+        // Same program, same MaterialData window and the same atlas bin in every texture slot
+        const Material& a = materials[first.Index()];
+        const Material& b = materials[second.Index()];
+        if (ProgramFor(a.shader) != ProgramFor(b.shader) || first.Index() / MaterialsPerBlock != second.Index() / MaterialsPerBlock)
+        {
+            return false;
+        }
+
+        for (size_t unit = 0; unit < MaxMaterialTextures; unit++)
+        {
+            if (a.textures[unit].IsValid() != b.textures[unit].IsValid())
+            {
+                return false;
+            }
+            if (a.textures[unit].IsValid() && textures[a.textures[unit].Index()].region.bin != textures[b.textures[unit].Index()].region.bin)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    ShaderHandle GLBackend::AddShader(const uint32_t program, const uint64_t cacheKey)
+    {
+        Shader& shader = shaders.emplace_back();
+        shader.program = program;
+        shader.cacheKey = cacheKey;
+        if (program != 0)
+        {
+            BindProgramInterface(program);
+        }
+        return {static_cast<uint32_t>(shaders.size())};
+    }
+
+    void GLBackend::BindProgramInterface(const uint32_t program)
+    {
+        // Blocks a shader doesn't declare are skipped, everything else always reads the same binding point
+        for (uint32_t binding = 0; binding < static_cast<uint32_t>(UniformBinding::Count); binding++)
+        {
+            if (const GLuint block = glGetUniformBlockIndex(program, UniformBlockNames[binding]); block != GL_INVALID_INDEX)
+            {
+                glUniformBlockBinding(program, block, binding);
+            }
+        }
+
+        // Sampler units never change, so they're assigned once here instead of per draw
+        state.UseProgram(program);
+        for (size_t unit = 0; unit < MaxMaterialTextures; unit++)
+        {
+            const std::string name = "texture" + std::to_string(unit + 1);
+            state.Uniform(glGetUniformLocation(program, name.c_str()), static_cast<int32_t>(unit));
+        }
+        for (uint32_t i = 0; i < LightBufferCount; i++)
+        {
+            state.Uniform(glGetUniformLocation(program, LightSamplerNames[i]), static_cast<int32_t>(LightUnit + i));
+        }
+    }
+
+    void GLBackend::CollectCompiledShaders()
+    {
+        for (const ShaderCompiler::Result& result : compiler.TakeFinished())
+        {
+            Shader& shader = shaders[result.shader.Index()];
+            if (result.program == 0)
+            {
+                LogRenderer->Error("Shader variant {} failed to build, it keeps drawing with shader {}", result.shader.id, shader.fallback.id);
+                continue;
+            }
+
+            shader.program = result.program;
+            BindProgramInterface(result.program);
+            programCache.Store(shader.cacheKey, result.program, result.buildMs);
+        }
+    }
+
+    uint32_t GLBackend::ProgramFor(const ShaderHandle handle) const
+    {
+        const Shader& shader = shaders[handle.Index()];
+        return shader.program != 0 ? shader.program : shaders[shader.fallback.Index()].program;
+    }
+
+    void GLBackend::ApplyPassState(const RenderPass pass)
+    {
+        state.DepthTest(pass != RenderPass::Overlay);
+        state.DepthWrite(pass == RenderPass::Opaque);
+        state.Blend(pass != RenderPass::Opaque);
+    }
+}
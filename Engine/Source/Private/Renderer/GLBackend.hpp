@@ -0,0 +1,178 @@
+﻿#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "GLStateCache.hpp"
+#include "GPURingBuffer.hpp"
+#include "ProgramCache.hpp"
+#include "RenderBackend.hpp"
+#include "ShaderCompiler.hpp"
+#include "TextureAtlas.hpp"
+#include "TextureStreamer.hpp"
+
+namespace blackbox
+{
+    class FileIO;
+    class GLContext;
+
+    /**
+     * Owns the GL objects for shaders, textures, meshes and materials and executes sorted command buffers.
+     * Only the thread that owns the GL context may call into it.
+     */
+    class GLBackend final : public RenderBackend
+    {
+    public:
+        // Samplers are bound by name, `texture1` reads unit 0, `texture2` unit 1 and so on
+        static constexpr size_t MaxMaterialTextures = MaterialTextureSlots;
+        // Followed by the LightClusters' texture buffers `lightData`, `lightClusters` and `lightIndices`
+        static constexpr uint32_t LightUnit = MaxMaterialTextures;
+        static constexpr size_t LightBufferCount = 3;
+
+        // Every draw is instanced, vertex shaders read the model matrix as a mat4 attribute at this location
+        static constexpr uint32_t InstanceAttribute = 2;
+        // Followed by the instance's index into the MaterialData array as a uint
+        static constexpr uint32_t MaterialAttribute = InstanceAttribute + 4;
+
+        // Sprite quads are indexed with 16 bits, longer runs are split into several draws
+        static constexpr uint32_t MaxSpritesPerDraw = 16384;
+
+    private:
+        struct Shader
+        {
+            uint32_t program {0}; // 0 while a variant is still building
+            ShaderHandle fallback {}; // Drawn with until `program` is ready
+            uint64_t cacheKey {0};
+        };
+
+        struct Texture
+        {
+            AtlasRegion region {};
+            uint2 size {};
+            bool streamed {false};
+        };
+
+        struct Mesh
+        {
+            uint32_t vertexArray {0};
+            uint32_t vertexBuffer {0};
+            uint32_t indexBuffer {0};
+            uint32_t count {0}; // Indices, or vertices for meshes without an index buffer
+        };
+
+        struct Material
+        {
+            ShaderHandle shader {};
+            std::array<TextureHandle, MaxMaterialTextures> textures {};
+            bool streamsTextures {false}; // At least one texture is streamed, draws report their screen size
+        };
+
+        // MaterialBlocks in windows of MaterialsPerBlock, a batch binds the window its materials are in.
+        // Uploaded whenever a material was added.
+        struct MaterialBlocks
+        {
+            uint32_t buffer {0};
+            size_t windowStride {0};
+            std::vector<std::byte> data {};
+            bool dirty {false};
+        };
+
+        // Texture buffers over the LightClusters arrays, filled again every frame
+        struct LightBuffers
+        {
+            std::array<uint32_t, LightBufferCount> buffers {};
+            std::array<uint32_t, LightBufferCount> textures {};
+        };
+
+        // A draw of sprites whose textures share an atlas bin and layer
+        struct SpriteRun
+        {
+            uint32_t bin {0};
+            uint32_t layer {0};
+            uint32_t first {0};
+            uint32_t count {0};
+        };
+
+        // Quads of every sprite, streamed through `spriteVertices` and drawn with a static index buffer
+        struct SpriteBuffers
+        {
+            uint32_t vertexArray {0};
+            uint32_t indexBuffer {0};
+            std::vector<SpriteRun> runs {};
+        };
+
+        std::vector<Shader> shaders {};
+        std::vector<Texture> textures {};
+        std::vector<Mesh> meshes {};
+        std::vector<Material> materials {};
+        MaterialBlocks materialBlocks {};
+        LightBuffers lightBuffers {};
+        SpriteBuffers spriteBuffers {};
+        size_t uniformAlignment {256};
+        float2 viewport {}; // Size of the current frame's target
+
+        GLStateCache state {};
+        RenderStats stats {};
+
+        GPURingBuffer instances;
+        GPURingBuffer spriteVertices;
+        TextureAtlas atlas;
+        TextureStreamer streamer;
+        ProgramCache programCache;
+        ShaderCompiler compiler;
+
+    public:
+        GLBackend(GLContext& context, const FileIO& fileIO);
+        ~GLBackend() override;
+
+        GLBackend(const GLBackend& other) = delete;
+        GLBackend& operator=(const GLBackend&) = delete;
+        GLBackend(GLBackend&& other) = delete;
+        GLBackend& operator=(GLBackend&& other) = delete;
+
+        // RenderBackend
+        ShaderHandle CreateShader(std::string_view vertexSource, std::string_view fragmentSource) override;
+        // Builds on the background compiler and draws with `fallback` until the program is ready. If the variant
+        // fails to build it keeps using the fallback.
+        ShaderHandle CreateShaderVariant(std::string vertexSource, std::string fragmentSource, ShaderHandle fallback) override;
+        // With a `sourcePath` large textures keep only their coarse mips resident and stream the rest from that file
+        TextureHandle CreateTexture(std::span<const uint8_t> rgba, uint2 size, const std::string& sourcePath) override;
+        MeshHandle CreateMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices) override;
+        MaterialHandle CreateMaterial(ShaderHandle shader, std::span<const TextureHandle> textures, const MaterialBlock& parameters) override;
+        // A GL_TEXTURE_2D with a framebuffer that has it as its only attachment
+        TargetTexture CreateTarget(const TargetDesc& desc) override;
+        void DestroyTarget(const TargetTexture& target) override;
+
+        [[nodiscard]] ShaderHandle MaterialShader(const MaterialHandle material) const override { return materials[material.Index()].shader; }
+        [[nodiscard]] bool IsShaderReady(const ShaderHandle shader) const override { return shaders[shader.Index()].program != 0; }
+
+        void BeginFrame(uint32_t framebuffer, uint2 size, const float4& clearColor) override;
+        void Execute(const RenderCommandBuffer& commands, const FrameData& frame) override;
+        // One draw per run of sprites sharing an atlas texture and layer
+        void DrawSprites(const SpriteBatch& sprites, ShaderHandle shader) override;
+        void EndFrame() override;
+
+        [[nodiscard]] const RenderStats& Stats() const override { return stats; }
+        [[nodiscard]] ProgramCacheStats ProgramStats() const override { return programCache.Stats(); }
+        [[nodiscard]] AtlasStats TextureStats() const override { return atlas.Stats(); }
+
+        // Streaming evicts mips to stay below the budget
+        void SetTextureBudget(const size_t bytes) override { streamer.SetBudget(bytes); }
+
+    private:
+        ShaderHandle AddShader(uint32_t program, uint64_t cacheKey);
+        void BindProgramInterface(uint32_t program);
+        void CollectCompiledShaders();
+        [[nodiscard]] uint32_t ProgramFor(ShaderHandle shader) const;
+        [[nodiscard]] bool CanBatch(MaterialHandle first, MaterialHandle second) const;
+        void MarkTexturesVisible(const DrawPacket& packet, const FrameData& frame);
+        void ApplyPassState(RenderPass pass);
+        void BindInstances(size_t offset);
+        void UploadMaterialBlocks();
+        void UploadLights(const LightClusters& lights);
+    };
+}
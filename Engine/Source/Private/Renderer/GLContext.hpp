@@ -0,0 +1,41 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <memory>
+
+#include "Types.hpp"
+
+namespace blackbox
+{
+    /**
+     * Something that owns an OpenGL 3.3 core context the renderer can draw into.
+     *
+     * Window provides an on-screen context, HeadlessContext a surfaceless EGL context that renders into an
+     * offscreen framebuffer. Renderer code only talks to this interface so it runs the same on both.
+     */
+    class GLContext
+    {
+    public:
+        virtual ~GLContext() = default;
+
+        // Make the context current on the calling thread
+        virtual void MakeCurrent() = 0;
+
+        // Detach the context from the calling thread, a context still current on another thread can't be destroyed
+        virtual void ReleaseCurrent() = 0;
+
+        // Finish the frame, swaps buffers for a window
+        virtual void Present() = 0;
+
+        [[nodiscard]] virtual uint2 FramebufferSize() const = 0;
+
+        // Framebuffer object the final image should be rendered into, 0 for the default framebuffer
+        [[nodiscard]] virtual uint32_t TargetFramebuffer() const { return 0; }
+
+        [[nodiscard]] virtual void* GetProcAddress(const char* name) const = 0;
+
+        // Context that shares programs, buffers and textures with this one, for GL work on a background thread.
+        // Has no framebuffer of its own. Returns nullptr when the platform can't share contexts.
+        [[nodiscard]] virtual std::unique_ptr<GLContext> CreateSharedContext() { return nullptr; }
+    };
+}
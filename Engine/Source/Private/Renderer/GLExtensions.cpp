@@ -0,0 +1,30 @@
+﻿#include "GLExtensions.hpp"
+
+#include <glad/glad.h>
+
+namespace blackbox
+{
+    bool HasGLVersion(const int major, const int minor)
+    {
+        GLint contextMajor {0};
+        GLint contextMinor {0};
+        glGetIntegerv(GL_MAJOR_VERSION, &contextMajor);
+        glGetIntegerv(GL_MINOR_VERSION, &contextMinor);
+        return contextMajor > major || (contextMajor == major && contextMinor >= minor);
+    }
+
+    bool HasGLExtension(const std::string_view name)
+    {
+        GLint count {0};
+        glGetIntegerv(GL_NUM_EXTENSIONS, &count);
+        for (GLint i = 0; i < count; i++)
+        {
+            if (name == reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, static_cast<GLuint>(i))))
+            {
+                return true;
+            }
+        }
+
+        return false;
+    }
+}
@@ -0,0 +1,10 @@
+﻿#pragma once
+
+#include <string_view>
+
+namespace blackbox
+{
+    // Queries against the current context, for features beyond the 3.3 core profile glad loads
+    [[nodiscard]] bool HasGLVersion(int major, int minor);
+    [[nodiscard]] bool HasGLExtension(std::string_view name);
+}
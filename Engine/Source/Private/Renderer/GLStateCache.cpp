@@ -0,0 +1,211 @@
+﻿#include "GLStateCache.hpp"
+
+#include <numeric>
+#include <glad/glad.h>
+#include <glm/gtc/type_ptr.hpp>
+
+namespace blackbox
+{
+    uint32_t GLStateCounters::TotalIssued() const
+    {
+        return std::accumulate(issued.begin(), issued.end(), 0u);
+    }
+
+    uint32_t GLStateCounters::TotalSkipped() const
+    {
+        return std::accumulate(skipped.begin(), skipped.end(), 0u);
+    }
+
+    void GLStateCache::UseProgram(const uint32_t id)
+    {
+        if (Changed(GLStateCall::Program, program != id))
+        {
+            program = id;
+            glUseProgram(id);
+        }
+    }
+
+    void GLStateCache::BindVertexArray(const uint32_t id)
+    {
+        if (Changed(GLStateCall::VertexArray, vertexArray != id))
+        {
+            vertexArray = id;
+            glBindVertexArray(id);
+        }
+    }
+
+    void GLStateCache::BindTexture(const uint32_t unit, const uint32_t target, const uint32_t id)
+    {
+        if (!Changed(GLStateCall::Texture, textures[unit] != uint2(target, id)))
+        {
+            return;
+        }
+
+        // Switching units only matters when something is bound, so it isn't counted as a call of its own
+        ActiveUnit(unit);
+        textures[unit] = uint2(target, id);
+        glBindTexture(target, id);
+    }
+
+    void GLStateCache::BindTextureForEdit(const uint32_t unit, const uint32_t target, const uint32_t id)
+    {
+        // A skipped bind leaves whichever unit was bound last active, and glTex* calls act on the active unit
+        ActiveUnit(unit);
+        BindTexture(unit, target, id);
+    }
+
+    void GLStateCache::BindBuffer(const uint32_t target, const uint32_t id)
+    {
+        uint32_t* bound = BoundBuffer(target);
+        if (Changed(GLStateCall::Buffer, bound == nullptr || *bound != id))
+        {
+            if (bound != nullptr)
+            {
+                *bound = id;
+            }
+            glBindBuffer(target, id);
+        }
+    }
+
+    void GLStateCache::BindUniformBuffer(const uint32_t binding, const uint32_t id, const size_t offset, const size_t size)
+    {
+        const int4 range(static_cast<int32_t>(id), static_cast<int32_t>(offset), static_cast<int32_t>(size), 0);
+        if (Changed(GLStateCall::Buffer, uniformBufferRanges[binding] != range))
+        {
+            uniformBufferRanges[binding] = range;
+            uniformBuffer = id; // Binding a range binds the generic target as well
+            glBindBufferRange(GL_UNIFORM_BUFFER, binding, id, static_cast<GLintptr>(offset), static_cast<GLsizeiptr>(size));
+        }
+    }
+
+    void GLStateCache::BindFramebuffer(const uint32_t id)
+    {
+        if (Changed(GLStateCall::Framebuffer, framebuffer != id))
+        {
+            framebuffer = id;
+            glBindFramebuffer(GL_FRAMEBUFFER, id);
+        }
+    }
+
+    void GLStateCache::Viewport(const int4 rectangle)
+    {
+        if (Changed(GLStateCall::Viewport, viewport != rectangle))
+        {
+            viewport = rectangle;
+            glViewport(rectangle.x, rectangle.y, rectangle.z, rectangle.w);
+        }
+    }
+
+    void GLStateCache::DepthTest(const bool enabled)
+    {
+        if (Changed(GLStateCall::Capability, depthTest != Flag(enabled)))
+        {
+            depthTest = Flag(enabled);
+            enabled ? glEnable(GL_DEPTH_TEST) : glDisable(GL_DEPTH_TEST);
+        }
+    }
+
+    void GLStateCache::DepthWrite(const bool enabled)
+    {
+        if (Changed(GLStateCall::Capability, depthWrite != Flag(enabled)))
+        {
+            depthWrite = Flag(enabled);
+            glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+        }
+    }
+
+    void GLStateCache::Blend(const bool enabled)
+    {
+        if (Changed(GLStateCall::Capability, blend != Flag(enabled)))
+        {
+            blend = Flag(enabled);
+            enabled ? glEnable(GL_BLEND) : glDisable(GL_BLEND);
+        }
+    }
+
+    void GLStateCache::Uniform(const int32_t location, const glm::mat4& value)
+    {
+        if (location < 0)
+        {
+            return;
+        }
+
+        const auto [it, inserted] = matrices.try_emplace(UniformKey(location), value);
+        if (Changed(GLStateCall::Uniform, inserted || it->second != value))
+        {
+            it->second = value;
+            glUniformMatrix4fv(location, 1, GL_FALSE, glm::value_ptr(value));
+        }
+    }
+
+    void GLStateCache::Uniform(const int32_t location, const int32_t value)
+    {
+        if (location < 0)
+        {
+            return;
+        }
+
+        const auto [it, inserted] = integers.try_emplace(UniformKey(location), value);
+        if (Changed(GLStateCall::Uniform, inserted || it->second != value))
+        {
+            it->second = value;
+            glUniform1i(location, value);
+        }
+    }
+
+    void GLStateCache::Invalidate()
+    {
+        program = Unknown;
+        vertexArray = Unknown;
+        activeUnit = Unknown;
+        textures.fill(uint2(Unknown));
+        arrayBuffer = Unknown;
+        uniformBuffer = Unknown;
+        textureBuffer = Unknown;
+        uniformBufferRanges.fill(int4(-1));
+        framebuffer = Unknown;
+        viewport = int4(-1);
+        depthTest = Unknown;
+        depthWrite = Unknown;
+        blend = Unknown;
+        matrices.clear();
+        integers.clear();
+    }
+
+    void GLStateCache::ForgetProgram(const uint32_t id)
+    {
+        std::erase_if(matrices, [id](const auto& entry) { return entry.first >> 32 == id; });
+        std::erase_if(integers, [id](const auto& entry) { return entry.first >> 32 == id; });
+    }
+
+    bool GLStateCache::Changed(const GLStateCall call, const bool changed)
+    {
+        auto& counter = changed ? counters.issued : counters.skipped;
+        counter[static_cast<size_t>(call)]++;
+        return changed;
+    }
+
+    void GLStateCache::ActiveUnit(const uint32_t unit)
+    {
+        if (activeUnit != unit)
+        {
+            activeUnit = unit;
+            glActiveTexture(GL_TEXTURE0 + unit);
+        }
+    }
+
+    uint32_t* GLStateCache::BoundBuffer(const uint32_t target)
+    {
+        switch (target)
+        {
+        case GL_ARRAY_BUFFER:
+            return &arrayBuffer;
+        case GL_UNIFORM_BUFFER:
+            return &uniformBuffer;
+        case GL_TEXTURE_BUFFER:
+            return &textureBuffer;
+        default:
+            return nullptr;
+        }
+    }
+}
@@ -0,0 +1,111 @@
+﻿#pragma once
+
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <glm/mat4x4.hpp>
+
+#include "Types.hpp"
+
+namespace blackbox
+{
+    enum class GLStateCall : uint8_t
+    {
+        Program,
+        VertexArray,
+        Texture,
+        Buffer,
+        Framebuffer,
+        Capability, // glEnable/glDisable, glDepthMask
+        Viewport,
+        Uniform,
+        Count,
+    };
+
+    struct GLStateCounters
+    {
+        std::array<uint32_t, static_cast<size_t>(GLStateCall::Count)> issued {};
+        std::array<uint32_t, static_cast<size_t>(GLStateCall::Count)> skipped {};
+
+        [[nodiscard]] uint32_t Issued(const GLStateCall call) const { return issued[static_cast<size_t>(call)]; }
+        [[nodiscard]] uint32_t Skipped(const GLStateCall call) const { return skipped[static_cast<size_t>(call)]; }
+        [[nodiscard]] uint32_t TotalIssued() const;
+        [[nodiscard]] uint32_t TotalSkipped() const;
+    };
+
+    /**
+     * Shadow copy of the GL state the renderer touches, calls that wouldn't change anything never reach the driver.
+     *
+     * Everything that binds or enables state on the GL thread has to go through the cache, or call Invalidate
+     * afterward so the shadow copy doesn't go stale.
+     */
+    class GLStateCache
+    {
+    public:
+        static constexpr size_t TextureUnits = 16;
+        static constexpr size_t UniformBufferBindings = 8;
+
+    private:
+        // Unknown until first set, so the first call of every kind always reaches the driver
+        static constexpr uint32_t Unknown = UINT32_MAX;
+
+        uint32_t program {Unknown};
+        uint32_t vertexArray {Unknown};
+        uint32_t activeUnit {Unknown};
+        std::array<uint2, TextureUnits> textures {}; // target, id
+        uint32_t arrayBuffer {Unknown};
+        uint32_t uniformBuffer {Unknown};
+        uint32_t textureBuffer {Unknown};
+        std::array<int4, UniformBufferBindings> uniformBufferRanges {}; // buffer, offset, size, unused
+        uint32_t framebuffer {Unknown};
+        int4 viewport {-1};
+        uint32_t depthTest {Unknown};
+        uint32_t depthWrite {Unknown};
+        uint32_t blend {Unknown};
+
+        // Last value uploaded per program and location, uniforms are program state and survive program switches
+        std::unordered_map<uint64_t, glm::mat4> matrices {};
+        std::unordered_map<uint64_t, int32_t> integers {};
+
+        GLStateCounters counters {};
+
+    public:
+        GLStateCache() { Invalidate(); }
+
+        void UseProgram(uint32_t id);
+        void BindVertexArray(uint32_t id);
+        void BindTexture(uint32_t unit, uint32_t target, uint32_t id);
+        // Like BindTexture but always leaves `unit` active, bind with this before glTex* calls that edit `id`
+        void BindTextureForEdit(uint32_t unit, uint32_t target, uint32_t id);
+        // Shadows GL_ARRAY_BUFFER, GL_UNIFORM_BUFFER and GL_TEXTURE_BUFFER each on their own, other targets always reach
+        // the driver. GL_ELEMENT_ARRAY_BUFFER is vertex array state, bind it directly while the vertex array is bound.
+        void BindBuffer(uint32_t target, uint32_t id);
+        void BindUniformBuffer(uint32_t binding, uint32_t id, size_t offset, size_t size);
+        void BindFramebuffer(uint32_t id);
+        void Viewport(int4 rectangle);
+        void DepthTest(bool enabled);
+        void DepthWrite(bool enabled);
+        void Blend(bool enabled);
+
+        // Uploads to the currently bound program
+        void Uniform(int32_t location, const glm::mat4& value);
+        void Uniform(int32_t location, int32_t value);
+
+        // Forget everything, the next call of every kind goes to the driver
+        void Invalidate();
+        // Drop cached uniforms of a program that is about to be deleted, ids get reused
+        void ForgetProgram(uint32_t id);
+
+        // Counters since the last reset, the renderer resets them once per frame
+        [[nodiscard]] const GLStateCounters& Counters() const { return counters; }
+        void ResetCounters() { counters = {}; }
+
+    private:
+        bool Changed(GLStateCall call, bool changed);
+        void ActiveUnit(uint32_t unit);
+        // The shadowed binding of a buffer target, nullptr for targets the cache doesn't track
+        [[nodiscard]] uint32_t* BoundBuffer(uint32_t target);
+        static uint32_t Flag(const bool enabled) { return enabled ? 1 : 0; }
+        [[nodiscard]] uint64_t UniformKey(const int32_t location) const { return (static_cast<uint64_t>(program) << 32) | static_cast<uint32_t>(location); }
+    };
+}
@@ -0,0 +1,177 @@
+﻿#include "GPURingBuffer.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <chrono>
+#include <cstring>
+#include <glad/glad.h>
+
+#include "Blackbox.hpp"
+#include "GLContext.hpp"
+#include "GLExtensions.hpp"
+#include "GLStateCache.hpp"
+
+namespace blackbox
+{
+    namespace
+    {
+        // ARB_buffer_storage / GL 4.4, not part of the 3.3 core headers
+        constexpr GLbitfield MapPersistentBit = 0x0040;
+        constexpr GLbitfield MapCoherentBit = 0x0080;
+        using BufferStorageFunction = void (APIENTRYP)(GLenum target, GLsizeiptr size, const void* data, GLbitfield flags);
+
+        BufferStorageFunction BufferStorage {nullptr};
+    }
+
+    GPURingBuffer::GPURingBuffer(const GLContext& context, GLStateCache& state, const size_t frameSize)
+        : state(state)
+    {
+        if (HasGLVersion(4, 4) || HasGLExtension("GL_ARB_buffer_storage"))
+        {
+            BufferStorage = reinterpret_cast<BufferStorageFunction>(context.GetProcAddress("glBufferStorage"));
+        }
+
+        persistent = BufferStorage != nullptr;
+        LogRenderer->Trace("Streaming buffers use {}", persistent ? "persistent mapping" : "orphaning");
+
+        Create(frameSize);
+    }
+
+    GPURingBuffer::~GPURingBuffer()
+    {
+        Destroy();
+    }
+
+    void GPURingBuffer::BeginFrame()
+    {
+        stats = {};
+        used = 0;
+        frameIndex = (frameIndex + 1) % FramesInFlight;
+
+        if (persistent)
+        {
+            WaitForRegion(frameIndex);
+        }
+    }
+
+    GPURingBuffer::Allocation GPURingBuffer::Allocate(const size_t size, const size_t alignment)
+    {
+        const size_t start = (used + alignment - 1) & ~(alignment - 1);
+        if (start + size > frameSize)
+        {
+            if (used > 0)
+            {
+                LogRenderer->Error("Streaming buffer is out of space ({} of {} bytes used), dropping a {} byte allocation", used, frameSize, size);
+                return {};
+            }
+
+            // Earlier frames may still be in flight, only the first allocation of a frame can move the buffer
+            const size_t newSize = std::bit_ceil(std::max(size, frameSize * 2));
+            LogRenderer->Info("Growing streaming buffer from {} to {} bytes per frame", frameSize, newSize);
+            Destroy();
+            Create(newSize);
+        }
+
+        used = start + size;
+        stats.bytesAllocated += size;
+
+        std::byte* base = persistent ? mapped + RegionOffset() : staging.data();
+        return {.data = base + start, .offset = RegionOffset() + start};
+    }
+
+    void GPURingBuffer::Flush()
+    {
+        if (persistent || used == 0)
+        {
+            // Coherent mapping, writes are visible to commands issued after them
+            return;
+        }
+
+        state.BindBuffer(GL_ARRAY_BUFFER, buffer);
+        glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(frameSize), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, static_cast<GLsizeiptr>(used), staging.data());
+    }
+
+    void GPURingBuffer::EndFrame()
+    {
+        if (persistent)
+        {
+            fences[frameIndex] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        }
+    }
+
+    void GPURingBuffer::Create(const size_t size)
+    {
+        frameSize = size;
+        glGenBuffers(1, &buffer);
+        state.BindBuffer(GL_ARRAY_BUFFER, buffer);
+
+        if (persistent)
+        {
+            constexpr GLbitfield flags = GL_MAP_WRITE_BIT | MapPersistentBit | MapCoherentBit;
+            const auto total = static_cast<GLsizeiptr>(frameSize * FramesInFlight);
+            BufferStorage(GL_ARRAY_BUFFER, total, nullptr, flags);
+            mapped = static_cast<std::byte*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, total, flags));
+        }
+        else
+        {
+            staging.resize(frameSize);
+            glBufferData(GL_ARRAY_BUFFER, static_cast<GLsizeiptr>(frameSize), nullptr, GL_STREAM_DRAW);
+        }
+    }
+
+    void GPURingBuffer::Destroy()
+    {
+        // The buffer can't go away while the GPU may still read from it
+        for (uint32_t region = 0; region < FramesInFlight; region++)
+        {
+            WaitForRegion(region);
+        }
+
+        if (mapped != nullptr)
+        {
+            state.BindBuffer(GL_ARRAY_BUFFER, buffer);
+            glUnmapBuffer(GL_ARRAY_BUFFER);
+            mapped = nullptr;
+        }
+
+        // Deleting unbinds the buffer everywhere, indexed uniform bindings included, and the next buffer usually
+        // gets the same name back. Like DestroyTarget the whole cache is dropped so no stale binding gets skipped.
+        glDeleteBuffers(1, &buffer);
+        state.Invalidate();
+        buffer = 0;
+    }
+
+    void GPURingBuffer::WaitForRegion(const uint32_t region)
+    {
+        const auto fence = static_cast<GLsync>(fences[region]);
+        if (fence == nullptr)
+        {
+            return;
+        }
+
+        // Checking without a timeout first keeps the common case from counting as a stall
+        GLenum result = glClientWaitSync(fence, 0, 0);
+        if (result == GL_TIMEOUT_EXPIRED)
+        {
+            const auto start = std::chrono::high_resolution_clock::now();
+            do
+            {
+                result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1'000'000);
+            } while (result == GL_TIMEOUT_EXPIRED);
+
+            const float waited = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+            stats.stalls++;
+            stats.stallTimeMs += waited;
+
+            // The first one is worth a warning, after that the stats tell how often it keeps happening
+            if (totalStalls++ == 0)
+            {
+                LogRenderer->Warn("Streaming buffer stalled {:.2f}ms waiting for the GPU, the CPU is more than {} frames ahead", waited, FramesInFlight);
+            }
+        }
+
+        glDeleteSync(fence);
+        fences[region] = nullptr;
+    }
+}
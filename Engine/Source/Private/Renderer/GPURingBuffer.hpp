@@ -0,0 +1,93 @@
+﻿#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace blackbox
+{
+    class GLContext;
+    class GLStateCache;
+
+    struct GPURingStats
+    {
+        uint32_t stalls {0};       // Frames that had to wait for the GPU before writing
+        float stallTimeMs {0.0f};
+        size_t bytesAllocated {0};
+    };
+
+    /**
+     * Streaming buffer for data rewritten every frame (instance transforms, sprite vertices, debug lines).
+     *
+     * With ARB_buffer_storage the buffer is split in one region per frame in flight and stays persistently mapped.
+     * Every frame writes into its own region straight from the CPU and a fence guards the region until the GPU is
+     * done with it, so a stall only happens when the CPU gets more than FramesInFlight frames ahead.
+     *
+     * Without it, writes go to a CPU copy that Flush uploads after orphaning the buffer, which lets the driver hand
+     * out fresh storage instead of waiting for draws still reading the old contents.
+     *
+     *   ring.BeginFrame();
+     *   const auto allocation = ring.Allocate(bytes);
+     *   std::memcpy(allocation.data, source, bytes);
+     *   ring.Flush();        // before any draw reads the data
+     *   ...draws using ring.Buffer() at allocation.offset...
+     *   ring.EndFrame();
+     */
+    class GPURingBuffer
+    {
+    public:
+        static constexpr uint32_t FramesInFlight = 3;
+
+        struct Allocation
+        {
+            void* data {nullptr}; // nullptr when the allocation didn't fit
+            size_t offset {0};    // Byte offset into Buffer()
+        };
+
+    private:
+        GLStateCache& state;
+        uint32_t buffer {0};
+        size_t frameSize {0};
+        bool persistent {false};
+
+        std::byte* mapped {nullptr};                 // Persistent mode, whole buffer
+        std::vector<std::byte> staging {};           // Orphaning mode, one frame
+        std::array<void*, FramesInFlight> fences {}; // GLsync per region, persistent mode only
+        uint32_t frameIndex {0};
+        size_t used {0};
+
+        GPURingStats stats {};
+        uint64_t totalStalls {0};
+
+    public:
+        GPURingBuffer(const GLContext& context, GLStateCache& state, size_t frameSize);
+        ~GPURingBuffer();
+
+        GPURingBuffer(const GPURingBuffer& other) = delete;
+        GPURingBuffer& operator=(const GPURingBuffer&) = delete;
+        GPURingBuffer(GPURingBuffer&& other) = delete;
+        GPURingBuffer& operator=(GPURingBuffer&& other) = delete;
+
+        // Waits until the GPU is done with the region this frame writes to, resets the stats
+        void BeginFrame();
+
+        // Grows the buffer when the first allocation of a frame doesn't fit, later ones that don't fit fail.
+        // `alignment` must be a power of two.
+        [[nodiscard]] Allocation Allocate(size_t size, size_t alignment = 16);
+
+        // Make this frame's writes visible to the GPU
+        void Flush();
+        void EndFrame();
+
+        [[nodiscard]] uint32_t Buffer() const { return buffer; }
+        [[nodiscard]] bool IsPersistent() const { return persistent; }
+        [[nodiscard]] const GPURingStats& Stats() const { return stats; }
+
+    private:
+        void Create(size_t size);
+        void Destroy();
+        void WaitForRegion(uint32_t region);
+        [[nodiscard]] size_t RegionOffset() const { return persistent ? frameIndex * frameSize : 0; }
+    };
+}
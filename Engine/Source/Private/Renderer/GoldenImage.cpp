@@ -0,0 +1,87 @@
+﻿#include "GoldenImage.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <filesystem>
+#include <SDL3/SDL_surface.h>
+
+#include "Blackbox.hpp"
+
+namespace blackbox
+{
+    bool GoldenImage::Save(const std::string& path, const std::span<const uint8_t> pixels, const uint2 size)
+    {
+        if (const auto directory = std::filesystem::path(path).parent_path(); !directory.empty())
+        {
+            std::error_code error {};
+            std::filesystem::create_directories(directory, error);
+        }
+
+        // SDL only reads through the pointer while saving
+        SDL_Surface* surface = SDL_CreateSurfaceFrom(static_cast<int>(size.x), static_cast<int>(size.y), SDL_PIXELFORMAT_RGBA32, const_cast<uint8_t*>(pixels.data()), static_cast<int>(size.x * 4));
+        if (surface == nullptr)
+        {
+            LogRenderer->Error("Could not create surface for {}: {}", path, SDL_GetError());
+            return false;
+        }
+
+        const bool saved = SDL_SaveBMP(surface, path.c_str());
+        SDL_DestroySurface(surface);
+
+        if (!saved)
+        {
+            LogRenderer->Error("Could not save {}: {}", path, SDL_GetError());
+        }
+        return saved;
+    }
+
+    GoldenImageResult GoldenImage::Compare(const std::string& path, const std::span<const uint8_t> pixels, const uint2 size, const uint8_t tolerance)
+    {
+        GoldenImageResult result {};
+
+        SDL_Surface* loaded = SDL_LoadBMP(path.c_str());
+        if (loaded == nullptr)
+        {
+            LogRenderer->Error("Could not load golden image {}: {}", path, SDL_GetError());
+            return result;
+        }
+
+        SDL_Surface* golden = SDL_ConvertSurface(loaded, SDL_PIXELFORMAT_RGBA32);
+        SDL_DestroySurface(loaded);
+        if (golden == nullptr)
+        {
+            LogRenderer->Error("Could not convert golden image {}: {}", path, SDL_GetError());
+            return result;
+        }
+
+        if (static_cast<uint32_t>(golden->w) != size.x || static_cast<uint32_t>(golden->h) != size.y || pixels.size() < size_t {size.x} * size.y * 4)
+        {
+            LogRenderer->Error("Golden image {} is {}x{}, capture is {}x{}", path, golden->w, golden->h, size.x, size.y);
+            SDL_DestroySurface(golden);
+            return result;
+        }
+
+        result.loaded = true;
+        for (uint32_t y = 0; y < size.y; y++)
+        {
+            const auto* expected = static_cast<const uint8_t*>(golden->pixels) + static_cast<size_t>(y) * golden->pitch;
+            const auto* actual = pixels.data() + static_cast<size_t>(y) * size.x * 4;
+
+            for (uint32_t x = 0; x < size.x * 4; x += 4)
+            {
+                uint32_t pixelDifference {0};
+                for (uint32_t channel = 0; channel < 4; channel++)
+                {
+                    pixelDifference = std::max<uint32_t>(pixelDifference, std::abs(expected[x + channel] - actual[x + channel]));
+                }
+
+                result.maxDifference = std::max(result.maxDifference, pixelDifference);
+                result.differingPixels += pixelDifference > tolerance ? 1 : 0;
+            }
+        }
+
+        SDL_DestroySurface(golden);
+        result.matches = result.differingPixels == 0;
+        return result;
+    }
+}
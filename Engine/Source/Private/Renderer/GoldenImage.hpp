@@ -0,0 +1,36 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+
+#include "Types.hpp"
+
+namespace blackbox
+{
+    struct GoldenImageResult
+    {
+        bool loaded {false};        // False when the golden image is missing or has a different size
+        bool matches {false};
+        uint32_t maxDifference {0}; // Largest per-channel difference found
+        uint64_t differingPixels {0};
+    };
+
+    /**
+     * Saves and compares RGBA8 captures against reference images for headless rendering tests.
+     * Images are stored as BMP so they can be inspected without extra tools.
+     *
+     * Content/Golden holds the demo scene from the GL pipeline on llvmpipe and from the software backend, CI checks
+     *   Engine -Headless -Frames=30 -Golden=Content/Golden/DemoSceneHeadless.bmp
+     *   Engine -Software -Frames=30 -Golden=Content/Golden/DemoSceneSoftware.bmp
+     */
+    class GoldenImage
+    {
+    public:
+        static bool Save(const std::string& path, std::span<const uint8_t> pixels, uint2 size);
+
+        // A pixel only counts as different when one of its channels is off by more than `tolerance`, which absorbs
+        // small rasterization differences between drivers
+        static GoldenImageResult Compare(const std::string& path, std::span<const uint8_t> pixels, uint2 size, uint8_t tolerance = 2);
+    };
+}
@@ -0,0 +1,307 @@
+﻿#include "HeadlessContext.hpp"
+
+#include <utility>
+#include <glad/glad.h>
+#include <SDL3/SDL_egl.h>
+#include <SDL3/SDL_loadso.h>
+
+#include "Blackbox.hpp"
+
+namespace blackbox
+{
+    // Resolved from libEGL at runtime
+    struct HeadlessContext::EGLFunctions
+    {
+        PFNEGLGETPROCADDRESSPROC GetProcAddress {nullptr};
+        PFNEGLGETDISPLAYPROC GetDisplay {nullptr};
+        PFNEGLINITIALIZEPROC Initialize {nullptr};
+        PFNEGLTERMINATEPROC Terminate {nullptr};
+        PFNEGLBINDAPIPROC BindAPI {nullptr};
+        PFNEGLCHOOSECONFIGPROC ChooseConfig {nullptr};
+        PFNEGLCREATECONTEXTPROC CreateContext {nullptr};
+        PFNEGLDESTROYCONTEXTPROC DestroyContext {nullptr};
+        PFNEGLMAKECURRENTPROC MakeCurrent {nullptr};
+        PFNEGLGETERRORPROC GetError {nullptr};
+    };
+
+    namespace
+    {
+#if defined(_WIN32)
+        constexpr auto EGLLibraryName = "libEGL.dll";
+#else
+        constexpr auto EGLLibraryName = "libEGL.so.1";
+#endif
+
+        constexpr EGLint ContextAttributes[] {
+            EGL_CONTEXT_MAJOR_VERSION, 3,
+            EGL_CONTEXT_MINOR_VERSION, 3,
+            EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+            EGL_NONE,
+        };
+
+        // Surfaceless like its parent, so it can be current on any thread without a surface of its own
+        class SharedHeadlessContext final : public GLContext
+        {
+            PFNEGLMAKECURRENTPROC makeCurrent {nullptr};
+            PFNEGLDESTROYCONTEXTPROC destroyContext {nullptr};
+            PFNEGLGETPROCADDRESSPROC getProcAddress {nullptr};
+            EGLDisplay display {nullptr};
+            EGLContext context {nullptr};
+
+        public:
+            SharedHeadlessContext(const PFNEGLMAKECURRENTPROC makeCurrent, const PFNEGLDESTROYCONTEXTPROC destroyContext, const PFNEGLGETPROCADDRESSPROC getProcAddress, const EGLDisplay display, const EGLContext context)
+                : makeCurrent(makeCurrent)
+                , destroyContext(destroyContext)
+                , getProcAddress(getProcAddress)
+                , display(display)
+                , context(context)
+            {}
+
+            ~SharedHeadlessContext() override { destroyContext(display, context); }
+
+            SharedHeadlessContext(const SharedHeadlessContext& other) = delete;
+            SharedHeadlessContext& operator=(const SharedHeadlessContext&) = delete;
+            SharedHeadlessContext(SharedHeadlessContext&& other) = delete;
+            SharedHeadlessContext& operator=(SharedHeadlessContext&& other) = delete;
+
+            void MakeCurrent() override { makeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context); }
+            void ReleaseCurrent() override { makeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT); }
+            void Present() override {}
+            [[nodiscard]] uint2 FramebufferSize() const override { return {}; }
+            [[nodiscard]] void* GetProcAddress(const char* name) const override { return reinterpret_cast<void*>(getProcAddress(name)); }
+        };
+
+        template <typename T>
+        bool Resolve(SDL_SharedObject* library, T& function, const char* name)
+        {
+            function = reinterpret_cast<T>(SDL_LoadFunction(library, name));
+            return function != nullptr;
+        }
+    }
+
+    HeadlessContext::HeadlessContext(const uint32_t width, const uint32_t height)
+        : egl(std::make_unique<EGLFunctions>())
+        , size(width, height)
+    {
+        if (!CreateContext())
+        {
+            return;
+        }
+
+        if (!gladLoadGLLoader(reinterpret_cast<GLADloadproc>(egl->GetProcAddress)))
+        {
+            LogEngine->Error("Failed to initialize GLAD");
+            return;
+        }
+
+        LogEngine->Info("OpenGL Version: {}", reinterpret_cast<const char*>(glGetString(GL_VERSION)));
+        LogEngine->Info("OpenGL Renderer: {}", reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
+
+        CreateFramebuffer();
+    }
+
+    HeadlessContext::~HeadlessContext()
+    {
+        if (framebuffer != 0)
+        {
+            glDeleteFramebuffers(1, &framebuffer);
+            glDeleteRenderbuffers(1, &colorBuffer);
+            glDeleteRenderbuffers(1, &depthBuffer);
+        }
+
+        if (context != nullptr)
+        {
+            egl->MakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+            egl->DestroyContext(display, context);
+        }
+
+        if (display != nullptr)
+        {
+            egl->Terminate(display);
+        }
+
+        SDL_UnloadObject(static_cast<SDL_SharedObject*>(library));
+    }
+
+    bool HeadlessContext::CreateContext()
+    {
+        auto* object = SDL_LoadObject(EGLLibraryName);
+        library = object;
+        if (object == nullptr)
+        {
+            LogEngine->Error("Could not load {}: {}", EGLLibraryName, SDL_GetError());
+            return false;
+        }
+
+        const bool resolved = Resolve(object, egl->GetProcAddress, "eglGetProcAddress")
+            && Resolve(object, egl->GetDisplay, "eglGetDisplay")
+            && Resolve(object, egl->Initialize, "eglInitialize")
+            && Resolve(object, egl->Terminate, "eglTerminate")
+            && Resolve(object, egl->BindAPI, "eglBindAPI")
+            && Resolve(object, egl->ChooseConfig, "eglChooseConfig")
+            && Resolve(object, egl->CreateContext, "eglCreateContext")
+            && Resolve(object, egl->DestroyContext, "eglDestroyContext")
+            && Resolve(object, egl->MakeCurrent, "eglMakeCurrent")
+            && Resolve(object, egl->GetError, "eglGetError");
+        if (!resolved)
+        {
+            LogEngine->Error("{} is missing required EGL entry points", EGLLibraryName);
+            return false;
+        }
+
+        // eglGetPlatformDisplay is EGL 1.5, older drivers only expose the EXT variant
+        if (const auto getPlatformDisplay = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYPROC>(egl->GetProcAddress("eglGetPlatformDisplay")))
+        {
+            display = getPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        }
+        else if (const auto getPlatformDisplayExt = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(egl->GetProcAddress("eglGetPlatformDisplayEXT")))
+        {
+            display = getPlatformDisplayExt(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+        }
+
+        if (display == EGL_NO_DISPLAY)
+        {
+            LogEngine->Warn("Surfaceless EGL platform is unavailable, falling back to the default display");
+            display = egl->GetDisplay(EGL_DEFAULT_DISPLAY);
+        }
+
+        EGLint major {0};
+        EGLint minor {0};
+        if (display == EGL_NO_DISPLAY || !egl->Initialize(display, &major, &minor))
+        {
+            LogEngine->Error("Failed to initialize EGL display (0x{:x})", egl->GetError());
+            display = nullptr;
+            return false;
+        }
+
+        LogEngine->Info("EGL Version: {}.{}", major, minor);
+
+        if (!egl->BindAPI(EGL_OPENGL_API))
+        {
+            LogEngine->Error("EGL display does not support desktop OpenGL (0x{:x})", egl->GetError());
+            return false;
+        }
+
+        // No surface is ever created, the config only needs to be compatible with a GL context.
+        // EGL_SURFACE_TYPE defaults to EGL_WINDOW_BIT, which surfaceless displays don't offer.
+        constexpr EGLint configAttributes[] {
+            EGL_SURFACE_TYPE, 0,
+            EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+            EGL_NONE,
+        };
+
+        EGLint configCount {0};
+        if (!egl->ChooseConfig(display, configAttributes, &config, 1, &configCount) || configCount == 0)
+        {
+            LogEngine->Error("No EGL config supports desktop OpenGL (0x{:x})", egl->GetError());
+            return false;
+        }
+
+        context = egl->CreateContext(display, config, EGL_NO_CONTEXT, ContextAttributes);
+        if (context == EGL_NO_CONTEXT)
+        {
+            LogEngine->Error("Failed to create OpenGL 3.3 core context (0x{:x})", egl->GetError());
+            context = nullptr;
+            return false;
+        }
+
+        if (!egl->MakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+        {
+            LogEngine->Error("Failed to make surfaceless context current (0x{:x})", egl->GetError());
+            return false;
+        }
+
+        return true;
+    }
+
+    void HeadlessContext::CreateFramebuffer()
+    {
+        const auto width = static_cast<GLsizei>(size.x);
+        const auto height = static_cast<GLsizei>(size.y);
+
+        glGenRenderbuffers(1, &colorBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, colorBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+
+        glGenRenderbuffers(1, &depthBuffer);
+        glBindRenderbuffer(GL_RENDERBUFFER, depthBuffer);
+        glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+
+        glGenFramebuffers(1, &framebuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, colorBuffer);
+        glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT, GL_RENDERBUFFER, depthBuffer);
+
+        if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+        {
+            LogEngine->Error("Offscreen framebuffer is incomplete");
+            return;
+        }
+
+        // Left bound so code that never asks for the target framebuffer still renders offscreen. Without a surface
+        // the viewport and scissor box start out empty instead of covering the drawable.
+        glViewport(0, 0, width, height);
+        glScissor(0, 0, width, height);
+        valid = true;
+    }
+
+    std::vector<uint8_t> HeadlessContext::ReadPixels() const
+    {
+        const size_t rowSize = static_cast<size_t>(size.x) * 4;
+        std::vector<uint8_t> pixels(rowSize * size.y);
+        if (!valid)
+        {
+            return pixels;
+        }
+
+        glBindFramebuffer(GL_READ_FRAMEBUFFER, framebuffer);
+        glPixelStorei(GL_PACK_ALIGNMENT, 1);
+        glReadPixels(0, 0, static_cast<GLsizei>(size.x), static_cast<GLsizei>(size.y), GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+
+        // OpenGL reads bottom row first
+        for (size_t top = 0, bottom = size.y > 0 ? size.y - 1 : 0; top < bottom; top++, bottom--)
+        {
+            std::swap_ranges(pixels.begin() + top * rowSize, pixels.begin() + (top + 1) * rowSize, pixels.begin() + bottom * rowSize);
+        }
+
+        return pixels;
+    }
+
+    void HeadlessContext::MakeCurrent()
+    {
+        egl->MakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context);
+    }
+
+    void HeadlessContext::ReleaseCurrent()
+    {
+        egl->MakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    }
+
+    void HeadlessContext::Present()
+    {
+        // Nothing to swap, finishing keeps frame timings honest for benchmark runs
+        glFinish();
+    }
+
+    void* HeadlessContext::GetProcAddress(const char* name) const
+    {
+        return reinterpret_cast<void*>(egl->GetProcAddress(name));
+    }
+
+    std::unique_ptr<GLContext> HeadlessContext::CreateSharedContext()
+    {
+        if (context == nullptr)
+        {
+            return nullptr;
+        }
+
+        const EGLContext shared = egl->CreateContext(display, config, context, ContextAttributes);
+        if (shared == EGL_NO_CONTEXT)
+        {
+            LogEngine->Warn("Failed to create shared OpenGL context (0x{:x})", egl->GetError());
+            return nullptr;
+        }
+
+        return std::make_unique<SharedHeadlessContext>(egl->MakeCurrent, egl->DestroyContext, egl->GetProcAddress, display, shared);
+    }
+}
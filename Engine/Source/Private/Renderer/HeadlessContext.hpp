@@ -0,0 +1,61 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "GLContext.hpp"
+
+namespace blackbox
+{
+    /**
+     * OpenGL 3.3 core context without a window or display, for CI machines and benchmarks.
+     *
+     * Uses surfaceless EGL (EGL_MESA_platform_surfaceless, works with Mesa llvmpipe) and renders into an
+     * offscreen framebuffer object with an RGBA8 color and depth/stencil attachment. libEGL is loaded at
+     * runtime, so nothing links against it unless -Headless is used.
+     */
+    class HeadlessContext final : public GLContext
+    {
+        struct EGLFunctions;
+
+        void* library {nullptr};
+        std::unique_ptr<EGLFunctions> egl {nullptr};
+        void* display {nullptr};
+        void* config {nullptr};
+        void* context {nullptr};
+
+        uint32_t framebuffer {0};
+        uint32_t colorBuffer {0};
+        uint32_t depthBuffer {0};
+        uint2 size {0, 0};
+        bool valid {false};
+
+    public:
+        HeadlessContext(uint32_t width, uint32_t height);
+        ~HeadlessContext() override;
+
+        HeadlessContext(const HeadlessContext& other) = delete;
+        HeadlessContext& operator=(const HeadlessContext&) = delete;
+        HeadlessContext(HeadlessContext&& other) = delete;
+        HeadlessContext& operator=(HeadlessContext&& other) = delete;
+
+        [[nodiscard]] bool IsValid() const { return valid; }
+
+        // Read back the framebuffer as tightly packed RGBA8, top row first
+        [[nodiscard]] std::vector<uint8_t> ReadPixels() const;
+
+        // GLContext
+        void MakeCurrent() override;
+        void ReleaseCurrent() override;
+        void Present() override;
+        [[nodiscard]] uint2 FramebufferSize() const override { return size; }
+        [[nodiscard]] uint32_t TargetFramebuffer() const override { return framebuffer; }
+        [[nodiscard]] void* GetProcAddress(const char* name) const override;
+        [[nodiscard]] std::unique_ptr<GLContext> CreateSharedContext() override;
+
+    private:
+        bool CreateContext();
+        void CreateFramebuffer();
+    };
+}
@@ -0,0 +1,155 @@
+﻿#include "LightClusters.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "Blackbox.hpp"
+#include "Jobs/JobSystem.hpp"
+
+namespace blackbox
+{
+    LightClusters::LightClusters(JobSystem& jobs)
+        : jobs(jobs)
+        , clusters(ClusterCount)
+    {
+    }
+
+    void LightClusters::Submit(const PointLight& light)
+    {
+        if (lights.size() >= MaxLights)
+        {
+            if (!limitReported)
+            {
+                LogRenderer->Warn("More than {} lights submitted in one frame, the rest are dropped", MaxLights);
+                limitReported = true;
+            }
+            return;
+        }
+        lights.push_back(light);
+    }
+
+    void LightClusters::Build(const glm::mat4& view, const glm::mat4& projection, const float farPlane, const uint2 viewportSize)
+    {
+        lightData.resize(lights.size() * 2);
+        for (size_t i = 0; i < lights.size(); i++)
+        {
+            const PointLight& light = lights[i];
+            lightData[i * 2] = float4(float3(view * float4(light.position, 1.0f)), std::max(light.radius, 0.0f));
+            lightData[i * 2 + 1] = float4(light.color * light.intensity, 0.0f);
+        }
+
+        // Slice 0 reaches from the camera to NearSliceDepth, the others split the rest evenly in log depth
+        const float logRange = std::log(std::max(farPlane, NearSliceDepth * 2.0f) / NearSliceDepth);
+        const float slicesPerLog = static_cast<float>(DepthSlices - 1) / logRange;
+        sliceDepths[0] = 0.0f;
+        for (uint32_t slice = 1; slice <= DepthSlices; slice++)
+        {
+            sliceDepths[slice] = NearSliceDepth * std::exp(static_cast<float>(slice - 1) / slicesPerLog);
+        }
+        clusterScale = {
+            slicesPerLog,
+            1.0f - std::log(NearSliceDepth) * slicesPerLog,
+            static_cast<float>(ClustersX) / static_cast<float>(std::max(viewportSize.x, 1u)),
+            static_cast<float>(ClustersY) / static_cast<float>(std::max(viewportSize.y, 1u)),
+        };
+
+        // Any clip-space depth lies on the ray through a pixel, dividing by the view depth moves it to depth 1
+        const glm::mat4 inverseProjection = glm::inverse(projection);
+        for (uint32_t y = 0; y <= ClustersY; y++)
+        {
+            for (uint32_t x = 0; x <= ClustersX; x++)
+            {
+                const float2 ndc = float2(x, y) / float2(ClustersX, ClustersY) * 2.0f - 1.0f;
+                const float4 point = inverseProjection * float4(ndc, 0.0f, 1.0f);
+                tileCorners[y * (ClustersX + 1) + x] = float3(point) / -point.z;
+            }
+        }
+
+        jobs.ParallelFor(DepthSlices, 1, [this](const size_t begin, const size_t end, uint32_t)
+        {
+            for (size_t slice = begin; slice < end; slice++)
+            {
+                BuildSlice(static_cast<uint32_t>(slice));
+            }
+        });
+
+        // Slices counted their entries from zero, packing them moves every cluster by the slices before it
+        size_t total {0};
+        for (const std::vector<uint16_t>& entries : sliceIndices)
+        {
+            total += entries.size();
+        }
+        indices.resize(total);
+
+        uint32_t offset {0};
+        for (uint32_t slice = 0; slice < DepthSlices; slice++)
+        {
+            std::ranges::copy(sliceIndices[slice], indices.begin() + offset);
+            for (uint32_t cluster = slice * ClustersX * ClustersY; cluster < (slice + 1) * ClustersX * ClustersY; cluster++)
+            {
+                clusters[cluster].x += offset;
+            }
+            offset += static_cast<uint32_t>(sliceIndices[slice].size());
+        }
+    }
+
+    uint32_t LightClusters::ClusterAt(const float2 fragCoord, const float viewDepth) const
+    {
+        const float slice = viewDepth > 0.0f ? std::log(viewDepth) * clusterScale.x + clusterScale.y : 0.0f;
+        const float3 cell = glm::clamp(float3(fragCoord.x * clusterScale.z, fragCoord.y * clusterScale.w, slice),
+            float3(0.0f), float3(ClustersX - 1, ClustersY - 1, DepthSlices - 1));
+        return (static_cast<uint32_t>(cell.z) * ClustersY + static_cast<uint32_t>(cell.y)) * ClustersX + static_cast<uint32_t>(cell.x);
+    }
+
+    void LightClusters::BuildSlice(const uint32_t slice)
+    {
+        const float nearDepth = sliceDepths[slice];
+        const float farDepth = sliceDepths[slice + 1];
+
+        // Most lights are nowhere near a given slice, only the ones reaching into it are tested per cluster
+        std::vector<uint16_t>& candidates = sliceLights[slice];
+        candidates.clear();
+        for (uint32_t light = 0; light < LightCount(); light++)
+        {
+            const float4& sphere = lightData[light * 2];
+            if (-sphere.z + sphere.w >= nearDepth && -sphere.z - sphere.w <= farDepth)
+            {
+                candidates.push_back(static_cast<uint16_t>(light));
+            }
+        }
+
+        std::vector<uint16_t>& entries = sliceIndices[slice];
+        entries.clear();
+        for (uint32_t y = 0; y < ClustersY; y++)
+        {
+            for (uint32_t x = 0; x < ClustersX; x++)
+            {
+                // Box around the cluster's frustum, the rays through its tile's corners cut at both slice depths
+                float3 lower(std::numeric_limits<float>::max());
+                float3 upper(std::numeric_limits<float>::lowest());
+                for (const uint32_t corner : {y * (ClustersX + 1) + x, y * (ClustersX + 1) + x + 1, (y + 1) * (ClustersX + 1) + x, (y + 1) * (ClustersX + 1) + x + 1})
+                {
+                    for (const float depth : {nearDepth, farDepth})
+                    {
+                        lower = glm::min(lower, tileCorners[corner] * depth);
+                        upper = glm::max(upper, tileCorners[corner] * depth);
+                    }
+                }
+
+                uint2& cluster = clusters[(slice * ClustersY + y) * ClustersX + x];
+                cluster.x = static_cast<uint32_t>(entries.size());
+                for (const uint16_t light : candidates)
+                {
+                    const float4& sphere = lightData[light * 2];
+                    const float3 offset = glm::clamp(float3(sphere), lower, upper) - float3(sphere);
+                    if (glm::dot(offset, offset) <= sphere.w * sphere.w)
+                    {
+                        entries.push_back(light);
+                    }
+                }
+                cluster.y = static_cast<uint32_t>(entries.size()) - cluster.x;
+            }
+        }
+    }
+}
@@ -0,0 +1,87 @@
+﻿#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/mat4x4.hpp>
+
+#include "RenderTypes.hpp"
+
+namespace blackbox
+{
+    class JobSystem;
+
+    /**
+     * Point lights sorted into a froxel grid, so shading a pixel only visits the lights of its cluster instead of
+     * every light in the scene.
+     *
+     * The view frustum is cut into ClustersX by ClustersY screen tiles and DepthSlices slices in view depth. The
+     * first slice ends at NearSliceDepth and the rest grow exponentially up to the far plane, so near clusters are
+     * about as deep as they are wide. Build tests every light against the box of every cluster on the JobSystem,
+     * one depth slice per job, and packs the result into three flat arrays the backends upload as they are:
+     *
+     *   LightData  two texels per light, view-space position and radius, then color times intensity
+     *   Clusters   per cluster its first entry in Indices and how many lights it has
+     *   Indices    light indices, cluster after cluster
+     *
+     * A pixel finds its cluster from its window position and view depth with ClusterScale, see Lighting.glsl.
+     * Lights are submitted from the thread that owns the renderer and only live for one frame.
+     */
+    class LightClusters
+    {
+    public:
+        static constexpr uint32_t ClustersX = 16;
+        static constexpr uint32_t ClustersY = 9;
+        static constexpr uint32_t DepthSlices = 24;
+        static constexpr uint32_t ClusterCount = ClustersX * ClustersY * DepthSlices;
+        static constexpr float NearSliceDepth = 0.5f;
+
+        // Light indices are stored as 16 bits
+        static constexpr uint32_t MaxLights = 4096;
+
+    private:
+        JobSystem& jobs;
+        std::vector<PointLight> lights {};
+
+        std::vector<float4> lightData {};
+        std::vector<uint2> clusters {}; // x: first entry in `indices`, y: light count
+        std::vector<uint16_t> indices {};
+
+        // Per depth slice, the lights reaching into it and the entries of its clusters before they're packed
+        std::array<std::vector<uint16_t>, DepthSlices> sliceLights {};
+        std::array<std::vector<uint16_t>, DepthSlices> sliceIndices {};
+        std::array<float, DepthSlices + 1> sliceDepths {};
+        std::array<float3, (ClustersX + 1) * (ClustersY + 1)> tileCorners {}; // View-space rays through tile corners, at depth 1
+        float4 clusterScale {};
+        bool limitReported {false};
+
+    public:
+        explicit LightClusters(JobSystem& jobs);
+
+        LightClusters(const LightClusters& other) = delete;
+        LightClusters& operator=(const LightClusters&) = delete;
+        LightClusters(LightClusters&& other) = delete;
+        LightClusters& operator=(LightClusters&& other) = delete;
+
+        // Dropped with a warning beyond MaxLights
+        void Submit(const PointLight& light);
+        // Assigns this frame's lights for a perspective `projection` and a target of `viewportSize`
+        void Build(const glm::mat4& view, const glm::mat4& projection, float farPlane, uint2 viewportSize);
+        // Drops the lights, the packed arrays stay valid until the next Build
+        void Clear() { lights.clear(); }
+
+        [[nodiscard]] std::span<const float4> LightData() const { return lightData; }
+        [[nodiscard]] std::span<const uint2> Clusters() const { return clusters; }
+        [[nodiscard]] std::span<const uint16_t> Indices() const { return indices; }
+        [[nodiscard]] uint32_t LightCount() const { return static_cast<uint32_t>(lightData.size() / 2); }
+
+        // x: slices per unit of log view depth, y: slice of view depth 1, zw: clusters per pixel
+        [[nodiscard]] float4 ClusterScale() const { return clusterScale; }
+        // What Lighting.glsl computes, `fragCoord` in pixels from the bottom left like gl_FragCoord
+        [[nodiscard]] uint32_t ClusterAt(float2 fragCoord, float viewDepth) const;
+
+    private:
+        void BuildSlice(uint32_t slice);
+    };
+}
@@ -0,0 +1,475 @@
+﻿#include "NullBackend.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <spdlog/fmt/fmt.h>
+
+#include "Blackbox.hpp"
+#include "LightClusters.hpp"
+#include "SortKey.hpp"
+#include "SpriteBatch.hpp"
+#include "TextureStreamer.hpp"
+
+namespace blackbox
+{
+    namespace
+    {
+        constexpr size_t PassCount = 3;
+        // GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT is unknown without a context, 256 is the largest drivers report
+        constexpr size_t UniformAlignment = 256;
+        // GLBackend's InstanceData, a model matrix and a material index padded to 16 bytes
+        constexpr size_t InstanceDataSize = sizeof(glm::mat4) + 16;
+        // GLBackend's sprite quad, and the quads its 16 bit index buffer covers
+        constexpr size_t SpriteQuadSize = 4 * sizeof(SpriteVertex);
+        constexpr uint32_t MaxSpritesPerDraw = 16384;
+        // Mesh vertex arrays start at 1, the sprite vertex array stands apart from them
+        constexpr uint32_t SpriteVertexArray = 0;
+
+        constexpr const char* PassNames[] {"opaque", "transparent", "overlay"};
+
+        size_t AlignUp(const size_t value, const size_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+    }
+
+    NullBackend::NullBackend(const std::string& recordingPath)
+    {
+        if (recordingPath.empty())
+        {
+            return;
+        }
+
+        if (const std::filesystem::path directory = std::filesystem::path(recordingPath).parent_path(); !directory.empty())
+        {
+            std::error_code error {};
+            std::filesystem::create_directories(directory, error);
+        }
+
+        recording.open(recordingPath, std::ios::trunc);
+        if (!recording.is_open())
+        {
+            LogRenderer->Error("Could not open {} to record the command stream", recordingPath);
+        }
+    }
+
+    ShaderHandle NullBackend::CreateShader(std::string_view, std::string_view)
+    {
+        if (shaderCount >= SortKey::MaxShaders - 1)
+        {
+            LogRenderer->Error("Shader limit of {} reached", SortKey::MaxShaders - 1);
+            return {};
+        }
+
+        return {++shaderCount};
+    }
+
+    ShaderHandle NullBackend::CreateShaderVariant(std::string vertexSource, std::string fragmentSource, ShaderHandle)
+    {
+        return CreateShader(vertexSource, fragmentSource);
+    }
+
+    TextureHandle NullBackend::CreateTexture(const std::span<const uint8_t> rgba, const uint2 size, const std::string& sourcePath)
+    {
+        if (size.x == 0 || size.y == 0 || rgba.size() < size_t {size.x} * size.y * 4)
+        {
+            LogRenderer->Error("Could not create a {}x{} texture from {} bytes", size.x, size.y, rgba.size());
+            return {};
+        }
+
+        // The bin the TextureAtlas would put it in, with every small image on the same pages
+        const bool small = size.x <= TextureAtlas::SmallTextureSize && size.y <= TextureAtlas::SmallTextureSize;
+        const bool streamed = !sourcePath.empty() && TextureStreamer::ShouldStream(size);
+        const uint3 bin(small ? uint2(TextureAtlas::PageSize) : size, streamed ? 1 : 0);
+
+        auto found = std::ranges::find(bins, bin);
+        if (found == bins.end())
+        {
+            found = bins.insert(bins.end(), bin);
+            binLayers.emplace_back();
+        }
+        const auto binIndex = static_cast<uint32_t>(found - bins.begin());
+
+        // And the layer it would take, sprites of different layers draw separately
+        const uint32_t padding = small ? TextureAtlas::Padding : 0;
+        const uint2 padded = size + uint2(padding * 2);
+        std::vector<SkylinePacker>& layers = binLayers[binIndex];
+        std::optional<uint2> cell {};
+        uint32_t layer {0};
+        for (; layer < layers.size() && !cell.has_value(); layer++)
+        {
+            cell = layers[layer].Insert(padded);
+        }
+        if (!cell.has_value())
+        {
+            layers.emplace_back(uint2(bin), std::max(padding, 1u));
+            cell = layers.back().Insert(padded);
+            layer = static_cast<uint32_t>(layers.size());
+        }
+
+        textureBins.push_back(binIndex);
+        textureLayers.push_back(layer - 1);
+        textureBytes += size_t {size.x} * size.y * 4;
+
+        return {static_cast<uint32_t>(textureBins.size())};
+    }
+
+    MeshHandle NullBackend::CreateMesh(const std::span<const Vertex> vertices, const std::span<const uint32_t> indices)
+    {
+        if (meshes.size() >= SortKey::MaxMeshes - 1)
+        {
+            LogRenderer->Error("Mesh limit of {} reached", SortKey::MaxMeshes - 1);
+            return {};
+        }
+
+        // Still created, so handles stay the same as with the other backends
+        if (std::ranges::any_of(indices, [&](const uint32_t index) { return index >= vertices.size(); }))
+        {
+            LogRenderer->Error("Mesh {} has indices past its {} vertices", meshes.size() + 1, vertices.size());
+        }
+        if ((indices.empty() ? vertices.size() : indices.size()) % 3 != 0)
+        {
+            LogRenderer->Error("Mesh {} doesn't consist of whole triangles", meshes.size() + 1);
+        }
+
+        meshes.push_back({.vertexCount = static_cast<uint32_t>(vertices.size()), .indexCount = static_cast<uint32_t>(indices.size())});
+        return {static_cast<uint32_t>(meshes.size())};
+    }
+
+    MaterialHandle NullBackend::CreateMaterial(const ShaderHandle shader, const std::span<const TextureHandle> materialTextures, const MaterialBlock&)
+    {
+        if (materials.size() >= SortKey::MaxMaterials - 1 || materialTextures.size() > MaterialTextureSlots)
+        {
+            LogRenderer->Error("Material limit reached or more than {} textures", MaterialTextureSlots);
+            return {};
+        }
+
+        if (std::ranges::any_of(materialTextures, [this](const TextureHandle texture) { return texture.IsValid() && texture.Index() >= textureBins.size(); }))
+        {
+            LogRenderer->Error("Material {} uses a texture that doesn't exist", materials.size() + 1);
+            return {};
+        }
+
+        Material& material = materials.emplace_back();
+        material.shader = shader;
+        std::ranges::copy(materialTextures, material.textures.begin());
+
+        return {static_cast<uint32_t>(materials.size())};
+    }
+
+    TargetTexture NullBackend::CreateTarget(const TargetDesc& desc)
+    {
+        // Texture and framebuffer ids from one counter, like GL names they never collide with 0
+        targetCount++;
+        if (recording.is_open())
+        {
+            recording << fmt::format("target create {} {}x{} format {}\n", targetCount, desc.size.x, desc.size.y, static_cast<uint32_t>(desc.format));
+        }
+        return {.texture = targetCount, .framebuffer = targetCount};
+    }
+
+    void NullBackend::DestroyTarget(const TargetTexture& target)
+    {
+        if (recording.is_open())
+        {
+            recording << fmt::format("target destroy {}\n", target.texture);
+        }
+    }
+
+    void NullBackend::BeginFrame(const uint32_t framebuffer, const uint2 size, const float4& clearColor)
+    {
+        stats = {};
+
+        Set(GLStateCall::Framebuffer, state.framebuffer, framebuffer);
+        ApplyPassState(RenderPass::Opaque);
+
+        if (recording.is_open())
+        {
+            recording << fmt::format("frame {} {}x{} clear {:.3f} {:.3f} {:.3f} {:.3f}\n", frameNumber, size.x, size.y, clearColor.r, clearColor.g, clearColor.b, clearColor.a);
+        }
+    }
+
+    void NullBackend::Execute(const RenderCommandBuffer& commands, const FrameData& frame)
+    {
+        const std::span<const SortEntry> entries = commands.Entries();
+        stats.packets += static_cast<uint32_t>(entries.size());
+        if (entries.empty())
+        {
+            return;
+        }
+
+        // Batches are built from the valid packets only, the GLBackend would draw garbage or crash on the others
+        validEntries.clear();
+        uint64_t previousKey {0};
+        for (const SortEntry& entry : entries)
+        {
+            const DrawPacket& packet = commands.Packet(entry);
+            std::string_view problem = Validate(entry, packet);
+            if (problem.empty() && entry.key < previousKey)
+            {
+                problem = "entries out of key order";
+            }
+
+            if (problem.empty())
+            {
+                previousKey = entry.key;
+                validEntries.push_back(entry);
+                continue;
+            }
+
+            if (stats.invalidPackets++ == 0)
+            {
+                LogRenderer->Error("Frame {}: invalid packet, {} (key {:016x}, mesh {}, material {})", frameNumber, problem, entry.key, packet.mesh.id, packet.material.id);
+            }
+            if (recording.is_open())
+            {
+                recording << fmt::format("invalid {:016x} mesh {} material {}: {}\n", entry.key, packet.mesh.id, packet.material.id, problem);
+            }
+        }
+
+        // What the GLBackend streams per Execute: FrameBlock | PassBlock per pass | InstanceData per packet
+        stats.streamingBytes += AlignUp(sizeof(FrameBlock), UniformAlignment) + AlignUp(sizeof(PassBlock), UniformAlignment) * PassCount
+            + validEntries.size() * InstanceDataSize;
+
+        // The frame and pass blocks move through the ring every frame, so binding them always reaches the driver
+        stats.glState.issued[static_cast<size_t>(GLStateCall::Buffer)] += 2;
+
+        // The GLBackend binds and refills its three light buffers and binds their textures, which stay the same every frame
+        if (frame.lights != nullptr)
+        {
+            stats.lights = frame.lights->LightCount();
+            stats.lightAssignments = static_cast<uint32_t>(frame.lights->Indices().size());
+            for (uint32_t i = 0; i < state.lightTextures.size(); i++)
+            {
+                stats.glState.issued[static_cast<size_t>(GLStateCall::Buffer)]++;
+                Set(GLStateCall::Texture, state.lightTextures[i], i);
+            }
+            if (recording.is_open())
+            {
+                recording << fmt::format("lights {} assignments {}\n", stats.lights, stats.lightAssignments);
+            }
+        }
+
+        if (recording.is_open())
+        {
+            const glm::mat4 viewProjection = frame.projection * frame.view;
+            recording << "viewProjection";
+            for (glm::length_t column = 0; column < 4; column++)
+            {
+                recording << fmt::format(" {:.4f} {:.4f} {:.4f} {:.4f}", viewProjection[column].x, viewProjection[column].y, viewProjection[column].z, viewProjection[column].w);
+            }
+            recording << '\n';
+        }
+
+        RenderPass currentPass {RenderPass::Opaque};
+        size_t first {0};
+        while (first < validEntries.size())
+        {
+            const DrawPacket& packet = commands.Packet(validEntries[first]);
+            const RenderPass pass = SortKey::Pass(validEntries[first].key);
+
+            size_t end = first + 1;
+            while (end < validEntries.size())
+            {
+                const DrawPacket& next = commands.Packet(validEntries[end]);
+                if (next.mesh != packet.mesh || !CanBatch(packet.material, next.material) || SortKey::Pass(validEntries[end].key) != pass)
+                {
+                    break;
+                }
+                end++;
+            }
+
+            // The same binds in the same order as GLBackend::Execute
+            if (pass != currentPass)
+            {
+                ApplyPassState(pass);
+                currentPass = pass;
+                stats.glState.issued[static_cast<size_t>(GLStateCall::Buffer)]++;
+            }
+
+            const Material& material = materials[packet.material.Index()];
+            Set(GLStateCall::Program, state.program, material.shader.id);
+            Set(GLStateCall::Buffer, state.materialWindow, static_cast<uint32_t>(packet.material.Index() / MaterialsPerBlock));
+            for (uint32_t unit = 0; unit < MaterialTextureSlots && material.textures[unit].IsValid(); unit++)
+            {
+                Set(GLStateCall::Texture, state.textures[unit], textureBins[material.textures[unit].Index()]);
+            }
+            Set(GLStateCall::VertexArray, state.vertexArray, packet.mesh.id);
+            stats.drawCalls++;
+
+            if (recording.is_open())
+            {
+                const Mesh& mesh = meshes[packet.mesh.Index()];
+                recording << fmt::format("draw {} shader {} mesh {} ({} {}) instances {}\n", PassNames[static_cast<size_t>(pass)], material.shader.id, packet.mesh.id,
+                    mesh.indexCount > 0 ? mesh.indexCount : mesh.vertexCount, mesh.indexCount > 0 ? "indices" : "vertices", end - first);
+
+                for (size_t index = first; index < end; index++)
+                {
+                    const DrawPacket& instance = commands.Packet(validEntries[index]);
+                    recording << fmt::format("  {:016x} material {} model", validEntries[index].key, instance.material.id);
+                    for (glm::length_t column = 0; column < 4; column++)
+                    {
+                        recording << fmt::format(" {:.4f} {:.4f} {:.4f} {:.4f}", instance.model[column].x, instance.model[column].y, instance.model[column].z, instance.model[column].w);
+                    }
+                    recording << '\n';
+                }
+            }
+
+            first = end;
+        }
+
+        ApplyPassState(RenderPass::Opaque);
+    }
+
+    void NullBackend::DrawSprites(const SpriteBatch& batch, const ShaderHandle shader)
+    {
+        const std::span<const uint32_t> order = batch.Order();
+        if (order.empty() || !shader.IsValid() || shader.Index() >= shaderCount)
+        {
+            return;
+        }
+
+        // The same binds in the same order as GLBackend::DrawSprites
+        stats.streamingBytes += order.size() * SpriteQuadSize;
+        ApplyPassState(RenderPass::Overlay);
+        Set(GLStateCall::Program, state.program, shader.id);
+        Set(GLStateCall::VertexArray, state.vertexArray, SpriteVertexArray);
+        stats.glState.issued[static_cast<size_t>(GLStateCall::Buffer)]++;
+
+        // Runs split where GLBackend's do, at every atlas bin, layer and MaxSpritesPerDraw. Sprites without a
+        // texture draw nothing and join whatever run they're in.
+        const std::span<const Sprite> sprites = batch.Sprites();
+        uint32_t runs {0};
+        uint32_t runLength {0};
+        uint32_t currentBin {UINT32_MAX};
+        uint32_t currentLayer {UINT32_MAX};
+        for (const uint32_t index : order)
+        {
+            const TextureHandle texture = sprites[index].texture;
+            const bool textured = texture.IsValid() && texture.Index() < textureBins.size();
+            if (runs == 0 || runLength == MaxSpritesPerDraw
+                || (textured && (textureBins[texture.Index()] != currentBin || textureLayers[texture.Index()] != currentLayer)))
+            {
+                if (textured)
+                {
+                    currentBin = textureBins[texture.Index()];
+                    currentLayer = textureLayers[texture.Index()];
+                    Set(GLStateCall::Texture, state.textures[0], currentBin);
+                }
+                else if (runs == 0)
+                {
+                    currentBin = 0;
+                    currentLayer = 0;
+                }
+                runs++;
+                runLength = 0;
+            }
+            runLength++;
+        }
+
+        stats.drawCalls += runs;
+        stats.sprites += static_cast<uint32_t>(order.size());
+        stats.spriteDrawCalls += runs;
+        if (recording.is_open())
+        {
+            recording << fmt::format("sprites {} draws {}\n", order.size(), runs);
+        }
+        ApplyPassState(RenderPass::Opaque);
+    }
+
+    void NullBackend::EndFrame()
+    {
+        stats.textureBytes = textureBytes;
+
+        // A frame at a time, so a crashing run still leaves everything up to the frame before
+        if (recording.is_open())
+        {
+            recording.flush();
+        }
+        frameNumber++;
+    }
+
+    std::string_view NullBackend::Validate(const SortEntry& entry, const DrawPacket& packet) const
+    {
+        if (!packet.mesh.IsValid() || packet.mesh.Index() >= meshes.size())
+        {
+            return "mesh doesn't exist";
+        }
+        if (!packet.material.IsValid() || packet.material.Index() >= materials.size())
+        {
+            return "material doesn't exist";
+        }
+        if (const ShaderHandle shader = materials[packet.material.Index()].shader; !shader.IsValid() || shader.Index() >= shaderCount)
+        {
+            return "material has no shader";
+        }
+
+        const RenderPass pass = SortKey::Pass(entry.key);
+        if (static_cast<size_t>(pass) >= PassCount)
+        {
+            return "sort key has no valid pass";
+        }
+
+        // State bits sit above the depth, except in the transparent pass which puts the depth above them
+        const uint64_t state = pass == RenderPass::Transparent ? entry.key : entry.key >> SortKey::DepthBits;
+        const bool meshMatches = (state & (SortKey::MaxMeshes - 1)) == (packet.mesh.id & (SortKey::MaxMeshes - 1));
+        const bool materialMatches = (state >> SortKey::MeshBits & (SortKey::MaxMaterials - 1)) == (packet.material.id & (SortKey::MaxMaterials - 1));
+        if (!meshMatches || !materialMatches)
+        {
+            return "sort key doesn't match the packet";
+        }
+
+        for (glm::length_t column = 0; column < 4; column++)
+        {
+            if (!std::isfinite(packet.model[column].x) || !std::isfinite(packet.model[column].y) || !std::isfinite(packet.model[column].z) || !std::isfinite(packet.model[column].w))
+            {
+                return "model matrix isn't finite";
+            }
+        }
+        return {};
+    }
+
+    bool NullBackend::CanBatch(const MaterialHandle first, const MaterialHandle second) const
+    {
+        if (first == second)
+        {
+            return true;
+        }
+
+        // Same shader, same MaterialData window and the same atlas bin in every texture slot
+        const Material& a = materials[first.Index()];
+        const Material& b = materials[second.Index()];
+        if (a.shader != b.shader || first.Index() / MaterialsPerBlock != second.Index() / MaterialsPerBlock)
+        {
+            return false;
+        }
+
+        for (size_t unit = 0; unit < MaterialTextureSlots; unit++)
+        {
+            if (a.textures[unit].IsValid() != b.textures[unit].IsValid())
+            {
+                return false;
+            }
+            if (a.textures[unit].IsValid() && textureBins[a.textures[unit].Index()] != textureBins[b.textures[unit].Index()])
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    void NullBackend::ApplyPassState(const RenderPass pass)
+    {
+        Set(GLStateCall::Capability, state.depthTest, pass != RenderPass::Overlay ? 1 : 0);
+        Set(GLStateCall::Capability, state.depthWrite, pass == RenderPass::Opaque ? 1 : 0);
+        Set(GLStateCall::Capability, state.blend, pass != RenderPass::Opaque ? 1 : 0);
+    }
+
+    void NullBackend::Set(const GLStateCall call, uint32_t& current, const uint32_t value)
+    {
+        const bool changed = current != value;
+        (changed ? stats.glState.issued : stats.glState.skipped)[static_cast<size_t>(call)]++;
+        current = value;
+    }
+}
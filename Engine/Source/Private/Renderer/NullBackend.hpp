@@ -0,0 +1,117 @@
+﻿#pragma once
+
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "RenderBackend.hpp"
+#include "SkylinePacker.hpp"
+
+namespace blackbox
+{
+    /**
+     * Accepts everything the Renderer hands a backend without drawing anything, to measure the CPU side of
+     * rendering (recording, sorting, building commands) without a driver or GPU in the way.
+     *
+     * Execute validates every packet against the resources it was given: handles in range, a sort key that
+     * matches the packet's mesh and material, entries in key order and a finite model matrix. Invalid packets
+     * are counted in RenderStats::invalidPackets and skipped, the first one per frame is logged.
+     *
+     * Valid packets are batched like the GLBackend batches them, and the GL state calls and uploads that would
+     * take are counted into the same RenderStats fields, so numbers compare between backends. With a recording
+     * path every frame's batches and packets are written there as text, one line each, meant for diffing two runs.
+     */
+    class NullBackend final : public RenderBackend
+    {
+        struct Mesh
+        {
+            uint32_t vertexCount {0};
+            uint32_t indexCount {0}; // 0 for meshes drawn without indices
+        };
+
+        struct Material
+        {
+            ShaderHandle shader {};
+            std::array<TextureHandle, MaterialTextureSlots> textures {};
+        };
+
+        // The last value of the GL state the GLBackend sets while drawing, like its GLStateCache. Unknown until
+        // first set, so the first call of every kind counts as issued.
+        struct ShadowState
+        {
+            uint32_t framebuffer {UINT32_MAX};
+            uint32_t program {UINT32_MAX};
+            uint32_t vertexArray {UINT32_MAX};
+            std::array<uint32_t, MaterialTextureSlots> textures {UINT32_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX};
+            std::array<uint32_t, 3> lightTextures {UINT32_MAX, UINT32_MAX, UINT32_MAX}; // Never change once bound
+            uint32_t materialWindow {UINT32_MAX};
+            uint32_t depthTest {UINT32_MAX};
+            uint32_t depthWrite {UINT32_MAX};
+            uint32_t blend {UINT32_MAX};
+        };
+
+        uint32_t shaderCount {0};
+        uint32_t targetCount {0}; // Created so far, ids are never reused
+        std::vector<uint32_t> textureBins {};   // Per texture, the index of its TextureAtlas bin in `bins`
+        std::vector<uint32_t> textureLayers {}; // Per texture, its layer within that bin
+        std::vector<uint3> bins {};             // Like TextureAtlas::FindBin, by layer size and whether they stream
+        std::vector<std::vector<SkylinePacker>> binLayers {}; // Per bin, packed like TextureAtlas packs its layers
+        std::vector<Mesh> meshes {};
+        std::vector<Material> materials {};
+        size_t textureBytes {0};
+
+        std::vector<SortEntry> validEntries {};
+        RenderStats stats {};
+        ShadowState state {};
+        uint64_t frameNumber {0};
+        std::ofstream recording {};
+
+    public:
+        // Writes every frame's command stream to `recordingPath` unless it's empty
+        explicit NullBackend(const std::string& recordingPath = {});
+
+        NullBackend(const NullBackend& other) = delete;
+        NullBackend& operator=(const NullBackend&) = delete;
+        NullBackend(NullBackend&& other) = delete;
+        NullBackend& operator=(NullBackend&& other) = delete;
+
+        // RenderBackend
+        ShaderHandle CreateShader(std::string_view vertexSource, std::string_view fragmentSource) override;
+        ShaderHandle CreateShaderVariant(std::string vertexSource, std::string fragmentSource, ShaderHandle fallback) override;
+        TextureHandle CreateTexture(std::span<const uint8_t> rgba, uint2 size, const std::string& sourcePath) override;
+        MeshHandle CreateMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices) override;
+        MaterialHandle CreateMaterial(ShaderHandle shader, std::span<const TextureHandle> textures, const MaterialBlock& parameters) override;
+        // Only hands out ids, recorded as "target" lines
+        TargetTexture CreateTarget(const TargetDesc& desc) override;
+        void DestroyTarget(const TargetTexture& target) override;
+
+        // Sort keys of packets with a material that doesn't exist get no shader, Execute reports them
+        [[nodiscard]] ShaderHandle MaterialShader(const MaterialHandle material) const override
+        {
+            return material.Index() < materials.size() ? materials[material.Index()].shader : ShaderHandle {};
+        }
+        [[nodiscard]] bool IsShaderReady(ShaderHandle) const override { return true; }
+
+        void BeginFrame(uint32_t framebuffer, uint2 size, const float4& clearColor) override;
+        void Execute(const RenderCommandBuffer& commands, const FrameData& frame) override;
+        // Runs are split like GLBackend splits them, by atlas bin and layer and at MaxSpritesPerDraw
+        void DrawSprites(const SpriteBatch& sprites, ShaderHandle shader) override;
+        void EndFrame() override;
+
+        [[nodiscard]] const RenderStats& Stats() const override { return stats; }
+
+        [[nodiscard]] bool IsRecording() const { return recording.is_open(); }
+
+    private:
+        // Empty when the packet is valid, otherwise what is wrong with it
+        [[nodiscard]] std::string_view Validate(const SortEntry& entry, const DrawPacket& packet) const;
+        [[nodiscard]] bool CanBatch(MaterialHandle first, MaterialHandle second) const;
+        void ApplyPassState(RenderPass pass);
+        // Counts the call as issued when it changes `current`, as skipped otherwise
+        void Set(GLStateCall call, uint32_t& current, uint32_t value);
+    };
+}
@@ -0,0 +1,313 @@
+﻿#include "OcclusionCulling.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <emmintrin.h>
+#include <limits>
+
+#include "Jobs/JobSystem.hpp"
+
+namespace blackbox
+{
+    namespace
+    {
+        float Cross(const float2 a, const float2 b, const float2 p)
+        {
+            return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+        }
+
+        // Screen position and depth of a clip-space position, the way SoftwareRasterizer maps them
+        float3 ToScreen(const float4& clip, const uint2 size)
+        {
+            const float3 ndc = float3(clip) / clip.w;
+            return {(ndc.x * 0.5f + 0.5f) * static_cast<float>(size.x), (0.5f - ndc.y * 0.5f) * static_cast<float>(size.y), ndc.z * 0.5f + 0.5f};
+        }
+    }
+
+    OcclusionCuller::OcclusionCuller(JobSystem& jobs, const uint2 resolution)
+        : jobs(jobs)
+    {
+        // Rows of every level stay a multiple of four pixels wide, so SSE2 never needs a tail
+        constexpr uint32_t alignX = 4u << (HierarchyLevels - 1);
+        size = {(std::max(resolution.x, 1u) + alignX - 1) / alignX * alignX, (std::max(resolution.y, 1u) + BandHeight - 1) / BandHeight * BandHeight};
+        for (uint32_t level = 0; level < HierarchyLevels; level++)
+        {
+            levels[level].assign(size_t {size.x >> level} * (size.y >> level), 1.0f);
+        }
+    }
+
+    void OcclusionCuller::Begin(const glm::mat4& frameViewProjection)
+    {
+        viewProjection = frameViewProjection;
+        occluders.clear();
+    }
+
+    void OcclusionCuller::AddOccluder(const std::span<const float3> positions, const std::span<const uint32_t> indices, const glm::mat4& model)
+    {
+        const size_t firstTriangle = occluders.empty() ? 0 : occluders.back().firstTriangle + occluders.back().indices.size() / 3 * 2;
+        occluders.push_back({.positions = positions, .indices = indices, .modelViewProjection = viewProjection * model, .firstTriangle = firstTriangle});
+    }
+
+    void OcclusionCuller::Rasterize()
+    {
+        triangles.resize(occluders.empty() ? 0 : occluders.back().firstTriangle + occluders.back().indices.size() / 3 * 2);
+
+        jobs.ParallelFor(occluders.size(), 1, [this](const size_t begin, const size_t end, uint32_t)
+        {
+            for (size_t i = begin; i < end; i++)
+            {
+                Setup(occluders[i]);
+            }
+        });
+        triangleCount = static_cast<uint32_t>(std::ranges::count_if(triangles, [](const Triangle& triangle) { return triangle.valid; }));
+
+        // Bands share no pixels, neither in the depth buffer nor in any level of the hierarchy
+        jobs.ParallelFor(size.y / BandHeight, 1, [this](const size_t begin, const size_t end, uint32_t)
+        {
+            for (size_t band = begin; band < end; band++)
+            {
+                RasterizeBand(static_cast<uint32_t>(band));
+            }
+        });
+    }
+
+    bool OcclusionCuller::IsVisible(const float3& boundsMin, const float3& boundsMax) const
+    {
+        float2 lower(std::numeric_limits<float>::max());
+        float2 upper(std::numeric_limits<float>::lowest());
+        float nearest {1.0f};
+        for (uint32_t corner = 0; corner < 8; corner++)
+        {
+            const float3 position((corner & 1) ? boundsMax.x : boundsMin.x, (corner & 2) ? boundsMax.y : boundsMin.y, (corner & 4) ? boundsMax.z : boundsMin.z);
+            const float4 clip = viewProjection * float4(position, 1.0f);
+            if (!(clip.w > 0.0f) || clip.z < -clip.w)
+            {
+                return true;
+            }
+
+            const float3 screen = ToScreen(clip, size);
+            lower = glm::min(lower, float2(screen));
+            upper = glm::max(upper, float2(screen));
+            nearest = std::min(nearest, screen.z);
+        }
+
+        // Off screen is for frustum culling to decide
+        if (!(upper.x > 0.0f && upper.y > 0.0f && lower.x < static_cast<float>(size.x) && lower.y < static_cast<float>(size.y)))
+        {
+            return true;
+        }
+
+        // Every pixel the box's rectangle touches, in the coarsest level where that's at most 4x4 texels
+        const float2 limit = float2(size) - 1.0f;
+        const uint2 first(glm::clamp(glm::floor(lower), float2(0.0f), limit));
+        const uint2 last = glm::max(first, uint2(glm::clamp(glm::ceil(upper) - 1.0f, float2(0.0f), limit)));
+        uint32_t level {0};
+        while (level + 1 < HierarchyLevels && ((last.x >> level) - (first.x >> level) >= 4 || (last.y >> level) - (first.y >> level) >= 4))
+        {
+            level++;
+        }
+
+        const uint32_t width = size.x >> level;
+        const std::vector<float>& farthest = levels[level];
+        for (uint32_t y = first.y >> level; y <= last.y >> level; y++)
+        {
+            for (uint32_t x = first.x >> level; x <= last.x >> level; x++)
+            {
+                if (farthest[size_t {y} * width + x] >= nearest)
+                {
+                    return true;
+                }
+            }
+        }
+        return false;
+    }
+
+    void OcclusionCuller::Setup(const Occluder& occluder)
+    {
+        for (size_t index = 0; index + 2 < occluder.indices.size(); index += 3)
+        {
+            Triangle* slots = &triangles[occluder.firstTriangle + index / 3 * 2];
+            slots[0].valid = false;
+            slots[1].valid = false;
+
+            std::array<float4, 3> input {};
+            bool inRange {true};
+            for (size_t i = 0; i < 3; i++)
+            {
+                const uint32_t vertex = occluder.indices[index + i];
+                inRange = inRange && vertex < occluder.positions.size();
+                input[i] = inRange ? occluder.modelViewProjection * float4(occluder.positions[vertex], 1.0f) : float4(0.0f);
+            }
+            if (!inRange)
+            {
+                continue;
+            }
+
+            // Clipped against the near plane like SoftwareRasterizer clips, the other planes only limit the bounds
+            std::array<float4, 4> polygon {};
+            size_t count {0};
+            for (size_t i = 0; i < input.size(); i++)
+            {
+                const float4& current = input[i];
+                const float4& next = input[(i + 1) % input.size()];
+                const float currentDistance = current.z + current.w;
+                const float nextDistance = next.z + next.w;
+
+                if (currentDistance >= 0.0f)
+                {
+                    polygon[count++] = current;
+                }
+                if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+                {
+                    polygon[count++] = glm::mix(current, next, currentDistance / (currentDistance - nextDistance));
+                }
+            }
+
+            if (count >= 3)
+            {
+                SetupClipped(slots[0], std::span<const float4, 3>(polygon.data(), 3));
+            }
+            if (count == 4)
+            {
+                const std::array<float4, 3> second {polygon[0], polygon[2], polygon[3]};
+                SetupClipped(slots[1], second);
+            }
+        }
+    }
+
+    void OcclusionCuller::SetupClipped(Triangle& triangle, const std::span<const float4, 3> vertices) const
+    {
+        std::array<float2, 3> screen {};
+        std::array<float, 3> depth {};
+        for (size_t i = 0; i < 3; i++)
+        {
+            if (!(vertices[i].w > 0.0f))
+            {
+                return;
+            }
+
+            const float3 projected = ToScreen(vertices[i], size);
+            screen[i] = float2(projected);
+            depth[i] = projected.z;
+        }
+
+        // Occluders count from both sides, flipping one winding makes every edge function positive inside
+        std::array<size_t, 3> order {0, 1, 2};
+        float area = Cross(screen[0], screen[1], screen[2]);
+        if (area < 0.0f)
+        {
+            std::swap(order[1], order[2]);
+            area = -area;
+        }
+        if (!(area > 0.0f))
+        {
+            return;
+        }
+
+        for (size_t i = 0; i < 3; i++)
+        {
+            const float2 from = screen[order[(i + 1) % 3]];
+            const float2 to = screen[order[(i + 2) % 3]];
+            const float2 delta = to - from;
+            triangle.edges[i] = float3(-delta.y, delta.x, delta.y * from.x - delta.x * from.y) / area;
+            triangle.topLeft[i] = (delta.y == 0.0f && delta.x > 0.0f) || delta.y < 0.0f;
+        }
+        triangle.depth = triangle.edges[0] * depth[order[0]] + triangle.edges[1] * depth[order[1]] + triangle.edges[2] * depth[order[2]];
+
+        const float2 lower = glm::min(screen[0], glm::min(screen[1], screen[2]));
+        const float2 upper = glm::max(screen[0], glm::max(screen[1], screen[2]));
+        const float2 limit = float2(size) - 1.0f;
+        const float2 first = glm::clamp(glm::ceil(lower - 0.5f), float2(0.0f), limit);
+        const float2 last = glm::clamp(glm::floor(upper - 0.5f), float2(-1.0f), limit);
+        triangle.bounds = {static_cast<int32_t>(first.x), static_cast<int32_t>(first.y), static_cast<int32_t>(last.x), static_cast<int32_t>(last.y)};
+        triangle.valid = triangle.bounds.x <= triangle.bounds.z && triangle.bounds.y <= triangle.bounds.w;
+    }
+
+    void OcclusionCuller::RasterizeBand(const uint32_t band)
+    {
+        const uint32_t firstRow = band * BandHeight;
+        const uint32_t lastRow = firstRow + BandHeight - 1;
+        float* depthBuffer = levels[0].data();
+        std::fill(depthBuffer + size_t {firstRow} * size.x, depthBuffer + size_t {lastRow + 1} * size.x, 1.0f);
+
+        const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 one = _mm_set1_ps(1.0f);
+        const __m128 allSet = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+        for (const Triangle& triangle : triangles)
+        {
+            if (!triangle.valid || triangle.bounds.w < static_cast<int32_t>(firstRow) || triangle.bounds.y > static_cast<int32_t>(lastRow))
+            {
+                continue;
+            }
+
+            const uint32_t firstX = static_cast<uint32_t>(triangle.bounds.x) & ~3u;
+            const auto lastX = static_cast<uint32_t>(triangle.bounds.z);
+            const uint32_t firstY = std::max(static_cast<uint32_t>(triangle.bounds.y), firstRow);
+            const uint32_t lastY = std::min(static_cast<uint32_t>(triangle.bounds.w), lastRow);
+
+            __m128 edgeX[3];
+            __m128 onEdge[3];
+            for (size_t i = 0; i < 3; i++)
+            {
+                edgeX[i] = _mm_set1_ps(triangle.edges[i].x);
+                onEdge[i] = triangle.topLeft[i] ? allSet : zero;
+            }
+            const __m128 depthX = _mm_set1_ps(triangle.depth.x);
+
+            for (uint32_t y = firstY; y <= lastY; y++)
+            {
+                const float centerY = static_cast<float>(y) + 0.5f;
+                __m128 edgeRow[3];
+                for (size_t i = 0; i < 3; i++)
+                {
+                    edgeRow[i] = _mm_set1_ps(triangle.edges[i].y * centerY + triangle.edges[i].z);
+                }
+                const __m128 depthRow = _mm_set1_ps(triangle.depth.y * centerY + triangle.depth.z);
+
+                for (uint32_t x = firstX; x <= lastX; x += 4)
+                {
+                    const __m128 centerX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+
+                    __m128 inside = allSet;
+                    for (size_t i = 0; i < 3; i++)
+                    {
+                        const __m128 weight = _mm_add_ps(_mm_mul_ps(edgeX[i], centerX), edgeRow[i]);
+                        inside = _mm_and_ps(inside, _mm_or_ps(_mm_cmpgt_ps(weight, zero), _mm_and_ps(_mm_cmpeq_ps(weight, zero), onEdge[i])));
+                    }
+                    if (_mm_movemask_ps(inside) == 0)
+                    {
+                        continue;
+                    }
+
+                    float* pixels = depthBuffer + size_t {y} * size.x + x;
+                    const __m128 depth = _mm_max_ps(_mm_min_ps(_mm_add_ps(_mm_mul_ps(depthX, centerX), depthRow), one), zero);
+                    const __m128 current = _mm_loadu_ps(pixels);
+                    _mm_storeu_ps(pixels, _mm_or_ps(_mm_and_ps(inside, _mm_min_ps(current, depth)), _mm_andnot_ps(inside, current)));
+                }
+            }
+        }
+
+        // Farthest of every 2x2, a band of BandHeight rows ends in a single row of the last level
+        for (uint32_t level = 1; level < HierarchyLevels; level++)
+        {
+            const uint32_t width = size.x >> level;
+            const float* source = levels[level - 1].data();
+            float* destination = levels[level].data();
+            for (uint32_t y = firstRow >> level; y <= lastRow >> level; y++)
+            {
+                const float* top = source + size_t {y} * 2 * width * 2;
+                const float* bottom = top + size_t {width} * 2;
+                for (uint32_t x = 0; x < width; x += 4)
+                {
+                    const __m128 left = _mm_max_ps(_mm_loadu_ps(top + x * 2), _mm_loadu_ps(bottom + x * 2));
+                    const __m128 right = _mm_max_ps(_mm_loadu_ps(top + x * 2 + 4), _mm_loadu_ps(bottom + x * 2 + 4));
+                    const __m128 even = _mm_shuffle_ps(left, right, _MM_SHUFFLE(2, 0, 2, 0));
+                    const __m128 odd = _mm_shuffle_ps(left, right, _MM_SHUFFLE(3, 1, 3, 1));
+                    _mm_storeu_ps(destination + size_t {y} * width + x, _mm_max_ps(even, odd));
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,99 @@
+﻿#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/mat4x4.hpp>
+
+#include "Types.hpp"
+
+namespace blackbox
+{
+    class JobSystem;
+
+    /**
+     * Coarse software depth buffer of a few large occluders, to skip objects hidden behind them before they are
+     * submitted.
+     *
+     * Occluders are meshes that are solid wherever they have triangles, like walls, floors and buildings, or a
+     * simplified mesh lying entirely inside the one that is drawn. Rasterize draws their depth at a low
+     * resolution on the JobSystem, one band of BandHeight rows per job and four pixels at a time with SSE2, then
+     * reduces every band into a hierarchy holding the farthest depth of 2x2, 4x4 and 8x8 pixel blocks.
+     * IsVisible projects an object's box and compares its nearest depth against the coarsest level that covers
+     * the box with a few texels, so the test costs about the same for small and large objects.
+     *
+     * Occluders cover the pixels GL would draw for them, pixel centers with a top-left fill rule, so meshes
+     * sharing edges leave no cracks. Boxes crossing the near plane are always visible. Like any coarse buffer it
+     * samples occluders at pixel centers, so an object much smaller than a pixel just outside an occluder's
+     * silhouette can still be culled.
+     *
+     *   occlusion.Begin(projection * view);
+     *   occlusion.AddOccluder(wallPositions, wallIndices, wallTransform);
+     *   occlusion.Rasterize();
+     *   if (occlusion.IsVisible(boundsMin, boundsMax)) { ... }
+     */
+    class OcclusionCuller
+    {
+    public:
+        static constexpr uint32_t HierarchyLevels = 4;
+        static constexpr uint32_t BandHeight = 1u << (HierarchyLevels - 1); // Every band reduces to one row of the last level
+
+    private:
+        struct Occluder
+        {
+            std::span<const float3> positions {};
+            std::span<const uint32_t> indices {};
+            glm::mat4 modelViewProjection {1.0f};
+            size_t firstTriangle {0}; // Slot of its first triangle, two slots per triangle to hold the near plane's clips
+        };
+
+        // Screen-space planes: value = x * plane.x + y * plane.y + plane.z
+        struct Triangle
+        {
+            std::array<float3, 3> edges {}; // Positive inside
+            std::array<bool, 3> topLeft {}; // Pixels exactly on an edge only belong to top and left edges
+            float3 depth {};
+            int4 bounds {};                 // Covered pixels, min x, min y, max x, max y inclusive
+            bool valid {false};
+        };
+
+        JobSystem& jobs;
+        uint2 size {};
+        glm::mat4 viewProjection {1.0f};
+
+        std::vector<Occluder> occluders {};
+        std::vector<Triangle> triangles {};
+        std::array<std::vector<float>, HierarchyLevels> levels {}; // Level 0 is the depth buffer, the others the farthest depth of each 2x2 below
+        uint32_t triangleCount {0};
+
+    public:
+        // `resolution` is rounded up to whole bands and hierarchy blocks
+        explicit OcclusionCuller(JobSystem& jobs, uint2 resolution = {256u, 128u});
+
+        OcclusionCuller(const OcclusionCuller& other) = delete;
+        OcclusionCuller& operator=(const OcclusionCuller&) = delete;
+        OcclusionCuller(OcclusionCuller&& other) = delete;
+        OcclusionCuller& operator=(OcclusionCuller&& other) = delete;
+
+        // Starts a frame, dropping the occluders of the last one
+        void Begin(const glm::mat4& viewProjection);
+        // Triangle list in model space, both spans must stay alive until Rasterize returns
+        void AddOccluder(std::span<const float3> positions, std::span<const uint32_t> indices, const glm::mat4& model);
+        void Rasterize();
+
+        // False when the world-space box lies entirely behind the occluders, safe to call from any thread after Rasterize
+        [[nodiscard]] bool IsVisible(const float3& boundsMin, const float3& boundsMax) const;
+
+        [[nodiscard]] uint2 Size() const { return size; }
+        // Occluder triangles that covered at least one pixel in the last Rasterize
+        [[nodiscard]] uint32_t TriangleCount() const { return triangleCount; }
+        // Depth at every pixel, z / w * 0.5 + 0.5 like GL, first row at the top
+        [[nodiscard]] std::span<const float> Depth() const { return levels[0]; }
+
+    private:
+        void Setup(const Occluder& occluder);
+        void SetupClipped(Triangle& triangle, std::span<const float4, 3> vertices) const;
+        void RasterizeBand(uint32_t band);
+    };
+}
@@ -0,0 +1,211 @@
+﻿#include "ProgramCache.hpp"
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <filesystem>
+#include <fstream>
+#include <utility>
+#include <vector>
+#include <glad/glad.h>
+#include <spdlog/fmt/fmt.h>
+
+#include "Blackbox.hpp"
+#include "GLContext.hpp"
+#include "GLExtensions.hpp"
+
+namespace blackbox
+{
+    namespace
+    {
+        // ARB_get_program_binary / GL 4.1, not part of the 3.3 core headers
+        constexpr GLenum ProgramBinaryRetrievableHint = 0x8257;
+        constexpr GLenum ProgramBinaryLength = 0x8741;
+        constexpr GLenum NumProgramBinaryFormats = 0x87FE;
+        using GetProgramBinaryFunction = void (APIENTRYP)(GLuint program, GLsizei bufSize, GLsizei* length, GLenum* binaryFormat, void* binary);
+        using ProgramBinaryFunction = void (APIENTRYP)(GLuint program, GLenum binaryFormat, const void* binary, GLsizei length);
+        using ProgramParameteriFunction = void (APIENTRYP)(GLuint program, GLenum pname, GLint value);
+
+        GetProgramBinaryFunction GetProgramBinary {nullptr};
+        ProgramBinaryFunction ProgramBinary {nullptr};
+        ProgramParameteriFunction ProgramParameteri {nullptr};
+
+        constexpr std::array<char, 8> EntryMagic {'B', 'B', 'P', 'R', 'O', 'G', '0', '1'};
+
+        #pragma pack(push, 1)
+        struct EntryHeader
+        {
+            std::array<char, 8> magic {EntryMagic};
+            uint64_t key {0};
+            uint32_t format {0};
+            uint32_t size {0};
+            float buildMs {0.0f};
+        };
+        #pragma pack(pop)
+
+        // FNV-1a, stable across runs and platforms unlike std::hash
+        uint64_t Hash(const std::string_view text, uint64_t hash = 14695981039346656037ull)
+        {
+            for (const char c : text)
+            {
+                hash ^= static_cast<uint8_t>(c);
+                hash *= 1099511628211ull;
+            }
+            return hash;
+        }
+
+        std::string_view GLString(const GLenum name)
+        {
+            const auto* text = reinterpret_cast<const char*>(glGetString(name));
+            return text != nullptr ? text : "";
+        }
+
+        float MillisecondsSince(const std::chrono::steady_clock::time_point start)
+        {
+            return std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+    }
+
+    ProgramCache::ProgramCache(const GLContext& context, std::string directory)
+        : directory(std::move(directory))
+    {
+        driver = fmt::format("{}\n{}\n{}", GLString(GL_VENDOR), GLString(GL_RENDERER), GLString(GL_VERSION));
+
+        if (HasGLVersion(4, 1) || HasGLExtension("GL_ARB_get_program_binary"))
+        {
+            GetProgramBinary = reinterpret_cast<GetProgramBinaryFunction>(context.GetProcAddress("glGetProgramBinary"));
+            ProgramBinary = reinterpret_cast<ProgramBinaryFunction>(context.GetProcAddress("glProgramBinary"));
+            ProgramParameteri = reinterpret_cast<ProgramParameteriFunction>(context.GetProcAddress("glProgramParameteri"));
+        }
+
+        // Drivers may expose the entry points but no format to store programs in
+        GLint formats {0};
+        if (GetProgramBinary != nullptr && ProgramBinary != nullptr && ProgramParameteri != nullptr)
+        {
+            glGetIntegerv(NumProgramBinaryFormats, &formats);
+        }
+
+        supported = formats > 0;
+        if (!supported)
+        {
+            LogRenderer->Trace("Program binaries are not supported, shaders are always compiled from source");
+            return;
+        }
+
+        std::error_code error {};
+        std::filesystem::create_directories(this->directory, error);
+    }
+
+    uint64_t ProgramCache::Key(const std::string_view vertexSource, const std::string_view fragmentSource) const
+    {
+        // Separators keep moving text from one stage to the other from producing the same key
+        uint64_t hash = Hash(driver);
+        hash = Hash(std::string_view("\0", 1), hash);
+        hash = Hash(vertexSource, hash);
+        hash = Hash(std::string_view("\0", 1), hash);
+        return Hash(fragmentSource, hash);
+    }
+
+    uint32_t ProgramCache::Load(const uint64_t key)
+    {
+        if (!supported)
+        {
+            stats.misses++;
+            return 0;
+        }
+
+        const auto start = std::chrono::steady_clock::now();
+        const std::string path = EntryPath(key);
+
+        std::ifstream file(path, std::ios::binary);
+        EntryHeader header {};
+        if (!file.is_open() || !file.read(reinterpret_cast<char*>(&header), sizeof(header)) || header.magic != EntryMagic || header.key != key)
+        {
+            stats.misses++;
+            return 0;
+        }
+
+        std::vector<char> binary(header.size);
+        if (!file.read(binary.data(), static_cast<std::streamsize>(binary.size())))
+        {
+            stats.misses++;
+            return 0;
+        }
+
+        const uint32_t program = glCreateProgram();
+        ProgramBinary(program, header.format, binary.data(), static_cast<GLsizei>(binary.size()));
+
+        GLint linked {GL_FALSE};
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (linked != GL_TRUE)
+        {
+            LogRenderer->Warn("Driver rejected cached program {}, compiling from source", path);
+            glDeleteProgram(program);
+            file.close();
+
+            std::error_code error {};
+            std::filesystem::remove(path, error);
+            stats.rejected++;
+            stats.misses++;
+            return 0;
+        }
+
+        const float loadMs = MillisecondsSince(start);
+        stats.hits++;
+        stats.loadMs += loadMs;
+        stats.savedMs += std::max(header.buildMs - loadMs, 0.0f);
+        return program;
+    }
+
+    void ProgramCache::PrepareForStore(const uint32_t program) const
+    {
+        if (supported)
+        {
+            ProgramParameteri(program, ProgramBinaryRetrievableHint, GL_TRUE);
+        }
+    }
+
+    void ProgramCache::Store(const uint64_t key, const uint32_t program, const float buildMs)
+    {
+        stats.compileMs += buildMs;
+        if (!supported)
+        {
+            return;
+        }
+
+        GLint length {0};
+        glGetProgramiv(program, ProgramBinaryLength, &length);
+        if (length <= 0)
+        {
+            return;
+        }
+
+        std::vector<char> binary(static_cast<size_t>(length));
+        EntryHeader header {.key = key, .buildMs = buildMs};
+        GLsizei written {0};
+        GetProgramBinary(program, length, &written, &header.format, binary.data());
+        header.size = static_cast<uint32_t>(written);
+
+        // Written to a temporary first so a crash halfway never leaves a truncated entry behind
+        const std::string path = EntryPath(key);
+        const std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+            file.write(binary.data(), written);
+            if (!file)
+            {
+                LogRenderer->Warn("Could not write program cache entry {}", temporary);
+                return;
+            }
+        }
+
+        std::error_code error {};
+        std::filesystem::rename(temporary, path, error);
+    }
+
+    std::string ProgramCache::EntryPath(const uint64_t key) const
+    {
+        return fmt::format("{}/{:016x}.bin", directory, key);
+    }
+}
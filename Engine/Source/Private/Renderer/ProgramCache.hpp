@@ -0,0 +1,59 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace blackbox
+{
+    class GLContext;
+
+    // Totals since startup, compile time saved is the recorded build time of each cached program minus its load time
+    struct ProgramCacheStats
+    {
+        uint32_t hits {0};
+        uint32_t misses {0};
+        uint32_t rejected {0}; // Stored binaries the driver refused, usually after a driver update
+        float loadMs {0.0f};
+        float compileMs {0.0f};
+        float savedMs {0.0f};
+    };
+
+    /**
+     * Persists linked programs with glGetProgramBinary so later launches can skip compiling and linking.
+     *
+     * Entries are keyed by a hash of the final shader sources and the driver's vendor, renderer and version
+     * strings, so editing a shader or updating the driver simply misses. The driver may still reject a binary
+     * it wrote itself, Load then deletes the entry and the caller compiles from source as usual.
+     *
+     * Needs GL 4.1 or ARB_get_program_binary and at least one binary format, otherwise every lookup misses
+     * and nothing is written.
+     */
+    class ProgramCache
+    {
+        std::string directory {};
+        std::string driver {};
+        bool supported {false};
+        ProgramCacheStats stats {};
+
+    public:
+        ProgramCache(const GLContext& context, std::string directory);
+
+        [[nodiscard]] uint64_t Key(std::string_view vertexSource, std::string_view fragmentSource) const;
+
+        // Linked program for `key`, or 0 when there is no usable entry
+        [[nodiscard]] uint32_t Load(uint64_t key);
+
+        // Must be called before linking so the driver keeps the binary around
+        void PrepareForStore(uint32_t program) const;
+
+        // Write a freshly linked program, `buildMs` is what compiling and linking it took
+        void Store(uint64_t key, uint32_t program, float buildMs);
+
+        [[nodiscard]] bool IsSupported() const { return supported; }
+        [[nodiscard]] const ProgramCacheStats& Stats() const { return stats; }
+
+    private:
+        [[nodiscard]] std::string EntryPath(uint64_t key) const;
+    };
+}
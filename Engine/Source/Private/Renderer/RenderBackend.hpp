@@ -0,0 +1,77 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <glm/mat4x4.hpp>
+
+#include "ProgramCache.hpp"
+#include "RenderCommandBuffer.hpp"
+#include "RenderGraph.hpp"
+#include "RenderStats.hpp"
+#include "RenderTypes.hpp"
+#include "TextureAtlas.hpp"
+#include "UniformBlocks.hpp"
+
+namespace blackbox
+{
+    class LightClusters;
+    class SpriteBatch;
+
+    struct FrameData
+    {
+        glm::mat4 view {1.0f};
+        glm::mat4 projection {1.0f};
+        float time {0.0f};
+        float deltaTime {0.0f};
+        float3 ambientLight {1.0f};
+        const LightClusters* lights {nullptr}; // Built for this frame's camera before Execute
+    };
+
+    /**
+     * What the Renderer draws through. Owns the resources behind the handles and executes sorted command buffers.
+     *
+     * GLBackend draws with OpenGL, SoftwareBackend on the CPU for machines without a GPU. Shaders are handed over
+     * as preprocessed GLSL, backends that can't run GLSL implement the shaders in Content themselves.
+     */
+    class RenderBackend
+    {
+    public:
+        virtual ~RenderBackend() = default;
+
+        // Returns an invalid handle and logs the compiler output when the program doesn't build
+        virtual ShaderHandle CreateShader(std::string_view vertexSource, std::string_view fragmentSource) = 0;
+        // May build in the background, materials using it draw with `fallback`, a shader from CreateShader, meanwhile
+        virtual ShaderHandle CreateShaderVariant(std::string vertexSource, std::string fragmentSource, ShaderHandle fallback) = 0;
+        // `sourcePath` is where `rgba` was loaded from, backends may load it again to stream mips
+        virtual TextureHandle CreateTexture(std::span<const uint8_t> rgba, uint2 size, const std::string& sourcePath = {}) = 0;
+        virtual MeshHandle CreateMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices = {}) = 0;
+        virtual MaterialHandle CreateMaterial(ShaderHandle shader, std::span<const TextureHandle> textures, const MaterialBlock& parameters = {}) = 0;
+
+        // Texture of a RenderGraph target and a framebuffer drawing into it, pooled by the TransientTargetPool.
+        // Returns an empty TargetTexture and logs when the target can't be created.
+        virtual TargetTexture CreateTarget(const TargetDesc& desc) = 0;
+        virtual void DestroyTarget(const TargetTexture& target) = 0;
+
+        [[nodiscard]] virtual ShaderHandle MaterialShader(MaterialHandle material) const = 0;
+        [[nodiscard]] virtual bool IsShaderReady(ShaderHandle shader) const = 0;
+
+        // Bind and clear the frame's target, resets the stats. `framebuffer` is a GL framebuffer object, 0 for the
+        // default one, other backends render into a target of their own.
+        virtual void BeginFrame(uint32_t framebuffer, uint2 size, const float4& clearColor) = 0;
+        // Draw a sorted command buffer into the target of the current frame
+        virtual void Execute(const RenderCommandBuffer& commands, const FrameData& frame) = 0;
+        // Draw sorted sprites over everything executed so far, blended and without depth testing. `shader` is
+        // sprite.vert/sprite.frag, backends that can't run GLSL draw the quads their own way.
+        virtual void DrawSprites(const SpriteBatch& sprites, ShaderHandle shader) = 0;
+        virtual void EndFrame() = 0;
+
+        [[nodiscard]] virtual const RenderStats& Stats() const = 0;
+        [[nodiscard]] virtual ProgramCacheStats ProgramStats() const { return {}; }
+        [[nodiscard]] virtual AtlasStats TextureStats() const { return {}; }
+
+        // Limit for all texture memory, for backends that stream textures
+        virtual void SetTextureBudget(size_t) {}
+    };
+}
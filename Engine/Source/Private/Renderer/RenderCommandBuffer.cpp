@@ -0,0 +1,99 @@
+﻿#include "RenderCommandBuffer.hpp"
+
+#include <algorithm>
+#include <array>
+
+namespace blackbox
+{
+    void CommandBucket::Submit(const uint64_t key, const DrawPacket& packet)
+    {
+        entries.push_back({.key = key, .bucket = index, .packet = static_cast<uint32_t>(packets.size())});
+        packets.push_back(packet);
+    }
+
+    RenderCommandBuffer::RenderCommandBuffer(const size_t bucketCount)
+        : buckets(std::max<size_t>(bucketCount, 1))
+    {
+        for (size_t i = 0; i < buckets.size(); i++)
+        {
+            buckets[i].index = static_cast<uint32_t>(i);
+        }
+    }
+
+    void RenderCommandBuffer::Sort()
+    {
+        entries.clear();
+        for (const CommandBucket& bucket : buckets)
+        {
+            entries.insert(entries.end(), bucket.entries.begin(), bucket.entries.end());
+        }
+
+        RadixSort(entries, scratch);
+    }
+
+    void RenderCommandBuffer::Clear()
+    {
+        // Keeps the capacity, a frame usually submits about as much as the one before it
+        for (CommandBucket& bucket : buckets)
+        {
+            bucket.packets.clear();
+            bucket.entries.clear();
+        }
+        entries.clear();
+    }
+
+    void RadixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch)
+    {
+        constexpr size_t passes = sizeof(uint64_t);
+        const size_t count = entries.size();
+        if (count < 2)
+        {
+            return;
+        }
+        scratch.resize(count);
+
+        // All histograms in a single read over the keys
+        std::array<std::array<uint32_t, 256>, passes> histograms {};
+        for (const SortEntry& entry : entries)
+        {
+            for (size_t pass = 0; pass < passes; pass++)
+            {
+                histograms[pass][(entry.key >> (pass * 8)) & 0xFF]++;
+            }
+        }
+
+        SortEntry* source = entries.data();
+        SortEntry* target = scratch.data();
+        for (size_t pass = 0; pass < passes; pass++)
+        {
+            auto& histogram = histograms[pass];
+
+            // A byte that is the same for every key doesn't change the order, which skips most passes since
+            // frames only use a handful of passes, shaders and materials
+            if (histogram[(source[0].key >> (pass * 8)) & 0xFF] == count)
+            {
+                continue;
+            }
+
+            uint32_t offset {0};
+            for (uint32_t& bucket : histogram)
+            {
+                const uint32_t size = bucket;
+                bucket = offset;
+                offset += size;
+            }
+
+            for (size_t i = 0; i < count; i++)
+            {
+                target[histogram[(source[i].key >> (pass * 8)) & 0xFF]++] = source[i];
+            }
+
+            std::swap(source, target);
+        }
+
+        if (source != entries.data())
+        {
+            entries.swap(scratch);
+        }
+    }
+}
@@ -0,0 +1,75 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+#include <glm/mat4x4.hpp>
+
+#include "RenderTypes.hpp"
+
+namespace blackbox
+{
+    struct DrawPacket
+    {
+        MeshHandle mesh {};
+        MaterialHandle material {};
+        glm::mat4 model {1.0f};
+    };
+
+    struct SortEntry
+    {
+        uint64_t key {0};
+        uint32_t bucket {0}; // Bucket that recorded the packet
+        uint32_t packet {0}; // Index into that bucket's packets
+    };
+
+    /**
+     * Linear list of draws recorded by a single thread. Buckets are only written by their owner while recording
+     * and only read after recording finished, so they need no locks.
+     */
+    class alignas(64) CommandBucket
+    {
+        std::vector<DrawPacket> packets {};
+        std::vector<SortEntry> entries {};
+        uint32_t index {0};
+
+        friend class RenderCommandBuffer;
+
+    public:
+        void Submit(uint64_t key, const DrawPacket& packet);
+
+        [[nodiscard]] size_t Size() const { return entries.size(); }
+    };
+
+    /**
+     * Draw packets for one frame, recorded into one bucket per worker thread. Sort merges the keys of all buckets
+     * and sorts only those, so sorting moves 16 bytes per draw instead of the whole packet.
+     */
+    class RenderCommandBuffer
+    {
+        std::vector<CommandBucket> buckets {};
+        std::vector<SortEntry> entries {};
+        std::vector<SortEntry> scratch {};
+
+    public:
+        explicit RenderCommandBuffer(size_t bucketCount = 1);
+
+        // Bucket 0 belongs to the thread that owns the renderer, worker threads use their JobSystem worker index
+        [[nodiscard]] CommandBucket& Bucket(const size_t index) { return buckets[index]; }
+        [[nodiscard]] size_t BucketCount() const { return buckets.size(); }
+
+        void Submit(const uint64_t key, const DrawPacket& packet) { buckets[0].Submit(key, packet); }
+
+        // Merge all buckets and LSD radix sort the keys, stable so equal keys keep submission order.
+        // Must not overlap with recording.
+        void Sort();
+        void Clear();
+
+        [[nodiscard]] size_t Size() const { return entries.size(); }
+        [[nodiscard]] std::span<const SortEntry> Entries() const { return entries; }
+        [[nodiscard]] const DrawPacket& Packet(const SortEntry& entry) const { return buckets[entry.bucket].packets[entry.packet]; }
+    };
+
+    // Sorts `entries` by key using `scratch` as the second buffer, both end up the same size
+    void RadixSort(std::vector<SortEntry>& entries, std::vector<SortEntry>& scratch);
+}
@@ -0,0 +1,331 @@
+﻿#include "RenderGraph.hpp"
+
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <utility>
+
+#include "Blackbox.hpp"
+#include "TransientTargetPool.hpp"
+
+namespace blackbox
+{
+    size_t TargetDesc::Bytes() const
+    {
+        size_t bytesPerPixel {4};
+        switch (format)
+        {
+        case TargetFormat::RGBA16F:
+            bytesPerPixel = 8;
+            break;
+        case TargetFormat::R8:
+            bytesPerPixel = 1;
+            break;
+        case TargetFormat::R16F:
+            bytesPerPixel = 2;
+            break;
+        default:
+            break;
+        }
+        return size_t {size.x} * size.y * bytesPerPixel;
+    }
+
+    TargetHandle RenderGraph::PassBuilder::Create(const std::string_view name, const TargetDesc& desc)
+    {
+        graph.targets.push_back({.name = name, .desc = desc});
+        const TargetHandle target {static_cast<uint32_t>(graph.targets.size())};
+        Write(target);
+        return target;
+    }
+
+    RenderGraph::PassBuilder& RenderGraph::PassBuilder::Read(const TargetHandle target)
+    {
+        graph.passes[pass].reads.push_back(target.Index());
+        return *this;
+    }
+
+    RenderGraph::PassBuilder& RenderGraph::PassBuilder::Write(const TargetHandle target)
+    {
+        graph.passes[pass].writes.push_back(target.Index());
+        return *this;
+    }
+
+    RenderGraph::PassBuilder& RenderGraph::PassBuilder::SideEffect()
+    {
+        graph.passes[pass].sideEffect = true;
+        return *this;
+    }
+
+    void RenderGraph::Reset()
+    {
+        passCount = 0;
+        targets.clear();
+        order.clear();
+        physicalTargets.clear();
+        stats = {};
+    }
+
+    TargetHandle RenderGraph::Import(const std::string_view name, const TargetDesc& desc, const TargetTexture& texture)
+    {
+        targets.push_back({.name = name, .desc = desc, .texture = texture, .imported = true});
+        return {static_cast<uint32_t>(targets.size())};
+    }
+
+    RenderGraph::PassBuilder RenderGraph::AddPass(const std::string_view name, PassFunction execute)
+    {
+        if (passCount == passes.size())
+        {
+            passes.emplace_back();
+        }
+
+        Pass& pass = passes[passCount];
+        pass.name = name;
+        pass.execute = std::move(execute);
+        pass.reads.clear();
+        pass.writes.clear();
+        pass.sideEffect = false;
+        pass.live = false;
+        return {*this, static_cast<uint32_t>(passCount++)};
+    }
+
+    bool RenderGraph::Compile()
+    {
+        Cull();
+        if (!Sort())
+        {
+            order.clear();
+            return false;
+        }
+        AssignPhysicalTargets();
+
+        stats.passes = static_cast<uint32_t>(passCount);
+        stats.culledPasses = static_cast<uint32_t>(passCount - order.size());
+        stats.physicalTargets = static_cast<uint32_t>(physicalTargets.size());
+        std::vector<size_t> liveBytes(order.size(), 0);
+        for (const Target& target : targets)
+        {
+            if (!target.imported && target.firstUse != Unused)
+            {
+                stats.transientTargets++;
+                stats.transientBytes += target.desc.Bytes();
+                for (uint32_t position = target.firstUse; position <= target.lastUse; position++)
+                {
+                    liveBytes[position] += target.desc.Bytes();
+                }
+            }
+        }
+        stats.liveBytes = liveBytes.empty() ? 0 : std::ranges::max(liveBytes);
+        for (const PhysicalTarget& physical : physicalTargets)
+        {
+            stats.aliasedBytes += physical.desc.Bytes();
+        }
+        return true;
+    }
+
+    void RenderGraph::Execute(TransientTargetPool& pool)
+    {
+        // Physical targets of the same description take the pool's textures of it in order, so a graph that
+        // doesn't change gets the same textures every frame
+        for (size_t index = 0; index < physicalTargets.size(); index++)
+        {
+            PhysicalTarget& physical = physicalTargets[index];
+            const auto instance = static_cast<uint32_t>(std::count_if(physicalTargets.begin(), physicalTargets.begin() + static_cast<std::ptrdiff_t>(index),
+                [&](const PhysicalTarget& other) { return other.desc == physical.desc; }));
+            physical.texture = pool.Acquire(physical.desc, instance);
+        }
+        stats.pooledTextures = static_cast<uint32_t>(pool.Size());
+        stats.pooledBytes = pool.Bytes();
+
+        for (const uint32_t pass : order)
+        {
+            if (passes[pass].execute)
+            {
+                passes[pass].execute();
+            }
+        }
+    }
+
+    TargetTexture RenderGraph::Texture(const TargetHandle target) const
+    {
+        const Target& entry = targets[target.Index()];
+        if (entry.imported)
+        {
+            return entry.texture;
+        }
+        return entry.physical != NoPhysicalTarget ? physicalTargets[entry.physical].texture : TargetTexture {};
+    }
+
+    std::vector<std::string_view> RenderGraph::ExecutionOrder() const
+    {
+        std::vector<std::string_view> names {};
+        names.reserve(order.size());
+        for (const uint32_t pass : order)
+        {
+            names.push_back(passes[pass].name);
+        }
+        return names;
+    }
+
+    void RenderGraph::Cull()
+    {
+        // Passes whose results leave the graph run, and with them every pass writing a target they read
+        std::vector<uint32_t> pending {};
+        for (uint32_t pass = 0; pass < passCount; pass++)
+        {
+            passes[pass].live = passes[pass].sideEffect
+                || std::ranges::any_of(passes[pass].writes, [this](const uint32_t target) { return targets[target].imported; });
+            if (passes[pass].live)
+            {
+                pending.push_back(pass);
+            }
+        }
+
+        while (!pending.empty())
+        {
+            const uint32_t pass = pending.back();
+            pending.pop_back();
+            for (const uint32_t target : passes[pass].reads)
+            {
+                // A pass drawing over a target only sees the writers added before it
+                const bool drawsOver = std::ranges::find(passes[pass].writes, target) != passes[pass].writes.end();
+                for (uint32_t writer = 0; writer < (drawsOver ? pass : passCount); writer++)
+                {
+                    if (!passes[writer].live && std::ranges::find(passes[writer].writes, target) != passes[writer].writes.end())
+                    {
+                        passes[writer].live = true;
+                        pending.push_back(writer);
+                    }
+                }
+            }
+        }
+    }
+
+    bool RenderGraph::Sort()
+    {
+        // Writers of a target run one after another in the order they were added, its readers after the last one
+        std::vector<uint32_t> lastWriter(targets.size(), Unused);
+        std::vector<std::vector<uint32_t>> dependents(passCount);
+        std::vector<uint32_t> dependencies(passCount, 0);
+        auto depend = [&](const uint32_t pass, const uint32_t on)
+        {
+            if (on != Unused && on != pass)
+            {
+                dependents[on].push_back(pass);
+                dependencies[pass]++;
+            }
+        };
+
+        for (uint32_t pass = 0; pass < passCount; pass++)
+        {
+            if (!passes[pass].live)
+            {
+                continue;
+            }
+            for (const uint32_t target : passes[pass].writes)
+            {
+                depend(pass, lastWriter[target]);
+                lastWriter[target] = pass;
+            }
+        }
+        for (uint32_t pass = 0; pass < passCount; pass++)
+        {
+            if (!passes[pass].live)
+            {
+                continue;
+            }
+            for (const uint32_t target : passes[pass].reads)
+            {
+                if (std::ranges::find(passes[pass].writes, target) == passes[pass].writes.end())
+                {
+                    depend(pass, lastWriter[target]);
+                }
+            }
+        }
+
+        // Of the passes that are ready, the one added first runs next
+        std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<>> ready {};
+        for (uint32_t pass = 0; pass < passCount; pass++)
+        {
+            if (passes[pass].live && dependencies[pass] == 0)
+            {
+                ready.push(pass);
+            }
+        }
+
+        const size_t liveCount = std::ranges::count_if(passes.begin(), passes.begin() + static_cast<std::ptrdiff_t>(passCount), &Pass::live);
+        order.clear();
+        while (!ready.empty())
+        {
+            const uint32_t pass = ready.top();
+            ready.pop();
+            order.push_back(pass);
+            for (const uint32_t dependent : dependents[pass])
+            {
+                if (--dependencies[dependent] == 0)
+                {
+                    ready.push(dependent);
+                }
+            }
+        }
+
+        if (order.size() != liveCount)
+        {
+            const auto stuck = std::ranges::find_if(passes.begin(), passes.begin() + static_cast<std::ptrdiff_t>(passCount),
+                [&](const Pass& pass) { return pass.live && dependencies[&pass - passes.data()] > 0; });
+            LogRenderer->Error("Render graph has a cycle through pass \"{}\", nothing is rendered", stuck->name);
+            return false;
+        }
+        return true;
+    }
+
+    void RenderGraph::AssignPhysicalTargets()
+    {
+        for (uint32_t position = 0; position < order.size(); position++)
+        {
+            const Pass& pass = passes[order[position]];
+            for (const std::vector<uint32_t>* uses : {&pass.reads, &pass.writes})
+            {
+                for (const uint32_t index : *uses)
+                {
+                    Target& target = targets[index];
+                    if (target.firstUse == Unused)
+                    {
+                        target.firstUse = position;
+                    }
+                    target.lastUse = position;
+                }
+            }
+        }
+
+        // Placing targets by their first use fills every texture as tightly as intervals allow
+        std::vector<uint32_t> transients {};
+        for (uint32_t index = 0; index < targets.size(); index++)
+        {
+            if (!targets[index].imported && targets[index].firstUse != Unused)
+            {
+                transients.push_back(index);
+            }
+        }
+        std::ranges::stable_sort(transients, {}, [this](const uint32_t index) { return targets[index].firstUse; });
+
+        for (const uint32_t index : transients)
+        {
+            Target& target = targets[index];
+            const auto free = std::ranges::find_if(physicalTargets, [&](const PhysicalTarget& physical)
+            {
+                return physical.desc == target.desc && physical.freeAfter < target.firstUse;
+            });
+
+            if (free != physicalTargets.end())
+            {
+                target.physical = static_cast<uint32_t>(free - physicalTargets.begin());
+                free->freeAfter = target.lastUse;
+            }
+            else
+            {
+                target.physical = static_cast<uint32_t>(physicalTargets.size());
+                physicalTargets.push_back({.desc = target.desc, .freeAfter = target.lastUse});
+            }
+        }
+    }
+}
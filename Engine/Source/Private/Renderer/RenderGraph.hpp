@@ -0,0 +1,173 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "RenderStats.hpp"
+#include "RenderTypes.hpp"
+
+namespace blackbox
+{
+    enum class TargetFormat : uint8_t
+    {
+        RGBA8,
+        RGBA16F,
+        R11G11B10F,
+        RG16F,
+        R8,
+        R16F,
+        R32F,
+        Depth24Stencil8,
+        Depth32F,
+    };
+
+    struct TargetDesc
+    {
+        uint2 size {};
+        TargetFormat format {TargetFormat::RGBA8};
+
+        [[nodiscard]] size_t Bytes() const;
+        bool operator==(const TargetDesc&) const = default;
+    };
+
+    // The backend's texture behind a target and a framebuffer drawing into it, 0 where there is none
+    struct TargetTexture
+    {
+        uint32_t texture {0};
+        uint32_t framebuffer {0};
+    };
+
+    // Index + 1 into the RenderGraph's targets, only valid until the graph is reset
+    using TargetHandle = RenderHandle<struct TargetTag>;
+
+    class TransientTargetPool;
+
+    /**
+     * The passes of a frame and the render targets they pass between each other, rebuilt every frame.
+     *
+     * Passes declare which targets they read and write and are added in any order. Compile drops every pass
+     * whose output nothing uses, sorts the rest so writers run before readers, keeping the order they were
+     * added in where it doesn't matter, and finds the first and last pass using every target. Transient
+     * targets, the ones created by a pass, only have to exist during that range, so targets that are never
+     * alive at the same time share one texture. GL 3.3 can't place different textures in the same memory,
+     * so only targets of the same size and format share, which is the common case for the ping-pong buffers
+     * of post-processing. Imported targets like the backbuffer live outside the graph and are never shared.
+     * Execute takes the shared textures from a TransientTargetPool, passes look theirs up with Texture.
+     *
+     * A pass reads what every pass writing the target produced, writers run in the order they were added.
+     * Passes that write an imported target or have a side effect always run.
+     *
+     *   const TargetHandle backbuffer = graph.Import("Backbuffer", {size, TargetFormat::RGBA8});
+     *   RenderGraph::PassBuilder scene = graph.AddPass("Scene", [&] { ... });
+     *   const TargetHandle color = scene.Create("SceneColor", {size, TargetFormat::RGBA16F});
+     *   graph.AddPass("Tonemap", [&] { ... graph.Texture(color).texture ... }).Read(color).Write(backbuffer);
+     *   if (graph.Compile()) { graph.Execute(pool); }
+     *
+     * Names are kept as views, they must outlive the graph, string literals do.
+     */
+    class RenderGraph
+    {
+    public:
+        using PassFunction = std::function<void()>;
+
+        class PassBuilder
+        {
+            RenderGraph& graph;
+            uint32_t pass {0};
+
+        public:
+            PassBuilder(RenderGraph& graph, const uint32_t pass) : graph(graph), pass(pass) {}
+
+            // New transient target, written by this pass
+            TargetHandle Create(std::string_view name, const TargetDesc& desc);
+            PassBuilder& Read(TargetHandle target);
+            // Passes drawing over what a target already holds read it as well
+            PassBuilder& Write(TargetHandle target);
+            // Runs even when nothing reads what it writes, like a readback or a capture
+            PassBuilder& SideEffect();
+        };
+
+        // Textures without one aren't shared, imported targets and targets of culled passes
+        static constexpr uint32_t NoPhysicalTarget = UINT32_MAX;
+
+        // A texture shared by transient targets whose lifetimes don't overlap
+        struct PhysicalTarget
+        {
+            TargetDesc desc {};
+            uint32_t freeAfter {0}; // Last use of the last target placed in it
+            TargetTexture texture {}; // From the pool, set by Execute
+        };
+
+    private:
+        static constexpr uint32_t Unused = UINT32_MAX;
+
+        struct Pass
+        {
+            std::string_view name {};
+            PassFunction execute {};
+            std::vector<uint32_t> reads {};
+            std::vector<uint32_t> writes {};
+            bool sideEffect {false};
+            bool live {false};
+        };
+
+        struct Target
+        {
+            std::string_view name {};
+            TargetDesc desc {};
+            TargetTexture texture {}; // Imported targets only, transient ones use their physical target's
+            bool imported {false};
+            uint32_t firstUse {Unused}; // Positions in the compiled order
+            uint32_t lastUse {Unused};
+            uint32_t physical {NoPhysicalTarget};
+        };
+
+        std::vector<Pass> passes {};
+        std::vector<Target> targets {};
+        std::vector<uint32_t> order {}; // Live passes in execution order
+        std::vector<PhysicalTarget> physicalTargets {};
+        RenderGraphStats stats {};
+        size_t passCount {0}; // Passes are reused between frames to keep their read and write lists
+
+    public:
+        RenderGraph() = default;
+
+        RenderGraph(const RenderGraph& other) = delete;
+        RenderGraph& operator=(const RenderGraph&) = delete;
+        RenderGraph(RenderGraph&& other) = delete;
+        RenderGraph& operator=(RenderGraph&& other) = delete;
+
+        // Drops all passes and targets, keeps the memory for the next frame's
+        void Reset();
+
+        TargetHandle Import(std::string_view name, const TargetDesc& desc, const TargetTexture& texture = {});
+        PassBuilder AddPass(std::string_view name, PassFunction execute);
+
+        // Culls, orders and assigns physical targets, false with an error logged when the passes form a cycle
+        bool Compile();
+        // Takes a texture from `pool` for every physical target and runs the live passes in order, after a
+        // successful Compile
+        void Execute(TransientTargetPool& pool);
+
+        // Pass names in execution order
+        [[nodiscard]] std::vector<std::string_view> ExecutionOrder() const;
+        [[nodiscard]] const TargetDesc& Desc(const TargetHandle target) const { return targets[target.Index()].desc; }
+        // What a pass binds or draws into, valid while Execute runs. Empty for targets of culled passes.
+        [[nodiscard]] TargetTexture Texture(TargetHandle target) const;
+        // The texture a transient target shares with the others assigned to it
+        [[nodiscard]] uint32_t PhysicalTargetOf(const TargetHandle target) const { return targets[target.Index()].physical; }
+        // Positions in the execution order of the first and last pass using the target
+        [[nodiscard]] uint2 Lifetime(const TargetHandle target) const { return {targets[target.Index()].firstUse, targets[target.Index()].lastUse}; }
+        [[nodiscard]] std::span<const PhysicalTarget> PhysicalTargets() const { return physicalTargets; }
+        [[nodiscard]] const RenderGraphStats& Stats() const { return stats; }
+
+    private:
+        void Cull();
+        bool Sort();
+        void AssignPhysicalTargets();
+    };
+}
@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "GLStateCache.hpp"
+
+namespace blackbox
+{
+    // Counted per frame, reset when the renderer begins a frame
+    struct RenderStats
+    {
+        uint32_t packets {0};
+        uint32_t drawCalls {0}; // Lower than packets when packets were merged into instanced draws
+        GLStateCounters glState {};
+
+        // Dynamic data uploaded through GPURingBuffers, stalls mean the CPU had to wait for the GPU
+        size_t streamingBytes {0};
+        uint32_t streamingStalls {0};
+        float streamingStallMs {0.0f};
+
+        uint32_t shadersBuilding {0}; // Variants still compiling in the background, drawn with their fallback meanwhile
+
+        size_t textureBytes {0};      // Resident texture memory at the end of the frame
+        uint32_t textureRequests {0}; // Mip loads the TextureStreamer started this frame
+        uint32_t texturesLoading {0}; // Mip loads still in flight
+
+        uint32_t invalidPackets {0}; // Packets the NullBackend rejected while validating, skipped instead of drawn
+
+        uint32_t sprites {0};
+        uint32_t spriteDrawCalls {0}; // Included in drawCalls
+
+        uint32_t lights {0};           // Point lights sorted into LightClusters
+        uint32_t lightAssignments {0}; // Entries in all clusters' light lists
+    };
+
+    // Counted when the Renderer compiles the frame's RenderGraph
+    struct RenderGraphStats
+    {
+        uint32_t passes {0};
+        uint32_t culledPasses {0};     // Nothing used what they write
+        uint32_t transientTargets {0}; // Used by the passes that run
+        uint32_t physicalTargets {0};  // Textures the transient targets share
+        size_t transientBytes {0};     // With a texture for every transient target
+        size_t aliasedBytes {0};       // With the shared textures
+        size_t liveBytes {0};          // Most transient target memory alive during one pass, the least aliasing can get to
+        uint32_t pooledTextures {0};   // Held by the TransientTargetPool, including ones kept for later frames
+        size_t pooledBytes {0};
+    };
+
+    // Counted per frame by scenes that cull before submitting, see DemoScene
+    struct CullingStats
+    {
+        uint32_t objects {0};
+        uint32_t outsideFrustum {0};
+        uint32_t occluded {0};          // Inside the frustum but hidden behind occluders
+        uint32_t occluderTriangles {0}; // Rasterized into the OcclusionCuller
+        float occlusionMs {0.0f};       // Rasterizing the occluders on the JobSystem
+    };
+}
@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include <compare>
+#include <cstdint>
+
+#include "Types.hpp"
+
+namespace blackbox
+{
+    // Index + 1 into the backend's resource list, 0 is never a valid resource
+    template <typename Tag>
+    struct RenderHandle
+    {
+        uint32_t id {0};
+
+        [[nodiscard]] bool IsValid() const { return id != 0; }
+        [[nodiscard]] uint32_t Index() const { return id - 1; }
+        auto operator<=>(const RenderHandle&) const = default;
+    };
+
+    using ShaderHandle = RenderHandle<struct ShaderTag>;
+    using TextureHandle = RenderHandle<struct TextureTag>;
+    using MeshHandle = RenderHandle<struct MeshTag>;
+    using MaterialHandle = RenderHandle<struct MaterialTag>;
+
+    // Matches the attribute locations in basic.vert
+    struct Vertex
+    {
+        float3 position {};
+        float2 texCoord {};
+    };
+
+    // Submitted every frame through Renderer::SubmitLight, lights materials built with CLUSTERED_LIGHTING
+    struct PointLight
+    {
+        float3 position {};
+        float radius {1.0f}; // Falls off to nothing here
+        float3 color {1.0f};
+        float intensity {1.0f};
+    };
+
+    // Screen-space textured quad submitted through Renderer::SubmitSprite, drawn over the scene
+    struct Sprite
+    {
+        float2 position {};                     // Center in pixels from the top left of the viewport
+        float2 size {1.0f};                     // In pixels
+        float rotation {0.0f};                  // Radians, clockwise on screen
+        float4 uvRect {0.0f, 0.0f, 1.0f, 1.0f}; // Offset and scale within the texture, for sprite sheets
+        float4 color {1.0f};                    // Multiplies the texture
+        TextureHandle texture {};
+        int16_t layer {0};                      // Higher layers draw over lower ones
+    };
+
+    enum class RenderPass : uint8_t
+    {
+        Opaque,      // Front to back
+        Transparent, // Back to front, blended
+        Overlay,     // Drawn last without depth testing
+    };
+}
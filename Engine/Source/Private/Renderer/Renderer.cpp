@@ -0,0 +1,261 @@
+﻿#include "Renderer.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <sstream>
+#include <utility>
+
+#define STB_IMAGE_IMPLEMENTATION
+#include <stb/stb_image.h>
+
+#include "Blackbox.hpp"
+#include "EventBus.hpp"
+#include "FileIO.hpp"
+#include "GLBackend.hpp"
+#include "GLContext.hpp"
+#include "Jobs/JobSystem.hpp"
+#include "SoftwareBackend.hpp"
+#include "SoftwareFramebuffer.hpp"
+#include "SortKey.hpp"
+
+namespace blackbox
+{
+    namespace
+    {
+        constexpr auto ShaderVariantManifest = "Content/Config/ShaderVariants.ini";
+
+        std::string VariantKey(const std::string& vertexPath, const std::string& fragmentPath, const std::vector<std::string>& defines)
+        {
+            std::string key = vertexPath + "|" + fragmentPath;
+            for (const std::string& define : defines)
+            {
+                key += "|" + define;
+            }
+            return key;
+        }
+    }
+
+    void RenderRecorder::Submit(const MeshHandle mesh, const MaterialHandle material, const glm::mat4& model, const RenderPass pass)
+    {
+        if (mesh.IsValid() && material.IsValid())
+        {
+            bucket.Submit(renderer.MakeKey(mesh, material, model, pass), {.mesh = mesh, .material = material, .model = model});
+        }
+    }
+
+    Renderer::Renderer(EventBus& eventbus, FileIO& fileIO, JobSystem& jobs, GLContext& context)
+        : Renderer(eventbus, fileIO, jobs, std::make_unique<GLBackend>(context, fileIO), context.FramebufferSize())
+    {
+        this->context = &context;
+    }
+
+    Renderer::Renderer(EventBus& eventbus, FileIO& fileIO, JobSystem& jobs, SoftwareFramebuffer& target)
+        : Renderer(eventbus, fileIO, jobs, std::make_unique<SoftwareBackend>(target, jobs), target.Size())
+    {
+    }
+
+    Renderer::Renderer(EventBus& eventbus, FileIO& fileIO, JobSystem& jobs, std::unique_ptr<RenderBackend> backend, const uint2 viewportSize)
+        : eventbus(eventbus)
+        , fileIO(fileIO)
+        , preprocessor(fileIO)
+        , backend(std::move(backend))
+        , commands(jobs.WorkerCount())
+        , lights(jobs)
+        , transientTargets(*this->backend)
+        , viewportSize(viewportSize)
+    {
+        frame.lights = &lights;
+
+        eventbus.Subscribe<ViewportResizedEvent>(this, &Renderer::OnViewportResized);
+        eventbus.Subscribe<TickEvent>(this, &Renderer::OnTick);
+
+        // Textures are authored top row first, the backends expect the bottom row first
+        stbi_set_flip_vertically_on_load(true);
+
+        if (std::filesystem::exists(ShaderVariantManifest))
+        {
+            PrecompileVariants(ShaderVariantManifest);
+        }
+        spriteShader = LoadShader("Content/sprite.vert", "Content/sprite.frag");
+    }
+
+    ShaderHandle Renderer::LoadShader(const std::string& vertexPath, const std::string& fragmentPath)
+    {
+        return LoadVariant(vertexPath, fragmentPath, {}, {}, false);
+    }
+
+    ShaderHandle Renderer::LoadShaderVariant(const ShaderHandle base, const std::initializer_list<std::string_view> defines)
+    {
+        const auto source = shaderSources.find(base.id);
+        if (source == shaderSources.end())
+        {
+            LogRenderer->Error("Shader {} was not loaded through the renderer, can't build a variant of it", base.id);
+            return base;
+        }
+
+        std::vector<std::string> variantDefines = source->second.defines;
+        variantDefines.insert(variantDefines.end(), defines.begin(), defines.end());
+        return LoadVariant(source->second.vertexPath, source->second.fragmentPath, std::move(variantDefines), base, true);
+    }
+
+    ShaderHandle Renderer::LoadVariant(const std::string& vertexPath, const std::string& fragmentPath, std::vector<std::string> defines, const ShaderHandle fallback, const bool background)
+    {
+        // The same defines in another order are the same variant
+        std::ranges::sort(defines);
+        const auto [first, last] = std::ranges::unique(defines);
+        defines.erase(first, last);
+
+        const std::string key = VariantKey(vertexPath, fragmentPath, defines);
+        if (const auto existing = shaderVariants.find(key); existing != shaderVariants.end())
+        {
+            return existing->second;
+        }
+
+        PreprocessedShader vertex = preprocessor.Process(vertexPath, defines);
+        PreprocessedShader fragment = preprocessor.Process(fragmentPath, defines);
+
+        ShaderHandle shader {};
+        if (vertex.valid && fragment.valid)
+        {
+            shader = background
+                ? backend->CreateShaderVariant(std::move(vertex.source), std::move(fragment.source), fallback)
+                : backend->CreateShader(vertex.source, fragment.source);
+        }
+
+        if (!shader.IsValid())
+        {
+            LogRenderer->Error("Could not create shader from {} and {}", vertexPath, fragmentPath);
+            return fallback;
+        }
+
+        shaderSources[shader.id] = {.vertexPath = vertexPath, .fragmentPath = fragmentPath, .defines = std::move(defines)};
+        shaderVariants[key] = shader;
+        return shader;
+    }
+
+    void Renderer::PrecompileVariants(const std::string& manifestPath)
+    {
+        const std::string manifest = fileIO.ReadFile(manifestPath);
+        std::istringstream lines(manifest);
+
+        size_t count {0};
+        std::string line {};
+        while (std::getline(lines, line))
+        {
+            // vertex path, fragment path, then the variant's defines, separated by whitespace
+            std::istringstream fields(line);
+            std::string vertexPath {};
+            std::string fragmentPath {};
+            if (line.starts_with(';') || !(fields >> vertexPath >> fragmentPath))
+            {
+                continue;
+            }
+
+            std::vector<std::string> defines {};
+            for (std::string define {}; fields >> define;)
+            {
+                defines.push_back(define);
+            }
+
+            const ShaderHandle base = LoadVariant(vertexPath, fragmentPath, {}, {}, false);
+            if (base.IsValid() && !defines.empty())
+            {
+                LoadVariant(vertexPath, fragmentPath, std::move(defines), base, false);
+            }
+            count++;
+        }
+
+        LogRenderer->Trace("Precompiled {} shader variant(s) from {}", count, manifestPath);
+    }
+
+    TextureHandle Renderer::LoadTexture(const std::string& path)
+    {
+        const std::string file = fileIO.ReadFile(path);
+
+        int width {0};
+        int height {0};
+        int channels {0};
+        stbi_uc* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.data()), static_cast<int>(file.size()), &width, &height, &channels, STBI_rgb_alpha);
+        if (pixels == nullptr)
+        {
+            LogRenderer->Error("Could not decode texture {}: {}", path, stbi_failure_reason());
+            return {};
+        }
+
+        const size_t size = static_cast<size_t>(width) * height * 4;
+        const TextureHandle texture = backend->CreateTexture({pixels, size}, uint2(width, height), path);
+        stbi_image_free(pixels);
+        return texture;
+    }
+
+    MeshHandle Renderer::CreateMesh(const std::span<const Vertex> vertices, const std::span<const uint32_t> indices)
+    {
+        return backend->CreateMesh(vertices, indices);
+    }
+
+    MaterialHandle Renderer::CreateMaterial(const ShaderHandle shader, const std::initializer_list<TextureHandle> textures, const MaterialBlock& parameters)
+    {
+        return backend->CreateMaterial(shader, {textures.begin(), textures.size()}, parameters);
+    }
+
+    void Renderer::SetCamera(const glm::mat4& view, const glm::mat4& projection, const float farPlane)
+    {
+        frame.view = view;
+        frame.projection = projection;
+        this->farPlane = farPlane;
+    }
+
+    void Renderer::Submit(const MeshHandle mesh, const MaterialHandle material, const glm::mat4& model, const RenderPass pass)
+    {
+        Recorder(0).Submit(mesh, material, model, pass);
+    }
+
+    uint64_t Renderer::MakeKey(const MeshHandle mesh, const MaterialHandle material, const glm::mat4& model, const RenderPass pass) const
+    {
+        // Distance along the view direction, only used for ordering so the translation is enough
+        const float viewDepth = -(frame.view * model[3]).z;
+        return SortKey::Make(pass, backend->MaterialShader(material), material, mesh, viewDepth / farPlane);
+    }
+
+    void Renderer::Render()
+    {
+        commands.Sort();
+        lights.Build(frame.view, frame.projection, farPlane, viewportSize);
+        sprites.Sort();
+
+        // The scene draws straight into the backbuffer, post-processing passes go between the two
+        graph.Reset();
+        const TargetHandle backbuffer = graph.Import("Backbuffer", {viewportSize, TargetFormat::RGBA8},
+            {.framebuffer = context != nullptr ? context->TargetFramebuffer() : 0});
+        graph.AddPass("Scene", [this, backbuffer]
+        {
+            backend->BeginFrame(graph.Texture(backbuffer).framebuffer, viewportSize, clearColor);
+            backend->Execute(commands, frame);
+        }).Write(backbuffer);
+        if (!sprites.Empty() && spriteShader.IsValid())
+        {
+            graph.AddPass("Sprites", [this] { backend->DrawSprites(sprites, spriteShader); }).Read(backbuffer).Write(backbuffer);
+        }
+        if (graph.Compile())
+        {
+            graph.Execute(transientTargets);
+            backend->EndFrame();
+        }
+        transientTargets.EndFrame();
+
+        commands.Clear();
+        lights.Clear();
+        sprites.Clear();
+    }
+
+    void Renderer::OnTick(const TickEvent& event)
+    {
+        frame.time += event.deltaTime;
+        frame.deltaTime = event.deltaTime;
+    }
+
+    float Renderer::AspectRatio() const
+    {
+        return viewportSize.y > 0 ? static_cast<float>(viewportSize.x) / static_cast<float>(viewportSize.y) : 1.0f;
+    }
+}
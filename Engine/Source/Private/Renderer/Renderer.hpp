@@ -0,0 +1,147 @@
+﻿#pragma once
+
+#include <initializer_list>
+#include <memory>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <glm/mat4x4.hpp>
+
+#include "Events.hpp"
+#include "LightClusters.hpp"
+#include "RenderBackend.hpp"
+#include "RenderCommandBuffer.hpp"
+#include "RenderGraph.hpp"
+#include "RenderTypes.hpp"
+#include "ShaderPreprocessor.hpp"
+#include "SpriteBatch.hpp"
+#include "TransientTargetPool.hpp"
+
+namespace blackbox
+{
+    class EventBus;
+    class FileIO;
+    class GLContext;
+    class JobSystem;
+    class Renderer;
+    class SoftwareFramebuffer;
+
+    // Records draws into a single command bucket, one per worker so recording threads never share a bucket
+    class RenderRecorder
+    {
+        const Renderer& renderer;
+        CommandBucket& bucket;
+
+    public:
+        RenderRecorder(const Renderer& renderer, CommandBucket& bucket) : renderer(renderer), bucket(bucket) {}
+
+        void Submit(MeshHandle mesh, MaterialHandle material, const glm::mat4& model, RenderPass pass = RenderPass::Opaque);
+    };
+
+    /**
+     * Frame-level entry point of the renderer. Game code submits draws during TickEvent, the engine calls
+     * Render once per frame which sorts everything by SortKey and hands it to the RenderBackend, the GLBackend
+     * for a GLContext, the SoftwareBackend for a SoftwareFramebuffer or whichever backend it was given.
+     *
+     *   renderer.SetCamera(view, projection, farPlane);
+     *   renderer.Submit(cube, woodMaterial, transform);
+     *
+     * Large scenes can record from JobSystem workers, each through the recorder for its worker index:
+     *
+     *   jobs.ParallelFor(count, 256, [&](size_t begin, size_t end, uint32_t worker)
+     *   {
+     *       RenderRecorder recorder = renderer.Recorder(worker);
+     *       ...
+     *   });
+     *
+     * Resources, the camera and Render belong to the thread that owns the GL context, or that created the
+     * renderer when rendering in software, and must not change while workers record.
+     */
+    class Renderer
+    {
+        // Where a shader came from, variants of it are built from the same files
+        struct ShaderSource
+        {
+            std::string vertexPath {};
+            std::string fragmentPath {};
+            std::vector<std::string> defines {};
+        };
+
+        EventBus& eventbus;
+        FileIO& fileIO;
+        GLContext* context {nullptr}; // nullptr when rendering in software
+
+        ShaderPreprocessor preprocessor;
+        std::unordered_map<uint32_t, ShaderSource> shaderSources {}; // By ShaderHandle id
+        std::unordered_map<std::string, ShaderHandle> shaderVariants {}; // By VariantKey, so every variant is built once
+
+        std::unique_ptr<RenderBackend> backend;
+        RenderCommandBuffer commands;
+        LightClusters lights;
+        SpriteBatch sprites {};
+        ShaderHandle spriteShader {};
+        RenderGraph graph {};
+        TransientTargetPool transientTargets; // Destroys its textures through the backend, declared after it
+        FrameData frame {};
+        float farPlane {100.0f};
+        uint2 viewportSize {};
+        float4 clearColor {0.1f, 0.1f, 0.12f, 1.0f};
+
+    public:
+        Renderer(EventBus& eventbus, FileIO& fileIO, JobSystem& jobs, GLContext& context);
+        // Renders on the CPU into `target`
+        Renderer(EventBus& eventbus, FileIO& fileIO, JobSystem& jobs, SoftwareFramebuffer& target);
+        // Draws through any backend, e.g. a NullBackend, into a target of `viewportSize`
+        Renderer(EventBus& eventbus, FileIO& fileIO, JobSystem& jobs, std::unique_ptr<RenderBackend> backend, uint2 viewportSize);
+        ~Renderer() = default;
+
+        Renderer(const Renderer& other) = delete;
+        Renderer& operator=(const Renderer&) = delete;
+        Renderer(Renderer&& other) = delete;
+        Renderer& operator=(Renderer&& other) = delete;
+
+        // Builds on the calling thread, so the shader is ready as soon as this returns
+        ShaderHandle LoadShader(const std::string& vertexPath, const std::string& fragmentPath);
+        // `base` built with extra `NAME` or `NAME=VALUE` defines. Variants compile in the background on first request
+        // and materials draw with `base` until then, unless Content/Config/ShaderVariants.ini built them at startup.
+        ShaderHandle LoadShaderVariant(ShaderHandle base, std::initializer_list<std::string_view> defines);
+        // Textures larger than TextureAtlas::SmallTextureSize load their coarse mips and stream the rest in as needed
+        TextureHandle LoadTexture(const std::string& path);
+        MeshHandle CreateMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices = {});
+        MaterialHandle CreateMaterial(ShaderHandle shader, std::initializer_list<TextureHandle> textures, const MaterialBlock& parameters = {});
+
+        void SetCamera(const glm::mat4& view, const glm::mat4& projection, float farPlane);
+        void SetClearColor(const float4& color) { clearColor = color; }
+        // Light that CLUSTERED_LIGHTING materials get without any point light nearby, white by default
+        void SetAmbientLight(const float3& color) { frame.ambientLight = color; }
+        void SetTextureBudget(const size_t bytes) { backend->SetTextureBudget(bytes); }
+        void Submit(MeshHandle mesh, MaterialHandle material, const glm::mat4& model, RenderPass pass = RenderPass::Opaque);
+        // Lights last one frame like draws, Render sorts them into LightClusters on the JobSystem
+        void SubmitLight(const PointLight& light) { lights.Submit(light); }
+        // Drawn over the scene at the end of the frame, see SpriteBatch for the order
+        void SubmitSprite(const Sprite& sprite) { sprites.Submit(sprite); }
+
+        // Recorder for the given JobSystem worker index, the main thread is worker 0
+        [[nodiscard]] RenderRecorder Recorder(const uint32_t worker) { return {*this, commands.Bucket(worker)}; }
+        [[nodiscard]] uint64_t MakeKey(MeshHandle mesh, MaterialHandle material, const glm::mat4& model, RenderPass pass) const;
+
+        // Sort and execute everything submitted since the last call
+        void Render();
+
+        [[nodiscard]] uint2 ViewportSize() const { return viewportSize; }
+        [[nodiscard]] float AspectRatio() const;
+        [[nodiscard]] const RenderStats& Stats() const { return backend->Stats(); }
+        [[nodiscard]] ProgramCacheStats ProgramStats() const { return backend->ProgramStats(); }
+        [[nodiscard]] AtlasStats TextureStats() const { return backend->TextureStats(); }
+        [[nodiscard]] const RenderGraphStats& GraphStats() const { return graph.Stats(); }
+
+    private:
+        ShaderHandle LoadVariant(const std::string& vertexPath, const std::string& fragmentPath, std::vector<std::string> defines, ShaderHandle fallback, bool background);
+        void PrecompileVariants(const std::string& manifestPath);
+
+        void OnViewportResized(const ViewportResizedEvent& event) { viewportSize = event.size; }
+        void OnTick(const TickEvent& event);
+    };
+}
@@ -0,0 +1,157 @@
+﻿#include "ShaderCompiler.hpp"
+
+#include <chrono>
+#include <utility>
+#include <glad/glad.h>
+
+#include "Blackbox.hpp"
+#include "ProgramCache.hpp"
+
+namespace blackbox
+{
+    ShaderCompiler::ShaderCompiler(GLContext& context, const ProgramCache& cache)
+        : cache(cache)
+        , sharedContext(context.CreateSharedContext())
+    {
+        if (sharedContext == nullptr)
+        {
+            LogRenderer->Warn("No shared context for background shader compilation, variants are built on the render thread");
+            return;
+        }
+
+        thread = std::thread(&ShaderCompiler::WorkerLoop, this);
+    }
+
+    ShaderCompiler::~ShaderCompiler()
+    {
+        if (thread.joinable())
+        {
+            {
+                std::lock_guard lock(mutex);
+                stopping = true;
+            }
+            wake.notify_one();
+            thread.join();
+        }
+
+        // Programs nobody picked up anymore, the render context is current again and shares them
+        for (const Result& result : finished)
+        {
+            glDeleteProgram(result.program);
+        }
+    }
+
+    size_t ShaderCompiler::Pending()
+    {
+        std::lock_guard lock(mutex);
+        return pending;
+    }
+
+    void ShaderCompiler::Submit(Request request)
+    {
+        {
+            std::lock_guard lock(mutex);
+            requests.push_back(std::move(request));
+            pending++;
+        }
+        wake.notify_one();
+    }
+
+    std::vector<ShaderCompiler::Result> ShaderCompiler::TakeFinished()
+    {
+        std::lock_guard lock(mutex);
+        pending -= finished.size();
+        return std::exchange(finished, {});
+    }
+
+    void ShaderCompiler::WorkerLoop()
+    {
+        sharedContext->MakeCurrent();
+
+        while (true)
+        {
+            Request request {};
+            {
+                std::unique_lock lock(mutex);
+                wake.wait(lock, [this] { return stopping || !requests.empty(); });
+                if (stopping)
+                {
+                    break;
+                }
+
+                request = std::move(requests.front());
+                requests.pop_front();
+            }
+
+            Result result {.shader = request.shader};
+            result.program = Build(request.vertexSource, request.fragmentSource, cache, result.buildMs);
+
+            // Other contexts only see a complete program once this context finished the commands that built it
+            glFinish();
+
+            std::lock_guard lock(mutex);
+            finished.push_back(result);
+        }
+
+        sharedContext->ReleaseCurrent();
+    }
+
+    uint32_t ShaderCompiler::Build(const std::string_view vertexSource, const std::string_view fragmentSource, const ProgramCache& cache, float& buildMs)
+    {
+        const auto start = std::chrono::steady_clock::now();
+
+        const uint32_t vertex = CompileStage(GL_VERTEX_SHADER, vertexSource);
+        const uint32_t fragment = CompileStage(GL_FRAGMENT_SHADER, fragmentSource);
+        if (vertex == 0 || fragment == 0)
+        {
+            glDeleteShader(vertex);
+            glDeleteShader(fragment);
+            return 0;
+        }
+
+        const uint32_t program = glCreateProgram();
+        cache.PrepareForStore(program);
+        glAttachShader(program, vertex);
+        glAttachShader(program, fragment);
+        glLinkProgram(program);
+        glDeleteShader(vertex);
+        glDeleteShader(fragment);
+
+        GLint linked {GL_FALSE};
+        glGetProgramiv(program, GL_LINK_STATUS, &linked);
+        if (linked != GL_TRUE)
+        {
+            std::string log(1024, '\0');
+            glGetProgramInfoLog(program, static_cast<GLsizei>(log.size()), nullptr, log.data());
+            LogRenderer->Error("Failed to link shader program: {}", log.c_str());
+            glDeleteProgram(program);
+            return 0;
+        }
+
+        // Drivers compile lazily, the link status query above waited for the real work
+        buildMs = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return program;
+    }
+
+    uint32_t ShaderCompiler::CompileStage(const uint32_t stage, const std::string_view source)
+    {
+        const uint32_t shader = glCreateShader(stage);
+        const char* text = source.data();
+        const auto length = static_cast<GLint>(source.size());
+        glShaderSource(shader, 1, &text, &length);
+        glCompileShader(shader);
+
+        GLint compiled {GL_FALSE};
+        glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+        if (compiled != GL_TRUE)
+        {
+            std::string log(1024, '\0');
+            glGetShaderInfoLog(shader, static_cast<GLsizei>(log.size()), nullptr, log.data());
+            LogRenderer->Error("Failed to compile {} shader: {}", stage == GL_VERTEX_SHADER ? "vertex" : "fragment", log.c_str());
+            glDeleteShader(shader);
+            return 0;
+        }
+
+        return shader;
+    }
+}
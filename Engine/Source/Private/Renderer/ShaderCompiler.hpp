@@ -0,0 +1,80 @@
+﻿#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "GLContext.hpp"
+#include "RenderTypes.hpp"
+
+namespace blackbox
+{
+    class ProgramCache;
+
+    /**
+     * Compiles and links shader programs on a background thread with its own context that shares objects with
+     * the render context, so building a shader variant never blocks a frame.
+     *
+     * Finished programs are linked and complete before they are handed back, the render thread only has to
+     * pick them up with TakeFinished. Without a shared context IsAsync() is false and callers build inline.
+     */
+    class ShaderCompiler
+    {
+    public:
+        struct Request
+        {
+            ShaderHandle shader {};
+            std::string vertexSource {};
+            std::string fragmentSource {};
+        };
+
+        struct Result
+        {
+            ShaderHandle shader {};
+            uint32_t program {0}; // 0 when the program failed to build, the log has the compiler output
+            float buildMs {0.0f};
+        };
+
+    private:
+        const ProgramCache& cache;
+        std::unique_ptr<GLContext> sharedContext {nullptr};
+        std::thread thread {};
+
+        std::mutex mutex {};
+        std::condition_variable wake {};
+        std::deque<Request> requests {};
+        std::vector<Result> finished {};
+        size_t pending {0}; // Submitted but not yet taken, guarded by `mutex`
+        bool stopping {false};
+
+    public:
+        ShaderCompiler(GLContext& context, const ProgramCache& cache);
+        ~ShaderCompiler();
+
+        ShaderCompiler(const ShaderCompiler& other) = delete;
+        ShaderCompiler& operator=(const ShaderCompiler&) = delete;
+        ShaderCompiler(ShaderCompiler&& other) = delete;
+        ShaderCompiler& operator=(ShaderCompiler&& other) = delete;
+
+        [[nodiscard]] bool IsAsync() const { return sharedContext != nullptr; }
+        [[nodiscard]] size_t Pending();
+
+        void Submit(Request request);
+
+        // Programs finished since the last call, the caller owns them from here on
+        [[nodiscard]] std::vector<Result> TakeFinished();
+
+        // Compile and link on the calling thread's current context, returns 0 and logs the compiler output on failure
+        static uint32_t Build(std::string_view vertexSource, std::string_view fragmentSource, const ProgramCache& cache, float& buildMs);
+
+    private:
+        static uint32_t CompileStage(uint32_t stage, std::string_view source);
+        void WorkerLoop();
+    };
+}
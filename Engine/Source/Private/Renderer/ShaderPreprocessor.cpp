@@ -0,0 +1,150 @@
+﻿#include "ShaderPreprocessor.hpp"
+
+#include <algorithm>
+#include <filesystem>
+#include <spdlog/fmt/fmt.h>
+
+#include "Blackbox.hpp"
+#include "FileIO.hpp"
+
+namespace blackbox
+{
+    namespace
+    {
+        // Deep enough for any sane include tree, shallow enough to stop runaway recursion quickly
+        constexpr size_t MaxIncludeDepth = 16;
+
+        std::string_view TrimStart(const std::string_view text)
+        {
+            const size_t start = text.find_first_not_of(" \t");
+            return start == std::string_view::npos ? std::string_view {} : text.substr(start);
+        }
+
+        // Directive name if the line is a preprocessor directive, e.g. "include" for `  # include "x"`
+        std::string_view Directive(const std::string_view line)
+        {
+            std::string_view text = TrimStart(line);
+            if (!text.starts_with('#'))
+            {
+                return {};
+            }
+
+            text = TrimStart(text.substr(1));
+            return text.substr(0, text.find_first_of(" \t\"<"));
+        }
+
+        // Path between the quotes of an include directive, empty when malformed
+        std::string_view IncludePath(const std::string_view line)
+        {
+            const size_t open = line.find('"');
+            const size_t close = open == std::string_view::npos ? open : line.find('"', open + 1);
+            return close == std::string_view::npos ? std::string_view {} : line.substr(open + 1, close - open - 1);
+        }
+    }
+
+    PreprocessedShader ShaderPreprocessor::Process(const std::string& path, const std::span<const std::string> defines) const
+    {
+        PreprocessedShader result {};
+        result.valid = Append(result, path, defines, 0);
+
+        // Compiler messages name files by index, e.g. "2(14)" is line 14 of the third file listed here
+        if (result.valid && result.files.size() > 1)
+        {
+            std::string files {};
+            for (size_t index = 0; index < result.files.size(); index++)
+            {
+                files += fmt::format("{}{}: {}", index > 0 ? ", " : "", index, result.files[index]);
+            }
+            LogRenderer->Trace("Shader {} is built from {}", path, files);
+        }
+
+        return result;
+    }
+
+    bool ShaderPreprocessor::Append(PreprocessedShader& result, const std::string& path, const std::span<const std::string> defines, const size_t depth) const
+    {
+        if (depth > MaxIncludeDepth)
+        {
+            LogRenderer->Error("Includes nested deeper than {} levels at {}", MaxIncludeDepth, path);
+            return false;
+        }
+
+        const std::string normalized = std::filesystem::path(path).lexically_normal().generic_string();
+        if (std::ranges::find(result.files, normalized) != result.files.end())
+        {
+            return true;
+        }
+
+        if (!std::filesystem::exists(normalized))
+        {
+            LogRenderer->Error("Shader file {} does not exist", normalized);
+            return false;
+        }
+
+        const size_t fileIndex = result.files.size();
+        result.files.push_back(normalized);
+
+        const std::string text = fileIO.ReadFile(normalized);
+        std::string_view remaining = text;
+
+        // Content files are saved with a UTF-8 BOM, which GLSL compilers reject
+        if (remaining.starts_with("\xEF\xBB\xBF"))
+        {
+            remaining.remove_prefix(3);
+        }
+
+        const std::string directory = std::filesystem::path(normalized).parent_path().generic_string();
+        if (fileIndex > 0)
+        {
+            result.source += fmt::format("#line 1 {}\n", fileIndex);
+        }
+
+        size_t lineNumber {0};
+        while (!remaining.empty())
+        {
+            const size_t end = remaining.find('\n');
+            const std::string_view line = remaining.substr(0, end);
+            remaining = end == std::string_view::npos ? std::string_view {} : remaining.substr(end + 1);
+            lineNumber++;
+
+            const std::string_view directive = Directive(line);
+            if (directive == "include")
+            {
+                const std::string_view include = IncludePath(line);
+                if (include.empty())
+                {
+                    LogRenderer->Error("{}({}): expected #include \"path\"", normalized, lineNumber);
+                    return false;
+                }
+
+                const std::string includePath = directory.empty() ? std::string(include) : directory + "/" + std::string(include);
+                if (!Append(result, includePath, {}, depth + 1))
+                {
+                    LogRenderer->Error("{}({}): could not include {}", normalized, lineNumber, include);
+                    return false;
+                }
+
+                result.source += fmt::format("#line {} {}\n", lineNumber + 1, fileIndex);
+                continue;
+            }
+
+            result.source += line;
+            result.source += '\n';
+
+            // Defines have to follow #version, which must be the first statement of the root file
+            if (directive == "version" && fileIndex == 0)
+            {
+                for (const std::string& define : defines)
+                {
+                    const size_t equals = define.find('=');
+                    result.source += equals == std::string::npos
+                        ? fmt::format("#define {} 1\n", define)
+                        : fmt::format("#define {} {}\n", define.substr(0, equals), define.substr(equals + 1));
+                }
+                result.source += fmt::format("#line {} 0\n", lineNumber + 1);
+            }
+        }
+
+        return true;
+    }
+}
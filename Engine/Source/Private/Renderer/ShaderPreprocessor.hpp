@@ -0,0 +1,39 @@
+﻿#pragma once
+
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace blackbox
+{
+    class FileIO;
+
+    struct PreprocessedShader
+    {
+        std::string source {};
+        std::vector<std::string> files {}; // Index is the source string number compiler messages report, 0 is the root file
+        bool valid {false};
+    };
+
+    /**
+     * Resolves `#include "path"` and injects feature defines before a shader reaches the GLSL compiler.
+     *
+     * Include paths are relative to the including file. Every file is included at most once per shader, so shared
+     * headers need no include guards. Defines are written as `NAME` or `NAME=VALUE` and inserted right after
+     * `#version`. `#line` directives keep compiler messages pointing at the original file and line, with the
+     * file given as its index in `files`.
+     */
+    class ShaderPreprocessor
+    {
+        const FileIO& fileIO;
+
+    public:
+        explicit ShaderPreprocessor(const FileIO& fileIO) : fileIO(fileIO) {}
+
+        [[nodiscard]] PreprocessedShader Process(const std::string& path, std::span<const std::string> defines = {}) const;
+
+    private:
+        bool Append(PreprocessedShader& result, const std::string& path, std::span<const std::string> defines, size_t depth) const;
+    };
+}
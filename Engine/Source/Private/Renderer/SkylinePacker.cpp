@@ -0,0 +1,131 @@
+﻿#include "SkylinePacker.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace blackbox
+{
+    namespace
+    {
+        uint32_t AlignUp(const uint32_t value, const uint32_t alignment)
+        {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+    }
+
+    SkylinePacker::SkylinePacker(const uint2 size, const uint32_t alignment)
+        : size(size)
+        , alignment(std::max(alignment, 1u))
+    {
+        skyline.push_back({.x = 0, .y = 0, .width = size.x});
+    }
+
+    std::optional<uint2> SkylinePacker::Insert(const uint2 rectangle)
+    {
+        const uint2 aligned(AlignUp(rectangle.x, alignment), AlignUp(rectangle.y, alignment));
+        if (aligned.x == 0 || aligned.y == 0 || aligned.x > size.x || aligned.y > size.y)
+        {
+            return std::nullopt;
+        }
+
+        size_t bestIndex {skyline.size()};
+        uint32_t bestY {std::numeric_limits<uint32_t>::max()};
+        uint32_t bestWidth {std::numeric_limits<uint32_t>::max()};
+
+        for (size_t index = 0; index < skyline.size(); index++)
+        {
+            const std::optional<uint32_t> y = Fit(index, aligned);
+            if (!y.has_value())
+            {
+                continue;
+            }
+
+            if (*y < bestY || (*y == bestY && skyline[index].width < bestWidth))
+            {
+                bestIndex = index;
+                bestY = *y;
+                bestWidth = skyline[index].width;
+            }
+        }
+
+        if (bestIndex == skyline.size())
+        {
+            return std::nullopt;
+        }
+
+        const uint2 position(skyline[bestIndex].x, bestY);
+        Place(bestIndex, position, aligned);
+        usedArea += static_cast<uint64_t>(aligned.x) * aligned.y;
+        return position;
+    }
+
+    float SkylinePacker::Occupancy() const
+    {
+        return static_cast<float>(static_cast<double>(usedArea) / (static_cast<double>(size.x) * size.y));
+    }
+
+    std::optional<uint32_t> SkylinePacker::Fit(size_t index, const uint2 rectangle) const
+    {
+        const uint32_t x = skyline[index].x;
+        if (x + rectangle.x > size.x)
+        {
+            return std::nullopt;
+        }
+
+        // The rectangle rests on the highest segment below its span
+        uint32_t y {0};
+        uint32_t widthLeft = rectangle.x;
+        while (widthLeft > 0)
+        {
+            y = std::max(y, skyline[index].y);
+            if (y + rectangle.y > size.y)
+            {
+                return std::nullopt;
+            }
+
+            widthLeft -= std::min(widthLeft, skyline[index].width);
+            index++;
+        }
+
+        return y;
+    }
+
+    void SkylinePacker::Place(const size_t index, const uint2 position, const uint2 rectangle)
+    {
+        skyline.insert(skyline.begin() + static_cast<ptrdiff_t>(index), {.x = position.x, .y = position.y + rectangle.y, .width = rectangle.x});
+
+        // Segments now covered by the rectangle shrink or disappear
+        const uint32_t right = position.x + rectangle.x;
+        for (size_t next = index + 1; next < skyline.size();)
+        {
+            Segment& segment = skyline[next];
+            if (segment.x >= right)
+            {
+                break;
+            }
+
+            const uint32_t overlap = std::min(right - segment.x, segment.width);
+            segment.x += overlap;
+            segment.width -= overlap;
+            if (segment.width > 0)
+            {
+                break;
+            }
+            skyline.erase(skyline.begin() + static_cast<ptrdiff_t>(next));
+        }
+
+        // Neighbours at the same height become one segment
+        for (size_t i = 0; i + 1 < skyline.size();)
+        {
+            if (skyline[i].y == skyline[i + 1].y)
+            {
+                skyline[i].width += skyline[i + 1].width;
+                skyline.erase(skyline.begin() + static_cast<ptrdiff_t>(i + 1));
+            }
+            else
+            {
+                i++;
+            }
+        }
+    }
+}
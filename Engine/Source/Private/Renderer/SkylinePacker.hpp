@@ -0,0 +1,49 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <vector>
+
+#include "Types.hpp"
+
+namespace blackbox
+{
+    /**
+     * Packs rectangles into a fixed-size page with the skyline bottom-left heuristic: the page is tracked as the
+     * list of horizontal segments that form its current top edge, and each rectangle goes where it ends up lowest,
+     * preferring the narrowest fit on ties.
+     *
+     * Sizes and positions are rounded up to `alignment`, so mip levels up to log2(alignment) never mix texels
+     * of neighbouring rectangles.
+     */
+    class SkylinePacker
+    {
+        struct Segment
+        {
+            uint32_t x {0};
+            uint32_t y {0};
+            uint32_t width {0};
+        };
+
+        uint2 size {};
+        uint32_t alignment {1};
+        std::vector<Segment> skyline {};
+        uint64_t usedArea {0};
+
+    public:
+        SkylinePacker(uint2 size, uint32_t alignment = 1);
+
+        // Top-left corner of the placed rectangle, nothing when it doesn't fit anymore
+        [[nodiscard]] std::optional<uint2> Insert(uint2 rectangle);
+
+        [[nodiscard]] uint2 Size() const { return size; }
+
+        // Fraction of the page covered by placed rectangles, including their alignment
+        [[nodiscard]] float Occupancy() const;
+
+    private:
+        // Height the rectangle would rest at when its left edge is at `index`, nothing if it doesn't fit there
+        [[nodiscard]] std::optional<uint32_t> Fit(size_t index, uint2 rectangle) const;
+        void Place(size_t index, uint2 position, uint2 rectangle);
+    };
+}
@@ -0,0 +1,324 @@
+﻿#include "SoftwareBackend.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#include "Blackbox.hpp"
+#include "Jobs/JobSystem.hpp"
+#include "LightClusters.hpp"
+#include "SoftwareFramebuffer.hpp"
+#include "SortKey.hpp"
+#include "SpriteBatch.hpp"
+#include "TextureAtlas.hpp"
+#include "TextureStreamer.hpp"
+
+namespace blackbox
+{
+    namespace
+    {
+        // Sorted entries each worker transforms at once, meshes differ in size so batches stay small
+        constexpr size_t VertexBatchSize = 16;
+        // Sprites are four vertices each, far cheaper than a mesh
+        constexpr size_t SpriteBatchSize = 1024;
+
+        // Whether the preprocessor defined `name`, it writes every define as `#define NAME VALUE` on a line of its own
+        bool HasDefine(const std::string_view source, const std::string_view name)
+        {
+            const std::string directive = "#define " + std::string(name);
+            for (size_t found = source.find(directive); found != std::string_view::npos; found = source.find(directive, found + 1))
+            {
+                const size_t end = found + directive.size();
+                const bool lineStart = found == 0 || source[found - 1] == '\n';
+                const bool nameEnd = end == source.size() || source[end] == ' ' || source[end] == '\r' || source[end] == '\n';
+                if (lineStart && nameEnd)
+                {
+                    return true;
+                }
+            }
+            return false;
+        }
+    }
+
+    SoftwareBackend::SoftwareBackend(SoftwareFramebuffer& target, JobSystem& jobs)
+        : target(target)
+        , jobs(jobs)
+        , rasterizer(jobs)
+        , clipVertices(jobs.WorkerCount())
+    {
+    }
+
+    ShaderHandle SoftwareBackend::CreateShader(std::string_view, const std::string_view fragmentSource)
+    {
+        if (shaders.size() >= SortKey::MaxShaders - 1)
+        {
+            LogRenderer->Error("Shader limit of {} reached", SortKey::MaxShaders - 1);
+            return {};
+        }
+
+        shaders.push_back({
+            .textureBlend = HasDefine(fragmentSource, "TEXTURE_BLEND"),
+            .alphaTest = HasDefine(fragmentSource, "ALPHA_TEST"),
+            .clusteredLighting = HasDefine(fragmentSource, "CLUSTERED_LIGHTING"),
+        });
+        return {static_cast<uint32_t>(shaders.size())};
+    }
+
+    ShaderHandle SoftwareBackend::CreateShaderVariant(std::string vertexSource, std::string fragmentSource, ShaderHandle)
+    {
+        return CreateShader(vertexSource, fragmentSource);
+    }
+
+    TextureHandle SoftwareBackend::CreateTexture(const std::span<const uint8_t> rgba, const uint2 size, const std::string&)
+    {
+        if (size.x == 0 || size.y == 0 || rgba.size() < size_t {size.x} * size.y * 4)
+        {
+            LogRenderer->Error("Could not create a {}x{} texture", size.x, size.y);
+            return {};
+        }
+
+        // Same filtering as the atlas: small images share a page and stop after the mips its padding covers,
+        // large images get their full chain
+        SoftwareTexture& texture = textures.emplace_back();
+        texture.clamp = size.x <= TextureAtlas::SmallTextureSize && size.y <= TextureAtlas::SmallTextureSize;
+        const uint32_t fullChain = std::bit_width(std::max(size.x, size.y));
+        const uint32_t levels = texture.clamp ? std::min<uint32_t>(fullChain, std::bit_width(TextureAtlas::Padding)) : fullChain;
+
+        std::vector<uint8_t> mip(rgba.begin(), rgba.begin() + static_cast<std::ptrdiff_t>(size_t {size.x} * size.y * 4));
+        for (uint32_t level = 0; level < levels; level++)
+        {
+            const uint2 mipSize = TextureAtlas::MipSize(size, level);
+            if (level > 0)
+            {
+                mip = TextureStreamer::Downsample(mip, TextureAtlas::MipSize(size, level - 1));
+            }
+
+            std::vector<uint32_t>& texels = texture.mips.emplace_back(size_t {mipSize.x} * mipSize.y);
+            std::memcpy(texels.data(), mip.data(), texels.size() * sizeof(uint32_t));
+            texture.sizes.push_back(mipSize);
+            textureBytes += texels.size() * sizeof(uint32_t);
+        }
+
+        return {static_cast<uint32_t>(textures.size())};
+    }
+
+    MeshHandle SoftwareBackend::CreateMesh(const std::span<const Vertex> vertices, const std::span<const uint32_t> indices)
+    {
+        if (meshes.size() >= SortKey::MaxMeshes - 1)
+        {
+            LogRenderer->Error("Mesh limit of {} reached", SortKey::MaxMeshes - 1);
+            return {};
+        }
+
+        Mesh& mesh = meshes.emplace_back();
+        mesh.vertices.assign(vertices.begin(), vertices.end());
+        if (indices.empty())
+        {
+            mesh.indices.resize(vertices.size());
+            for (uint32_t index = 0; index < mesh.indices.size(); index++)
+            {
+                mesh.indices[index] = index;
+            }
+        }
+        else
+        {
+            mesh.indices.assign(indices.begin(), indices.end());
+        }
+
+        // A trailing partial triangle never draws, out of range indices would read past the vertices
+        mesh.indices.resize(vertices.empty() ? 0 : mesh.indices.size() / 3 * 3);
+        std::ranges::replace_if(mesh.indices, [&](const uint32_t index) { return index >= vertices.size(); }, 0);
+        return {static_cast<uint32_t>(meshes.size())};
+    }
+
+    MaterialHandle SoftwareBackend::CreateMaterial(const ShaderHandle shader, const std::span<const TextureHandle> materialTextures, const MaterialBlock& parameters)
+    {
+        if (materials.size() >= SortKey::MaxMaterials - 1 || materialTextures.size() > MaterialTextureSlots)
+        {
+            LogRenderer->Error("Material limit reached or more than {} textures", MaterialTextureSlots);
+            return {};
+        }
+
+        // basic.frag only reads the first two slots
+        SoftwareMaterial& material = materials.emplace_back();
+        std::copy_n(materialTextures.begin(), std::min(materialTextures.size(), material.textures.size()), material.textures.begin());
+        material.color = parameters.color;
+        material.params = parameters.params;
+        if (shader.IsValid())
+        {
+            material.textureBlend = shaders[shader.Index()].textureBlend;
+            material.alphaTest = shaders[shader.Index()].alphaTest;
+            material.clusteredLighting = shaders[shader.Index()].clusteredLighting;
+        }
+        materialShaders.push_back(shader);
+
+        return {static_cast<uint32_t>(materials.size())};
+    }
+
+    TargetTexture SoftwareBackend::CreateTarget(const TargetDesc& desc)
+    {
+        auto free = std::ranges::find_if(targets, &std::vector<std::byte>::empty);
+        if (free == targets.end())
+        {
+            free = targets.emplace(targets.end());
+        }
+        free->resize(desc.Bytes());
+        return {.texture = static_cast<uint32_t>(free - targets.begin() + 1)};
+    }
+
+    void SoftwareBackend::DestroyTarget(const TargetTexture& target)
+    {
+        if (target.texture > 0 && target.texture <= targets.size())
+        {
+            std::vector<std::byte>().swap(targets[target.texture - 1]);
+        }
+    }
+
+    void SoftwareBackend::BeginFrame(uint32_t, const uint2 size, const float4& clearColor)
+    {
+        stats = {};
+
+        if (target.Size() != size)
+        {
+            target.Resize(size);
+        }
+        target.Clear(clearColor);
+    }
+
+    void SoftwareBackend::Execute(const RenderCommandBuffer& commands, const FrameData& frame)
+    {
+        const std::span<const SortEntry> entries = commands.Entries();
+        stats.packets += static_cast<uint32_t>(entries.size());
+        if (entries.empty())
+        {
+            return;
+        }
+
+        // Every packet owns a fixed range of triangle slots, so the vertex stage can run in any order
+        firstTriangles.resize(entries.size());
+        size_t triangleCount {0};
+        for (size_t index = 0; index < entries.size(); index++)
+        {
+            const DrawPacket& packet = commands.Packet(entries[index]);
+            firstTriangles[index] = triangleCount;
+            triangleCount += meshes[packet.mesh.Index()].indices.size() / 3;
+
+            // Counted like the GL backend's instanced draws, runs of one mesh and material in one pass
+            if (index == 0)
+            {
+                stats.drawCalls++;
+                continue;
+            }
+            const DrawPacket& previous = commands.Packet(entries[index - 1]);
+            if (packet.mesh != previous.mesh || packet.material != previous.material || SortKey::Pass(entries[index].key) != SortKey::Pass(entries[index - 1].key))
+            {
+                stats.drawCalls++;
+            }
+        }
+
+        rasterizer.Reset(target.Size(), triangleCount);
+
+        const glm::mat4 viewProjection = frame.projection * frame.view;
+        jobs.ParallelFor(entries.size(), VertexBatchSize, [&](const size_t begin, const size_t end, const uint32_t worker)
+        {
+            std::vector<ClipVertex>& clip = clipVertices[worker];
+            for (size_t index = begin; index < end; index++)
+            {
+                const DrawPacket& packet = commands.Packet(entries[index]);
+                const Mesh& mesh = meshes[packet.mesh.Index()];
+                const RenderPass pass = SortKey::Pass(entries[index].key);
+
+                // basic.vert
+                const glm::mat4 modelViewProjection = viewProjection * packet.model;
+                const glm::mat4 modelView = frame.view * packet.model;
+                clip.resize(mesh.vertices.size());
+                for (size_t vertex = 0; vertex < mesh.vertices.size(); vertex++)
+                {
+                    const float4 position(mesh.vertices[vertex].position, 1.0f);
+                    clip[vertex] = {
+                        .position = modelViewProjection * position,
+                        .texCoord = mesh.vertices[vertex].texCoord,
+                        .viewPosition = float3(modelView * position),
+                    };
+                }
+
+                size_t slot = firstTriangles[index];
+                for (size_t first = 0; first < mesh.indices.size(); first += 3)
+                {
+                    rasterizer.Setup(slot++, clip[mesh.indices[first]], clip[mesh.indices[first + 1]], clip[mesh.indices[first + 2]], packet.material.Index(), pass);
+                }
+            }
+        });
+
+        rasterizer.Draw(target, textures, materials, frame);
+        if (frame.lights != nullptr)
+        {
+            stats.lights = frame.lights->LightCount();
+            stats.lightAssignments = static_cast<uint32_t>(frame.lights->Indices().size());
+        }
+    }
+
+    void SoftwareBackend::DrawSprites(const SpriteBatch& batch, ShaderHandle)
+    {
+        const std::span<const uint32_t> order = batch.Order();
+        if (order.empty())
+        {
+            return;
+        }
+
+        // Counted like the GL backend's runs of one texture, which ignore that textures may share an atlas layer
+        const std::span<const Sprite> sprites = batch.Sprites();
+        spriteMaterials.resize(order.size());
+        for (size_t index = 0; index < order.size(); index++)
+        {
+            const Sprite& sprite = sprites[order[index]];
+            spriteMaterials[index] = {.textures = {sprite.texture}, .color = sprite.color};
+            if (index == 0 || sprite.texture != sprites[order[index - 1]].texture)
+            {
+                stats.drawCalls++;
+                stats.spriteDrawCalls++;
+            }
+        }
+        stats.sprites += static_cast<uint32_t>(order.size());
+
+        rasterizer.Reset(target.Size(), order.size() * 2);
+
+        const float2 size(target.Size());
+        jobs.ParallelFor(order.size(), SpriteBatchSize, [&](const size_t begin, const size_t end, uint32_t)
+        {
+            for (size_t index = begin; index < end; index++)
+            {
+                const Sprite& sprite = sprites[order[index]];
+                if (!sprite.texture.IsValid() || sprite.texture.Index() >= textures.size())
+                {
+                    // Slots keep last frame's triangles until set up again
+                    rasterizer.Setup(index * 2, {}, {}, {}, 0, RenderPass::Overlay);
+                    rasterizer.Setup(index * 2 + 1, {}, {}, {}, 0, RenderPass::Overlay);
+                    continue;
+                }
+
+                // sprite.vert, pixels from the top left to clip space
+                const SpriteCorners corners = SpriteBatch::Corners(sprite);
+                std::array<ClipVertex, 4> clip {};
+                for (size_t corner = 0; corner < 4; corner++)
+                {
+                    const float2 position = corners.positions[corner];
+                    clip[corner] = {
+                        .position = float4(position.x * 2.0f / size.x - 1.0f, 1.0f - position.y * 2.0f / size.y, 0.0f, 1.0f),
+                        .texCoord = glm::clamp(corners.texCoords[corner], 0.0f, 1.0f),
+                    };
+                }
+                const auto material = static_cast<uint32_t>(index);
+                rasterizer.Setup(index * 2, clip[0], clip[1], clip[2], material, RenderPass::Overlay);
+                rasterizer.Setup(index * 2 + 1, clip[2], clip[3], clip[0], material, RenderPass::Overlay);
+            }
+        });
+
+        rasterizer.Draw(target, textures, spriteMaterials, FrameData {});
+    }
+
+    void SoftwareBackend::EndFrame()
+    {
+        stats.textureBytes = textureBytes;
+    }
+}
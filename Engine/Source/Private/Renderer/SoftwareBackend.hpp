@@ -0,0 +1,91 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "RenderBackend.hpp"
+#include "SoftwareRasterizer.hpp"
+
+namespace blackbox
+{
+    class JobSystem;
+    class SoftwareFramebuffer;
+
+    /**
+     * Renders into a SoftwareFramebuffer on the CPU, for machines and CI runners without a usable GPU.
+     *
+     * There is no GLSL compiler on the CPU, so the backend implements basic.vert and basic.frag natively and reads
+     * a shader's variant from the TEXTURE_BLEND, ALPHA_TEST and CLUSTERED_LIGHTING defines in its preprocessed
+     * fragment source. Every shader is ready as soon as it's created. Vertices are transformed on the JobSystem, the SoftwareRasterizer
+     * draws the tiles in parallel. Sprites are drawn the same way, each with a material of its own.
+     */
+    class SoftwareBackend final : public RenderBackend
+    {
+        struct Shader
+        {
+            bool textureBlend {false};
+            bool alphaTest {false};
+            bool clusteredLighting {false};
+        };
+
+        struct Mesh
+        {
+            std::vector<Vertex> vertices {};
+            std::vector<uint32_t> indices {}; // Three per triangle, generated for meshes created without
+        };
+
+        SoftwareFramebuffer& target;
+        JobSystem& jobs;
+
+        std::vector<Shader> shaders {};
+        std::vector<SoftwareTexture> textures {};
+        std::vector<Mesh> meshes {};
+        std::vector<ShaderHandle> materialShaders {};
+        std::vector<SoftwareMaterial> materials {};
+        std::vector<std::vector<std::byte>> targets {}; // Render graph targets by texture - 1, empty once destroyed
+        size_t textureBytes {0};
+
+        SoftwareRasterizer rasterizer;
+        std::vector<size_t> firstTriangles {};              // Per sorted entry, its first slot in the rasterizer
+        std::vector<std::vector<ClipVertex>> clipVertices {}; // Per worker, the current mesh after the vertex stage
+        std::vector<SoftwareMaterial> spriteMaterials {};     // Per sorted sprite, its texture and color
+        RenderStats stats {};
+
+    public:
+        SoftwareBackend(SoftwareFramebuffer& target, JobSystem& jobs);
+        ~SoftwareBackend() override = default;
+
+        SoftwareBackend(const SoftwareBackend& other) = delete;
+        SoftwareBackend& operator=(const SoftwareBackend&) = delete;
+        SoftwareBackend(SoftwareBackend&& other) = delete;
+        SoftwareBackend& operator=(SoftwareBackend&& other) = delete;
+
+        // RenderBackend
+        ShaderHandle CreateShader(std::string_view vertexSource, std::string_view fragmentSource) override;
+        // Nothing to build in the background, the variant is ready right away
+        ShaderHandle CreateShaderVariant(std::string vertexSource, std::string fragmentSource, ShaderHandle fallback) override;
+        // Keeps the whole mip chain in memory, `sourcePath` isn't needed
+        TextureHandle CreateTexture(std::span<const uint8_t> rgba, uint2 size, const std::string& sourcePath) override;
+        MeshHandle CreateMesh(std::span<const Vertex> vertices, std::span<const uint32_t> indices) override;
+        MaterialHandle CreateMaterial(ShaderHandle shader, std::span<const TextureHandle> textures, const MaterialBlock& parameters) override;
+        // Plain memory of the target's size, there are no framebuffers besides the SoftwareFramebuffer
+        TargetTexture CreateTarget(const TargetDesc& desc) override;
+        void DestroyTarget(const TargetTexture& target) override;
+
+        [[nodiscard]] ShaderHandle MaterialShader(const MaterialHandle material) const override { return materialShaders[material.Index()]; }
+        [[nodiscard]] bool IsShaderReady(ShaderHandle) const override { return true; }
+
+        // `framebuffer` is ignored, the target is the SoftwareFramebuffer, resized to `size`
+        void BeginFrame(uint32_t framebuffer, uint2 size, const float4& clearColor) override;
+        void Execute(const RenderCommandBuffer& commands, const FrameData& frame) override;
+        // sprite.vert and sprite.frag natively, two overlay triangles per sprite
+        void DrawSprites(const SpriteBatch& sprites, ShaderHandle shader) override;
+        void EndFrame() override;
+
+        [[nodiscard]] const RenderStats& Stats() const override { return stats; }
+    };
+}
@@ -0,0 +1,47 @@
+﻿#include "SoftwareFramebuffer.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace blackbox
+{
+    SoftwareFramebuffer::SoftwareFramebuffer(const uint32_t width, const uint32_t height)
+    {
+        Resize({width, height});
+    }
+
+    void SoftwareFramebuffer::Resize(const uint2 newSize)
+    {
+        size = newSize;
+        stride = (size.x + 3) / 4 * 4;
+        color.assign(size_t {stride} * size.y, 0);
+        depth.assign(size_t {stride} * size.y, 1.0f);
+    }
+
+    void SoftwareFramebuffer::Clear(const float4& clearColor)
+    {
+        std::ranges::fill(color, Pack(clearColor));
+        std::ranges::fill(depth, 1.0f);
+    }
+
+    uint32_t SoftwareFramebuffer::Pack(const float4& rgba)
+    {
+        const uint4 bytes(glm::clamp(rgba, 0.0f, 1.0f) * 255.0f + 0.5f);
+        return bytes.r | bytes.g << 8 | bytes.b << 16 | bytes.a << 24;
+    }
+
+    float4 SoftwareFramebuffer::Unpack(const uint32_t rgba)
+    {
+        return float4(uint4(rgba & 0xFF, rgba >> 8 & 0xFF, rgba >> 16 & 0xFF, rgba >> 24)) / 255.0f;
+    }
+
+    std::vector<uint8_t> SoftwareFramebuffer::ReadPixels() const
+    {
+        std::vector<uint8_t> pixels(size_t {size.x} * size.y * 4);
+        for (uint32_t y = 0; y < size.y; y++)
+        {
+            std::memcpy(pixels.data() + size_t {y} * size.x * 4, color.data() + size_t {y} * stride, size_t {size.x} * 4);
+        }
+        return pixels;
+    }
+}
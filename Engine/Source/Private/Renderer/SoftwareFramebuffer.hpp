@@ -0,0 +1,44 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "Types.hpp"
+
+namespace blackbox
+{
+    /**
+     * Color and depth buffer in system memory that SoftwareBackend renders into, the CPU counterpart of
+     * HeadlessContext for machines without a GPU.
+     *
+     * Color is RGBA8 packed into one uint32_t per pixel with red in the lowest byte, depth is a float per pixel.
+     * Rows are stored top row first and padded to a multiple of four pixels, so the rasterizer can always
+     * process four pixels at once.
+     */
+    class SoftwareFramebuffer
+    {
+        uint2 size {0, 0};
+        uint32_t stride {0}; // Pixels per row, including padding
+        std::vector<uint32_t> color {};
+        std::vector<float> depth {};
+
+    public:
+        SoftwareFramebuffer(uint32_t width, uint32_t height);
+
+        void Resize(uint2 newSize);
+        void Clear(const float4& clearColor);
+
+        [[nodiscard]] uint2 Size() const { return size; }
+        [[nodiscard]] uint32_t Stride() const { return stride; }
+        [[nodiscard]] std::span<uint32_t> Color() { return color; }
+        [[nodiscard]] std::span<float> Depth() { return depth; }
+
+        // Between float colors in [0, 1] and packed RGBA8, rounded like a GL RGBA8 target
+        [[nodiscard]] static uint32_t Pack(const float4& rgba);
+        [[nodiscard]] static float4 Unpack(uint32_t rgba);
+
+        // Tightly packed RGBA8, top row first, the same layout as HeadlessContext::ReadPixels
+        [[nodiscard]] std::vector<uint8_t> ReadPixels() const;
+    };
+}
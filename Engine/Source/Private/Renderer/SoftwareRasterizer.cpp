@@ -0,0 +1,422 @@
+﻿#include "SoftwareRasterizer.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <emmintrin.h>
+#include <utility>
+
+#include "Jobs/JobSystem.hpp"
+#include "LightClusters.hpp"
+#include "RenderBackend.hpp"
+#include "SoftwareFramebuffer.hpp"
+
+namespace blackbox
+{
+    namespace
+    {
+        float Cross(const float2 a, const float2 b, const float2 p)
+        {
+            return (b.x - a.x) * (p.y - a.y) - (b.y - a.y) * (p.x - a.x);
+        }
+
+        float Evaluate(const float3& plane, const float x, const float y)
+        {
+            return plane.x * x + plane.y * y + plane.z;
+        }
+
+        ClipVertex Lerp(const ClipVertex& a, const ClipVertex& b, const float t)
+        {
+            return {
+                .position = glm::mix(a.position, b.position, t),
+                .texCoord = glm::mix(a.texCoord, b.texCoord, t),
+                .viewPosition = glm::mix(a.viewPosition, b.viewPosition, t),
+            };
+        }
+
+        // Lighting.glsl, `fragCoord` from the bottom left like gl_FragCoord
+        float3 ClusteredLight(const LightClusters& lights, const float3& ambient, const float2 fragCoord, const float3& viewPosition)
+        {
+            const uint2 range = lights.Clusters()[lights.ClusterAt(fragCoord, -viewPosition.z)];
+            const std::span<const float4> lightData = lights.LightData();
+
+            float3 light = ambient;
+            for (const uint16_t index : lights.Indices().subspan(range.x, range.y))
+            {
+                const float4& sphere = lightData[size_t {index} * 2];
+                const float3 offset = float3(sphere) - viewPosition;
+                const float falloff = std::clamp(1.0f - glm::dot(offset, offset) / (sphere.w * sphere.w), 0.0f, 1.0f);
+                light += float3(lightData[size_t {index} * 2 + 1]) * falloff * falloff;
+            }
+            return light;
+        }
+
+        // basic.frag, false when the pixel is discarded. `light` is ClusteredLight for lit materials.
+        bool Shade(const float3& inverseW, const float3& uOverW, const float3& vOverW, const SoftwareMaterial& material,
+            const std::span<const SoftwareTexture> textures, const float x, const float y, const float3& light, float4& color)
+        {
+            // Texture coordinates are a quotient of two screen-space planes, which also gives their exact derivatives
+            const float w = 1.0f / Evaluate(inverseW, x, y);
+            const float2 uv = float2(Evaluate(uOverW, x, y), Evaluate(vOverW, x, y)) * w;
+            const float2 uvPerPixelX = (float2(uOverW.x, vOverW.x) - uv * inverseW.x) * w;
+            const float2 uvPerPixelY = (float2(uOverW.y, vOverW.y) - uv * inverseW.y) * w;
+
+            // An unbound sampler reads an incomplete texture, which GL returns as opaque black
+            auto sample = [&](const TextureHandle texture)
+            {
+                return texture.IsValid() ? textures[texture.Index()].Sample(uv, uvPerPixelX, uvPerPixelY) : float4(0.0f, 0.0f, 0.0f, 1.0f);
+            };
+
+            color = sample(material.textures[0]);
+            if (material.textureBlend)
+            {
+                color = glm::mix(color, sample(material.textures[1]), material.params.x);
+            }
+            color *= material.color;
+            if (material.clusteredLighting)
+            {
+                color = float4(float3(color) * light, color.a);
+            }
+            color = glm::clamp(color, 0.0f, 1.0f);
+
+            return !material.alphaTest || color.a >= material.params.y;
+        }
+    }
+
+    float4 SoftwareTexture::Sample(float2 uv, const float2 uvPerPixelX, const float2 uvPerPixelY) const
+    {
+        if (mips.empty())
+        {
+            return {0.0f, 0.0f, 0.0f, 1.0f};
+        }
+
+        if (clamp)
+        {
+            uv = glm::clamp(uv, 0.0f, 1.0f);
+        }
+
+        // GL_LINEAR_MIPMAP_LINEAR minification, GL_LINEAR magnification
+        const float2 texels(sizes[0]);
+        const float lod = std::log2(std::max(glm::length(uvPerPixelX * texels), glm::length(uvPerPixelY * texels)));
+        if (!(lod > 0.0f) || mips.size() == 1)
+        {
+            return Bilinear(0, uv);
+        }
+
+        const float level = std::min(lod, static_cast<float>(mips.size() - 1));
+        const auto base = static_cast<size_t>(level);
+        if (base + 1 >= mips.size())
+        {
+            return Bilinear(base, uv);
+        }
+        return glm::mix(Bilinear(base, uv), Bilinear(base + 1, uv), level - static_cast<float>(base));
+    }
+
+    float4 SoftwareTexture::Bilinear(const size_t level, const float2 uv) const
+    {
+        const uint2 size = sizes[level];
+        const std::vector<uint32_t>& texels = mips[level];
+
+        const float2 position = uv * float2(size) - 0.5f;
+        const float2 first = glm::floor(position);
+        const float2 weight = position - first;
+
+        // The first texel wrapped or clamped, its right or upper neighbour follows from it
+        auto address = [this](const float coordinate, const uint32_t count)
+        {
+            const auto n = static_cast<int64_t>(count);
+            const auto first = static_cast<int64_t>(coordinate);
+            if (clamp)
+            {
+                return std::pair(static_cast<uint32_t>(std::clamp<int64_t>(first, 0, n - 1)), static_cast<uint32_t>(std::clamp<int64_t>(first + 1, 0, n - 1)));
+            }
+            const auto wrapped = static_cast<uint32_t>((first % n + n) % n);
+            return std::pair(wrapped, wrapped + 1 < count ? wrapped + 1 : 0);
+        };
+
+        const auto [x0, x1] = address(first.x, size.x);
+        const auto [y0, y1] = address(first.y, size.y);
+
+        const float4 bottom = glm::mix(SoftwareFramebuffer::Unpack(texels[size_t {y0} * size.x + x0]), SoftwareFramebuffer::Unpack(texels[size_t {y0} * size.x + x1]), weight.x);
+        const float4 top = glm::mix(SoftwareFramebuffer::Unpack(texels[size_t {y1} * size.x + x0]), SoftwareFramebuffer::Unpack(texels[size_t {y1} * size.x + x1]), weight.x);
+        return glm::mix(bottom, top, weight.y);
+    }
+
+    void SoftwareRasterizer::Reset(const uint2 targetSize, const size_t count)
+    {
+        size = targetSize;
+        tileCount = (size + uint2(TileSize - 1)) / TileSize;
+        tiles.resize(size_t {tileCount.x} * tileCount.y);
+        for (std::vector<uint32_t>& tile : tiles)
+        {
+            tile.clear();
+        }
+
+        // Clipping against the near plane turns a triangle into at most two
+        triangles.resize(count * 2);
+    }
+
+    void SoftwareRasterizer::Setup(const size_t index, const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, const uint32_t material, const RenderPass pass)
+    {
+        Triangle* slots = &triangles[index * 2];
+        slots[0].valid = false;
+        slots[1].valid = false;
+
+        // Entirely outside one plane of the view volume
+        auto outside = [&](auto&& test) { return test(a.position) && test(b.position) && test(c.position); };
+        if (outside([](const float4& p) { return p.x < -p.w; }) || outside([](const float4& p) { return p.x > p.w; })
+            || outside([](const float4& p) { return p.y < -p.w; }) || outside([](const float4& p) { return p.y > p.w; })
+            || outside([](const float4& p) { return p.z < -p.w; }) || outside([](const float4& p) { return p.z > p.w; }))
+        {
+            return;
+        }
+
+        // Only the near plane needs real clipping, the other planes are handled by the bounds and the depth test
+        const std::array<ClipVertex, 3> input {a, b, c};
+        std::array<ClipVertex, 4> polygon {};
+        size_t count {0};
+        for (size_t i = 0; i < input.size(); i++)
+        {
+            const ClipVertex& current = input[i];
+            const ClipVertex& next = input[(i + 1) % input.size()];
+            const float currentDistance = current.position.z + current.position.w;
+            const float nextDistance = next.position.z + next.position.w;
+
+            if (currentDistance >= 0.0f)
+            {
+                polygon[count++] = current;
+            }
+            if ((currentDistance >= 0.0f) != (nextDistance >= 0.0f))
+            {
+                polygon[count++] = Lerp(current, next, currentDistance / (currentDistance - nextDistance));
+            }
+        }
+
+        if (count >= 3)
+        {
+            SetupClipped(slots[0], std::span<const ClipVertex, 3>(polygon.data(), 3), material, pass);
+        }
+        if (count == 4)
+        {
+            const std::array<ClipVertex, 3> second {polygon[0], polygon[2], polygon[3]};
+            SetupClipped(slots[1], second, material, pass);
+        }
+    }
+
+    void SoftwareRasterizer::SetupClipped(Triangle& triangle, const std::span<const ClipVertex, 3> vertices, const uint32_t material, const RenderPass pass) const
+    {
+        std::array<float2, 3> screen {};
+        std::array<float, 3> depth {};
+        std::array<float, 3> inverseW {};
+        for (size_t i = 0; i < 3; i++)
+        {
+            if (!(vertices[i].position.w > 0.0f))
+            {
+                return;
+            }
+
+            inverseW[i] = 1.0f / vertices[i].position.w;
+            const float3 ndc = float3(vertices[i].position) * inverseW[i];
+            screen[i] = {(ndc.x * 0.5f + 0.5f) * static_cast<float>(size.x), (0.5f - ndc.y * 0.5f) * static_cast<float>(size.y)};
+            depth[i] = ndc.z * 0.5f + 0.5f;
+        }
+
+        // Both windings are drawn, flipping one makes every edge function positive inside
+        std::array<size_t, 3> order {0, 1, 2};
+        float area = Cross(screen[0], screen[1], screen[2]);
+        if (area < 0.0f)
+        {
+            std::swap(order[1], order[2]);
+            area = -area;
+        }
+        if (!(area > 0.0f))
+        {
+            return;
+        }
+
+        for (size_t i = 0; i < 3; i++)
+        {
+            const float2 from = screen[order[(i + 1) % 3]];
+            const float2 to = screen[order[(i + 2) % 3]];
+            const float2 delta = to - from;
+            triangle.edges[i] = float3(-delta.y, delta.x, delta.y * from.x - delta.x * from.y) / area;
+            triangle.topLeft[i] = (delta.y == 0.0f && delta.x > 0.0f) || delta.y < 0.0f;
+        }
+
+        // The weights sum to one everywhere, so any per-vertex value is the weighted sum of the edge planes
+        auto plane = [&](auto&& value)
+        {
+            return triangle.edges[0] * value(order[0]) + triangle.edges[1] * value(order[1]) + triangle.edges[2] * value(order[2]);
+        };
+        triangle.depth = plane([&](const size_t i) { return depth[i]; });
+        triangle.inverseW = plane([&](const size_t i) { return inverseW[i]; });
+        triangle.uOverW = plane([&](const size_t i) { return vertices[i].texCoord.x * inverseW[i]; });
+        triangle.vOverW = plane([&](const size_t i) { return vertices[i].texCoord.y * inverseW[i]; });
+        for (glm::length_t axis = 0; axis < 3; axis++)
+        {
+            triangle.viewOverW[axis] = plane([&](const size_t i) { return vertices[i].viewPosition[axis] * inverseW[i]; });
+        }
+
+        // Pixels whose center lies within the triangle's extent
+        const float2 lower = glm::min(screen[0], glm::min(screen[1], screen[2]));
+        const float2 upper = glm::max(screen[0], glm::max(screen[1], screen[2]));
+        const float2 limit = float2(size) - 1.0f;
+        const float2 first = glm::clamp(glm::ceil(lower - 0.5f), float2(0.0f), limit);
+        const float2 last = glm::clamp(glm::floor(upper - 0.5f), float2(-1.0f), limit);
+        triangle.bounds = {static_cast<int32_t>(first.x), static_cast<int32_t>(first.y), static_cast<int32_t>(last.x), static_cast<int32_t>(last.y)};
+
+        triangle.material = material;
+        triangle.pass = pass;
+        triangle.valid = triangle.bounds.x <= triangle.bounds.z && triangle.bounds.y <= triangle.bounds.w;
+    }
+
+    void SoftwareRasterizer::Draw(SoftwareFramebuffer& target, const std::span<const SoftwareTexture> textures, const std::span<const SoftwareMaterial> materials,
+        const FrameData& frame)
+    {
+        // Binning walks the slots in order, so every tile lists its triangles in draw order
+        for (size_t index = 0; index < triangles.size(); index++)
+        {
+            const Triangle& triangle = triangles[index];
+            if (!triangle.valid)
+            {
+                continue;
+            }
+
+            const uint4 tileBounds = uint4(triangle.bounds) / TileSize;
+            for (uint32_t y = tileBounds.y; y <= tileBounds.w; y++)
+            {
+                for (uint32_t x = tileBounds.x; x <= tileBounds.z; x++)
+                {
+                    tiles[size_t {y} * tileCount.x + x].push_back(static_cast<uint32_t>(index));
+                }
+            }
+        }
+
+        jobs.ParallelFor(tiles.size(), 1, [&](const size_t begin, const size_t end, uint32_t)
+        {
+            for (size_t tile = begin; tile < end; tile++)
+            {
+                DrawTile(target, static_cast<uint32_t>(tile), textures, materials, frame);
+            }
+        });
+    }
+
+    void SoftwareRasterizer::DrawTile(SoftwareFramebuffer& target, const uint32_t tile, const std::span<const SoftwareTexture> textures, const std::span<const SoftwareMaterial> materials,
+        const FrameData& frame) const
+    {
+        const std::vector<uint32_t>& indices = tiles[tile];
+        if (indices.empty())
+        {
+            return;
+        }
+
+        const uint2 origin = uint2(tile % tileCount.x, tile / tileCount.x) * TileSize;
+        const uint2 end = glm::min(origin + TileSize, size);
+        const uint32_t stride = target.Stride();
+        uint32_t* color = target.Color().data();
+        float* depthBuffer = target.Depth().data();
+
+        const __m128 laneOffsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+        const __m128 zero = _mm_setzero_ps();
+        const __m128 allSet = _mm_castsi128_ps(_mm_set1_epi32(-1));
+
+        for (const uint32_t index : indices)
+        {
+            const Triangle& triangle = triangles[index];
+            const SoftwareMaterial& material = materials[triangle.material];
+            const bool depthTest = triangle.pass != RenderPass::Overlay;
+            const bool depthWrite = triangle.pass == RenderPass::Opaque;
+            const bool blend = triangle.pass != RenderPass::Opaque;
+            const bool lit = material.clusteredLighting && frame.lights != nullptr;
+
+            // Rows are padded to four pixels and tiles are a multiple of four wide, so groups never cross either
+            const uint32_t firstX = std::max<uint32_t>(triangle.bounds.x, origin.x) & ~3u;
+            const uint32_t lastX = std::min<uint32_t>(triangle.bounds.z, end.x - 1);
+            const uint32_t firstY = std::max<uint32_t>(triangle.bounds.y, origin.y);
+            const uint32_t lastY = std::min<uint32_t>(triangle.bounds.w, end.y - 1);
+
+            __m128 edgeX[3];
+            __m128 onEdge[3];
+            for (size_t i = 0; i < 3; i++)
+            {
+                edgeX[i] = _mm_set1_ps(triangle.edges[i].x);
+                onEdge[i] = triangle.topLeft[i] ? allSet : zero;
+            }
+            const __m128 depthX = _mm_set1_ps(triangle.depth.x);
+
+            for (uint32_t y = firstY; y <= lastY; y++)
+            {
+                const float centerY = static_cast<float>(y) + 0.5f;
+                __m128 edgeRow[3];
+                for (size_t i = 0; i < 3; i++)
+                {
+                    edgeRow[i] = _mm_set1_ps(triangle.edges[i].y * centerY + triangle.edges[i].z);
+                }
+                const __m128 depthRow = _mm_set1_ps(triangle.depth.y * centerY + triangle.depth.z);
+
+                for (uint32_t x = firstX; x <= lastX; x += 4)
+                {
+                    const __m128 centerX = _mm_add_ps(_mm_set1_ps(static_cast<float>(x)), laneOffsets);
+
+                    __m128 inside = allSet;
+                    for (size_t i = 0; i < 3; i++)
+                    {
+                        const __m128 weight = _mm_add_ps(_mm_mul_ps(edgeX[i], centerX), edgeRow[i]);
+                        const __m128 covered = _mm_or_ps(_mm_cmpgt_ps(weight, zero), _mm_and_ps(_mm_cmpeq_ps(weight, zero), onEdge[i]));
+                        inside = _mm_and_ps(inside, covered);
+                    }
+
+                    uint32_t mask = static_cast<uint32_t>(_mm_movemask_ps(inside));
+                    if (x + 4 > size.x)
+                    {
+                        mask &= (1u << (size.x - x)) - 1;
+                    }
+                    if (mask == 0)
+                    {
+                        continue;
+                    }
+
+                    const size_t pixel = size_t {y} * stride + x;
+                    const __m128 depth = _mm_add_ps(_mm_mul_ps(depthX, centerX), depthRow);
+                    if (depthTest)
+                    {
+                        mask &= static_cast<uint32_t>(_mm_movemask_ps(_mm_cmplt_ps(depth, _mm_loadu_ps(depthBuffer + pixel))));
+                    }
+
+                    alignas(16) std::array<float, 4> depths {};
+                    _mm_store_ps(depths.data(), depth);
+
+                    for (; mask != 0; mask &= mask - 1)
+                    {
+                        const auto lane = static_cast<uint32_t>(std::countr_zero(mask));
+
+                        const float centerX = static_cast<float>(x + lane) + 0.5f;
+                        float3 light(1.0f);
+                        if (lit)
+                        {
+                            const float w = 1.0f / Evaluate(triangle.inverseW, centerX, centerY);
+                            const float3 viewPosition = float3(Evaluate(triangle.viewOverW[0], centerX, centerY),
+                                Evaluate(triangle.viewOverW[1], centerX, centerY), Evaluate(triangle.viewOverW[2], centerX, centerY)) * w;
+                            light = ClusteredLight(*frame.lights, frame.ambientLight, float2(centerX, static_cast<float>(size.y) - centerY), viewPosition);
+                        }
+
+                        float4 rgba {};
+                        if (!Shade(triangle.inverseW, triangle.uOverW, triangle.vOverW, material, textures, centerX, centerY, light, rgba))
+                        {
+                            continue;
+                        }
+
+                        if (depthWrite)
+                        {
+                            depthBuffer[pixel + lane] = depths[lane];
+                        }
+
+                        // GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA on every channel
+                        uint32_t& destination = color[pixel + lane];
+                        destination = SoftwareFramebuffer::Pack(blend ? rgba * rgba.a + SoftwareFramebuffer::Unpack(destination) * (1.0f - rgba.a) : rgba);
+                    }
+                }
+            }
+        }
+    }
+}
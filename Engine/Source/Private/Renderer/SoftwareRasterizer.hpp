@@ -0,0 +1,107 @@
+﻿#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "RenderTypes.hpp"
+
+namespace blackbox
+{
+    class JobSystem;
+    class SoftwareFramebuffer;
+    struct FrameData;
+
+    // RGBA8 image with its mip chain, sampled like the GL backend samples it from the TextureAtlas
+    struct SoftwareTexture
+    {
+        std::vector<uint2> sizes {};                 // Per mip
+        std::vector<std::vector<uint32_t>> mips {};  // Packed RGBA8, first row is texture coordinate v = 0
+        bool clamp {false}; // Images sharing an atlas page in GL can't repeat, see TextureAtlas.glsl
+
+        // Trilinear with the mip picked from the texture coordinate derivatives per pixel
+        [[nodiscard]] float4 Sample(float2 uv, float2 uvPerPixelX, float2 uvPerPixelY) const;
+
+    private:
+        [[nodiscard]] float4 Bilinear(size_t level, float2 uv) const;
+    };
+
+    // What basic.frag needs to shade a pixel, its variants become flags
+    struct SoftwareMaterial
+    {
+        std::array<TextureHandle, 2> textures {}; // `texture1` and `texture2`
+        float4 color {1.0f};
+        float4 params {0.0f};
+        bool textureBlend {false};
+        bool alphaTest {false};
+        bool clusteredLighting {false};
+    };
+
+    // Output of the vertex stage, basic.vert's gl_Position, texCoord and viewPosition
+    struct ClipVertex
+    {
+        float4 position {};
+        float2 texCoord {};
+        float3 viewPosition {};
+    };
+
+    /**
+     * Tile-binned triangle rasterizer with a depth buffer and perspective-correct texturing.
+     *
+     * Triangles are set up into fixed slots, so the vertex stage can run on any number of threads and the draw
+     * order stays the order of the slots. Draw bins them into TileSize squares and rasterizes the tiles in
+     * parallel on the JobSystem, each tile walks its triangles in slot order, which keeps depth ties and blending
+     * identical to drawing one triangle after another. Coverage and the depth test run on four pixels at a time
+     * with SSE2, shading runs per covered pixel.
+     *
+     * Follows GL's conventions: pixel centers at .5, a top-left fill rule, clipping against -w <= z and depth
+     * z / w * 0.5 + 0.5 tested with GL_LESS.
+     */
+    class SoftwareRasterizer
+    {
+    public:
+        static constexpr uint32_t TileSize = 64;
+
+    private:
+        // Attributes are planes in screen space: value = x * plane.x + y * plane.y + plane.z
+        struct Triangle
+        {
+            std::array<float3, 3> edges {};     // Barycentric weight of each vertex
+            std::array<bool, 3> topLeft {};     // Pixels exactly on an edge only belong to top and left edges
+            float3 depth {};
+            float3 inverseW {};
+            float3 uOverW {};
+            float3 vOverW {};
+            std::array<float3, 3> viewOverW {}; // View-space position, for clustered lighting
+            int4 bounds {};                     // Covered pixels, min x, min y, max x, max y inclusive
+            uint32_t material {0};
+            RenderPass pass {RenderPass::Opaque};
+            bool valid {false};
+        };
+
+        JobSystem& jobs;
+        std::vector<Triangle> triangles {};
+        std::vector<std::vector<uint32_t>> tiles {}; // Triangle indices per tile, row by row
+        uint2 size {};
+        uint2 tileCount {};
+
+    public:
+        explicit SoftwareRasterizer(JobSystem& jobs) : jobs(jobs) {}
+
+        // Start a batch of `count` triangles for a target of `targetSize`
+        void Reset(uint2 targetSize, size_t count);
+
+        // Clip and set up triangle `index` of the batch, safe to call from several threads for different indices
+        void Setup(size_t index, const ClipVertex& a, const ClipVertex& b, const ClipVertex& c, uint32_t material, RenderPass pass);
+
+        // Rasterize the batch into `target`, `materials` is indexed by the material passed to Setup. Lit materials
+        // read the frame's LightClusters and ambient light.
+        void Draw(SoftwareFramebuffer& target, std::span<const SoftwareTexture> textures, std::span<const SoftwareMaterial> materials, const FrameData& frame);
+
+    private:
+        void SetupClipped(Triangle& triangle, std::span<const ClipVertex, 3> vertices, uint32_t material, RenderPass pass) const;
+        void DrawTile(SoftwareFramebuffer& target, uint32_t tile, std::span<const SoftwareTexture> textures, std::span<const SoftwareMaterial> materials,
+            const FrameData& frame) const;
+    };
+}
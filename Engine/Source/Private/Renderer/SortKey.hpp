@@ -0,0 +1,55 @@
+﻿#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include "RenderTypes.hpp"
+
+namespace blackbox
+{
+    /**
+     * 64-bit draw sort key, sorting packets by key gives the execution order for the frame.
+     *
+     *   Opaque/Overlay:  pass:4 | shader:10 | material:14 | mesh:12 | depth:24
+     *   Transparent:     pass:4 | ~depth:24 | shader:10 | material:14 | mesh:12
+     *
+     * Opaque draws are grouped by state first and sorted front to back within a group, transparent draws need
+     * strict back to front order so their inverted depth goes above the state bits.
+     */
+    struct SortKey
+    {
+        static constexpr uint32_t PassBits = 4;
+        static constexpr uint32_t ShaderBits = 10;
+        static constexpr uint32_t MaterialBits = 14;
+        static constexpr uint32_t MeshBits = 12;
+        static constexpr uint32_t DepthBits = 24;
+        static_assert(PassBits + ShaderBits + MaterialBits + MeshBits + DepthBits == 64);
+
+        static constexpr uint32_t MaxShaders = 1u << ShaderBits;
+        static constexpr uint32_t MaxMaterials = 1u << MaterialBits;
+        static constexpr uint32_t MaxMeshes = 1u << MeshBits;
+
+        // `depth` is the normalized view distance, 0 at the camera and 1 at the far plane
+        [[nodiscard]] static uint64_t Make(RenderPass pass, ShaderHandle shader, MaterialHandle material, MeshHandle mesh, float depth);
+
+        [[nodiscard]] static RenderPass Pass(const uint64_t key) { return static_cast<RenderPass>(key >> (64 - PassBits)); }
+    };
+
+    inline uint64_t SortKey::Make(const RenderPass pass, const ShaderHandle shader, const MaterialHandle material, const MeshHandle mesh, const float depth)
+    {
+        constexpr uint64_t depthMax = (1ull << DepthBits) - 1;
+        const auto quantizedDepth = static_cast<uint64_t>(std::clamp(depth, 0.0f, 1.0f) * static_cast<float>(depthMax));
+
+        const uint64_t state = (static_cast<uint64_t>(shader.id & (MaxShaders - 1)) << (MaterialBits + MeshBits))
+            | (static_cast<uint64_t>(material.id & (MaxMaterials - 1)) << MeshBits)
+            | static_cast<uint64_t>(mesh.id & (MaxMeshes - 1));
+
+        const uint64_t passBits = static_cast<uint64_t>(pass) << (64 - PassBits);
+        if (pass == RenderPass::Transparent)
+        {
+            return passBits | ((depthMax - quantizedDepth) << (ShaderBits + MaterialBits + MeshBits)) | state;
+        }
+
+        return passBits | (state << DepthBits) | quantizedDepth;
+    }
+}
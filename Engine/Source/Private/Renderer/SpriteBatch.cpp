@@ -0,0 +1,92 @@
+﻿#include "SpriteBatch.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+#include "Blackbox.hpp"
+
+namespace blackbox
+{
+    namespace
+    {
+        uint16_t Normalized16(const float value)
+        {
+            return static_cast<uint16_t>(std::clamp(value, 0.0f, 1.0f) * 65535.0f + 0.5f);
+        }
+
+        uint32_t PackColor(const float4& color)
+        {
+            const glm::uvec4 bytes(glm::clamp(color, 0.0f, 1.0f) * 255.0f + 0.5f);
+            return bytes.r | bytes.g << 8 | bytes.b << 16 | bytes.a << 24;
+        }
+    }
+
+    void SpriteBatch::Submit(const Sprite& sprite)
+    {
+        if (sprites.size() >= MaxSprites)
+        {
+            if (!limitReported)
+            {
+                LogRenderer->Warn("More than {} sprites submitted in one frame, the rest are dropped", MaxSprites);
+                limitReported = true;
+            }
+            return;
+        }
+        sprites.push_back(sprite);
+    }
+
+    void SpriteBatch::Sort()
+    {
+        // Layers are biased to sort as unsigned, texture ids fill the low 32 bits. RadixSort is stable, so
+        // sprites with equal keys keep their submission order.
+        keys.resize(sprites.size());
+        for (uint32_t index = 0; index < sprites.size(); index++)
+        {
+            const Sprite& sprite = sprites[index];
+            keys[index] = {.key = uint64_t {static_cast<uint16_t>(sprite.layer) ^ 0x8000u} << 32 | sprite.texture.id, .packet = index};
+        }
+        RadixSort(keys, scratch);
+
+        order.resize(keys.size());
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            order[i] = keys[i].packet;
+        }
+    }
+
+    void SpriteBatch::Clear()
+    {
+        sprites.clear();
+        order.clear();
+    }
+
+    SpriteCorners SpriteBatch::Corners(const Sprite& sprite)
+    {
+        // With y pointing down the usual rotation turns clockwise on screen
+        const float2 half = sprite.size * 0.5f;
+        const float cosine = std::cos(sprite.rotation);
+        const float sine = std::sin(sprite.rotation);
+        const float2 right = float2(cosine, sine) * half.x;
+        const float2 down = float2(-sine, cosine) * half.y;
+
+        // Textures are stored bottom row first, the top of the quad shows the top of the rect
+        const float2 uvMin(sprite.uvRect.x, sprite.uvRect.y);
+        const float2 uvMax = uvMin + float2(sprite.uvRect.z, sprite.uvRect.w);
+        return {
+            .positions = {sprite.position - right - down, sprite.position + right - down, sprite.position + right + down, sprite.position - right + down},
+            .texCoords = {float2(uvMin.x, uvMax.y), uvMax, float2(uvMax.x, uvMin.y), uvMin},
+        };
+    }
+
+    void SpriteBatch::WriteQuad(const Sprite& sprite, const float4& atlasRect, const std::span<SpriteVertex, 4> quad)
+    {
+        // Clamped like SampleAtlas clamps images sharing a layer, sprites never repeat their texture
+        const SpriteCorners corners = Corners(sprite);
+        const uint32_t color = PackColor(sprite.color);
+        for (size_t corner = 0; corner < 4; corner++)
+        {
+            const float2 texCoord = float2(atlasRect) + glm::clamp(corners.texCoords[corner], 0.0f, 1.0f) * float2(atlasRect.z, atlasRect.w);
+            quad[corner] = {.position = corners.positions[corner], .texCoord = {Normalized16(texCoord.x), Normalized16(texCoord.y)}, .color = color};
+        }
+    }
+}
@@ -0,0 +1,77 @@
+﻿#pragma once
+
+#include <array>
+#include <cstdint>
+#include <span>
+#include <vector>
+
+#include "RenderCommandBuffer.hpp"
+#include "RenderTypes.hpp"
+
+namespace blackbox
+{
+    // Where a sprite's quad lies on screen and what part of its texture it shows
+    struct SpriteCorners
+    {
+        std::array<float2, 4> positions {}; // Pixels, top left, top right, bottom right, bottom left
+        std::array<float2, 4> texCoords {}; // Texture coordinates of the same corners
+    };
+
+    // Corner of a sprite quad as GLBackend streams it, read by sprite.vert
+    struct SpriteVertex
+    {
+        float2 position {};                  // Pixels
+        std::array<uint16_t, 2> texCoord {}; // Normalized within the atlas layer
+        uint32_t color {0};                  // RGBA8
+    };
+
+    /**
+     * Sprites of one frame, sorted for drawing in as few batches as possible.
+     *
+     * Sort orders the sprites by layer and within a layer by texture with RadixSort over their keys, so
+     * sprites sharing a texture end up next to each other and a backend draws each run with one call. Sprites
+     * with the same layer and texture keep the order they were submitted in. Within a layer sprites of
+     * different textures draw in texture order, overlapping sprites that need a fixed order go on different
+     * layers.
+     *
+     *   sprites.Submit({.position = {64.0f, 64.0f}, .size = {32.0f, 32.0f}, .texture = icon, .layer = 1});
+     *   sprites.Sort();
+     *   for (const uint32_t index : sprites.Order()) { ... sprites.Sprites()[index] ... }
+     *
+     * Sprites are submitted from the thread that owns the renderer and only live for one frame.
+     */
+    class SpriteBatch
+    {
+    public:
+        static constexpr uint32_t MaxSprites = 1u << 22;
+
+    private:
+        std::vector<Sprite> sprites {};
+        std::vector<SortEntry> keys {}; // Layer, then texture, with the sprite's index as the packet
+        std::vector<SortEntry> scratch {};
+        std::vector<uint32_t> order {};
+        bool limitReported {false};
+
+    public:
+        SpriteBatch() = default;
+
+        SpriteBatch(const SpriteBatch& other) = delete;
+        SpriteBatch& operator=(const SpriteBatch&) = delete;
+        SpriteBatch(SpriteBatch&& other) = delete;
+        SpriteBatch& operator=(SpriteBatch&& other) = delete;
+
+        // Dropped with a warning beyond MaxSprites
+        void Submit(const Sprite& sprite);
+        void Sort();
+        void Clear();
+
+        [[nodiscard]] bool Empty() const { return sprites.empty(); }
+        [[nodiscard]] std::span<const Sprite> Sprites() const { return sprites; }
+        // Indices into Sprites in drawing order, valid after Sort
+        [[nodiscard]] std::span<const uint32_t> Order() const { return order; }
+
+        [[nodiscard]] static SpriteCorners Corners(const Sprite& sprite);
+        // The corners of a sprite whose texture lies at `atlasRect` of its atlas layer, as offset and scale
+        static void WriteQuad(const Sprite& sprite, const float4& atlasRect, std::span<SpriteVertex, 4> quad);
+    };
+}
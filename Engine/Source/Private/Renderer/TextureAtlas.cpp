@@ -0,0 +1,291 @@
+﻿#include "TextureAtlas.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <glad/glad.h>
+
+#include "Blackbox.hpp"
+#include "GLStateCache.hpp"
+
+namespace blackbox
+{
+    namespace
+    {
+        constexpr uint32_t InitialLayers = 4;
+    }
+
+    TextureAtlas::TextureAtlas(GLStateCache& state)
+        : state(state)
+    {
+        GLint layers {0};
+        glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &layers);
+        maxLayers = static_cast<uint32_t>(layers);
+        glGenFramebuffers(1, &copyFramebuffer);
+    }
+
+    TextureAtlas::~TextureAtlas()
+    {
+        for (const Bin& bin : bins)
+        {
+            glDeleteTextures(1, &bin.texture);
+        }
+        glDeleteFramebuffers(1, &copyFramebuffer);
+    }
+
+    std::optional<AtlasRegion> TextureAtlas::Insert(const std::span<const uint8_t> rgba, const uint2 size)
+    {
+        return Add(rgba, size, 0, false);
+    }
+
+    std::optional<AtlasRegion> TextureAtlas::InsertStreamed(const std::span<const uint8_t> rgba, const uint2 size, const uint32_t level)
+    {
+        if (size.x <= SmallTextureSize && size.y <= SmallTextureSize)
+        {
+            return std::nullopt;
+        }
+        return Add(rgba, size, level, true);
+    }
+
+    void TextureAtlas::StreamIn(const uint32_t binIndex, const std::span<const std::vector<uint8_t>> layers)
+    {
+        Bin& bin = bins[binIndex];
+        if (bin.residentLevel == 0 || layers.size() != bin.layers.size())
+        {
+            return;
+        }
+
+        const uint32_t level = bin.residentLevel - 1;
+        const uint2 size = MipSize(bin.layerSize, level);
+        state.BindTextureForEdit(0, GL_TEXTURE_2D_ARRAY, bin.texture);
+        glTexImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level), GL_RGBA8, static_cast<GLsizei>(size.x), static_cast<GLsizei>(size.y),
+            static_cast<GLsizei>(bin.capacity), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+        for (uint32_t layer = 0; layer < layers.size(); layer++)
+        {
+            Upload(bin, layer, uint2(0), layers[layer], size, level);
+        }
+
+        // Coarser mips are already there, the new level only becomes visible by lowering the base level
+        state.BindTextureForEdit(0, GL_TEXTURE_2D_ARRAY, bin.texture);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(level));
+        bin.residentLevel = level;
+    }
+
+    void TextureAtlas::Evict(const uint32_t binIndex, uint32_t level)
+    {
+        Bin& bin = bins[binIndex];
+        level = std::min(level, bin.levels - 1);
+        if (level <= bin.residentLevel)
+        {
+            return;
+        }
+
+        state.BindTextureForEdit(0, GL_TEXTURE_2D_ARRAY, bin.texture);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(level));
+
+        // Redefining a mip as empty is the only way to give its memory back on a mutable texture
+        for (uint32_t released = bin.residentLevel; released < level; released++)
+        {
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(released), GL_RGBA8, 0, 0, 0, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+        bin.residentLevel = level;
+    }
+
+    std::optional<AtlasRegion> TextureAtlas::Add(const std::span<const uint8_t> rgba, const uint2 size, const uint32_t level, const bool streamed)
+    {
+        const uint2 mipSize = MipSize(size, level);
+        if (size.x == 0 || size.y == 0 || rgba.size() < size_t {mipSize.x} * mipSize.y * 4)
+        {
+            return std::nullopt;
+        }
+
+        const bool small = size.x <= SmallTextureSize && size.y <= SmallTextureSize;
+        const uint2 layerSize = small ? uint2(PageSize) : size;
+        const uint32_t padding = small ? Padding : 0;
+
+        const size_t binIndex = FindBin(layerSize, padding, streamed);
+        Bin& bin = bins[binIndex];
+
+        // A streamed bin holds one resident level for all layers. Newcomers bring a coarse mip, so finer ones go.
+        if (bin.texture == 0)
+        {
+            bin.residentLevel = std::min(level, bin.levels - 1);
+        }
+        else if (level > bin.residentLevel)
+        {
+            Evict(static_cast<uint32_t>(binIndex), level);
+        }
+        else if (level < bin.residentLevel)
+        {
+            LogRenderer->Error("Texture bin for {}x{} layers has no mip {} resident", layerSize.x, layerSize.y, level);
+            return std::nullopt;
+        }
+
+        const uint2 padded = size + uint2(padding * 2);
+        std::optional<uint2> cell {};
+        uint32_t layer {0};
+        for (; layer < bin.layers.size() && !cell.has_value(); layer++)
+        {
+            cell = bin.layers[layer].Insert(padded);
+        }
+
+        if (!cell.has_value())
+        {
+            if (bin.layers.size() >= maxLayers)
+            {
+                LogRenderer->Error("Texture bin for {}x{} layers is full ({} layers)", layerSize.x, layerSize.y, maxLayers);
+                return std::nullopt;
+            }
+
+            bin.layers.emplace_back(layerSize, std::max(padding, 1u));
+            cell = bin.layers.back().Insert(padded);
+            layer = static_cast<uint32_t>(bin.layers.size());
+            Reserve(bin, layer);
+        }
+
+        layer--;
+        Upload(bin, layer, *cell, rgba, mipSize, level);
+        bin.mipsDirty = true;
+
+        // Divided rather than scaled, so an image filling its layer gets a scale of exactly 1
+        return AtlasRegion {
+            .bin = static_cast<uint32_t>(binIndex),
+            .layer = layer,
+            .rect = {float2(*cell + uint2(padding)) / float2(layerSize), float2(size) / float2(layerSize)},
+        };
+    }
+
+    void TextureAtlas::Flush()
+    {
+        for (Bin& bin : bins)
+        {
+            if (bin.mipsDirty)
+            {
+                state.BindTextureForEdit(0, GL_TEXTURE_2D_ARRAY, bin.texture);
+                glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+                bin.mipsDirty = false;
+            }
+        }
+    }
+
+    size_t TextureAtlas::LevelBytes(const uint32_t bin, const uint32_t level) const
+    {
+        const uint2 size = MipSize(bins[bin].layerSize, level);
+        return size_t {size.x} * size.y * 4 * bins[bin].capacity;
+    }
+
+    size_t TextureAtlas::ResidentBytes(const uint32_t bin) const
+    {
+        size_t bytes {0};
+        for (uint32_t level = bins[bin].residentLevel; level < bins[bin].levels; level++)
+        {
+            bytes += LevelBytes(bin, level);
+        }
+        return bytes;
+    }
+
+    AtlasStats TextureAtlas::Stats() const
+    {
+        AtlasStats stats {.bins = static_cast<uint32_t>(bins.size())};
+        for (uint32_t bin = 0; bin < bins.size(); bin++)
+        {
+            stats.layers += bins[bin].capacity;
+            stats.bytes += ResidentBytes(bin);
+        }
+        return stats;
+    }
+
+    size_t TextureAtlas::FindBin(const uint2 layerSize, const uint32_t padding, const bool streamed)
+    {
+        const auto existing = std::ranges::find_if(bins, [&](const Bin& bin)
+        {
+            return bin.layerSize == layerSize && bin.padding == padding && bin.streamed == streamed;
+        });
+        if (existing != bins.end())
+        {
+            return static_cast<size_t>(existing - bins.begin());
+        }
+
+        Bin& bin = bins.emplace_back();
+        bin.layerSize = layerSize;
+        bin.padding = padding;
+        // Deeper mips would average texels of neighbouring images in a shared page
+        bin.levels = padding > 0 ? std::countr_zero(padding) + 1 : std::bit_width(std::max(layerSize.x, layerSize.y));
+        bin.streamed = streamed;
+        return bins.size() - 1;
+    }
+
+    void TextureAtlas::Reserve(Bin& bin, const uint32_t layers)
+    {
+        if (layers <= bin.capacity)
+        {
+            return;
+        }
+
+        const uint32_t capacity = std::min(std::max({layers, bin.capacity * 2, InitialLayers}), maxLayers);
+
+        uint32_t texture {0};
+        glGenTextures(1, &texture);
+        state.BindTextureForEdit(0, GL_TEXTURE_2D_ARRAY, texture);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, static_cast<GLint>(bin.residentLevel));
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, static_cast<GLint>(bin.levels - 1));
+        for (uint32_t level = bin.residentLevel; level < bin.levels; level++)
+        {
+            const uint2 size = MipSize(bin.layerSize, level);
+            glTexImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level), GL_RGBA8, static_cast<GLsizei>(size.x), static_cast<GLsizei>(size.y),
+                static_cast<GLsizei>(capacity), 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+        }
+
+        // GL 3.3 has no glCopyImageSubData, layers are copied by reading them through a framebuffer instead.
+        // Only the finest resident mip is copied, the rest is regenerated on the next Flush.
+        if (bin.texture != 0)
+        {
+            const uint2 size = MipSize(bin.layerSize, bin.residentLevel);
+            const auto level = static_cast<GLint>(bin.residentLevel);
+            state.BindFramebuffer(copyFramebuffer);
+            for (uint32_t layer = 0; layer < bin.capacity; layer++)
+            {
+                glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, bin.texture, level, static_cast<GLint>(layer));
+                glCopyTexSubImage3D(GL_TEXTURE_2D_ARRAY, level, 0, 0, static_cast<GLint>(layer), 0, 0, static_cast<GLsizei>(size.x), static_cast<GLsizei>(size.y));
+            }
+            glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, 0, 0, 0);
+            state.BindFramebuffer(0);
+
+            glDeleteTextures(1, &bin.texture);
+            LogRenderer->Trace("Grew {}x{} texture bin to {} layers", bin.layerSize.x, bin.layerSize.y, capacity);
+        }
+
+        bin.texture = texture;
+        bin.capacity = capacity;
+        bin.mipsDirty = true;
+    }
+
+    void TextureAtlas::Upload(const Bin& bin, const uint32_t layer, const uint2 position, const std::span<const uint8_t> rgba, const uint2 size, const uint32_t level) const
+    {
+        // `size` is the size of `rgba` at `level`, only streamed bins, which have no padding, upload above level 0
+        // The whole aligned cell is written so every texel a clean mip level can reach holds a copy of an edge
+        const uint32_t alignment = std::max(bin.padding, 1u);
+        const uint2 cell = (size + uint2(bin.padding * 2) + uint2(alignment - 1)) / alignment * alignment;
+        const uint2 extent = glm::min(cell, MipSize(bin.layerSize, level) - position);
+
+        std::vector<uint8_t> pixels(size_t {extent.x} * extent.y * 4);
+        for (uint32_t y = 0; y < extent.y; y++)
+        {
+            const uint32_t sourceY = static_cast<uint32_t>(std::clamp<int64_t>(int64_t {y} - bin.padding, 0, size.y - 1));
+            for (uint32_t x = 0; x < extent.x; x++)
+            {
+                const uint32_t sourceX = static_cast<uint32_t>(std::clamp<int64_t>(int64_t {x} - bin.padding, 0, size.x - 1));
+                std::copy_n(rgba.data() + (size_t {sourceY} * size.x + sourceX) * 4, 4, pixels.data() + (size_t {y} * extent.x + x) * 4);
+            }
+        }
+
+        state.BindTextureForEdit(0, GL_TEXTURE_2D_ARRAY, bin.texture);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexSubImage3D(GL_TEXTURE_2D_ARRAY, static_cast<GLint>(level), static_cast<GLint>(position.x), static_cast<GLint>(position.y), static_cast<GLint>(layer),
+            static_cast<GLsizei>(extent.x), static_cast<GLsizei>(extent.y), 1, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    }
+}
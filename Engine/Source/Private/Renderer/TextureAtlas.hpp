@@ -0,0 +1,110 @@
+﻿#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "SkylinePacker.hpp"
+#include "Types.hpp"
+
+namespace blackbox
+{
+    class GLStateCache;
+
+    // Where a texture ended up, `rect` is offset and scale of its texture coordinates within the layer
+    struct AtlasRegion
+    {
+        uint32_t bin {0};
+        uint32_t layer {0};
+        float4 rect {0.0f, 0.0f, 1.0f, 1.0f};
+    };
+
+    struct AtlasStats
+    {
+        uint32_t bins {0};
+        uint32_t layers {0};
+        size_t bytes {0}; // Resident mips of every allocated layer
+    };
+
+    /**
+     * Bins RGBA8 images into GL_TEXTURE_2D_ARRAY textures so materials share texture bindings.
+     *
+     * Images up to SmallTextureSize on both sides are packed into shared PageSize pages with a SkylinePacker.
+     * Each one is surrounded by Padding replicated edge texels and aligned to it, which keeps bilinear filtering
+     * and mips up to log2(Padding) from bleeding between neighbours. Small images therefore don't repeat, their
+     * shader clamps texture coordinates to the image. Larger images take a whole layer of a bin holding only
+     * images of exactly their size, so they keep their full mip chain and repeat like a plain texture.
+     *
+     * Bins grow by doubling their layer count, which replaces their texture object. Look the texture up with
+     * Texture() when binding instead of keeping the id.
+     *
+     * Large images can also be inserted streamed, with only a coarse mip loaded. They go into bins of their own whose
+     * finest resident mip is GL_TEXTURE_BASE_LEVEL. StreamIn adds the next finer mip to all layers of such a bin at
+     * once and Evict releases the finest ones again, TextureStreamer decides when.
+     */
+    class TextureAtlas
+    {
+    public:
+        static constexpr uint32_t SmallTextureSize = 256;
+        static constexpr uint32_t PageSize = 1024;
+        static constexpr uint32_t Padding = 8;
+
+    private:
+        struct Bin
+        {
+            uint2 layerSize {};
+            uint32_t padding {0};
+            uint32_t texture {0};
+            uint32_t capacity {0}; // Allocated layers, at least layers.size()
+            std::vector<SkylinePacker> layers {};
+            uint32_t levels {1};        // Mips of a fully resident layer
+            uint32_t residentLevel {0}; // Finest allocated mip, only streamed bins go above 0
+            bool streamed {false};
+            bool mipsDirty {false};
+        };
+
+        GLStateCache& state;
+        std::vector<Bin> bins {};
+        uint32_t copyFramebuffer {0};
+        uint32_t maxLayers {0};
+
+    public:
+        explicit TextureAtlas(GLStateCache& state);
+        ~TextureAtlas();
+
+        TextureAtlas(const TextureAtlas& other) = delete;
+        TextureAtlas& operator=(const TextureAtlas&) = delete;
+        TextureAtlas(TextureAtlas&& other) = delete;
+        TextureAtlas& operator=(TextureAtlas&& other) = delete;
+
+        // Copy `rgba` into a bin, nothing when the image is empty or its bin is full
+        [[nodiscard]] std::optional<AtlasRegion> Insert(std::span<const uint8_t> rgba, uint2 size);
+        // Like Insert for an image larger than SmallTextureSize of which only mip `level` is loaded, `rgba` is that mip
+        [[nodiscard]] std::optional<AtlasRegion> InsertStreamed(std::span<const uint8_t> rgba, uint2 size, uint32_t level);
+
+        // Add mip ResidentLevel(bin) - 1, `layers` holds it for every layer of the bin in order
+        void StreamIn(uint32_t bin, std::span<const std::vector<uint8_t>> layers);
+        // Release the mips finer than `level`
+        void Evict(uint32_t bin, uint32_t level);
+
+        // Rebuild the mips of bins that received images, call once before drawing
+        void Flush();
+
+        [[nodiscard]] uint32_t Texture(const uint32_t bin) const { return bins[bin].texture; }
+        [[nodiscard]] uint32_t Layers(const uint32_t bin) const { return static_cast<uint32_t>(bins[bin].layers.size()); }
+        [[nodiscard]] uint32_t ResidentLevel(const uint32_t bin) const { return bins[bin].residentLevel; }
+        [[nodiscard]] size_t LevelBytes(uint32_t bin, uint32_t level) const;
+        [[nodiscard]] size_t ResidentBytes(uint32_t bin) const;
+        [[nodiscard]] AtlasStats Stats() const;
+
+        // Size of mip `level` of an image, rounded like GL does
+        [[nodiscard]] static uint2 MipSize(const uint2 size, const uint32_t level) { return glm::max(size >> level, uint2(1)); }
+
+    private:
+        [[nodiscard]] std::optional<AtlasRegion> Add(std::span<const uint8_t> rgba, uint2 size, uint32_t level, bool streamed);
+        [[nodiscard]] size_t FindBin(uint2 layerSize, uint32_t padding, bool streamed);
+        void Reserve(Bin& bin, uint32_t layers);
+        void Upload(const Bin& bin, uint32_t layer, uint2 position, std::span<const uint8_t> rgba, uint2 size, uint32_t level) const;
+    };
+}
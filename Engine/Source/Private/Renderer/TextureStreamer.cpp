@@ -0,0 +1,314 @@
+﻿#include "TextureStreamer.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+#include <stb/stb_image.h>
+
+#include "Blackbox.hpp"
+#include "FileIO.hpp"
+
+namespace blackbox
+{
+    TextureStreamer::TextureStreamer(const FileIO& fileIO, TextureAtlas& atlas)
+        : fileIO(fileIO)
+        , atlas(atlas)
+    {
+        thread = std::thread(&TextureStreamer::WorkerLoop, this);
+    }
+
+    TextureStreamer::~TextureStreamer()
+    {
+        {
+            std::lock_guard lock(mutex);
+            stopping = true;
+        }
+        wake.notify_one();
+        thread.join();
+    }
+
+    bool TextureStreamer::ShouldStream(const uint2 size)
+    {
+        return (size.x > TextureAtlas::SmallTextureSize || size.y > TextureAtlas::SmallTextureSize) && std::max(size.x, size.y) > ResidentSize;
+    }
+
+    std::optional<AtlasRegion> TextureStreamer::Add(const std::string& path, const std::span<const uint8_t> rgba, const uint2 size)
+    {
+        if (rgba.size() < size_t {size.x} * size.y * 4)
+        {
+            return std::nullopt;
+        }
+
+        uint32_t level {0};
+        std::vector<uint8_t> mip(rgba.begin(), rgba.end());
+        for (uint2 mipSize = size; std::max(mipSize.x, mipSize.y) > ResidentSize; mipSize = TextureAtlas::MipSize(size, ++level))
+        {
+            mip = Downsample(mip, mipSize);
+        }
+
+        const std::optional<AtlasRegion> region = atlas.InsertStreamed(mip, size, level);
+        if (!region.has_value())
+        {
+            return std::nullopt;
+        }
+
+        StreamedBin& bin = bins[region->bin];
+        bin.size = size;
+        bin.coarsestLevel = level;
+        bin.wantedLevel = level;
+        bin.paths.resize(std::max<size_t>(bin.paths.size(), region->layer + 1));
+        bin.paths[region->layer] = path;
+        return region;
+    }
+
+    void TextureStreamer::MarkVisible(const uint32_t bin, const float pixels)
+    {
+        const auto found = bins.find(bin);
+        if (found == bins.end())
+        {
+            return;
+        }
+
+        // The mip with about one texel per pixel, which is what the GPU samples when the texture faces the camera
+        StreamedBin& streamed = found->second;
+        const float texelsPerPixel = static_cast<float>(std::max(streamed.size.x, streamed.size.y)) / std::max(pixels, 1.0f);
+        const auto level = static_cast<uint32_t>(std::clamp(std::floor(std::log2(texelsPerPixel)), 0.0f, static_cast<float>(streamed.coarsestLevel)));
+
+        streamed.wantedLevel = std::min(streamed.wantedLevel, level);
+        streamed.coverage = std::max(streamed.coverage, pixels);
+        streamed.lastVisibleFrame = frame;
+    }
+
+    void TextureStreamer::Update()
+    {
+        requests = 0;
+
+        for (const Result& result : TakeFinished())
+        {
+            StreamedBin& bin = bins[result.bin];
+            bin.loading = false;
+            bin.failed = result.layers.empty();
+
+            // Layers added or mips evicted while loading make the result stale, it's requested again if still needed
+            if (bin.failed || atlas.ResidentLevel(result.bin) != result.level + 1 || atlas.Layers(result.bin) != result.layers.size())
+            {
+                continue;
+            }
+            atlas.StreamIn(result.bin, result.layers);
+        }
+
+        // Bins growing or a lower budget can leave us above it without anything new being requested
+        size_t resident = atlas.Stats().bytes;
+        while (resident > budget)
+        {
+            const std::optional<uint32_t> victim = FindVictim(std::numeric_limits<uint32_t>::max(), std::numeric_limits<float>::max());
+            if (!victim.has_value())
+            {
+                break;
+            }
+
+            const uint32_t level = atlas.ResidentLevel(*victim);
+            resident -= atlas.LevelBytes(*victim, level);
+            atlas.Evict(*victim, level + 1);
+        }
+
+        // Mips being loaded count against the budget already
+        size_t reserved {0};
+        std::vector<uint32_t> candidates {};
+        for (const auto& [index, bin] : bins)
+        {
+            const uint32_t residentLevel = atlas.ResidentLevel(index);
+            if (bin.loading)
+            {
+                reserved += atlas.LevelBytes(index, residentLevel - 1);
+            }
+            else if (!bin.failed && bin.lastVisibleFrame == frame && residentLevel > bin.wantedLevel)
+            {
+                candidates.push_back(index);
+            }
+        }
+
+        std::ranges::sort(candidates, [this](const uint32_t a, const uint32_t b) { return bins[a].coverage > bins[b].coverage; });
+
+        for (const uint32_t index : candidates)
+        {
+            if (requests >= MaxRequestsPerFrame)
+            {
+                break;
+            }
+
+            StreamedBin& bin = bins[index];
+            const uint32_t level = atlas.ResidentLevel(index) - 1;
+            const size_t cost = atlas.LevelBytes(index, level);
+
+            while (resident + reserved + cost > budget)
+            {
+                const std::optional<uint32_t> victim = FindVictim(index, bin.coverage);
+                if (!victim.has_value())
+                {
+                    break;
+                }
+
+                const uint32_t victimLevel = atlas.ResidentLevel(*victim);
+                resident -= atlas.LevelBytes(*victim, victimLevel);
+                atlas.Evict(*victim, victimLevel + 1);
+            }
+
+            if (resident + reserved + cost > budget)
+            {
+                continue;
+            }
+
+            {
+                std::lock_guard lock(mutex);
+                queue.push_back({.bin = index, .level = level, .size = bin.size, .paths = bin.paths});
+                pending++;
+            }
+            wake.notify_one();
+
+            bin.loading = true;
+            reserved += cost;
+            requests++;
+        }
+
+        for (auto& [index, bin] : bins)
+        {
+            bin.wantedLevel = bin.coarsestLevel;
+            bin.coverage = 0.0f;
+        }
+        frame++;
+    }
+
+    size_t TextureStreamer::Pending()
+    {
+        std::lock_guard lock(mutex);
+        return pending;
+    }
+
+    std::vector<uint8_t> TextureStreamer::Downsample(const std::span<const uint8_t> rgba, const uint2 size)
+    {
+        const uint2 half = TextureAtlas::MipSize(size, 1);
+        std::vector<uint8_t> pixels(size_t {half.x} * half.y * 4);
+
+        for (uint32_t y = 0; y < half.y; y++)
+        {
+            const uint32_t y0 = std::min(y * 2, size.y - 1);
+            const uint32_t y1 = std::min(y * 2 + 1, size.y - 1);
+            for (uint32_t x = 0; x < half.x; x++)
+            {
+                const uint32_t x0 = std::min(x * 2, size.x - 1);
+                const uint32_t x1 = std::min(x * 2 + 1, size.x - 1);
+                for (uint32_t channel = 0; channel < 4; channel++)
+                {
+                    const uint32_t sum = rgba[(size_t {y0} * size.x + x0) * 4 + channel] + rgba[(size_t {y0} * size.x + x1) * 4 + channel]
+                        + rgba[(size_t {y1} * size.x + x0) * 4 + channel] + rgba[(size_t {y1} * size.x + x1) * 4 + channel];
+                    pixels[(size_t {y} * half.x + x) * 4 + channel] = static_cast<uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+        return pixels;
+    }
+
+    std::optional<uint32_t> TextureStreamer::FindVictim(const uint32_t requester, const float coverage) const
+    {
+        // Bins holding more than they needed this frame go first, the longest invisible of them before the others.
+        // Otherwise the least covered bin that is less covered than the requester.
+        std::optional<uint32_t> victim {};
+        bool victimSurplus {false};
+        for (const auto& [index, bin] : bins)
+        {
+            const uint32_t residentLevel = atlas.ResidentLevel(index);
+            if (index == requester || bin.loading || residentLevel >= bin.coarsestLevel)
+            {
+                continue;
+            }
+
+            const bool surplus = residentLevel < bin.wantedLevel;
+            if (!surplus && bin.coverage >= coverage)
+            {
+                continue;
+            }
+
+            if (!victim.has_value() || (surplus && !victimSurplus))
+            {
+                victim = index;
+                victimSurplus = surplus;
+                continue;
+            }
+
+            const StreamedBin& current = bins.at(*victim);
+            const bool better = surplus == victimSurplus
+                && (surplus ? bin.lastVisibleFrame < current.lastVisibleFrame : bin.coverage < current.coverage);
+            if (better)
+            {
+                victim = index;
+            }
+        }
+        return victim;
+    }
+
+    std::vector<TextureStreamer::Result> TextureStreamer::TakeFinished()
+    {
+        std::lock_guard lock(mutex);
+        pending -= finished.size();
+        return std::exchange(finished, {});
+    }
+
+    void TextureStreamer::WorkerLoop()
+    {
+        while (true)
+        {
+            Request request {};
+            {
+                std::unique_lock lock(mutex);
+                wake.wait(lock, [this] { return stopping || !queue.empty(); });
+                if (stopping)
+                {
+                    break;
+                }
+
+                request = std::move(queue.front());
+                queue.pop_front();
+            }
+
+            Result result = Load(request);
+
+            std::lock_guard lock(mutex);
+            finished.push_back(std::move(result));
+        }
+    }
+
+    TextureStreamer::Result TextureStreamer::Load(const Request& request) const
+    {
+        Result result {.bin = request.bin, .level = request.level};
+        for (const std::string& path : request.paths)
+        {
+            const std::string file = fileIO.ReadFile(path);
+
+            int width {0};
+            int height {0};
+            int channels {0};
+            stbi_uc* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(file.data()), static_cast<int>(file.size()), &width, &height, &channels, STBI_rgb_alpha);
+            if (pixels == nullptr || uint2(width, height) != request.size)
+            {
+                LogRenderer->Error("Could not stream mip {} of texture {}", request.level, path);
+                stbi_image_free(pixels);
+                result.layers.clear();
+                return result;
+            }
+
+            uint2 size = request.size;
+            std::vector<uint8_t> mip(pixels, pixels + size_t {size.x} * size.y * 4);
+            stbi_image_free(pixels);
+            for (uint32_t level = 0; level < request.level; level++)
+            {
+                mip = Downsample(mip, size);
+                size = TextureAtlas::MipSize(size, 1);
+            }
+            result.layers.push_back(std::move(mip));
+        }
+        return result;
+    }
+}
@@ -0,0 +1,117 @@
+﻿#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "TextureAtlas.hpp"
+
+namespace blackbox
+{
+    class FileIO;
+
+    /**
+     * Keeps large textures at the mip their on-screen size needs, within a budget for all texture memory.
+     *
+     * Streamed textures are created with only their mips up to ResidentSize, which stay resident for good. Every
+     * frame the backend reports how many pixels each visible streamed texture covers, and Update asks a loader
+     * thread for the next finer mip of the bins that are short of it, most covered pixels first. The loader
+     * re-reads and decodes the source files, the render thread only uploads the result.
+     *
+     * Residency is per TextureAtlas bin, because all layers of a texture array share their mip range, so a bin
+     * streams in as far as its most demanding texture needs. When a request doesn't fit the budget, mips are
+     * evicted from bins that have more than they currently need first, then from less covered bins.
+     */
+    class TextureStreamer
+    {
+    public:
+        static constexpr uint32_t ResidentSize = 64; // Largest side of the mip every streamed texture keeps
+        static constexpr size_t DefaultBudget = 256 * 1024 * 1024;
+        static constexpr uint32_t MaxRequestsPerFrame = 4;
+
+    private:
+        struct Request
+        {
+            uint32_t bin {0};
+            uint32_t level {0};
+            uint2 size {};
+            std::vector<std::string> paths {}; // One per layer
+        };
+
+        struct Result
+        {
+            uint32_t bin {0};
+            uint32_t level {0};
+            std::vector<std::vector<uint8_t>> layers {}; // Empty when a file could not be loaded
+        };
+
+        struct StreamedBin
+        {
+            uint2 size {};
+            uint32_t coarsestLevel {0}; // The always resident mip
+            std::vector<std::string> paths {}; // Source of every layer
+            uint32_t wantedLevel {0};   // Finest mip a visible texture asked for this frame
+            float coverage {0.0f};      // Largest on-screen size in pixels of its textures this frame
+            uint64_t lastVisibleFrame {0};
+            bool loading {false};
+            bool failed {false};        // A source file could not be loaded, the bin stays at what it has
+        };
+
+        const FileIO& fileIO;
+        TextureAtlas& atlas;
+        std::unordered_map<uint32_t, StreamedBin> bins {};
+        size_t budget {DefaultBudget};
+        uint64_t frame {1};
+        uint32_t requests {0};
+
+        std::thread thread {};
+        std::mutex mutex {};
+        std::condition_variable wake {};
+        std::deque<Request> queue {};
+        std::vector<Result> finished {};
+        size_t pending {0}; // Requested but not yet taken, guarded by `mutex`
+        bool stopping {false};
+
+    public:
+        TextureStreamer(const FileIO& fileIO, TextureAtlas& atlas);
+        ~TextureStreamer();
+
+        TextureStreamer(const TextureStreamer& other) = delete;
+        TextureStreamer& operator=(const TextureStreamer&) = delete;
+        TextureStreamer(TextureStreamer&& other) = delete;
+        TextureStreamer& operator=(TextureStreamer&& other) = delete;
+
+        // Whether textures of this size are worth streaming, smaller ones are inserted into the atlas directly
+        [[nodiscard]] static bool ShouldStream(uint2 size);
+
+        // Insert the coarse mips of a texture that can be loaded again from `path`, `rgba` is the whole image
+        [[nodiscard]] std::optional<AtlasRegion> Add(const std::string& path, std::span<const uint8_t> rgba, uint2 size);
+
+        // A streamed texture in `bin` covers about `pixels` pixels across on screen this frame
+        void MarkVisible(uint32_t bin, float pixels);
+
+        // Upload finished mips, evict to stay within the budget and request mips for what was visible, once per frame
+        void Update();
+
+        void SetBudget(const size_t bytes) { budget = bytes; }
+        [[nodiscard]] size_t Budget() const { return budget; }
+        [[nodiscard]] uint32_t RequestsThisFrame() const { return requests; }
+        [[nodiscard]] size_t Pending();
+
+        // Half the size in both directions with a 2x2 box filter, odd edges repeat their last texel
+        [[nodiscard]] static std::vector<uint8_t> Downsample(std::span<const uint8_t> rgba, uint2 size);
+
+    private:
+        [[nodiscard]] std::optional<uint32_t> FindVictim(uint32_t requester, float coverage) const;
+        [[nodiscard]] std::vector<Result> TakeFinished();
+        void WorkerLoop();
+        [[nodiscard]] Result Load(const Request& request) const;
+    };
+}
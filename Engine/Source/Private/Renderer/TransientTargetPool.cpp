@@ -0,0 +1,45 @@
+﻿#include "TransientTargetPool.hpp"
+
+#include <algorithm>
+
+#include "RenderBackend.hpp"
+
+namespace blackbox
+{
+    TransientTargetPool::~TransientTargetPool()
+    {
+        for (const Entry& entry : entries)
+        {
+            backend.DestroyTarget(entry.texture);
+        }
+    }
+
+    TargetTexture TransientTargetPool::Acquire(const TargetDesc& desc, const uint32_t instance)
+    {
+        const auto found = std::ranges::find_if(entries, [&](const Entry& entry) { return entry.desc == desc && entry.instance == instance; });
+        if (found != entries.end())
+        {
+            found->unusedFrames = 0;
+            return found->texture;
+        }
+
+        const TargetTexture texture = backend.CreateTarget(desc);
+        entries.push_back({.desc = desc, .instance = instance, .texture = texture});
+        bytes += desc.Bytes();
+        return texture;
+    }
+
+    void TransientTargetPool::EndFrame()
+    {
+        std::erase_if(entries, [this](Entry& entry)
+        {
+            if (++entry.unusedFrames <= MaxUnusedFrames)
+            {
+                return false;
+            }
+            backend.DestroyTarget(entry.texture);
+            bytes -= entry.desc.Bytes();
+            return true;
+        });
+    }
+}
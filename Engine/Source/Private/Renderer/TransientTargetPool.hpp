@@ -0,0 +1,60 @@
+﻿#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "RenderGraph.hpp"
+
+namespace blackbox
+{
+    class RenderBackend;
+
+    /**
+     * Textures for the RenderGraph's transient targets, created through the backend and kept between frames.
+     *
+     * Textures are looked up by their TargetDesc and the index among the frame's physical targets of that
+     * description, so the same graph gets the same textures every frame. A texture no graph asked for in
+     * MaxUnusedFrames frames is destroyed, which frees the old sizes after a resize.
+     *
+     *   const TargetTexture texture = pool.Acquire({size, TargetFormat::RGBA16F}, 0);
+     *   ...
+     *   pool.EndFrame();
+     */
+    class TransientTargetPool
+    {
+    public:
+        // Enough for a pass that only runs every other frame to keep its textures
+        static constexpr uint32_t MaxUnusedFrames = 8;
+
+    private:
+        struct Entry
+        {
+            TargetDesc desc {};
+            uint32_t instance {0};
+            TargetTexture texture {};
+            uint32_t unusedFrames {0};
+        };
+
+        RenderBackend& backend;
+        std::vector<Entry> entries {};
+        size_t bytes {0};
+
+    public:
+        explicit TransientTargetPool(RenderBackend& backend) : backend(backend) {}
+        ~TransientTargetPool();
+
+        TransientTargetPool(const TransientTargetPool& other) = delete;
+        TransientTargetPool& operator=(const TransientTargetPool&) = delete;
+        TransientTargetPool(TransientTargetPool&& other) = delete;
+        TransientTargetPool& operator=(TransientTargetPool&& other) = delete;
+
+        // The `instance`th texture of `desc`, created the first time it's asked for
+        TargetTexture Acquire(const TargetDesc& desc, uint32_t instance);
+        // Destroys the textures that haven't been acquired for MaxUnusedFrames frames
+        void EndFrame();
+
+        [[nodiscard]] size_t Size() const { return entries.size(); }
+        [[nodiscard]] size_t Bytes() const { return bytes; }
+    };
+}
@@ -0,0 +1,58 @@
+﻿#pragma once
+
+#include <array>
+#include <cstdint>
+#include <glm/mat4x4.hpp>
+
+#include "Types.hpp"
+
+// C++ mirrors of the std140 uniform blocks shared by all shaders, declared for GLSL in Content/UniformBlocks.glsl.
+// GLSL 330 has no `layout(binding = N)`, so the backend looks blocks up by name after linking and assigns these
+// binding points with glUniformBlockBinding. Members are only mat4/vec4 sized to keep the C++ layout identical to std140.
+namespace blackbox
+{
+    // Texture slots per material, samplers `texture1` to `texture4`
+    constexpr size_t MaterialTextureSlots = 4;
+
+    // MaterialData holds an array of this many materials and instances pick theirs by index, so draws of different
+    // materials can merge. Mirrors MATERIALS_PER_BLOCK, sized so a block fits the 16 KiB GL guarantees.
+    constexpr size_t MaterialsPerBlock = 128;
+
+    enum class UniformBinding : uint32_t
+    {
+        Frame,    // Once per frame
+        Pass,     // Whenever the render pass changes
+        Material, // Whenever the material changes
+        Count,
+    };
+
+    struct FrameBlock
+    {
+        glm::mat4 view {1.0f};
+        glm::mat4 projection {1.0f};
+        glm::mat4 viewProjection {1.0f};
+        float4 cameraPosition {};
+        float4 time {}; // x: seconds since start, y: delta time
+        float4 clusterScale {}; // LightClusters::ClusterScale
+        int4 clusterCount {};   // xyz: LightClusters along x, y and depth, w: lights
+        float4 ambientLight {}; // rgb: added to the clustered lights
+    };
+
+    struct PassBlock
+    {
+        float4 viewport {}; // xy: size in pixels, zw: 1 / size
+        int4 pass {};       // x: RenderPass
+    };
+
+    struct MaterialBlock
+    {
+        float4 color {1.0f};
+        float4 params {0.2f, 0.0f, 0.0f, 0.0f}; // x: texture2 blend with TEXTURE_BLEND, y: alpha cutoff with ALPHA_TEST
+
+        // Filled in by the backend from the textures' TextureAtlas regions
+        std::array<float4, MaterialTextureSlots> textureRects {}; // xy: offset, zw: scale of the texture coordinates
+        int4 textureLayers {};
+    };
+
+    constexpr const char* UniformBlockNames[] {"FrameData", "PassData", "MaterialData"};
+}
@@ -4,6 +4,31 @@
 
 #include "EventBus.hpp"
 
+namespace
+{
+    // Second context on the same window, made current on a background thread. It never draws to the window.
+    class SharedWindowContext final : public blackbox::GLContext
+    {
+        SDL_Window* window {nullptr};
+        SDL_GLContext context {nullptr};
+
+    public:
+        SharedWindowContext(SDL_Window* window, const SDL_GLContext context) : window(window), context(context) {}
+        ~SharedWindowContext() override { SDL_GL_DestroyContext(context); }
+
+        SharedWindowContext(const SharedWindowContext& other) = delete;
+        SharedWindowContext& operator=(const SharedWindowContext&) = delete;
+        SharedWindowContext(SharedWindowContext&& other) = delete;
+        SharedWindowContext& operator=(SharedWindowContext&& other) = delete;
+
+        void MakeCurrent() override { SDL_GL_MakeCurrent(window, context); }
+        void ReleaseCurrent() override { SDL_GL_MakeCurrent(window, nullptr); }
+        void Present() override {}
+        [[nodiscard]] blackbox::uint2 FramebufferSize() const override { return {}; }
+        [[nodiscard]] void* GetProcAddress(const char* name) const override { return reinterpret_cast<void*>(SDL_GL_GetProcAddress(name)); }
+    };
+}
+
 blackbox::Window::Window(
     EventBus& eventbus, 
     const uint32_t width,
@@ -34,7 +59,8 @@ blackbox::Window::Window(
         SDL_DestroySurface(iconSurface);
     }
 
-    if (SDL_GL_CreateContext(raw) == nullptr)
+    context = SDL_GL_CreateContext(raw);
+    if (context == nullptr)
     {
         LogEngine->Error("Failed to create openGL context. {}", SDL_GetError());
     }
@@ -49,6 +75,7 @@ blackbox::Window::Window(
     LogEngine->Info("OpenGL Version: {}", reinterpret_cast<const char*>(glGetString(GL_VERSION)));
     LogEngine->Info("OpenGL Renderer: {}", reinterpret_cast<const char*>(glGetString(GL_RENDERER)));
 
+    SDL_GetWindowSize(raw, &this->width, &this->height);
     glViewport(0, 0, Width(), Height());
 
     EnableVSync(true);
@@ -56,12 +83,14 @@ blackbox::Window::Window(
 
 blackbox::Window::~Window()
 {
+    SDL_GL_DestroyContext(context);
     SDL_DestroyWindow(raw);
 }
 
 float blackbox::Window::AspectRatio() const
 {
-    return Width<float>() / Height<float>();
+    // A minimized window can report a height of 0
+    return height > 0 ? Width<float>() / Height<float>() : 1.0f;
 }
 
 void blackbox::Window::SwapBuffers() const
@@ -74,10 +103,63 @@ void blackbox::Window::EnableVSync(const bool enabled) const
     SDL_GL_SetSwapInterval(enabled);
 }
 
+void blackbox::Window::MakeCurrent()
+{
+    SDL_GL_MakeCurrent(raw, context);
+}
+
+void blackbox::Window::ReleaseCurrent()
+{
+    SDL_GL_MakeCurrent(raw, nullptr);
+}
+
+void* blackbox::Window::GetProcAddress(const char* name) const
+{
+    return reinterpret_cast<void*>(SDL_GL_GetProcAddress(name));
+}
+
+std::unique_ptr<blackbox::GLContext> blackbox::Window::CreateSharedContext()
+{
+    // SDL shares with whatever is current and makes the new context current, so the window's context is restored after
+    MakeCurrent();
+    SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 1);
+    const SDL_GLContext shared = SDL_GL_CreateContext(raw);
+    SDL_GL_SetAttribute(SDL_GL_SHARE_WITH_CURRENT_CONTEXT, 0);
+    MakeCurrent();
+
+    if (shared == nullptr)
+    {
+        LogEngine->Warn("Failed to create shared OpenGL context. {}", SDL_GetError());
+        return nullptr;
+    }
+
+    return std::make_unique<SharedWindowContext>(raw, shared);
+}
+
+void blackbox::Window::ApplyPendingResize()
+{
+    if (!resizePending)
+    {
+        return;
+    }
+
+    resizePending = false;
+    eventbus.Broadcast(ViewportResizedEvent{.size = {Width<uint32_t>(), Height<uint32_t>()}});
+}
+
 void blackbox::Window::OnWindowResized(const WindowResizedEvent event)
 {
-    LogEngine->Info("Resized window from ({}, {}) -> ({}, {})", Width(), Height(), event.windowSize.x, event.windowSize.y);
-    glViewport(0, 0, static_cast<int32_t>(event.windowSize.y), static_cast<int32_t>(event.windowSize.y));
+    const int32_t newWidth = static_cast<int32_t>(event.windowSize.x);
+    const int32_t newHeight = static_cast<int32_t>(event.windowSize.y);
+    if (newWidth == width && newHeight == height)
+    {
+        return;
+    }
+
+    LogEngine->Trace("Resized window from ({}, {}) -> ({}, {})", width, height, newWidth, newHeight);
+    width = newWidth;
+    height = newHeight;
+    resizePending = true;
 }
 
 std::string blackbox::Window::GetBuildModeSuffix() const
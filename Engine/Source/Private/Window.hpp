@@ -8,19 +8,26 @@
 
 #include "Events.hpp"
 #include "Types.hpp"
+#include "Renderer/GLContext.hpp"
 
 namespace blackbox
 {
     class EventBus;
     
-    class Window
+    class Window final : public GLContext
     {
         SDL_Window* raw {nullptr};
+        SDL_GLContext context {nullptr};
         EventBus& eventbus;
+
+        // Kept up to date from resize events so the accessors never have to ask SDL
+        int32_t width {0};
+        int32_t height {0};
+        bool resizePending {false};
         
     public:
         Window(EventBus& eventbus, uint32_t width, uint32_t height, const std::string& name, const std::string& icon = {});
-        ~Window();
+        ~Window() override;
 
         Window(const Window& other) = delete;
         Window &operator=(const Window&) = delete;
@@ -35,8 +42,20 @@ namespace blackbox
 
         void SwapBuffers() const;
         void EnableVSync(bool enabled = true) const;
+
+        // Apply the resizes received since the last call and broadcast a single ViewportResizedEvent, the renderer
+        // sets its viewport from that. Called once per frame so a drag doesn't reallocate render targets per event.
+        void ApplyPendingResize();
         
         void OnWindowResized(WindowResizedEvent event);
+
+        // GLContext
+        void MakeCurrent() override;
+        void ReleaseCurrent() override;
+        void Present() override { SwapBuffers(); }
+        [[nodiscard]] uint2 FramebufferSize() const override { return {Width<uint32_t>(), Height<uint32_t>()}; }
+        [[nodiscard]] void* GetProcAddress(const char* name) const override;
+        [[nodiscard]] std::unique_ptr<GLContext> CreateSharedContext() override;
         
     private:
         [[nodiscard]] std::string GetBuildModeSuffix() const;
@@ -45,18 +64,12 @@ namespace blackbox
     template <Numeric T>
     T Window::Width() const
     {
-        int32_t width {};
-        SDL_GetWindowSize(raw, &width, nullptr);
-
         return static_cast<T>(width);
     }
 
     template <Numeric T>
     T Window::Height() const
     {
-        int32_t height {};
-        SDL_GetWindowSize(raw, nullptr, &height);
-
         return static_cast<T>(height);
     }
 }
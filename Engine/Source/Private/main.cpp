@@ -1,10 +1,10 @@
 ﻿#include "Engine.hpp"
 
-int main(int /*argc*/, char* /*argv*/[])
+int main(int argc, char* argv[])
 {
-    Engine.Initialize();
+    Engine.Initialize(argc, argv);
     Engine.Run();
     Engine.Shutdown();
 
-    return 0;
+    return Engine.ExitCode();
 }
@@ -1,7 +1,10 @@
 ﻿#pragma once
 
+#include <memory>
 #include <string>
 
+#include "FileStream.hpp"
+
 namespace blackbox
 {
     class FileIO
@@ -16,5 +19,8 @@ namespace blackbox
         FileIO& operator=(FileIO&& other) = delete;
 
         std::string ReadFile(const std::string& filepath) const;
+
+        // Open a file for chunked reading, at most two chunks of chunkSize bytes are kept in memory at once
+        [[nodiscard]] std::unique_ptr<FileStream> OpenStream(const std::string& filepath, size_t chunkSize = 1024 * 1024) const;
     };
 }
@@ -0,0 +1,98 @@
+﻿#pragma once
+
+#include <array>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <span>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace blackbox
+{
+    struct FileChunk
+    {
+        std::span<const std::byte> data {};
+        uint64_t offset {0}; // Byte offset of this chunk in the file
+        bool last {false};   // True for the final chunk of the file
+    };
+
+    /**
+     * Reads a file as a sequence of fixed-size chunks without ever holding more than two of them in memory.
+     *
+     * A background thread prefetches the next chunk while the consumer works on the current one. Once both
+     * buffers are filled the reader waits until the consumer hands one back, so a slow consumer throttles the
+     * disk reads instead of growing memory (backpressure).
+     *
+     * Usage:
+     *   auto stream = fileIO->OpenStream("Content/Level.bin", 4 * 1024 * 1024);
+     *   FileChunk chunk {};
+     *   while (stream->Acquire(chunk))
+     *   {
+     *       Process(chunk.data);
+     *   }
+     */
+    class FileStream
+    {
+        enum class SlotState : uint8_t { Free, Ready, Acquired };
+
+        struct Slot
+        {
+            std::vector<std::byte> buffer {};
+            size_t size {0};
+            uint64_t offset {0};
+            bool last {false};
+            SlotState state {SlotState::Free};
+        };
+
+        std::ifstream file {};
+        uint64_t fileSize {0};
+        size_t chunkSize {0};
+
+        std::array<Slot, 2> slots {};
+        uint32_t readSlot {0};  // Next slot the consumer will acquire
+        uint32_t writeSlot {0}; // Next slot the prefetch thread will fill
+        bool holdingChunk {false};
+        bool finished {false};  // Prefetch thread reached end of file (or failed)
+        bool stopRequested {false};
+
+        mutable std::mutex mutex {};
+        std::condition_variable chunkReady {};
+        std::condition_variable slotFreed {};
+        std::thread prefetchThread {};
+
+    public:
+        FileStream(const std::string& filepath, size_t chunkSize);
+        ~FileStream();
+
+        FileStream(const FileStream& other) = delete;
+        FileStream &operator=(const FileStream&) = delete;
+        FileStream(FileStream&& other) = delete;
+        FileStream& operator=(FileStream&& other) = delete;
+
+        [[nodiscard]] bool IsOpen() const { return file.is_open(); }
+        [[nodiscard]] uint64_t Size() const { return fileSize; }
+        [[nodiscard]] size_t ChunkSize() const { return chunkSize; }
+
+        // True if the next chunk has been prefetched and Acquire would not block
+        [[nodiscard]] bool IsChunkReady() const;
+
+        // Blocks until the next chunk is available. Returns false once the whole file has been consumed.
+        // The previously acquired chunk is released, its data must not be used after this call.
+        bool Acquire(FileChunk& chunk);
+
+        // Non-blocking variant of Acquire, returns false if the next chunk is not ready yet (or the stream ended)
+        bool TryAcquire(FileChunk& chunk);
+
+        // Hand the current chunk back to the prefetch thread so it can be refilled
+        void Release();
+
+    private:
+        void PrefetchLoop();
+        void ReleaseLocked();
+        void TakeReadySlot(FileChunk& chunk);
+    };
+}
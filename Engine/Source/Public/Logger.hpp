@@ -1,10 +1,34 @@
 ﻿#pragma once
 
+#include <atomic>
 #include <memory>
+#include <string_view>
 #include <spdlog/spdlog.h>
 
 namespace blackbox
 {
+enum class LogOverflowPolicy : uint8_t
+{
+    Block,        // Wait until the background thread frees a slot, no message is lost
+    Drop,         // Silently discard the message
+    DropAndCount, // Discard the message and report how many were lost once the queue drains
+};
+
+enum class LogLevel : uint8_t
+{
+    Trace,
+    Info,
+    Warn,
+    Error,
+    Off,
+};
+
+struct AsyncLogSettings
+{
+    size_t queueSize {8192}; // Number of messages that can be in flight, rounded up to a power of two
+    LogOverflowPolicy overflowPolicy {LogOverflowPolicy::DropAndCount};
+};
+
 /**
  * Logger class for outputting color-coded messages to the console using spdlog.
  *
@@ -18,56 +42,113 @@ namespace blackbox
  * - Info:  Green  — for general informative messages.
  * - Warn:  Yellow — for warnings that aren't fatal but might require attention.
  * - Error: Red    — for serious issues that require immediate attention.
+ *
+ * Every category has its own runtime level. The default is Trace in Debug, Info in Development and Warn in
+ * Shipping builds, it can be changed per category with Logger::SetLevel or Logger::ApplyLevelSpec (the engine
+ * reads Content/Config/Logging.ini and the -LogLevel= command line option). A disabled level costs one branch.
+ *
+ * Format strings are checked at compile time and never copied into a std::string, a disabled level returns
+ * before anything is formatted. Use BB_LOG to also skip evaluating the arguments.
+ *
+ * By default messages are written to the console on the calling thread. After Logger::EnableAsync() the
+ * calling thread only formats the message and pushes it into a lock-free queue, a background thread does
+ * the console output. Call Logger::Shutdown() before exiting so nothing queued is lost.
  */
 class Logger
 {
     std::shared_ptr<spdlog::logger> log {};
+    std::atomic<LogLevel> level {LogLevel::Trace};
     
 public:
     explicit Logger(const std::string& name);
+    ~Logger();
+
+    Logger(const Logger& other) = delete;
+    Logger& operator=(const Logger&) = delete;
+    Logger(Logger&& other) = delete;
+    Logger& operator=(Logger&& other) = delete;
+
+    // Move console output for every logger to a background thread
+    static void EnableAsync(const AsyncLogSettings& settings = {});
+
+    // Write out everything still queued and stop the background thread, logging continues synchronously
+    static void Shutdown();
+
+    // Set the level of a category by name, "All" targets every category. Applies to categories created later too.
+    static void SetLevel(std::string_view category, LogLevel level);
+
+    // Apply a list of `Category=Level` pairs separated by commas or newlines, e.g. "All=Warn,LogRenderer=Trace".
+    // Lines starting with ';' or '#' are ignored. Returns false if any entry could not be parsed.
+    static bool ApplyLevelSpec(std::string_view spec);
+
+    void SetLevel(const LogLevel newLevel) { level.store(newLevel, std::memory_order_relaxed); }
+    [[nodiscard]] LogLevel GetLevel() const { return level.load(std::memory_order_relaxed); }
+    [[nodiscard]] const std::string& Name() const { return log->name(); }
+
+    // Cheap check callers can use to skip building expensive arguments, see BB_LOG
+    [[nodiscard]] bool IsEnabled(const LogLevel messageLevel) const { return messageLevel >= level.load(std::memory_order_relaxed); }
 
     template <typename... TArgs>
-    void Trace(const std::string& format, TArgs&&... args);
+    void Trace(spdlog::format_string_t<TArgs...> format, TArgs&&... args);
 
     template <typename... TArgs>
-    void Info(const std::string& format, TArgs&&... args);
+    void Info(spdlog::format_string_t<TArgs...> format, TArgs&&... args);
 
     template <typename... TArgs>
-    void Warn(const std::string& format, TArgs&&... args);
+    void Warn(spdlog::format_string_t<TArgs...> format, TArgs&&... args);
 
     template <typename... TArgs>
-    void Error(const std::string& format, TArgs&&... args);
+    void Error(spdlog::format_string_t<TArgs...> format, TArgs&&... args);
 };
 
 template <typename... TArgs>
-void Logger::Trace(const std::string& format, TArgs&&... args)
+void Logger::Trace(spdlog::format_string_t<TArgs...> format, TArgs&&... args)
 {
-#ifndef NDEBUG
-    log->trace(fmt::runtime(format), std::forward<TArgs>(args)...);
-#endif
+    if (IsEnabled(LogLevel::Trace))
+    {
+        log->trace(format, std::forward<TArgs>(args)...);
+    }
 }
 
-template <typename... Args>
-void Logger::Info(const std::string& format, Args&&... args)
+template <typename... TArgs>
+void Logger::Info(spdlog::format_string_t<TArgs...> format, TArgs&&... args)
 {
-#ifndef NDEBUG
-    log->info(fmt::runtime(format), std::forward<Args>(args)...);
-#endif
+    if (IsEnabled(LogLevel::Info))
+    {
+        log->info(format, std::forward<TArgs>(args)...);
+    }
 }
 
-template <typename... Args>
-void Logger::Warn(const std::string& format, Args&&... args)
+template <typename... TArgs>
+void Logger::Warn(spdlog::format_string_t<TArgs...> format, TArgs&&... args)
 {
-#ifndef NDEBUG
-    log->warn(fmt::runtime(format), std::forward<Args>(args)...);
-#endif
+    if (IsEnabled(LogLevel::Warn))
+    {
+        log->warn(format, std::forward<TArgs>(args)...);
+    }
 }
 
-template <typename... Args>
-void Logger::Error(const std::string& format, Args&&... args)
+template <typename... TArgs>
+void Logger::Error(spdlog::format_string_t<TArgs...> format, TArgs&&... args)
 {
-#ifndef NDEBUG        
-    log->error(fmt::runtime(format), std::forward<Args>(args)...);
-#endif
+    if (IsEnabled(LogLevel::Error))
+    {
+        log->error(format, std::forward<TArgs>(args)...);
+    }
 }
 }
+
+/**
+ * Logs through `Category` only if `Level` is enabled, the format arguments are not evaluated otherwise.
+ * Prefer this over calling the Logger directly when an argument is expensive to compute.
+ *
+ *   BB_LOG(LogRenderer, Trace, "Visible objects: {}", CountVisible());
+ */
+#define BB_LOG(Category, Level, ...) \
+    do \
+    { \
+        if ((Category)->IsEnabled(::blackbox::LogLevel::Level)) \
+        { \
+            (Category)->Level(__VA_ARGS__); \
+        } \
+    } while (false)
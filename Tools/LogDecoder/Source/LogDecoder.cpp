@@ -0,0 +1,315 @@
+﻿// Turns a binary log written by blackbox::BinaryLog back into text.
+//
+// Usage: LogDecoder <input.bblog> [output.txt]
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <ranges>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <spdlog/fmt/fmt.h>
+#include <spdlog/fmt/bundled/args.h>
+
+#include "BinaryLogFormat.hpp"
+
+namespace
+{
+    using namespace blackbox::binarylog;
+
+    constexpr std::string_view LevelNames[] {"Trace", "Info", "Warn", "Error", "Off"};
+
+    struct Descriptor
+    {
+        uint8_t level {0};
+        uint32_t line {0};
+        std::vector<ArgType> args {};
+        std::string category {};
+        std::string file {};
+        std::string format {};
+    };
+
+    struct Line
+    {
+        uint64_t tsc {0};
+        uint32_t threadIndex {0};
+        std::string text {};
+    };
+
+    class Reader
+    {
+        const std::byte* cursor {nullptr};
+        const std::byte* end {nullptr};
+
+    public:
+        Reader(const std::byte* data, const size_t size) : cursor(data), end(data + size) {}
+
+        [[nodiscard]] bool AtEnd() const { return cursor >= end; }
+
+        template <typename T>
+        bool Read(T& value)
+        {
+            if (static_cast<size_t>(end - cursor) < sizeof(T))
+            {
+                return false;
+            }
+
+            std::memcpy(&value, cursor, sizeof(T));
+            cursor += sizeof(T);
+            return true;
+        }
+
+        // Returns the next `size` bytes and skips past them, or nullptr if fewer are left
+        const std::byte* Take(const size_t size)
+        {
+            if (static_cast<size_t>(end - cursor) < size)
+            {
+                return nullptr;
+            }
+
+            const std::byte* data = cursor;
+            cursor += size;
+            return data;
+        }
+
+        bool ReadString(std::string& value)
+        {
+            uint16_t length {0};
+            if (!Read(length) || static_cast<size_t>(end - cursor) < length)
+            {
+                return false;
+            }
+
+            value.assign(reinterpret_cast<const char*>(cursor), length);
+            cursor += length;
+            return true;
+        }
+    };
+
+    bool ReadDescriptor(Reader& reader, std::unordered_map<uint32_t, Descriptor>& descriptors)
+    {
+        uint32_t id {0};
+        uint8_t argCount {0};
+        Descriptor descriptor {};
+        if (!reader.Read(id) || !reader.Read(descriptor.level) || !reader.Read(descriptor.line) || !reader.Read(argCount))
+        {
+            return false;
+        }
+
+        descriptor.args.resize(argCount);
+        for (ArgType& type : descriptor.args)
+        {
+            if (!reader.Read(type))
+            {
+                return false;
+            }
+        }
+
+        if (!reader.ReadString(descriptor.category) || !reader.ReadString(descriptor.file) || !reader.ReadString(descriptor.format))
+        {
+            return false;
+        }
+
+        descriptors[id] = std::move(descriptor);
+        return true;
+    }
+
+    template <typename T>
+    bool PushArg(Reader& reader, fmt::dynamic_format_arg_store<fmt::format_context>& store)
+    {
+        T value {};
+        if (!reader.Read(value))
+        {
+            return false;
+        }
+
+        store.push_back(value);
+        return true;
+    }
+
+    bool DecodeArgs(Reader& reader, const Descriptor& descriptor, fmt::dynamic_format_arg_store<fmt::format_context>& store)
+    {
+        for (const ArgType type : descriptor.args)
+        {
+            bool ok {false};
+            switch (type)
+            {
+            case ArgType::Bool: ok = PushArg<bool>(reader, store); break;
+            case ArgType::Char: ok = PushArg<char>(reader, store); break;
+            case ArgType::Int32: ok = PushArg<int32_t>(reader, store); break;
+            case ArgType::UInt32: ok = PushArg<uint32_t>(reader, store); break;
+            case ArgType::Int64: ok = PushArg<int64_t>(reader, store); break;
+            case ArgType::UInt64: ok = PushArg<uint64_t>(reader, store); break;
+            case ArgType::Float: ok = PushArg<float>(reader, store); break;
+            case ArgType::Double: ok = PushArg<double>(reader, store); break;
+            case ArgType::Pointer:
+            {
+                uint64_t address {0};
+                ok = reader.Read(address);
+                store.push_back(reinterpret_cast<const void*>(static_cast<uintptr_t>(address)));
+                break;
+            }
+            case ArgType::String:
+            {
+                std::string text {};
+                ok = reader.ReadString(text);
+                store.push_back(std::move(text));
+                break;
+            }
+            }
+
+            if (!ok)
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+}
+
+int main(const int argc, char* argv[])
+{
+    if (argc < 2)
+    {
+        std::fprintf(stderr, "Usage: LogDecoder <input.bblog> [output.txt]\n");
+        return 1;
+    }
+
+    std::ifstream input(argv[1], std::ios::binary);
+    if (!input.is_open())
+    {
+        std::fprintf(stderr, "Could not open %s\n", argv[1]);
+        return 1;
+    }
+
+    const std::vector<char> raw {std::istreambuf_iterator(input), std::istreambuf_iterator<char>()};
+    Reader file(reinterpret_cast<const std::byte*>(raw.data()), raw.size());
+
+    FileHeader header {};
+    if (!file.Read(header) || header.magic != Magic)
+    {
+        std::fprintf(stderr, "%s is not a binary log\n", argv[1]);
+        return 1;
+    }
+
+    // First pass: descriptors and clock calibration can appear anywhere in the file
+    std::unordered_map<uint32_t, Descriptor> descriptors {};
+    std::vector<std::pair<ChunkType, Reader>> chunks {};
+    uint64_t tscAtOpen {0};
+    double ticksPerNanosecond {0.0};
+
+    ChunkHeader chunk {};
+    while (!file.AtEnd() && file.Read(chunk))
+    {
+        const std::byte* payload = file.Take(chunk.size);
+        if (payload == nullptr)
+        {
+            std::fprintf(stderr, "Truncated chunk at the end of the file, ignoring it\n");
+            break;
+        }
+
+        Reader reader(payload, chunk.size);
+        chunks.emplace_back(chunk.type, reader);
+
+        if (chunk.type == ChunkType::Descriptor)
+        {
+            ReadDescriptor(reader, descriptors);
+        }
+        else if (chunk.type == ChunkType::Calibration)
+        {
+            uint64_t tscNow {0};
+            uint64_t nanoseconds {0};
+            if (reader.Read(tscAtOpen) && reader.Read(tscNow) && reader.Read(nanoseconds) && nanoseconds > 0)
+            {
+                ticksPerNanosecond = static_cast<double>(tscNow - tscAtOpen) / static_cast<double>(nanoseconds);
+            }
+        }
+    }
+
+    // Second pass: decode records, threads are interleaved by timestamp afterward
+    std::vector<Line> lines {};
+    uint64_t droppedTotal {0};
+
+    for (auto& [type, reader] : chunks)
+    {
+        uint32_t threadIndex {0};
+        if (type == ChunkType::Dropped)
+        {
+            uint64_t count {0};
+            if (reader.Read(threadIndex) && reader.Read(count))
+            {
+                droppedTotal += count;
+                lines.push_back({.tsc = lines.empty() ? 0 : lines.back().tsc, .threadIndex = threadIndex, .text = fmt::format("Dropped {} message(s), staging buffer was full", count)});
+            }
+            continue;
+        }
+
+        if (type != ChunkType::Records || !reader.Read(threadIndex))
+        {
+            continue;
+        }
+
+        uint32_t id {0};
+        uint64_t tsc {0};
+        while (!reader.AtEnd() && reader.Read(id) && reader.Read(tsc))
+        {
+            const auto it = descriptors.find(id);
+            if (it == descriptors.end())
+            {
+                std::fprintf(stderr, "Unknown descriptor %u, skipping rest of chunk\n", id);
+                break;
+            }
+
+            const Descriptor& descriptor = it->second;
+            fmt::dynamic_format_arg_store<fmt::format_context> store {};
+            if (!DecodeArgs(reader, descriptor, store))
+            {
+                std::fprintf(stderr, "Truncated record for descriptor %u\n", id);
+                break;
+            }
+
+            std::string message {};
+            try
+            {
+                message = fmt::vformat(descriptor.format, store);
+            }
+            catch (const fmt::format_error& error)
+            {
+                message = fmt::format("<format error '{}' in \"{}\">", error.what(), descriptor.format);
+            }
+
+            const std::string_view level = descriptor.level < std::size(LevelNames) ? LevelNames[descriptor.level] : "?";
+            lines.push_back({.tsc = tsc, .threadIndex = threadIndex, .text = fmt::format("{} {} {}", descriptor.category, level, message)});
+        }
+    }
+
+    std::ranges::stable_sort(lines, {}, &Line::tsc);
+
+    std::FILE* output = argc > 2 ? std::fopen(argv[2], "w") : stdout;
+    if (output == nullptr)
+    {
+        std::fprintf(stderr, "Could not open %s for writing\n", argv[2]);
+        return 1;
+    }
+
+    for (const Line& line : lines)
+    {
+        const double seconds = ticksPerNanosecond > 0.0 && line.tsc >= tscAtOpen
+            ? static_cast<double>(line.tsc - tscAtOpen) / ticksPerNanosecond / 1e9
+            : 0.0;
+        fmt::print(output, "[{:12.6f}] T{} {}\n", seconds, line.threadIndex, line.text);
+    }
+
+    if (output != stdout)
+    {
+        std::fclose(output);
+    }
+
+    std::fprintf(stderr, "Decoded %zu message(s), %llu dropped\n", lines.size(), static_cast<unsigned long long>(droppedTotal));
+    return 0;
+}
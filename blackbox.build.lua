@@ -2,7 +2,14 @@ workspace "Blackbox"
     architecture "x86_64"
     configurations { "Development", "Debug", "Shipping" }
     startproject "Engine"
-    buildoptions { "/utf-8" }
+
+    filter "system:windows"
+        buildoptions { "/utf-8" }
+
+    filter "system:linux"
+        buildoptions { "-finput-charset=UTF-8", "-pthread" }
+
+    filter {}
 
     -- Output directories
     outputdir = "%{cfg.buildcfg}-%{cfg.system}-%{cfg.architecture}"
@@ -52,9 +59,6 @@ project "Engine"
 
     links
     {
-        -- Libraries
-        "SDL3.lib",
-        "opengl32.lib",
         -- Dependencies
         "EnTT",
         "fastgltf",
@@ -74,10 +78,61 @@ project "Engine"
 
     postbuildcommands
     {
-        "{COPY} %{wks.location}Engine/ThirdParty/SDL/lib/SDL3.dll %{wks.location}Binaries/\"" .. outputdir .. "\"/%{prj.name}",
         "{COPY} %{wks.location}Engine/Content/** %{wks.location}Binaries/\"" .. outputdir .. "\"/%{prj.name}/Content",
     }
 
+    filter "system:windows"
+        links { "SDL3.lib", "opengl32.lib" }
+        postbuildcommands
+        {
+            "{COPY} %{wks.location}Engine/ThirdParty/SDL/lib/SDL3.dll %{wks.location}Binaries/\"" .. outputdir .. "\"/%{prj.name}",
+        }
+
+    -- GL and EGL are resolved at runtime through SDL, only SDL3 itself comes from the system
+    filter "system:linux"
+        links { "SDL3", "dl" }
+        linkoptions { "-pthread" }
+
+    filter "configurations:Debug"
+        defines { "DEBUG" }
+        runtime "Debug"
+        symbols "On"
+
+    filter "configurations:Development"
+        defines { "DEVELOPMENT" }
+        runtime "Release"
+        symbols "On"
+        optimize "Debug"
+
+    filter "configurations:Shipping"
+        defines { "SHIPPING", "NDEBUG" }
+        runtime "Release"
+        symbols "Off"
+        optimize "Full"
+
+group "Tools"
+project "LogDecoder"
+    location "Tools/LogDecoder"
+    kind "ConsoleApp"
+    language "C++"
+    staticruntime "on"
+    cppdialect "C++20"
+
+    warnings "High"
+    targetdir ("Binaries/" .. outputdir .. "/%{prj.name}")
+    objdir ("Intermediate/" .. outputdir .. "/%{prj.name}")
+
+    files
+    {
+        "Tools/%{prj.name}/Source/**",
+    }
+
+    includedirs
+    {
+        "Engine/Source/Private/Logging/",
+        "Engine/ThirdParty/spdlog/include",
+    }
+
     filter "configurations:Debug"
         defines { "DEBUG" }
         runtime "Debug"
@@ -94,3 +149,4 @@ project "Engine"
         runtime "Release"
         symbols "Off"
         optimize "Full"
+group ""